@@ -1,10 +1,38 @@
 
 #include "ADC.h"
 #include "adc_driver.h"
+#include "TimeSynch.h"
+#include "Event.h"
+#include "Clock.h"
 
 volatile uint8_t checksumADC[3] = {0};  // checksum for FRAM test
 volatile uint8_t checksumFRAM[3] = {0};  // checksum for FRAM test
+static uint8_t Continuous;	// acquisition runs until ADC_Stop_Sampling
 
+//keep a sample: into the buffer and, if asked, FRAM. a continuous acquisition goes round the first FR_STREAM_SIZE bytes of FRAM.
+//called from the sampling ISRs
+static void storeSample(int32_t sample){
+	ADC_BUFFER[sampleCount%ADC_buffer_size] = sample;
+	if(write_to_FRAM){
+		writeFRAM((uint8_t*)(ADC_BUFFER+(sampleCount%ADC_buffer_size)), 4);
+		if(Continuous && FRAMAddress >= FR_BASEADD + FR_STREAM_SIZE) FRAMAddress = FR_BASEADD;
+	}
+	sampleCount++;
+	if(!(sampleCount % ADC_BLOCK_SAMPLES)) Event_Post(EVENT_SAMPLES);
+}
+
+
+static int8_t OffsetA = ADC_NO_OFFSET, OffsetB = ADC_NO_OFFSET;
+
+void ADC_Set_Internal_Offsets(int8_t a, int8_t b){
+	OffsetA = a;
+	OffsetB = b;
+}
+
+void ADC_Get_Internal_Offsets(int8_t* a, int8_t* b){
+	*a = OffsetA;
+	*b = OffsetB;
+}
 
 void CO_collectTemp(uint16_t *avgV, uint16_t *minV, uint16_t *maxV) {
 	
@@ -16,6 +44,7 @@ void CO_collectTemp(uint16_t *avgV, uint16_t *minV, uint16_t *maxV) {
 	volatile int8_t offset;	
 
 	ADCPower(TRUE);
+	ADC_Rail_Settle();
 
 	/* Move stored calibration values to ADCA. */
 	ADC_CalibrationValues_Load(&ADCA);
@@ -35,15 +64,18 @@ void CO_collectTemp(uint16_t *avgV, uint16_t *minV, uint16_t *maxV) {
 	                                 ADC_DRIVER_CH_GAIN_NONE);
 
 	
-	/* Get offset value for ADCA. */
-   	ADC_Ch_InputMux_Config(&ADCA.CH0, ADC_CH_MUXPOS_PIN1_gc, ADC_CH_MUXNEG_PIN1_gc);
-
-	ADC_Enable(&ADCA);
-	/* Wait until common mode voltage is stable. Default clk is 16MHz and
-	 * therefore below the maximum frequency to use this function. */
-	ADC_Wait_32MHz(&ADCA);
- 	offset = ADC_Offset_Get_Unsigned(&ADCA, &ADCA.CH0, false);
-    ADC_Disable(&ADCA);
+	/* Get offset value for ADCA, unless it was measured before. */
+	if (OffsetA == ADC_NO_OFFSET) {
+	   	ADC_Ch_InputMux_Config(&ADCA.CH0, ADC_CH_MUXPOS_PIN1_gc, ADC_CH_MUXNEG_PIN1_gc);
+
+		ADC_Enable(&ADCA);
+		/* Wait until common mode voltage is stable. Default clk is 16MHz and
+		 * therefore below the maximum frequency to use this function. */
+		ADC_Wait_32MHz(&ADCA);
+	 	OffsetA = ADC_Offset_Get_Unsigned(&ADCA, &ADCA.CH0, false);
+	    ADC_Disable(&ADCA);
+	}
+	offset = OffsetA;
     
 	/* Set input to the channels in ADCA */
 	ADC_Ch_InputMux_Config(&ADCA.CH0, ADC_CH_MUXPOS_PIN0_gc, 0);
@@ -100,8 +132,10 @@ void CO_collectBatt(uint16_t *avgV, uint16_t *minV, uint16_t *maxV) {
 	volatile int8_t offset;	
 
 	ADCPower(TRUE);
+	PortEx_Begin();
 	PortEx_DIRSET(BIT2_bm, PS_BANKB);
 	PortEx_OUTSET(BIT2_bm, PS_BANKB); // activate PIO24 (VBATT)
+	PortEx_End();
 	_delay_ms(100);
 	//setPortEx(BIT2_bm, PS_BANKB);
 		
@@ -123,14 +157,17 @@ void CO_collectBatt(uint16_t *avgV, uint16_t *minV, uint16_t *maxV) {
 	                                 ADC_DRIVER_CH_GAIN_NONE);
 
 	
-	// Get offset value for ADCB.
-   	ADC_Ch_InputMux_Config(&ADCB.CH0, ADC_CH_MUXPOS_PIN1_gc, ADC_CH_MUXNEG_PIN1_gc);
-
-	ADC_Enable(&ADCB);
-	// Wait until common mode voltage is stable. Default clk is 16MHz
-	ADC_Wait_32MHz(&ADCB);
-	offset = ADC_Offset_Get_Unsigned(&ADCB, &ADCB.CH0, false);
-    ADC_Disable(&ADCB);
+	// Get offset value for ADCB, unless it was measured before.
+	if (OffsetB == ADC_NO_OFFSET) {
+	   	ADC_Ch_InputMux_Config(&ADCB.CH0, ADC_CH_MUXPOS_PIN1_gc, ADC_CH_MUXNEG_PIN1_gc);
+
+		ADC_Enable(&ADCB);
+		// Wait until common mode voltage is stable. Default clk is 16MHz
+		ADC_Wait_32MHz(&ADCB);
+		OffsetB = ADC_Offset_Get_Unsigned(&ADCB, &ADCB.CH0, false);
+	    ADC_Disable(&ADCB);
+	}
+	offset = OffsetB;
     
 	/* Set input to the channels in ADC B */
 	ADC_Ch_InputMux_Config(&ADCB.CH0, ADC_CH_MUXPOS_PIN0_gc, 0);
@@ -280,8 +317,6 @@ void CO_collectADC_ext(uint8_t channel, uint8_t filterConfig, uint8_t gainExpone
 
 	enableADCMUX(TRUE);
 	setADCInput(channel);
-	SPIInit(SPI_MODE_1_gc);
-	SPIC.CTRL = ADC_SPI_CONFIG_gc;
 	
 	// Configure IO13 (PF0) to capture ADC DRDY signal
 	PORTF.DIRCLR = PIN0_bm;
@@ -308,8 +343,12 @@ void CO_collectADC_ext(uint8_t channel, uint8_t filterConfig, uint8_t gainExpone
 	TCC1.CTRLA = 0x00;
 	TCC1.CTRLFSET = 0x0C;
 	
-	//set the period as number of samples to know when to stop sampling (and compensate for discarded samples at start of sampling)
-	TCC1.PER = numOfSamples;
+	//set the period as number of samples to know when to stop sampling (and compensate for discarded samples at start of sampling).
+	//0 samples until stopped: the counter just wraps
+	Continuous = !numOfSamples;
+	TCC1.PER = Continuous ? 0xFFFF : numOfSamples;
+	//full speed until the acquisition ends (see Clock.h)
+	Clock_Hold(CLOCK_HOLD_ADC);
 	//Configure IO13(PF0) to drive event channel that triggers event every time a sample is collected
 	EVSYS.CH1MUX = EVSYS_CHMUX_PORTF_PIN0_gc;
 	//set overflow interrupt to low lvl
@@ -319,6 +358,8 @@ void CO_collectADC_ext(uint8_t channel, uint8_t filterConfig, uint8_t gainExpone
 	
 	////////////////////////////////////////////////////////////////////////////////////////////////////////
 	
+	// the front end has to be settled before the first sample
+	ADC_Rail_Settle();
 	// Set oscillator source and frequency and start
 	TCE1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_DIV1_gc;
 	
@@ -346,20 +387,21 @@ void CO_collectADC_ext(uint8_t channel, uint8_t filterConfig, uint8_t gainExpone
 //triggers when specified number of samples has been collected by ADC
 ISR(TCC1_OVF_vect){
 
+	if(Continuous) return;
 	// turn off ADC timer(s)
 	TCE1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_OFF_gc;
 	TCC0.CTRLA = ( TCC0.CTRLA & ~TC0_CLKSEL_gm ) | TC_CLKSEL_OFF_gc;
 	TCD0.CTRLA = ( TCD0.CTRLA & ~TC0_CLKSEL_gm ) | TC_CLKSEL_OFF_gc;
 	TCC1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_OFF_gc;
 
-	//turn off SPI bus and ADC MUX used by ADC
-	SPICS(FALSE);
-	SPIDisable();
+	//turn off ADC MUX used by ADC. SPIC is left configured and goes off with the ADC power
 	enableADCMUX(FALSE);
+	Clock_Release(CLOCK_HOLD_ADC);
 	
 	//set a global flag to tell system that all the samples have been collected
 	ADC_Sampling_Finished = 1;
 	DataAvailable = 1;
+	Event_Post(EVENT_SAMPLES);
 }
 
 //continuously take samples and send them via radio. NOT RECOMMENDED
@@ -433,12 +475,13 @@ void ADC_Stop_Sampling(){
 	TCD0.CTRLA = ( TCD0.CTRLA & ~TC0_CLKSEL_gm ) | TC_CLKSEL_OFF_gc;
 	TCC1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_OFF_gc;
 
-	//turn off SPI bus and ADC MUX used by ADC
-	SPICS(FALSE);
-	SPIDisable();
+	//turn off ADC MUX used by ADC. SPIC is left configured and goes off with the ADC power
 	enableADCMUX(FALSE);
+	Clock_Release(CLOCK_HOLD_ADC);
+	Continuous = FALSE;
 	ADC_Sampling_Finished = 1;
 	DataAvailable = 1;
+	Event_Post(EVENT_SAMPLES);
 }
 
 //returns number of samples collected by last ADC sampling time
@@ -453,6 +496,17 @@ uint16_t ADC_Get_Num_Samples(){
 	else return 0;		
 }
 
+uint32_t ADC_Get_Sample_Count(){
+
+	uint32_t count;
+	uint8_t sreg = SREG;
+
+	cli();
+	count = sampleCount;
+	SREG = sreg;
+	return count;
+}
+
 void ADC_Pause_Sampling(){
 		//ignore interrupts from the ADC...don't turn it off to avoid the boot up time
 	PORTF.INT1MASK = 0x00;
@@ -537,6 +591,7 @@ ISR(PORTF_INT0_vect) {
 	// skip first samples because cannot perform recommended reset
 	volatile int32_t currentSample;
 	volatile int64_t var;
+	const SPIBus_Device_t* prev;
 	if (discardCount < ADC_DISCARD) {
 		discardCount++;
 		if(discardCount == ADC_DISCARD){
@@ -544,16 +599,14 @@ ISR(PORTF_INT0_vect) {
 			TCC1.CTRLA = ( TCC1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_EVCH1_gc;
 		}
 	} else { 
-		// collect data from offchip ADC
-		SPICS(TRUE); // CS SPI-SS
-		PORTF.OUTCLR = PIN1_bm; // pull ADC_CS down to enable data read
+		// stamp the first sample with the captured time of its DRDY edge so the data can be put on network time
+		if(sampleCount == 0) SampleStartTime = TimeSynch_Sample_Capture();
+		// collect data from offchip ADC. takes the bus from whoever has it (e.g. the sd card in the middle of a block)
+		prev = SPIBus_Acquire(&SPIBus_ADC); // pull ADC_CS down to enable data read
 		for(uint8_t bufIndex = 0; bufIndex < 3; bufIndex++) {
-			SPIC.DATA = 0xAA; // dummy data to start SPI clock
-			while(!(SPIC.STATUS & SPI_IF_bm));
-			SPIBuffer[bufIndex] = SPIC.DATA;
+			SPIBuffer[bufIndex] = Hal_Spi_Transfer(HAL_SPIC, 0xAA); // dummy data to start SPI clock
 		}
-		PORTF.OUTSET = PIN1_bm; // pull ADC_CS up to end data read
-		SPICS(FALSE);
+		SPIBus_Release(&SPIBus_ADC, prev); // pull ADC_CS up to end data read
 
 		// create 32 bits from SPIBuffer[0:2] with sign extension of SPIBuffer[0][7]
 		if(SPIBuffer[0] & BIT7_bm) *(((uint8_t*)&currentSample) + 3) = 0xFF; // sign extension if negative
@@ -564,11 +617,7 @@ ISR(PORTF_INT0_vect) {
 		
 		//ADC_BUFFER[sampleCount] = (int32_t) -((uint64_t)currentSample * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR);
 		var = currentSample;
-		ADC_BUFFER[sampleCount%ADC_buffer_size] = (int32_t) -(var * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR);
-		if(write_to_FRAM){
-			writeFRAM((uint8_t*)(ADC_BUFFER+(sampleCount%ADC_buffer_size)), 4);
-		}
-		sampleCount++;
+		storeSample((int32_t) -(var * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR));
 	}
 }
 
@@ -576,8 +625,10 @@ ISR(PORTF_INT0_vect) {
 // Pull PIO27 high to enable
 void ACC_DCPassEnable(uint8_t enable) {
 	if (enable) {
+		PortEx_Begin();
 		PortEx_DIRSET(BIT5_bm, PS_BANKB);
 		PortEx_OUTSET(BIT5_bm, PS_BANKB);
+		PortEx_End();
 		//setPortEx(BIT5_bm, PS_BANKB);
 	} else {
 		PortEx_DIRCLR(BIT5_bm, PS_BANKB);
@@ -642,6 +693,8 @@ uint16_t averagingPtC, uint16_t averagingPtD) {
 	// set period
 	TCE1.PER = (0x20 << subsamplesPerSecond);
 	TCE1.CCBBUF = (0x10 << subsamplesPerSecond);
+	// the front end has to be settled before the first sample
+	ADC_Rail_Settle();
 	// Set oscillator source and frequency and start
 	TCE1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_DIV1_gc;
 	
@@ -694,8 +747,6 @@ uint16_t averagingPtC, uint16_t averagingPtD, uint16_t numOfSamples, int32_t* Da
 	set_ampGain(ADC_CH_8_gc, gain[2]);
 	set_filter(filterConfig);
 	ACC_DCPassEnable(DCPassEnable);
-	SPIInit(SPI_MODE_1_gc);
-	SPIC.CTRL = ADC_SPI_CONFIG_gc;
 
 	enableADCMUX(TRUE);
 	setADCInput(ADC_CH_6_gc);
@@ -737,8 +788,11 @@ uint16_t averagingPtC, uint16_t averagingPtD, uint16_t numOfSamples, int32_t* Da
 	//reset count to zero
 	TCC1.CTRLA = 0x00;
 	TCC1.CTRLFSET = 0x0C;	
-	//set the period as number of samples to know when to stop sampling
-	TCC1.PER = numOfSamples;
+	//set the period as number of samples to know when to stop sampling. 0 samples until stopped: the counter just wraps
+	Continuous = !numOfSamples;
+	TCC1.PER = Continuous ? 0xFFFF : numOfSamples;
+	//full speed until the acquisition ends (see Clock.h)
+	Clock_Hold(CLOCK_HOLD_ADC);
 	//Configure IO13(PF0) to drive event channel that triggers event every time the 4 samples are collected and averaged
 	EVSYS.CH1MUX = EVSYS_CHMUX_TCC0_OVF_gc;
 	//set overflow interrupt to low lvl
@@ -748,6 +802,8 @@ uint16_t averagingPtC, uint16_t averagingPtD, uint16_t numOfSamples, int32_t* Da
 		
 	////////////////////////////////////////////////////////////////////////////////////////////////////////
 		
+	// the front end has to be settled before the first sample
+	ADC_Rail_Settle();
 	// Set oscillator source and frequency and start
 	TCE1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_DIV1_gc;
 	
@@ -814,11 +870,9 @@ ISR(TCC0_OVF_vect) {
 	}
 		
 	sum = sum / 4;
-	ADC_BUFFER[sampleCount%ADC_buffer_size] = (int32_t)(sum * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR);
-	if(write_to_FRAM){
-		writeFRAM((uint8_t*)(ADC_BUFFER+(sampleCount%ADC_buffer_size)), 4);
-	}
-	sampleCount++;
+	// stamp the first sample with the captured time of the DRDY edge of its last subsample
+	if(sampleCount == 0) SampleStartTime = TimeSynch_Sample_Capture();
+	storeSample((int32_t)(sum * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR));
 
 }
 
@@ -854,8 +908,6 @@ void CO_collectSeismic1Channel_ext(uint8_t channel, uint8_t filterConfig, uint8_
 	set_ampGain(channel, gain);
 	set_filter(filterConfig);
 	ACC_DCPassEnable(DCPassEnable);
-	SPIInit(SPI_MODE_1_gc);
-	SPIC.CTRL = ADC_SPI_CONFIG_gc;
 
 	enableADCMUX(TRUE);
 	setADCInput(channel);
@@ -878,7 +930,8 @@ void CO_collectSeismic1Channel_ext(uint8_t channel, uint8_t filterConfig, uint8_
 	TCD0.INTCTRLB = TC_CCAINTLVL_HI_gc | TC_CCBINTLVL_HI_gc | TC_CCCINTLVL_HI_gc | TC_CCDINTLVL_HI_gc;
 	TCD0.CTRLA = ( TCD0.CTRLA & ~TC0_CLKSEL_gm ) | TC_CLKSEL_EVCH0_gc;
 
-	//FRAMAddress = FR_BASEADD;
+	//start at the bottom of FRAM so the samples stay clear of the mesh queue at the top (see Mesh.h)
+	FRAMAddress = FR_BASEADD;
 	sampleCount = 0;
 	SPICount = 0;
 	//checksumADC[0] = checksumADC[1] = checksumADC[2] = 0;
@@ -898,8 +951,11 @@ void CO_collectSeismic1Channel_ext(uint8_t channel, uint8_t filterConfig, uint8_
 	//reset count to zero
 	TCC1.CTRLA = 0x00;
 	TCC1.CTRLFSET = 0x0C;	
-	//set the period as number of samples to know when to stop sampling
-	TCC1.PER = numOfSamples;
+	//set the period as number of samples to know when to stop sampling. 0 samples until stopped: the counter just wraps
+	Continuous = !numOfSamples;
+	TCC1.PER = Continuous ? 0xFFFF : numOfSamples;
+	//full speed until the acquisition ends (see Clock.h)
+	Clock_Hold(CLOCK_HOLD_ADC);
 	//Configure IO13(PF0) to drive event channel that triggers event every time the 4 samples are collected and averaged
 	EVSYS.CH1MUX = EVSYS_CHMUX_TCD0_OVF_gc;
 	//set overflow interrupt to low lvl
@@ -909,6 +965,8 @@ void CO_collectSeismic1Channel_ext(uint8_t channel, uint8_t filterConfig, uint8_
 		
 	////////////////////////////////////////////////////////////////////////////////////////////////////////
 	
+	// the front end has to be settled before the first sample
+	ADC_Rail_Settle();
 	// Set oscillator source and frequency and start
 	TCE1.CTRLA = ( TCE1.CTRLA & ~TC1_CLKSEL_gm ) | TC_CLKSEL_DIV1_gc;
 	
@@ -967,19 +1025,16 @@ ISR(TCD0_OVF_vect) {
 	}
 		
 	sum = sum / 4;
+	// stamp the first sample with the captured time of the DRDY edge of its last subsample
+	if(sampleCount == 0) SampleStartTime = TimeSynch_Sample_Capture();
 	//get average of the 4 subsamples
-	ADC_BUFFER[sampleCount%ADC_buffer_size] = (int32_t)(sum * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR);
-	if(write_to_FRAM){
-		writeFRAM((uint8_t*)(ADC_BUFFER+(sampleCount%ADC_buffer_size)), 4);
-	}
-	sampleCount++;
+	storeSample((int32_t)(sum * ADC_VREF / ADC_MAX * ADC_DRIVER_GAIN_DENOMINATOR / ADC_DRIVER_GAIN_NUMERATOR));
 }
 
 //sample an axis of accelerometer with ADC
 void sampleCurrentChannel() {
 	
-	SPICS(TRUE);
-	PORTF.OUTCLR = PIN1_bm; // pull ADC_CS down to enable data read
+	const SPIBus_Device_t* prev = SPIBus_Acquire(&SPIBus_ADC); // pull ADC_CS down to enable data read
 	SPIC.DATA = 0xAA; // dummy data to start SPI clock
 	while(!(SPIC.STATUS & SPI_IF_bm));
 	SPIBuffer[SPICount] = SPIC.DATA;
@@ -989,9 +1044,8 @@ void sampleCurrentChannel() {
 	SPIC.DATA = 0xAA; // dummy data to start SPI clock
 	while(!(SPIC.STATUS & SPI_IF_bm));
 	SPIBuffer[SPICount+2] = SPIC.DATA;
-	PORTF.OUTSET = PIN1_bm; // pull ADC_CS up to end data read
+	SPIBus_Release(&SPIBus_ADC, prev); // pull ADC_CS up to end data read
 	SPICount +=3;
-	SPICS(FALSE);
 }
 
 //write collected accelerometer samples to FRAM. OBSOLETE
@@ -999,10 +1053,9 @@ void writeSE2FRAM() {
 
 	volatile int32_t sum = 0;
 	volatile int32_t currentSample;
+	const SPIBus_Device_t* prev;
 	sampleCount++;
 	
-	SPIC.CTRL = FR_SPI_CONFIG_gc;
-	
 	for(uint8_t i = 0; i < 12; i+=3) {
 		if(SPIBuffer[i] & BIT7_bm) *(((uint8_t*)&currentSample) + 3) = 0xFF; // sign extension if negative
 		else *(((uint8_t*)&currentSample) + 3) = 0x00;
@@ -1019,7 +1072,7 @@ void writeSE2FRAM() {
 
 
 	
-	PORTC.OUTCLR = PIN4_bm;  // enable SPI-SS
+	prev = SPIBus_Acquire(&SPIBus_FRAM);
 	PORTB.OUTCLR = PIN3_bm;  // pull down CS_FRAM to write enable
 	nop();
 	SPIC.DATA = FR_WREN;
@@ -1049,9 +1102,7 @@ void writeSE2FRAM() {
 	SPIBuffer[12] = SPIC.DATA;
 	
 	PORTB.OUTSET = PIN3_bm;  // pull up CS_FRAM to write protect
-	PORTC.OUTSET = PIN4_bm;  // disable SPI-SS
-	SPIC.CTRL = ADC_SPI_CONFIG_gc;
-	PORTC.OUTCLR = PIN4_bm;  // enable SPI-SS
+	SPIBus_Release(&SPIBus_FRAM, prev);
 	
 	FRAMAddress +=3;
 	checksumADC[0] += SPIBuffer[0];
@@ -1095,19 +1146,18 @@ void writeSE2FRAM() {
 
 //test function for FRAM
 void FRAMWriteKnowns() {
+	const SPIBus_Device_t* prev;
 	FRAMAddress = FR_BASEADD;
 	sampleCount = 0;
 	checksumADC[0] = checksumADC[1] = checksumADC[2] = 0;
 	
 	ADCPower(TRUE);
-	SPIInit(SPI_MODE_1_gc);
-	SPIC.CTRL = FR_SPI_CONFIG_gc;
 	SPIBuffer[0] = 0x0D;
 	SPIBuffer[1] = 0xF3;
 	SPIBuffer[2] = 0x57;
 	
 	while(sampleCount < FR_TOTAL_NUM_SE_SAMPLES) {
-		PORTC.OUTCLR = PIN4_bm;  // enable SPI-SS
+		prev = SPIBus_Acquire(&SPIBus_FRAM);
 		PORTB.OUTCLR = PIN3_bm;  // pull down CS_FRAM to write enable
 		nop();
 		SPIC.DATA = FR_WREN;
@@ -1137,7 +1187,7 @@ void FRAMWriteKnowns() {
 		SPIBuffer[12] = SPIC.DATA;
 		
 		PORTB.OUTSET = PIN3_bm;  // pull up CS_FRAM to write protect
-		PORTC.OUTSET = PIN4_bm;  // disable SPI-SS
+		SPIBus_Release(&SPIBus_FRAM, prev);
 		
 		FRAMAddress +=3;
 		checksumADC[0] += SPIBuffer[0];
@@ -1147,7 +1197,6 @@ void FRAMWriteKnowns() {
 		sampleCount++;
 	}
 	
-	SPIDisable();
 	ADCPower(FALSE);
 }
 
@@ -22,6 +22,9 @@
 //ADC software defines
 #define ADC_DISCARD 128
 #define NUM_SAMPLES 1024
+#define ADC_BLOCK_SAMPLES 32	// EVENT_SAMPLES is posted every this many samples
+// a continuous acquisition (numOfSamples 0) to FRAM goes round and round this much of it from FR_BASEADD
+#define FR_STREAM_SIZE 0x4000
 
 // Sample frequency (samples per second)
 #define SPS_32_gc 0x05
@@ -97,12 +100,17 @@ uint16_t ADC_buffer_size;
 uint8_t write_to_FRAM;	//set to write samples to FRAM as they are taken
 volatile uint8_t ADC_Sampling_Finished;
 volatile uint8_t DataAvailable;
+volatile uint32_t SampleStartTime;	// local time (TimeSynch clock) the first sample of the last acquisition was ready
 
 //ADC sampling functions
 void CO_collectTemp(uint16_t *avgV, uint16_t *minV, uint16_t *maxV);
 void CO_collectBatt(uint16_t *avgV, uint16_t *minV, uint16_t *maxV);
 void CO_collectSP(uint8_t channel, int32_t *averageV, int32_t *minV,
 int32_t *maxV, uint8_t gainExponent);
+//the collect functions start sampling and return. numOfSamples 0 samples until ADC_Stop_Sampling
+//while the sd card is written (writeFile, SD_write_block) the data ready interrupt waits for up to one command and data block
+//on the card (~2.2ms at SPI_PRESCALER, see SD_Wait_Busy), so samples get lost above about 450 SPS. keep SPS below that or
+//leave the card alone while sampling
 //collect data from one channel of ADC
 void CO_collectADC(uint8_t channel, uint8_t gainExponent, uint16_t SPS, uint16_t numOfSamples, int32_t* DataArray, uint16_t BufferSize, uint8_t use_FRAM);
 void CO_collectADC_ext(uint8_t channel, uint8_t filterConfig, uint8_t gainExponent, uint16_t sps, uint16_t numOfSamples, int32_t* DataArray, uint16_t BufferSize, uint8_t use_FRAM);
@@ -141,6 +149,13 @@ void ADC_Pause_Sampling();
 void ADC_Resume_Sampling();
 void ADC_Stop_Sampling();
 uint16_t ADC_Get_Num_Samples();
+// samples kept so far by the running (or last) acquisition
+uint32_t ADC_Get_Sample_Count();
+// offsets of the internal ADCs (ADCA for CO_collectTemp, ADCB for CO_collectBatt). measured on first use and kept, so a saved
+// pair (see Config.h) skips the measurement after a reset. ADC_NO_OFFSET measures again
+#define ADC_NO_OFFSET INT8_MIN
+void ADC_Set_Internal_Offsets(int8_t a, int8_t b);
+void ADC_Get_Internal_Offsets(int8_t* a, int8_t* b);
 
 
 #endif /* ADC_H_ */
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+ * Channel.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Channel.h"
+#include "TimeSynch.h"
+#include "Mesh.h"
+#include "Event.h"
+
+#define CHANNEL_TICKS_PER_MS (TS_TICKS_PER_SEC/1000)
+
+static uint8_t Pending;
+static uint8_t PendingChannel;
+static uint32_t SwitchAt;	// local time
+static uint32_t LastHeard;	// local time
+static uint8_t Searching;
+
+uint8_t Channel_Survey(uint8_t* EdAvg, uint8_t* EdMax){
+
+	uint8_t ch, best;
+
+	chb_channel_survey(EdAvg, EdMax, CHANNEL_SURVEY_SAMPLES);
+	//lowest average wins, the peaks break ties. stay put unless another channel is actually quieter
+	best = chb_get_channel();
+	for(ch = CHB_MIN_CHANNEL; ch <= CHB_MAX_CHANNEL; ch++){
+		if(EdAvg[ch] < EdAvg[best] || (EdAvg[ch] == EdAvg[best] && EdMax[ch] < EdMax[best])) best = ch;
+	}
+	return best;
+}
+
+static void Channel_Schedule(uint8_t channel, uint16_t DelayMs){
+	PendingChannel = channel;
+	SwitchAt = TimeSynch_Get_Local_Time() + (uint32_t)DelayMs*CHANNEL_TICKS_PER_MS;
+	Pending = TRUE;
+}
+
+uint8_t Channel_Migrate(uint8_t channel){
+
+	uint8_t command[CHANNEL_MIGRATE_LENGTH], i, status = CHB_SUCCESS;
+	int32_t left;
+
+	if(channel < CHB_MIN_CHANNEL || channel > CHB_MAX_CHANNEL) return CHB_INVALID;
+	Channel_Schedule(channel, CHANNEL_SWITCH_DELAY);
+	command[0] = CHANNEL_MIGRATE;
+	command[1] = channel;
+	//repeat the announcement (new flood each time) in case a mote missed one. each copy carries the time left
+	for(i = 0; i < CHANNEL_ANNOUNCE_REPEATS; i++){
+		left = (int32_t)(SwitchAt - TimeSynch_Get_Local_Time())/CHANNEL_TICKS_PER_MS;
+		if(left <= 0) break;
+		*(uint16_t*)(command+2) = (uint16_t)left;
+		status = Mesh_Flood(command, CHANNEL_MIGRATE_LENGTH);
+		Hal_Delay_Ms(100);
+	}
+	return status;
+}
+
+void Channel_Handle(uint8_t* msg, uint8_t length){
+	if(length < CHANNEL_MIGRATE_LENGTH || msg[1] < CHB_MIN_CHANNEL || msg[1] > CHB_MAX_CHANNEL) return;
+	Channel_Schedule(msg[1], *(uint16_t*)(msg+2));
+}
+
+void Channel_Heard(){
+	LastHeard = TimeSynch_Get_Local_Time();
+	Searching = FALSE;
+}
+
+void Channel_Poll(uint8_t IsBase){
+
+	uint32_t now = TimeSynch_Get_Local_Time();
+	uint8_t ch;
+
+	if(Pending && (int32_t)(now - SwitchAt) >= 0){
+		chb_set_channel(PendingChannel);
+		Pending = FALSE;
+		LastHeard = now;
+	}
+	if(Pending) Event_Wake_At(SwitchAt);
+	if(IsBase || Pending) return;
+	//the local clock wraps every ~2 min, so this has to be called more often than that for the difference to mean anything
+	if((int32_t)(now - LastHeard) > (int32_t)((Searching ? CHANNEL_DWELL : CHANNEL_LOST_TIMEOUT)*TS_TICKS_PER_SEC)){
+		ch = chb_get_channel() + 1;
+		if(ch > CHB_MAX_CHANNEL) ch = CHB_MIN_CHANNEL;
+		chb_set_channel(ch);
+		Searching = TRUE;
+		LastHeard = now;
+	}
+	//the wakeup for the timeout also keeps the main loop calling this often enough
+	Event_Wake_At(LastHeard + (Searching ? CHANNEL_DWELL : CHANNEL_LOST_TIMEOUT)*TS_TICKS_PER_SEC + 1);
+}
@@ -0,0 +1,42 @@
+/*
+ * Channel.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef CHANNEL_H_
+#define CHANNEL_H_
+
+#include "constants_and_globals.h"
+#include "chb_drvr.h"
+
+// Channel selection
+// the base station surveys the band with the radio's energy detection and moves the network to the quietest channel.
+// the move is flooded a few times as ['C', channel, delay (2 bytes, ms)] and every mote switches when the delay runs
+// out, so the network moves all at once and the relays are still on the old channel while they pass the command on.
+// a mote that hears nothing for CHANNEL_LOST_TIMEOUT (missed the move, or the base station came back on another
+// channel) goes looking: it listens CHANNEL_DWELL on each channel in turn until it hears a frame.
+#define CHANNEL_MIGRATE 'C'
+#define CHANNEL_MIGRATE_LENGTH 4
+#define CHANNEL_AUTO 0xFF	// pick the quietest channel
+#define CHANNEL_SURVEY_SAMPLES 16	// ed measurements per channel, ~1 ms apart
+#define CHANNEL_SWITCH_DELAY 1500	// ms from the first announcement to the switch
+#define CHANNEL_ANNOUNCE_REPEATS 3
+#define CHANNEL_LOST_TIMEOUT 30	// sec. has to be well over the beacon and hello periods
+#define CHANNEL_DWELL 3	// sec on each channel while looking for the network
+
+// measure every channel. EdAvg and EdMax get the average and max ed level of each channel, indexed by channel
+// (CHB_MAX_CHANNEL + 1 entries). returns the quietest channel, the current one if it is as good as any
+uint8_t Channel_Survey(uint8_t* EdAvg, uint8_t* EdMax);
+// base station: flood the move to channel and switch along with the motes (Channel_Poll). returns the chb_write status
+uint8_t Channel_Migrate(uint8_t channel);
+// mote: process a flooded 'C' command
+void Channel_Handle(uint8_t* msg, uint8_t length);
+// mote: call for every frame received. the network is around
+void Channel_Heard();
+// switch when a move is due and, on motes, look for the network when nothing was heard for a while. call from the main loop.
+// asks for a wakeup (Event_Wake_At) when the next of these is due
+void Channel_Poll(uint8_t IsBase);
+
+#endif /* CHANNEL_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Clock.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Clock.h"
+#include "Hal.h"
+#include "clksys_driver.h"
+#include "utility_functions.h"
+#include "TimeSynch.h"
+
+static uint8_t Slow = FALSE;
+static volatile uint8_t Holders = 0;
+static volatile uint8_t Running = 0;	// holders of the clock running
+static uint8_t Stopped = FALSE;
+static uint16_t StopRtc;	// RTC count at the stop
+static uint16_t RtcFrac;	// fraction of a local tick left over from the last stop (1/(CLOCK_RTC_HZ/64))
+static uint16_t TimeoutPer;	// TCE0 period at full speed
+
+void Clock_Init(){
+	Hal_Clock_32MHz_Calibrated();
+	Slow = FALSE;
+	Running = CLOCK_HOLD_RADIO | CLOCK_HOLD_APP;
+	//the crystal is already running for the calibration. the RTC counts it free running for the fine part of event wakeups
+	Hal_Rtc_Source(CLK_RTCSRC_TOSC32_gc | CLK_RTCEN_bm);
+	Hal_Rtc_Wait();
+	Hal_Rtc_Period(0xFFFF);
+	Hal_Rtc_Count(0);
+	Hal_Rtc_Ctrl(RTC_PRESCALER_DIV1_gc);
+}
+
+//change speed along with everything that counts time on the clock. interrupts are off
+static void Clock_Switch(uint8_t slow){
+
+	uint8_t ticking = Hal_Timer_Running(HAL_TCD1);
+
+	if(slow == Slow) return;
+	Slow = slow;
+	//the local clock prescaler changes on the side of the switch where it runs slower, so it never races ahead
+	if(slow){
+		Hal_Clock_Prescalers(CLK_PSADIV_8_gc, CLK_PSBCDIV_1_1_gc);
+		if(ticking) Hal_Timer_Clksel(HAL_TCD1, TC_CLKSEL_DIV1_gc);
+		TimeoutPer = Hal_Timer_Get_Period(HAL_TCE0);
+		Hal_Timer_Period(HAL_TCE0, TimeoutPer/CLOCK_SLOW_DIV);
+		Hal_Timer_Count(HAL_TCE0, Hal_Timer_Get_Count(HAL_TCE0)/CLOCK_SLOW_DIV);
+	}
+	else{
+		if(ticking) Hal_Timer_Clksel(HAL_TCD1, TC_CLKSEL_DIV8_gc);
+		Hal_Clock_Prescalers(CLK_PSADIV_1_gc, CLK_PSBCDIV_1_1_gc);
+		Hal_Timer_Count(HAL_TCE0, Hal_Timer_Get_Count(HAL_TCE0)*CLOCK_SLOW_DIV);
+		Hal_Timer_Period(HAL_TCE0, TimeoutPer);
+	}
+}
+
+void Clock_Hold(uint8_t holders){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	Holders |= holders;
+	Clock_Switch(FALSE);
+	Hal_Irq_Restore(irq);
+}
+
+void Clock_Release(uint8_t holders){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	Holders &= ~holders;
+	Hal_Irq_Restore(irq);
+}
+
+void Clock_Hold_Running(uint8_t holders){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	Running |= holders;
+	Hal_Irq_Restore(irq);
+}
+
+void Clock_Release_Running(uint8_t holders){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	Running &= ~holders;
+	Hal_Irq_Restore(irq);
+}
+
+uint8_t Clock_Can_Stop(){
+	return CLOCK_DEEP_SLEEP && !Holders && !Running;
+}
+
+void Clock_Stop(){
+	Hal_Rtc_Wait();
+	StopRtc = Hal_Rtc_Get_Count();
+	Stopped = TRUE;
+}
+
+void Clock_Start(){
+
+	uint32_t ticks;
+	uint8_t clksel;
+
+	if(!Stopped) return;
+	Stopped = FALSE;
+	//the count reads right once the RTC is back in synch after the wakeup. 65535 RTC ticks times CLOCK_TICK_HZ/64 still fits
+	Hal_Rtc_Wait();
+	ticks = (uint32_t)(uint16_t)(Hal_Rtc_Get_Count() - StopRtc)*(CLOCK_TICK_HZ/64) + RtcFrac;
+	RtcFrac = ticks%(CLOCK_RTC_HZ/64);
+	ticks = TimeSynch_Get_Local_Time() + ticks/(CLOCK_RTC_HZ/64);
+	//the low word stops while both are written so it can't roll over in between
+	clksel = Hal_Timer_Get_Clksel(HAL_TCD1);
+	Hal_Timer_Clksel(HAL_TCD1, TC_CLKSEL_OFF_gc);
+	Hal_Timer_Count(HAL_TCF0, (uint16_t)(ticks >> 16));
+	Hal_Timer_Count(HAL_TCD1, (uint16_t)ticks);
+	Hal_Timer_Clksel(HAL_TCD1, clksel);
+}
+
+void Clock_Slow(){
+	if(CLOCK_SCALING && !Holders) Clock_Switch(TRUE);
+}
+
+void Clock_Fast(){
+	Clock_Switch(FALSE);
+}
+
+uint32_t Clock_Hz(){
+	return Slow ? CLOCK_SLOW_HZ : CLOCK_FAST_HZ;
+}
+
+uint8_t Clock_Tick_Clksel(){
+	return Slow ? TC_CLKSEL_DIV1_gc : TC_CLKSEL_DIV8_gc;
+}
@@ -0,0 +1,68 @@
+/*
+ * Clock.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include "constants_and_globals.h"
+
+// Clock scaling
+// the core runs from the 32MHz RC oscillator calibrated against the 32kHz crystal: at full speed while it has work, and with
+// the system clock prescaled by CLOCK_SLOW_DIV while it sleeps in Event_Wait (see Event.h) and only interrupts run. the
+// prescaler switches right away and the oscillator stays locked, unlike moving to the 2MHz RC oscillator and back.
+// the peripherals run on the same clock, so Clock_Slow and Clock_Fast retune the ones that count time with it:
+//  - the local clock (see TimeSynch.h) ticks at CLOCK_TICK_HZ at both speeds by changing its prescaler along with the clock.
+//    a change can gain or lose a fraction of a tick; the synch regression takes up the average
+//  - the reply timeout of the apps (TCE0) has its count and period scaled
+// what can't take a change halfway through holds the clock fast:
+//  - the ADC while sampling: the AD7767 MCLK (TCE1) and the DRDY interrupt have to keep their timing
+//  - the serial link while it is open: bytes can come in at any time and a baud rate change would garble them
+// main loop code always runs fast, so F_CPU holds outside of interrupts.
+// with nothing holding it running the core goes further down, to power-save: the peripheral clock stops and only the RTC keeps
+// counting. the local clock stops with it, so Clock_Start moves it on by the time asleep counted on the RTC (to a tick, the
+// fraction carries over to the next stop). a stop lasts at most CLOCK_STOP_MAX RTC ticks so the RTC can't wrap around
+// during it. the radio holds the clock running while it is awake (the IRQ and its timestamps need the timers), and so do
+// the apps until they are set up for it.
+#define CLOCK_SCALING 1	// 0 to always run fast
+#define CLOCK_DEEP_SLEEP 1	// 0 to never stop the clock
+#define CLOCK_FAST_HZ F_CPU
+#define CLOCK_SLOW_DIV 8
+#define CLOCK_SLOW_HZ (CLOCK_FAST_HZ/CLOCK_SLOW_DIV)
+#define CLOCK_TICK_HZ CLOCK_SLOW_HZ	// local clock rate
+#define CLOCK_RTC_HZ 32768UL	// the RTC runs free from the 32kHz crystal
+#define CLOCK_STOP_MAX 0xF000	// RTC ticks, ~1.9 sec
+
+// holders
+#define CLOCK_HOLD_ADC 0x01
+#define CLOCK_HOLD_SERIAL 0x02
+#define CLOCK_HOLD_RADIO 0x04	// running only
+#define CLOCK_HOLD_APP 0x80
+
+// start the 32MHz oscillator and its calibration (set_32MHz_Calibrated) and the RTC, at full speed. the radio and the app
+// hold it running
+void Clock_Init();
+// keep the clock fast until the same holders release it. safe from ISRs
+void Clock_Hold(uint8_t holders);
+void Clock_Release(uint8_t holders);
+// keep the clock running (no power-save) until the same holders release it. holding it fast holds it running too. safe from ISRs
+void Clock_Hold_Running(uint8_t holders);
+void Clock_Release_Running(uint8_t holders);
+// slow down unless held, speed back up. called with interrupts off around the sleep in Event_Wait
+void Clock_Slow();
+void Clock_Fast();
+// TRUE if nothing holds the clock running or fast. interrupts are off
+uint8_t Clock_Can_Stop();
+// around a power-save sleep in Event_Wait: note the RTC count, then move the local clock on by the time asleep. Clock_Start
+// does nothing if the clock wasn't stopped, so the ISR that wakes the core can call it first. interrupts are off
+void Clock_Stop();
+void Clock_Start();
+// current cpu and peripheral clock
+uint32_t Clock_Hz();
+// prescaler that gives the local clock CLOCK_TICK_HZ at the current speed (TimeSynch_Init)
+uint8_t Clock_Tick_Clksel();
+
+#endif /* CLOCK_H_ */
@@ -0,0 +1,73 @@
+/*
+ * Command.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Command.h"
+
+uint8_t Command_Begin(cmd_batch_t* batch, uint8_t* frame, uint8_t length, uint8_t* reply, uint8_t ReplyMax){
+
+	batch->frame = frame;
+	batch->length = length;
+	batch->pos = CMD_HEADER_LENGTH;
+	batch->left = 0;
+	batch->reply = reply;
+	batch->ReplyMax = ReplyMax;
+	batch->ReplyLength = CMD_HEADER_LENGTH;
+	reply[0] = CMD_BATCH_REPLY;
+	reply[1] = CMD_VERSION;
+	reply[2] = (length > 2) ? frame[2] : 0;
+	reply[3] = 0;
+	if(length < CMD_HEADER_LENGTH || frame[0] != CMD_BATCH || frame[1] != CMD_VERSION) return FALSE;
+	batch->left = frame[3];
+	return TRUE;
+}
+
+uint8_t Command_Next(cmd_batch_t* batch, uint8_t* opcode, uint8_t** params, uint8_t* length){
+
+	uint8_t* command = batch->frame + batch->pos;
+
+	if(!batch->left || batch->pos + 2 > batch->length || batch->pos + 2 + command[1] > batch->length) return FALSE;
+	*opcode = command[0];
+	*length = command[1];
+	*params = command + 2;
+	batch->pos += 2 + command[1];
+	batch->left--;
+	return TRUE;
+}
+
+uint8_t Command_Reply(cmd_batch_t* batch, uint8_t opcode, uint8_t status, uint8_t* data, uint8_t length){
+
+	uint8_t* result = batch->reply + batch->ReplyLength;
+
+	if(batch->ReplyLength + CMD_RESULT_HEADER_LENGTH + length > batch->ReplyMax) return FALSE;
+	result[0] = opcode;
+	result[1] = status;
+	result[2] = length;
+	for(uint8_t i = 0; i < length; i++) result[CMD_RESULT_HEADER_LENGTH + i] = data[i];
+	batch->ReplyLength += CMD_RESULT_HEADER_LENGTH + length;
+	batch->reply[3]++;
+	return TRUE;
+}
+
+uint8_t Command_End(cmd_batch_t* batch){
+	return batch->ReplyLength;
+}
+
+uint16_t Command_Get_U16(uint8_t* p){
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+uint32_t Command_Get_U32(uint8_t* p){
+	return (uint32_t)Command_Get_U16(p) | ((uint32_t)Command_Get_U16(p+2) << 16);
+}
+
+void Command_Put_U16(uint8_t* p, uint16_t value){
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+}
+
+void Command_Put_U32(uint8_t* p, uint32_t value){
+	Command_Put_U16(p, (uint16_t)value);
+	Command_Put_U16(p+2, (uint16_t)(value >> 16));
+}
@@ -0,0 +1,75 @@
+/*
+ * Command.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef COMMAND_H_
+#define COMMAND_H_
+
+#include "constants_and_globals.h"
+
+// Binary command batches
+// several commands go to a mote in one frame and the results come back in one reply instead of a round trip per command.
+// batch:  ['B', version, seq, count, commands...] with each command [opcode, length, parameters (length bytes)]
+// reply:  ['b', version, seq, count, results...] with each result [opcode, status, length, data (length bytes)]
+// multi-byte fields are little endian. the commands run in order and a failing one doesn't stop the rest. a mote that
+// doesn't speak the version replies with its own version and no results. batches sent to the broadcast address (or flooded)
+// run on every mote with no reply.
+#define CMD_BATCH 'B'
+#define CMD_BATCH_REPLY 'b'
+#define CMD_VERSION 1
+#define CMD_HEADER_LENGTH 4
+#define CMD_RESULT_HEADER_LENGTH 3
+
+// opcodes
+#define CMD_SET_GAIN 0x01	// gain (1 byte: 1, 2, 4 ... 128)
+#define CMD_SET_RATE 0x02	// sampling frequency (2 bytes, Hz)
+#define CMD_ARM 0x03	// start an acquisition
+#define CMD_STOP 0x04	// stop the acquisition
+#define CMD_STATUS 0x05	// reply: sampling, data available, samples (4 bytes), synched, channel, mesh queue length (2 bytes)
+#define CMD_QUEUE 0x06	// send the collected samples to the base station over the mesh (like 'Q')
+#define CMD_TIME 0x07	// reply: network time of the first sample (4 bytes), synched (like 'N')
+#define CMD_SET_LPL 0x08	// wake interval (2 bytes, ms), listen window (2 bytes, ms). takes effect after the reply
+#define CMD_STREAM 0x09	// 1 (start) or 0 (stop) continuous sampling, sent over the mesh block by block as it comes in
+#define CMD_ENERGY 0x0A	// reply: ms counted (4 bytes), then charge drawn by each Energy.h subsystem (4 bytes each, uC). 1 to reset after (optional)
+#define CMD_SCHEDULE 0x0B	// start (4 bytes, network time), period (4 bytes, sec, 0 stops), samples (2 bytes), rate (2 bytes, Hz), gain (1 byte)
+
+#define CMD_STATUS_LENGTH 10
+#define CMD_ENERGY_LENGTH 24
+
+// status of a result
+#define CMD_OK 0
+#define CMD_BAD_LENGTH 1
+#define CMD_BAD_VALUE 2
+#define CMD_BUSY 3
+#define CMD_UNKNOWN 4
+
+typedef struct{
+	uint8_t* frame;
+	uint8_t length;
+	uint8_t pos;
+	uint8_t left;	// commands not read yet
+	uint8_t* reply;
+	uint8_t ReplyLength;
+	uint8_t ReplyMax;
+} cmd_batch_t;
+
+// start on a received batch and put the reply header in reply (ReplyMax bytes). returns FALSE if the batch is in another
+// version or too short, in which case the reply (Command_End) has no results
+uint8_t Command_Begin(cmd_batch_t* batch, uint8_t* frame, uint8_t length, uint8_t* reply, uint8_t ReplyMax);
+// get the next command. returns FALSE when there are no more (or the rest of the frame is cut short)
+uint8_t Command_Next(cmd_batch_t* batch, uint8_t* opcode, uint8_t** params, uint8_t* length);
+// add a result to the reply. returns FALSE if it doesn't fit
+uint8_t Command_Reply(cmd_batch_t* batch, uint8_t opcode, uint8_t status, uint8_t* data, uint8_t length);
+// returns the length of the reply
+uint8_t Command_End(cmd_batch_t* batch);
+
+// little endian fields at any alignment
+uint16_t Command_Get_U16(uint8_t* p);
+uint32_t Command_Get_U32(uint8_t* p);
+void Command_Put_U16(uint8_t* p, uint16_t value);
+void Command_Put_U32(uint8_t* p, uint32_t value);
+
+#endif /* COMMAND_H_ */
@@ -0,0 +1,34 @@
+/*
+ * Config.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Config.h"
+#include <stddef.h>
+#include <util/crc16.h>
+#include "chb_eeprom.h"
+
+static uint16_t Config_CRC(config_t* config){
+
+	uint8_t* data = (uint8_t*)config;
+	uint16_t crc = 0xFFFF;
+
+	for(uint8_t i = 0; i < offsetof(config_t, crc); i++) crc = _crc_xmodem_update(crc, data[i]);
+	return crc;
+}
+
+uint8_t Config_Load(config_t* config){
+
+	config_t saved;
+
+	chb_eeprom_read(CONFIG_EEPROM_ADDR, (uint8_t*)&saved, sizeof(saved));
+	if(saved.version != CONFIG_VERSION || saved.crc != Config_CRC(&saved)) return FALSE;
+	*config = saved;
+	return TRUE;
+}
+
+void Config_Save(config_t* config){
+	config->version = CONFIG_VERSION;
+	config->crc = Config_CRC(config);
+	chb_eeprom_update(CONFIG_EEPROM_ADDR, (uint8_t*)config, sizeof(config_t));
+}
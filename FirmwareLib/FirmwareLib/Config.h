@@ -0,0 +1,41 @@
+/*
+ * Config.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include "constants_and_globals.h"
+
+// Saved configuration
+// what a mote comes back up with after a reset: acquisition settings, the low power listening schedule, the acquisition
+// schedule and the calibration it measured. the record sits in EEPROM after the radio's addresses (CHB_EEPROM_SHORT_ADDR)
+// and carries a version and a crc: a record of another version, or one torn by a reset halfway through a write, fails
+// Config_Load and the app starts from its defaults. Config_Save writes only the bytes that changed (chb_eeprom_update), so
+// saving after every change costs little time or wear.
+#define CONFIG_EEPROM_ADDR 0x20	// second EEPROM page
+#define CONFIG_VERSION 1	// change along with config_t
+
+typedef struct{
+	uint8_t version;
+	uint8_t gain;	// GAIN_x_gc
+	uint16_t rate;	// Hz
+	uint16_t lpl_interval;	// ms
+	uint16_t lpl_window;	// ms
+	uint32_t schedule_period;	// sec, 0 without a schedule
+	uint16_t schedule_samples;
+	uint16_t schedule_rate;	// Hz
+	uint8_t schedule_gain;	// GAIN_x_gc
+	int8_t offset_a, offset_b;	// internal ADC offsets (ADC_Get_Internal_Offsets)
+	uint16_t crc;	// CRC-16/CCITT-FALSE of everything before it
+} config_t;
+
+// TRUE and the saved record if there is a good one. config is left alone otherwise
+uint8_t Config_Load(config_t* config);
+// fill in the version and crc and save the record
+void Config_Save(config_t* config);
+
+#endif /* CONFIG_H_ */
@@ -240,10 +240,12 @@ void Ext1Power(uint8_t on) {
 		//PortEx_DIRSET(PIN3_bm, PS_BANKB);
 		//PortEx_OUTSET(PIN3_bm, PS_BANKB);  //write protect SDHC
 		_delay_ms(100);
+		Energy_Set(ENERGY_SD, ENERGY_ON);
 		
 	} else {
 		PORTF.OUTCLR = PIN5_bm;
 		PORTF.DIRCLR = PIN5_bm;
+		Energy_Set(ENERGY_SD, ENERGY_OFF);
 		//PortEx_OUTCLR(PIN3_bm, PS_BANKB);  //no need to write protect SDHC
 	}
 }
@@ -266,9 +268,11 @@ void HVPower(uint8_t on) {
 		PORTF.DIRSET = PIN7_bm;
 		PORTF.OUTSET = PIN7_bm;
 		_delay_ms(100);
+		Energy_Set(ENERGY_HV, ENERGY_ON);
 	} else {
 		PORTF.OUTCLR = PIN7_bm;
 		PORTF.DIRCLR = PIN7_bm;
+		Energy_Set(ENERGY_HV, ENERGY_OFF);
 	}
 	_delay_us(1000);
 }
@@ -491,8 +495,6 @@ ISR(PORTE_INT0_vect){
 			chb_read(msg);
 			if(!strncmp((const char*)(msg->data),"start sampling",14)){	//if basestation synch response message received, do the following
 				RadioMonitorMode = SYNCHED;
-				TCD1.CTRLA = TC_CLKSEL_EVCH1_gc;	//restart the synch timers
-				TCC1.CTRLA = 0x01;  
 				ADC_Resume_Sampling();	//resume sampling with the adc
 			}
 			break;
@@ -10,10 +10,26 @@
 #include "FAT32.h"
 #include "chb.h"
 #include "chb_drvr.h"
+#include "chb_link.h"
 #include "ADC.h"
 #include "SD_Card.h"
 #include "SerialUSB.h"
 #include "FRAM.h"
+#include "TimeSynch.h"
+#include "TDMA.h"
+#include "Mesh.h"
+#include "LPL.h"
+#include "Channel.h"
+#include "Command.h"
+#include "Sniffer.h"
+#include "HostLink.h"
+#include "Clock.h"
+#include "Event.h"
+#include "Queue.h"
+#include "Task.h"
+#include "Energy.h"
+#include "Schedule.h"
+#include "Config.h"
 
 
 
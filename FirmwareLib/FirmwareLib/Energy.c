@@ -0,0 +1,105 @@
+/*
+ * Energy.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Energy.h"
+#include "Hal.h"
+
+#define ENERGY_TICKS_PER_MS (TS_TICKS_PER_SEC/1000)
+#define ENERGY_FOLD_TICKS 0x40000000UL	// ticks gathered before they go into the ms totals
+
+static uint8_t State[ENERGY_SUBSYSTEMS] = {ENERGY_CPU_ACTIVE};
+static uint32_t Since[ENERGY_SUBSYSTEMS];	// local time of the last accounting
+static uint32_t Ticks[ENERGY_SUBSYSTEMS][ENERGY_STATES];	// not yet in Ms
+static uint32_t Ms[ENERGY_SUBSYSTEMS][ENERGY_STATES];
+static uint16_t Current[ENERGY_SUBSYSTEMS][ENERGY_STATES] = ENERGY_MODEL;
+
+//add the time since the last accounting to the current state. interrupts are off
+static void Energy_Account(uint8_t subsystem, uint32_t now){
+
+	uint8_t state = State[subsystem];
+
+	Ticks[subsystem][state] += now - Since[subsystem];
+	Since[subsystem] = now;
+	if(Ticks[subsystem][state] >= ENERGY_FOLD_TICKS){
+		Ms[subsystem][state] += Ticks[subsystem][state]/ENERGY_TICKS_PER_MS;
+		Ticks[subsystem][state] %= ENERGY_TICKS_PER_MS;
+	}
+}
+
+void Energy_Reset(){
+
+	uint8_t i, j;
+	uint32_t now;
+	hal_irq_t irq = Hal_Irq_Save();
+
+	now = TimeSynch_Get_Local_Time();
+	for(i=0;i<ENERGY_SUBSYSTEMS;i++){
+		Since[i] = now;
+		for(j=0;j<ENERGY_STATES;j++){
+			Ticks[i][j] = 0;
+			Ms[i][j] = 0;
+		}
+	}
+	Hal_Irq_Restore(irq);
+}
+
+void Energy_Set(uint8_t subsystem, uint8_t state){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	if(state != State[subsystem]){
+		Energy_Account(subsystem, TimeSynch_Get_Local_Time());
+		State[subsystem] = state;
+	}
+	Hal_Irq_Restore(irq);
+}
+
+void Energy_Poll(){
+
+	uint8_t i;
+	uint32_t now;
+	hal_irq_t irq = Hal_Irq_Save();
+
+	now = TimeSynch_Get_Local_Time();
+	for(i=0;i<ENERGY_SUBSYSTEMS;i++) Energy_Account(i, now);
+	Hal_Irq_Restore(irq);
+}
+
+void Energy_Set_Current(uint8_t subsystem, uint8_t state, uint16_t uA){
+	if(subsystem < ENERGY_SUBSYSTEMS && state < ENERGY_STATES) Current[subsystem][state] = uA;
+}
+
+uint32_t Energy_Get_Ms(uint8_t subsystem, uint8_t state){
+
+	uint32_t ms;
+	hal_irq_t irq;
+
+	Energy_Poll();
+	irq = Hal_Irq_Save();
+	ms = Ms[subsystem][state] + Ticks[subsystem][state]/ENERGY_TICKS_PER_MS;
+	Hal_Irq_Restore(irq);
+	return ms;
+}
+
+uint32_t Energy_Get_Charge(uint8_t subsystem){
+
+	uint8_t state;
+	uint64_t charge = 0;
+
+	for(state=0;state<ENERGY_STATES;state++){
+		charge += (uint64_t)Energy_Get_Ms(subsystem, state)*Current[subsystem][state];
+	}
+	return charge/1000;
+}
+
+uint32_t Energy_Get_Elapsed(){
+
+	uint8_t state;
+	uint32_t ms = 0;
+
+	//the cpu is always in one of its states
+	for(state=0;state<ENERGY_STATES;state++) ms += Energy_Get_Ms(ENERGY_CPU, state);
+	return ms;
+}
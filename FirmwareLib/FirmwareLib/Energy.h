@@ -0,0 +1,64 @@
+/*
+ * Energy.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include "constants_and_globals.h"
+#include "TimeSynch.h"
+
+// Energy accounting
+// the drivers report each power state change of their subsystem (the cpu around the sleep in Event_Wait, the radio in
+// chb_drvr.c, the ADC, SD card and HV supplies in their power functions) and the time in every state is measured on the
+// local clock. times the current of each state (the model below, changeable at run time) that gives the charge drawn per
+// subsystem. interrupts that run while the core sleeps count as sleep. the model is from the datasheets at 3.3V
+// except where marked; measure the board to tighten it. tools/energysim runs this on the host against a duty cycle.
+#define ENERGY_CPU 0
+#define ENERGY_RADIO 1
+#define ENERGY_ADC 2
+#define ENERGY_SD 3
+#define ENERGY_HV 4
+#define ENERGY_SUBSYSTEMS 5
+#define ENERGY_STATES 4	// at most, per subsystem. state 0 draws the least
+
+// states
+#define ENERGY_OFF 0	// ADC, SD, HV
+#define ENERGY_ON 1
+#define ENERGY_CPU_STOP 0	// power-save, only the RTC running (see Clock.h)
+#define ENERGY_CPU_SLEEP_SLOW 1	// idle at the slow clock
+#define ENERGY_CPU_SLEEP 2	// idle at full speed
+#define ENERGY_CPU_ACTIVE 3
+#define ENERGY_RADIO_SLEEP 0
+#define ENERGY_RADIO_IDLE 1	// TRX_OFF
+#define ENERGY_RADIO_RX 2	// listening, or PLL on waiting to send
+#define ENERGY_RADIO_TX 3
+
+// current model (uA) by subsystem and state
+#define ENERGY_MODEL {\
+	{3, 700, 3600, 11000},	/* cpu: power-save with the RTC, idle at 4MHz, idle at 32MHz, active at 32MHz */\
+	{0, 400, 9200, 25000},	/* radio (AT86RF212): sleep (0.2uA), trx off, rx, tx at +10dBm (PHY_TX_PWR 0xE1, chb_init) */\
+	{0, 6000, 0, 0},	/* ADC: AD7767, amplifiers and mux (estimate) */\
+	{0, 20000, 0, 0},	/* SD card: average while powered (estimate) */\
+	{0, 5000, 0, 0}	/* HV supply (estimate) */\
+}
+#define ENERGY_POLL_MS 240000UL	// Energy_Poll at least this often or long stretches in one state get lost
+
+// subsystem changed power state. safe from ISRs
+void Energy_Set(uint8_t subsystem, uint8_t state);
+// fold the time in the current states into the totals
+void Energy_Poll();
+// zero the totals and count from now. the states already reported are kept. needs the local clock running (TimeSynch_Init)
+void Energy_Reset();
+// current of a state (uA)
+void Energy_Set_Current(uint8_t subsystem, uint8_t state, uint16_t uA);
+// time in a state (ms) and charge drawn by a subsystem (uA*s, i.e. uC) since Energy_Reset
+uint32_t Energy_Get_Ms(uint8_t subsystem, uint8_t state);
+uint32_t Energy_Get_Charge(uint8_t subsystem);
+// time counted (ms)
+uint32_t Energy_Get_Elapsed();
+
+#endif /* ENERGY_H_ */
@@ -0,0 +1,147 @@
+/*
+ * Event.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Event.h"
+#include "Hal.h"
+#include "Clock.h"
+#include "Energy.h"
+#include "TimeSynch.h"
+
+#define EVENT_TICKS_PER_RTC ((int32_t)(CLOCK_TICK_HZ/CLOCK_RTC_HZ))	// signed, a deadline can be past
+#define EVENT_RTC_MIN 3	// (RTC ticks) a deadline closer than this is due: the RTC could miss a compare that near
+
+static volatile uint8_t Pending;
+static uint8_t Armed;
+static uint32_t Deadline;	// local time
+
+//local ticks to whole RTC ticks. an RTC tick isn't a whole number of local ticks, the ~0.06% adds up over a long stop
+static uint16_t Event_Rtc_Ticks(uint32_t ticks){
+	return ticks*(CLOCK_RTC_HZ/64)/(CLOCK_TICK_HZ/64);	// fits up to CLOCK_STOP_MAX RTC ticks
+}
+
+void Event_Post(uint8_t events){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	Pending |= events;
+	Hal_Irq_Restore(irq);
+}
+
+//stop the compares and post the timer event. interrupts are off
+static void Event_Timer_Due(){
+	Hal_Timer_Int_Ctrlb(HAL_TCF0, Hal_Timer_Get_Int_Ctrlb(HAL_TCF0) & ~TC0_CCDINTLVL_gm);
+	Hal_Rtc_Int_Ctrl(Hal_Rtc_Get_Int_Ctrl() & ~RTC_COMPINTLVL_gm);
+	Armed = FALSE;
+	Pending |= EVENT_TIMER;
+}
+
+//the compare on the high word of the local clock gets within 65536 ticks of the deadline and a compare on the RTC the rest of
+//the way. the high word compare only fires when the count gets to it, so one that is already there (or past) is checked here
+//too. interrupts are off
+static void Event_Check_Timer(){
+
+	int32_t left;
+
+	if(!Armed || (int16_t)((uint16_t)(Deadline >> 16) - Hal_Timer_Get_Count(HAL_TCF0)) > 0) return;
+	left = (int32_t)(Deadline - TimeSynch_Get_Local_Time());
+	if(left < EVENT_RTC_MIN*EVENT_TICKS_PER_RTC) Event_Timer_Due();
+	else if(!(Hal_Rtc_Get_Int_Ctrl() & RTC_COMPINTLVL_gm)){
+		Hal_Timer_Int_Ctrlb(HAL_TCF0, Hal_Timer_Get_Int_Ctrlb(HAL_TCF0) & ~TC0_CCDINTLVL_gm);
+		Hal_Rtc_Wait();
+		Hal_Rtc_Compare(Hal_Rtc_Get_Count() + Event_Rtc_Ticks(left));
+		Hal_Rtc_Clear_Flags(RTC_COMPIF_bm);
+		Hal_Rtc_Int_Ctrl((Hal_Rtc_Get_Int_Ctrl() & ~RTC_COMPINTLVL_gm) | RTC_COMPINTLVL_LO_gc);
+	}
+}
+
+//the local clock stops in power-save, so the RTC times the whole wait: up to the deadline, or CLOCK_STOP_MAX to wake up and
+//go round again. a deadline the high word compare hasn't reached can still be only a few RTC ticks off. interrupts are off
+static void Event_Arm_Stop(){
+
+	uint32_t left = CLOCK_STOP_MAX;
+	int32_t ticks;
+
+	if(Armed){
+		ticks = (int32_t)(Deadline - TimeSynch_Get_Local_Time());
+		if(ticks < (int32_t)(CLOCK_STOP_MAX*EVENT_TICKS_PER_RTC)) left = (ticks > 0) ? Event_Rtc_Ticks(ticks) : 0;
+		if(left < EVENT_RTC_MIN) left = EVENT_RTC_MIN;
+	}
+	Hal_Rtc_Wait();
+	Hal_Rtc_Compare(Hal_Rtc_Get_Count() + left);
+	Hal_Rtc_Clear_Flags(RTC_COMPIF_bm);
+	Hal_Rtc_Int_Ctrl((Hal_Rtc_Get_Int_Ctrl() & ~RTC_COMPINTLVL_gm) | RTC_COMPINTLVL_LO_gc);
+	Hal_Irq_Levels_On(PMIC_LOLVLEN_bm);
+}
+
+void Event_Wake_At(uint32_t t){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	if(!Armed || (int32_t)(t - Deadline) < 0){
+		Deadline = t;
+		Armed = TRUE;
+		Hal_Rtc_Int_Ctrl(Hal_Rtc_Get_Int_Ctrl() & ~RTC_COMPINTLVL_gm);
+		Hal_Timer_Cc(HAL_TCF0, HAL_CCD, (uint16_t)(t >> 16));
+		Hal_Timer_Clear_Flags(HAL_TCF0, TC0_CCDIF_bm);
+		Hal_Timer_Int_Ctrlb(HAL_TCF0, (Hal_Timer_Get_Int_Ctrlb(HAL_TCF0) & ~TC0_CCDINTLVL_gm) | TC_CCDINTLVL_LO_gc);
+		Hal_Irq_Levels_On(PMIC_LOLVLEN_bm);
+	}
+	Hal_Irq_Restore(irq);
+}
+
+uint8_t Event_Wait(uint8_t events){
+
+	hal_irq_t irq = Hal_Irq_Save();
+	uint8_t got, mode;
+
+	Event_Check_Timer();
+	while(!(Pending & events)){
+		//Hal_Sleep lets interrupts in only as the core goes to sleep, so one that comes in after the check still wakes it.
+		//the interrupts run at the slow clock, the caller at full speed again. with nothing holding the clock running the core
+		//goes to power-save instead and the local clock catches up when it wakes (see Clock.h)
+		if(Clock_Can_Stop()){
+			mode = SLEEP_SMODE_PSAVE_gc;
+			Event_Arm_Stop();
+			Energy_Set(ENERGY_CPU, ENERGY_CPU_STOP);
+			Clock_Stop();
+		}
+		else{
+			mode = SLEEP_SMODE_IDLE_gc;
+			Clock_Slow();
+			Energy_Set(ENERGY_CPU, (Clock_Hz() == CLOCK_SLOW_HZ) ? ENERGY_CPU_SLEEP_SLOW : ENERGY_CPU_SLEEP);
+		}
+		Hal_Sleep(mode);
+		Clock_Start();
+		Energy_Set(ENERGY_CPU, ENERGY_CPU_ACTIVE);
+		Event_Check_Timer();
+	}
+	Clock_Fast();
+	got = Pending & events;
+	Pending &= ~got;
+	Hal_Irq_Restore(irq);
+	return got;
+}
+
+uint8_t Event_Get(uint8_t events){
+
+	hal_irq_t irq = Hal_Irq_Save();
+	uint8_t got;
+
+	Event_Check_Timer();
+	got = Pending & events;
+	Pending &= ~got;
+	Hal_Irq_Restore(irq);
+	return got;
+}
+
+ISR(TCF0_CCD_vect){
+	Event_Check_Timer();
+}
+
+ISR(RTC_COMP_vect){
+	Clock_Start();
+	Hal_Rtc_Int_Ctrl(Hal_Rtc_Get_Int_Ctrl() & ~RTC_COMPINTLVL_gm);
+	Event_Check_Timer();
+}
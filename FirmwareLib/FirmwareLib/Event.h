@@ -0,0 +1,42 @@
+/*
+ * Event.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include "constants_and_globals.h"
+
+// Events
+// interrupts post events and the code waiting on them sleeps until one comes in instead of spinning on a flag.
+// timers are tickless: there is no periodic wakeup. whoever has a deadline asks for one with Event_Wake_At() before waiting and
+// the earliest one goes on a compare of the high word of the local clock (TCF0.CCD) and, once that is within 65536 ticks
+// (~16ms), on a compare of the RTC, so the core sleeps until it is due. the RTC counts the 32kHz crystal, so a wakeup comes up
+// to a few RTC ticks (~100us) early and that bit is spent awake. callers check their deadline again after waking up anyway.
+// the core runs at the slow clock while it sleeps, or stops it in power-save when nothing needs it running (see Clock.h). in
+// power-save the RTC times the whole wait.
+// needs the local clock (TimeSynch_Init) and the RTC (Clock_Init) running.
+#define EVENT_RADIO_RX 0x01	// frame received (pcb->data_rcv)
+#define EVENT_RADIO_TX 0x02	// the radio is done with a frame (pcb->tx_end)
+#define EVENT_SAMPLES 0x04	// an acquisition finished (ADC_Sampling_Finished) or another ADC_BLOCK_SAMPLES samples came in
+#define EVENT_TIMER 0x08	// a deadline given to Event_Wake_At came up, or a synch beacon is due on the root
+#define EVENT_TIMEOUT 0x10	// the reply timeout (TCE0) ran out
+#define EVENT_HOST 0x20	// bytes from the host on the serial link
+#define EVENT_QUEUE 0x40	// an item went into a queue (see Queue.h)
+#define EVENT_ALL 0xFF
+
+// post events. safe from ISRs and the main loop
+void Event_Post(uint8_t events);
+// wake up at local time t if nothing else does first. the earliest deadline asked for since the last timer event wins.
+// a deadline that has already passed makes the next Event_Wait return right away
+void Event_Wake_At(uint32_t t);
+// sleep until one of events is pending. returns the ones that were and clears them. the others stay pending.
+// check the flag being waited on before calling: events posted after the check are never missed
+uint8_t Event_Wait(uint8_t events);
+// Event_Wait without the sleep: returns the ones of events that are pending and clears them
+uint8_t Event_Get(uint8_t events);
+
+#endif /* EVENT_H_ */
@@ -25,7 +25,7 @@ unsigned char getBootSectorData (void)
 struct BS_Structure *bpb; //mapping the buffer onto the structure
 struct MBRinfo_Structure *mbr;
 struct partitionInfo_Structure *partition;
-unsigned long dataSectors;
+uint32_t dataSectors;
 
 unusedSectors = 0;
 
@@ -70,7 +70,7 @@ return 0;
 //Arguments: cluster number for which first sector is to be found
 //return: first sector address
 //***************************************************************************
-unsigned long getFirstSector(unsigned long clusterNumber)
+uint32_t getFirstSector(uint32_t clusterNumber)
 {
   return (((clusterNumber - 2) * sectorPerCluster) + firstDataSector);
 }
@@ -82,26 +82,26 @@ unsigned long getFirstSector(unsigned long clusterNumber)
 //if next cluster is to be set 3. next cluster number, if argument#2 = SET, else 0
 //return: next cluster number, if if argument#2 = GET, else 0
 //****************************************************************************
-unsigned long getSetNextCluster (unsigned long clusterNumber,
+uint32_t getSetNextCluster (uint32_t clusterNumber,
                                  unsigned char get_set,
-                                 unsigned long clusterEntry)
+                                 uint32_t clusterEntry)
 {
-unsigned int FATEntryOffset;
-unsigned long *FATEntryValue;
-unsigned long FATEntrySector;
+uint16_t FATEntryOffset;
+uint32_t *FATEntryValue;
+uint32_t FATEntrySector;
 //unsigned char retry = 0;
 
 //get sector number of the cluster entry in the FAT
 FATEntrySector = unusedSectors + reservedSectorCount + ((clusterNumber * 4) / bytesPerSector) ;
 
 //get the offset address in that sector number
-FATEntryOffset = (unsigned int) ((clusterNumber * 4) % bytesPerSector);
+FATEntryOffset = (uint16_t) ((clusterNumber * 4) % bytesPerSector);
 
 //read the sector into a buffer
 SD_read_block(FATEntrySector,SDBuffer);
 
 //get the cluster address from the buffer
-FATEntryValue = (unsigned long *) &SDBuffer[FATEntryOffset];
+FATEntryValue = (uint32_t *) &SDBuffer[FATEntryOffset];
 
 if(get_set == GET)
   return ((*FATEntryValue) & 0x0fffffff);
@@ -123,7 +123,7 @@ return (0);
 //        total number of free clusters, if arg1 is TOTAL_FREE & arg2 is GET
 //		  0xffffffff, if any error or if arg2 is SET
 //********************************************************************************************
-unsigned long getSetFreeCluster(unsigned char totOrNext, unsigned char get_set, unsigned long FSEntry)
+uint32_t getSetFreeCluster(unsigned char totOrNext, unsigned char get_set, uint32_t FSEntry)
 {
 struct FSInfo_Structure *FS = (struct FSInfo_Structure *) &SDBuffer;
 
@@ -160,9 +160,9 @@ if((FS->leadSignature != 0x41615252) || (FS->structureSignature != 0x61417272) |
 //****************************************************************************
 struct dir_Structure* findFiles (unsigned char flag, unsigned char *fileName)
 {
-unsigned long cluster, sector, firstSector, firstCluster, nextCluster;
+uint32_t cluster, sector, firstSector, firstCluster, nextCluster;
 struct dir_Structure *dir;
-unsigned int i;
+uint16_t i;
 unsigned char j;
 
 cluster = rootCluster; //root cluster
@@ -196,13 +196,13 @@ while(1)
               {
 			    appendFileSector = firstSector + sector;
 				appendFileLocation = i;
-				appendStartCluster = (((unsigned long) dir->firstClusterHI) << 16) | dir->firstClusterLO;
+				appendStartCluster = (((uint32_t) dir->firstClusterHI) << 16) | dir->firstClusterLO;
 				fileSize = dir->fileSize;
 			    return (dir);
 			  }	
 			  else    //when flag = DELETE
 			  {
-				 firstCluster = (((unsigned long) dir->firstClusterHI) << 16) | dir->firstClusterLO;
+				 firstCluster = (((uint32_t) dir->firstClusterHI) << 16) | dir->firstClusterLO;
                 
 				 //mark file as 'deleted' in FAT table
 				 dir->name[0] = DELETED;    
@@ -255,12 +255,12 @@ return 0;
 //	      1, if file is already existing and flag = VERIFY; or if flag=READ and file does not exist
 //		  2, if file name is incompatible
 //***************************************************************************
-unsigned char readFile (unsigned char flag, unsigned char *fileName)
+static unsigned char readFileHeld (unsigned char flag, unsigned char *fileName)
 {
 struct dir_Structure *dir;
-unsigned long cluster, firstSector;
-//unsigned long byteCounter;
-//unsigned long  fileSize;
+uint32_t cluster, firstSector;
+//uint32_t byteCounter;
+//uint32_t  fileSize;
 unsigned char j, error;
 
 error = convertFileName (fileName); //convert fileName into FAT format
@@ -275,7 +275,7 @@ if(dir == 0)
 
 if(flag == VERIFY) return (1);	//specified file name is already existing
 
-cluster = (((unsigned long) dir->firstClusterHI) << 16) | dir->firstClusterLO;
+cluster = (((uint32_t) dir->firstClusterHI) << 16) | dir->firstClusterLO;
 
 //fileSize = dir->fileSize;
 
@@ -333,7 +333,7 @@ if(j>8 && j<12) {//Invalid fileName
 	return 1;}
 else if (j==12) NoExtension=TRUE;	
 
-for(k=0; k<j; k++) //setting file name
+for(k=0; k<j && k<8; k++) //setting file name (a name without extension is cut at 8)
   fileNameFAT[k] = Filename[k];
 
 for(k=j; k<=7; k++) //filling file name trail with blanks
@@ -365,12 +365,13 @@ return 0;
 //Arguments: pointer to the file name
 //return: 1 - invalid filename, 2 - no free cluster, 3 - end of cluster chain, 4 - error in getting cluster
 //************************************************************************************
-unsigned char writeFile (unsigned char* fileName,uint8_t* dataArray,uint32_t lengthOfData){
+static unsigned char writeFileHeld (unsigned char* fileName,uint8_t* dataArray,uint32_t lengthOfData){
 unsigned char j, fileCreatedFlag = 0, start = 0, appendFile = 0, sector=0;
 //unsigned char error, data;
-unsigned int firstClusterHigh=0, firstClusterLow=0, startBlock=0;  //value 0 is assigned just to avoid warning in compilation
+uint16_t firstClusterHigh=0, firstClusterLow=0;  //value 0 is assigned just to avoid warning in compilation
+uint32_t startBlock=0;	//a sector number, 16 bits ran out 32MB into the card
 struct dir_Structure *dir;
-unsigned long cluster, nextCluster, prevCluster, firstSector, clusterCount, extraMemory;
+uint32_t cluster, nextCluster, prevCluster, firstSector, clusterCount, extraMemory;
 
 
 j = readFile (VERIFY, fileName);
@@ -386,7 +387,7 @@ if(j == 1)
   while(1)
   {
     nextCluster = getSetNextCluster (cluster, GET, 0);
-    if(nextCluster == EOF) break;
+    if(nextCluster == FAT_EOC) break;
 	cluster = nextCluster;
 	clusterCount++;
   }
@@ -411,10 +412,10 @@ else
 	   // No free cluster!
 	  return 2;
    }
-  getSetNextCluster(cluster, SET, EOF);   //set last cluster of the file, marked EOF
+  getSetNextCluster(cluster, SET, FAT_EOC);   //set last cluster of the file, marked EOF
    
-  firstClusterHigh = (unsigned int) ((cluster & 0xffff0000) >> 16 );
-  firstClusterLow = (unsigned int) ( cluster & 0x0000ffff);
+  firstClusterHigh = (uint16_t) ((cluster & 0xffff0000) >> 16 );
+  firstClusterLow = (uint16_t) ( cluster & 0x0000ffff);
   fileSize = 0;
 }
 
@@ -458,7 +459,8 @@ while(lengthOfData!=0){
 		  return 2;
 	   }
 		getSetNextCluster(prevCluster, SET, cluster);
-		getSetNextCluster(cluster, SET, EOF);   //last cluster of the file, marked EOF
+		getSetNextCluster(cluster, SET, FAT_EOC);   //last cluster of the file, marked EOF
+		startBlock = getFirstSector (cluster);	//carry on at the start of the new cluster
 	}
 	//otherwise increment the sector offset 
 	else startBlock++;       
@@ -537,11 +539,11 @@ while(1)
 
    if(cluster > 0x0ffffff6)
    {
-      if(cluster == EOF)   //this situation will come when total files in root is multiple of (32*sectorPerCluster)
+      if(cluster == FAT_EOC)   //this situation will come when total files in root is multiple of (32*sectorPerCluster)
 	  {  
 		cluster = searchNextFreeCluster(prevCluster); //find next cluster for root directory entries
 		getSetNextCluster(prevCluster, SET, cluster); //link the new cluster of root to the previous cluster
-		getSetNextCluster(cluster, SET, EOF);  //set the new cluster as end of the root directory
+		getSetNextCluster(cluster, SET, FAT_EOC);  //set the new cluster as end of the root directory
       } 
 
       else
@@ -561,15 +563,39 @@ while(1)
 }
 
 
+//***************************************************************************
+//readFile and writeFile keep the sd card selected for the whole file (see SD_Hold)
+//instead of selecting it through the port expander for every sector
+//***************************************************************************
+unsigned char readFile (unsigned char flag, unsigned char *fileName)
+{
+unsigned char result;
+
+SD_Hold(TRUE);
+result = readFileHeld(flag, fileName);
+SD_Hold(FALSE);
+return result;
+}
+
+unsigned char writeFile (unsigned char* fileName,uint8_t* dataArray,uint32_t lengthOfData)
+{
+unsigned char result;
+
+SD_Hold(TRUE);
+result = writeFileHeld(fileName, dataArray, lengthOfData);
+SD_Hold(FALSE);
+return result;
+}
+
 //***************************************************************************
 //Function: to search for the next free cluster in the root directory
 //          starting from a specified cluster
 //Arguments: Starting cluster
 //return: the next free cluster
 //****************************************************************
-unsigned long searchNextFreeCluster (unsigned long startCluster)
+uint32_t searchNextFreeCluster (uint32_t startCluster)
 {
-  unsigned long cluster, *value, sector;
+  uint32_t cluster, *value, sector;
   unsigned char i;
     
 	startCluster -=  (startCluster % 128);   //to start with the first file in a FAT sector
@@ -579,7 +605,7 @@ unsigned long searchNextFreeCluster (unsigned long startCluster)
       SD_read_block(sector,SDBuffer);
       for(i=0; i<128; i++)
       {
-       	 value = (unsigned long *) &SDBuffer[i*4];
+       	 value = (uint32_t *) &SDBuffer[i*4];
          if(((*value) & 0x0fffffff) == 0)
             return(cluster+i);
       }  
@@ -611,9 +637,9 @@ void deleteFile (unsigned char *fileName)
 //Arguments: #1.flag ADD or REMOVE #2.file size in Bytes
 //return: none
 //********************************************************************
-void freeMemoryUpdate (unsigned char flag, unsigned long size)
+void freeMemoryUpdate (unsigned char flag, uint32_t size)
 {
-  unsigned long freeClusters;
+  uint32_t freeClusters;
   //convert file size into number of clusters occupied
   if((size % 512) == 0) size = size / 512;
   else size = (size / 512) +1;
@@ -12,70 +12,74 @@
 #ifndef _FAT32_H_
 #define _FAT32_H_
 
+#include <stdint.h>
+
+//the structures below map sectors read off the card byte for byte: fixed width fields and no padding, whatever int is
+
 //Structure to access Master Boot Record for getting info about partioions
 struct MBRinfo_Structure{
 unsigned char	nothing[446];		//ignore, placed here to fill the gap in the structure
 unsigned char	partitionData[64];	//partition records (16x4)
-unsigned int	signature;		//0xaa55
-};
+uint16_t	signature;		//0xaa55
+} __attribute__((packed));
 
 //Structure to access info of the first partioion of the disk 
 struct partitionInfo_Structure{ 				
 unsigned char	status;				//0x80 - active partition
 unsigned char 	headStart;			//starting head
-unsigned int	cylSectStart;		//starting cylinder and sector
+uint16_t	cylSectStart;		//starting cylinder and sector
 unsigned char	type;				//partition type 
 unsigned char	headEnd;			//ending head of the partition
-unsigned int	cylSectEnd;			//ending cylinder and sector
-unsigned long	firstSector;		//total sectors between MBR & the first sector of the partition
-unsigned long	sectorsTotal;		//size of this partition in sectors
-};
+uint16_t	cylSectEnd;			//ending cylinder and sector
+uint32_t	firstSector;		//total sectors between MBR & the first sector of the partition
+uint32_t	sectorsTotal;		//size of this partition in sectors
+} __attribute__((packed));
 
 //Structure to access boot sector data
 struct BS_Structure{
 unsigned char jumpBoot[3]; //default: 0x009000EB
 unsigned char OEMName[8];
-unsigned int bytesPerSector; //deafault: 512
+uint16_t bytesPerSector; //deafault: 512
 unsigned char sectorPerCluster;
-unsigned int reservedSectorCount;
+uint16_t reservedSectorCount;
 unsigned char numberofFATs;
-unsigned int rootEntryCount;
-unsigned int totalSectors_F16; //must be 0 for FAT32
+uint16_t rootEntryCount;
+uint16_t totalSectors_F16; //must be 0 for FAT32
 unsigned char mediaType;
-unsigned int FATsize_F16; //must be 0 for FAT32
-unsigned int sectorsPerTrack;
-unsigned int numberofHeads;
-unsigned long hiddenSectors;
-unsigned long totalSectors_F32;
-unsigned long FATsize_F32; //count of sectors occupied by one FAT
-unsigned int extFlags;
-unsigned int FSversion; //0x0000 (defines version 0.0)
-unsigned long rootCluster; //first cluster of root directory (=2)
-unsigned int FSinfo; //sector number of FSinfo structure (=1)
-unsigned int BackupBootSector;
+uint16_t FATsize_F16; //must be 0 for FAT32
+uint16_t sectorsPerTrack;
+uint16_t numberofHeads;
+uint32_t hiddenSectors;
+uint32_t totalSectors_F32;
+uint32_t FATsize_F32; //count of sectors occupied by one FAT
+uint16_t extFlags;
+uint16_t FSversion; //0x0000 (defines version 0.0)
+uint32_t rootCluster; //first cluster of root directory (=2)
+uint16_t FSinfo; //sector number of FSinfo structure (=1)
+uint16_t BackupBootSector;
 unsigned char reserved[12];
 unsigned char driveNumber;
 unsigned char reserved1;
 unsigned char bootSignature;
-unsigned long volumeID;
+uint32_t volumeID;
 unsigned char volumeLabel[11]; //"NO NAME "
 unsigned char fileSystemType[8]; //"FAT32"
 unsigned char bootData[420];
-unsigned int bootEndSignature; //0xaa55
-};
+uint16_t bootEndSignature; //0xaa55
+} __attribute__((packed));
 
 
 //Structure to access FSinfo sector data
 struct FSInfo_Structure
 {
-unsigned long leadSignature; //0x41615252
+uint32_t leadSignature; //0x41615252
 unsigned char reserved1[480];
-unsigned long structureSignature; //0x61417272
-unsigned long freeClusterCount; //initial: 0xffffffff
-unsigned long nextFreeCluster; //initial: 0xffffffff
+uint32_t structureSignature; //0x61417272
+uint32_t freeClusterCount; //initial: 0xffffffff
+uint32_t nextFreeCluster; //initial: 0xffffffff
 unsigned char reserved2[12];
-unsigned long trailSignature; //0xaa550000
-};
+uint32_t trailSignature; //0xaa550000
+} __attribute__((packed));
 
 //Structure to access Directory Entry in the FAT
 struct dir_Structure{
@@ -83,15 +87,15 @@ unsigned char name[11];
 unsigned char attrib; //file attributes
 unsigned char NTreserved; //always 0
 unsigned char timeTenth; //tenths of seconds, set to 0 here
-unsigned int createTime; //time file was created
-unsigned int createDate; //date file was created
-unsigned int lastAccessDate;
-unsigned int firstClusterHI; //higher word of the first cluster number
-unsigned int writeTime; //time of last write
-unsigned int writeDate; //date of last write
-unsigned int firstClusterLO; //lower word of the first cluster number
-unsigned long fileSize; //size of file in bytes
-};
+uint16_t createTime; //time file was created
+uint16_t createDate; //date file was created
+uint16_t lastAccessDate;
+uint16_t firstClusterHI; //higher word of the first cluster number
+uint16_t writeTime; //time of last write
+uint16_t writeDate; //date of last write
+uint16_t firstClusterLO; //lower word of the first cluster number
+uint32_t fileSize; //size of file in bytes
+} __attribute__((packed));
 
 //Attribute definitions for file/directory
 #define ATTR_READ_ONLY     0x01
@@ -119,16 +123,16 @@ unsigned long fileSize; //size of file in bytes
 #define GET_LIST     0
 #define GET_FILE     1
 #define DELETE		 2
-#define EOF		0x0fffffff
+#define FAT_EOC		0x0fffffff	//end of a cluster chain (not EOF, which stdio.h defines as -1 and wins)
 
 
 //#define MAX_STRING_SIZE		100	 //defining the maximum size of the dataString
 
 
 //************* external variables *************
-volatile unsigned long firstDataSector, rootCluster, totalClusters;
-volatile unsigned int  bytesPerSector, sectorPerCluster, reservedSectorCount;
-unsigned long unusedSectors, appendFileSector, appendFileLocation, fileSize, appendStartCluster;
+volatile uint32_t firstDataSector, rootCluster, totalClusters;
+volatile uint16_t  bytesPerSector, sectorPerCluster, reservedSectorCount;
+uint32_t unusedSectors, appendFileSector, appendFileLocation, fileSize, appendStartCluster;
 uint8_t Filename[15];	//array to store file name to be used
 
 //global flag to keep track of free cluster count updating in FSinfo sector
@@ -141,17 +145,17 @@ unsigned char freeClusterCountUpdated;
 
 //************* functions *************
 unsigned char getBootSectorData (void);
-unsigned long getFirstSector(unsigned long clusterNumber);
-unsigned long getSetFreeCluster(unsigned char totOrNext, unsigned char get_set, unsigned long FSEntry);
+uint32_t getFirstSector(uint32_t clusterNumber);
+uint32_t getSetFreeCluster(unsigned char totOrNext, unsigned char get_set, uint32_t FSEntry);
 struct dir_Structure* findFiles (unsigned char flag, unsigned char *fileName);
-unsigned long getSetNextCluster (unsigned long clusterNumber,unsigned char get_set,unsigned long clusterEntry);
+uint32_t getSetNextCluster (uint32_t clusterNumber,unsigned char get_set,uint32_t clusterEntry);
 unsigned char readFile (unsigned char flag, unsigned char *fileName);
 unsigned char convertFileName (unsigned char *fileName);
 unsigned char writeFile (unsigned char* fileName,uint8_t* dataArray,uint32_t lengthOfData);
 void appendFile (void);
-unsigned long searchNextFreeCluster (unsigned long startCluster);
-void displayMemory (unsigned char flag, unsigned long memory);
+uint32_t searchNextFreeCluster (uint32_t startCluster);
+void displayMemory (unsigned char flag, uint32_t memory);
 void deleteFile (unsigned char *fileName);
-void freeMemoryUpdate (unsigned char flag, unsigned long size);
+void freeMemoryUpdate (unsigned char flag, uint32_t size);
 
 #endif
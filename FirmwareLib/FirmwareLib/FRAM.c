@@ -8,82 +8,71 @@
 
 void writeFRAM(uint8_t* buffer, uint16_t length) {
 	
-	uint8_t prev_SPI_settings;
+	writeFRAMAt(buffer, length, FRAMAddress);
+	//increment address by the written length
+	FRAMAddress +=length;
+}
+
+// Write to FRAM at a given address without touching FRAMAddress (used for regions outside the ADC sample area)
+// interrupts are off while the FRAM has the bus, so it goes FR_BUS_CHUNK bytes at a time to keep the ADC interrupt from
+// waiting on a long write
+void writeFRAMAt(uint8_t* buffer, uint16_t length, uint16_t address) {
+	
+	const SPIBus_Device_t* prev;
+	uint16_t chunk;
 	ADCPower(TRUE);
 	
-	prev_SPI_settings = SPIC.CTRL;
-	SPIInit(SPI_MODE_0_gc);
-	SPIC.CTRL = FR_SPI_CONFIG_gc;
-	SPICS(TRUE);
-	PORTB.OUTCLR = PIN3_bm;  // pull down CS_FRAM to write enable
-	nop();
-	SPIC.DATA = FR_WREN;
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	PORTB.OUTSET = PIN3_bm;  // latch opcode
-	nop(); // time for CS_FRAM to accept high signal
-	PORTB.OUTCLR = PIN3_bm;  // pull down CS_FRAM to write enable
-	nop();
-	SPIC.DATA = FR_WRITE;
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	//send address at which to start writing data
-	SPIC.DATA = *(((uint8_t*)&FRAMAddress)+1);
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	SPIC.DATA = *((uint8_t*)&FRAMAddress);
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	//write data to FRAM
-	for(uint32_t i = 0; i< length; i++){
-		SPIC.DATA = buffer[i];
-		while(!(SPIC.STATUS & SPI_IF_bm));
-		SPIBuffer[12] = SPIC.DATA;
+	while(length) {
+		chunk = (length > FR_BUS_CHUNK) ? FR_BUS_CHUNK : length;
+		prev = SPIBus_Acquire(&SPIBus_FRAM);
+		Hal_Gpio_Clr(HAL_PORTB, PIN3_bm);  // pull down CS_FRAM to write enable
+		Hal_Nop();
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, FR_WREN);
+		Hal_Gpio_Set(HAL_PORTB, PIN3_bm);  // latch opcode
+		Hal_Nop(); // time for CS_FRAM to accept high signal
+		Hal_Gpio_Clr(HAL_PORTB, PIN3_bm);  // pull down CS_FRAM to write enable
+		Hal_Nop();
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, FR_WRITE);
+		//send address at which to start writing data
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, *(((uint8_t*)&address)+1));
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, *((uint8_t*)&address));
+		//write data to FRAM
+		for(uint16_t i = 0; i < chunk; i++){
+			SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, buffer[i]);
+		}
+		
+		Hal_Gpio_Set(HAL_PORTB, PIN3_bm);  // pull up CS_FRAM to write protect
+		SPIBus_Release(&SPIBus_FRAM, prev);
+		buffer += chunk;
+		address += chunk;
+		length -= chunk;
 	}
-	
-	PORTB.OUTSET = PIN3_bm;  // pull up CS_FRAM to write protect
-	SPICS(FALSE);
-	SPIC.CTRL = prev_SPI_settings;
-	//SPIC.CTRL = ADC_SPI_CONFIG_gc;
-	//PORTC.OUTCLR = PIN4_bm;  // enable SPI-SS
-	
-	//increment address by the written length
-	FRAMAddress +=length;
 }
 
 // Read from FRAM
 // FRAM power (VDC-2) must be on with CS_FRAM pulled high to write protect
 void readFRAM (uint16_t numBytes, uint16_t startAddress) {
 	
-	//save SPI registers
-	uint8_t prev_SPI_settings;
+	const SPIBus_Device_t* prev;
+	uint16_t chunk, i = 0;
 	ADCPower(TRUE);
 	
-	prev_SPI_settings = SPIC.CTRL;
-	SPIInit(SPI_MODE_0_gc);
-	SPIC.CTRL = FR_SPI_CONFIG_gc;
-	SPICS(TRUE);
-	PORTB.OUTCLR = PIN3_bm;  // pull down CS_FRAM to write enable
-	nop();
-	
-	SPIC.DATA = FR_READ;
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	SPIC.DATA = *(((uint8_t*)&startAddress) + 1);;
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	SPIC.DATA = *(((uint8_t*)&startAddress) + 0);;
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	
-	for(uint16_t i = 0; i < numBytes; i++) {
-		SPIC.DATA = 0xAA;
-		while(!(SPIC.STATUS & SPI_IF_bm));
-		FRAMReadBuffer[i] = SPIC.DATA;
-	}
-
-	PORTB.OUTSET = PIN3_bm;  // CS_FRAM write protect
-	SPICS(FALSE);
-	SPIC.CTRL = prev_SPI_settings;
+	while(i < numBytes) {
+		chunk = (numBytes - i > FR_BUS_CHUNK) ? FR_BUS_CHUNK : numBytes - i;
+		prev = SPIBus_Acquire(&SPIBus_FRAM);
+		Hal_Gpio_Clr(HAL_PORTB, PIN3_bm);  // pull down CS_FRAM to write enable
+		Hal_Nop();
+		
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, FR_READ);
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, *(((uint8_t*)&startAddress) + 1));
+		SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, *(((uint8_t*)&startAddress) + 0));
+		
+		for(uint16_t end = i + chunk; i < end; i++) {
+			FRAMReadBuffer[i] = Hal_Spi_Transfer(HAL_SPIC, 0xAA);
+		}
 
+		Hal_Gpio_Set(HAL_PORTB, PIN3_bm);  // CS_FRAM write protect
+		SPIBus_Release(&SPIBus_FRAM, prev);
+		startAddress += chunk;
+	}
 }
@@ -7,7 +7,10 @@
 
 #include "utility_functions.h"
 
+#define FR_BUS_CHUNK 32	// bytes moved per SPIBus acquisition
+
 void writeFRAM(uint8_t* buffer, uint16_t length);
+void writeFRAMAt(uint8_t* buffer, uint16_t length, uint16_t address);
 void readFRAM (uint16_t numBytes, uint16_t startAddress);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,229 @@
+/*
+ * Hal.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef HAL_H_
+#define HAL_H_
+
+// Hardware abstraction
+// SPIBus.c, FRAM.c, SD_Card.c, the port expander, mux and power switches in utility_functions.c, the AD7767 read in
+// ADC.c, SerialUSB.c, the radio driver (chb.c, chb_drvr.c, chb_spi.c, chb_eeprom.c, Sniffer.c), the clock and timing
+// modules (Clock.c, TimeSynch.c, Event.c) and Energy.c go through these calls instead of the registers, so they also
+// build for the host. the XMEGA backend below maps every call onto the register access it replaced and the target gets
+// the same code as before. built with HAL_SIM defined, HalSim.h (tools/hostsim) supplies the Linux backend: the same
+// calls run against models of the chips on the board. ports, SPI modules, USARTs and timers are passed as handles
+// (HAL_PORTA, HAL_SPIC, HAL_USARTC0, HAL_TCD1, ...). the delays take constants, like the _delay_ functions under them.
+// still on the registers: the rest of ADC.c (sampling timers, internal ADC, event routing), the oscillator setup in
+// utility_functions.c and clksys_driver.c, adc_driver.c and Queue.c (see README).
+
+#ifdef HAL_SIM
+#include "HalSim.h"
+#else
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/delay.h>
+#include "clksys_driver.h"
+
+// interrupts. Hal_Irq_Save turns them off and returns what to give Hal_Irq_Restore
+typedef uint8_t hal_irq_t;
+
+static inline hal_irq_t Hal_Irq_Save(){
+
+	hal_irq_t sreg = SREG;
+
+	cli();
+	return sreg;
+}
+
+#define Hal_Irq_Restore(sreg) (SREG = (sreg))
+#define Hal_Irq_Off() cli()
+#define Hal_Irq_On() sei()
+// software reset, for a state the firmware can't go on from
+#define Hal_Reset() CCPWrite(&RST.CTRL, RST_SWRST_bm)
+// interrupt levels (the PMIC). levels is a mask of PMIC_LOLVLEN_bm, PMIC_MEDLVLEN_bm and PMIC_HILVLEN_bm
+#define Hal_Irq_Levels_On(levels) (PMIC.CTRL |= (levels))
+#define Hal_Irq_Levels_Off(levels) (PMIC.CTRL &= ~(levels))
+
+// gpio. pins is a bitmap
+typedef PORT_t* hal_port_t;
+#define HAL_PORTA (&PORTA)
+#define HAL_PORTB (&PORTB)
+#define HAL_PORTC (&PORTC)
+#define HAL_PORTD (&PORTD)
+#define HAL_PORTE (&PORTE)
+#define HAL_PORTF (&PORTF)
+#define Hal_Gpio_Set(port, pins) ((port)->OUTSET = (pins))
+#define Hal_Gpio_Clr(port, pins) ((port)->OUTCLR = (pins))
+#define Hal_Gpio_Output(port, pins) ((port)->DIRSET = (pins))
+#define Hal_Gpio_Input(port, pins) ((port)->DIRCLR = (pins))
+#define Hal_Gpio_Pullup(port, pin) ((&(port)->PIN0CTRL)[pin] = PORT_OPC_WIREDANDPULL_gc)	// one pin by number
+#define Hal_Gpio_Get_Out(port) ((port)->OUT)
+// pin configuration and the pin change interrupt 0, by the values of the PINnCTRL, INTCTRL and INT0MASK registers
+#define Hal_Gpio_Pin_Ctrl(port, pin, ctrl) ((&(port)->PIN0CTRL)[pin] = (ctrl))
+#define Hal_Gpio_Get_Pin_Ctrl(port, pin) ((&(port)->PIN0CTRL)[pin])
+#define Hal_Gpio_Int_Ctrl(port, ctrl) ((port)->INTCTRL = (ctrl))
+#define Hal_Gpio_Get_Int_Ctrl(port) ((port)->INTCTRL)
+#define Hal_Gpio_Int0_Mask(port, pins) ((port)->INT0MASK = (pins))
+#define Hal_Gpio_Get_Int0_Mask(port) ((port)->INT0MASK)
+
+// spi, master only. ctrl is the value of the module's CTRL register
+typedef SPI_t* hal_spi_t;
+#define HAL_SPIC (&SPIC)
+#define HAL_SPID (&SPID)
+#define Hal_Spi_Ctrl(spi, ctrl) ((spi)->CTRL = (ctrl))
+#define Hal_Spi_Int_Off(spi) ((spi)->INTCTRL = SPI_INTLVL_OFF_gc)
+
+// send a byte and return the one clocked in
+static inline uint8_t Hal_Spi_Transfer(hal_spi_t spi, uint8_t data){
+	spi->DATA = data;
+	while(!(spi->STATUS & SPI_IF_bm));	//wait for byte to be sent
+	return spi->DATA;	//read SPI data register to reset status flag
+}
+
+// usart. ctrla, ctrlb, ctrlc and status are the values of the module's registers, bsel the 12 bit baud setting
+typedef USART_t* hal_usart_t;
+#define HAL_USARTC0 (&USARTC0)
+#define Hal_Usart_Baud(usart, bsel) ((usart)->BAUDCTRLA = (bsel) & 0xFF, (usart)->BAUDCTRLB = ((bsel) >> 8) & 0x0F)
+#define Hal_Usart_Ctrla(usart, ctrla) ((usart)->CTRLA = (ctrla))
+#define Hal_Usart_Get_Ctrla(usart) ((usart)->CTRLA)
+#define Hal_Usart_Ctrlb(usart, ctrlb) ((usart)->CTRLB = (ctrlb))
+#define Hal_Usart_Get_Ctrlb(usart) ((usart)->CTRLB)
+#define Hal_Usart_Ctrlc(usart, ctrlc) ((usart)->CTRLC = (ctrlc))
+#define Hal_Usart_Status(usart) ((usart)->STATUS)
+#define Hal_Usart_Clear_Status(usart, flags) ((usart)->STATUS = (flags))
+#define Hal_Usart_Put(usart, data) ((usart)->DATA = (data))
+#define Hal_Usart_Get(usart) ((usart)->DATA)
+
+// eeprom, a byte at a time through the NVM controller. Hal_Eeprom_Write erases and writes the byte's page, the next access
+// waits for it to finish
+// NVM_EXEC sets CMDEX in NVM.CTRLA, which has to come within 4 cycles of the signature going into CCP
+#define NVM_EXEC()  asm("push r30"      "\n\t"  \
+                "push r31"      "\n\t"  \
+                    "push r16"      "\n\t"  \
+                    "push r18"      "\n\t"  \
+                "ldi r30, 0xCB" "\n\t"  \
+                "ldi r31, 0x01" "\n\t"  \
+                "ldi r16, 0xD8" "\n\t"  \
+                "ldi r18, 0x01" "\n\t"  \
+                "out 0x34, r16" "\n\t"  \
+                "st Z, r18"     "\n\t"  \
+                    "pop r18"       "\n\t"  \
+                "pop r16"       "\n\t"  \
+                "pop r31"       "\n\t"  \
+                "pop r30"       "\n\t"  \
+                )
+
+#define Hal_Eeprom_Unmap() (NVM.CTRLB &= ~NVM_EEMAPEN_bm)	// reach the eeprom through the NVM registers only
+
+static inline void Hal_Eeprom_Write(uint16_t addr, uint8_t value){
+	// flush the eeprom buffers
+	/* Wait until NVM is not busy. */
+	while ((NVM.STATUS & NVM_NVMBUSY_bm) == NVM_NVMBUSY_bm);
+
+	/* Flush EEPROM page buffer if necessary. */
+	if ((NVM.STATUS & NVM_EELOAD_bm) != 0) {
+		NVM.CMD = NVM_CMD_ERASE_EEPROM_BUFFER_gc;
+		NVM_EXEC();
+	}
+
+	// tell the non-volatile regs that we're going to load the eeprom addr
+	NVM.CMD = NVM_CMD_LOAD_EEPROM_BUFFER_gc;
+
+	// load the address
+	NVM.ADDR0 = addr & 0xFF;
+	NVM.ADDR1 = (addr >> 8) & 0x1F;
+	NVM.ADDR2 = 0x00;
+
+	// load the data to write
+	NVM.DATA0 = value;
+
+	// execute the eeprom write command
+	NVM.CMD = NVM_CMD_ERASE_WRITE_EEPROM_PAGE_gc;
+	NVM_EXEC();
+}
+
+static inline uint8_t Hal_Eeprom_Read(uint16_t addr){
+	/* Wait until NVM is not busy. */
+	while ((NVM.STATUS & NVM_NVMBUSY_bm) == NVM_NVMBUSY_bm);
+
+	/* Set address to read from. */
+	NVM.ADDR0 = addr & 0xFF;
+	NVM.ADDR1 = (addr >> 8) & 0x1F;
+	NVM.ADDR2 = 0x00;
+
+	/* Issue EEPROM Read command. */
+	NVM.CMD = NVM_CMD_READ_EEPROM_gc;
+	NVM_EXEC();
+
+	return NVM.DATA0;
+}
+
+// timers. clksel, ctrlb, ctrld, intctrlb and flags are the values of the module's CTRLA, CTRLB, CTRLD, INTCTRLB and INTFLAGS
+// registers. ch is the compare or capture channel (HAL_CCA to HAL_CCD, C and D on TCx0 only). a capture channel is double
+// buffered: reading it gives the oldest capture and its flag stays up while there is another
+#define HAL_TCD1 (&TCD1)
+#define HAL_TCE0 (&TCE0)
+#define HAL_TCF0 (&TCF0)
+#define HAL_TCC0 (&TCC0)
+#define HAL_TCD0 (&TCD0)
+#define Hal_Timer_Clksel(tc, clksel) ((tc)->CTRLA = (clksel))
+#define Hal_Timer_Get_Clksel(tc) ((tc)->CTRLA & TC0_CLKSEL_gm)
+#define Hal_Timer_Running(tc) (Hal_Timer_Get_Clksel(tc) != TC_CLKSEL_OFF_gc)
+#define Hal_Timer_Reset(tc) ((tc)->CTRLFSET = TC_CMD_RESET_gc)	// stopped first
+#define Hal_Timer_Ctrlb(tc, ctrlb) ((tc)->CTRLB = (ctrlb))
+#define Hal_Timer_Ctrld(tc, ctrld) ((tc)->CTRLD = (ctrld))
+#define Hal_Timer_Int_Ctrlb(tc, intctrlb) ((tc)->INTCTRLB = (intctrlb))
+#define Hal_Timer_Get_Int_Ctrlb(tc) ((tc)->INTCTRLB)
+#define Hal_Timer_Flags(tc) ((tc)->INTFLAGS)
+#define Hal_Timer_Clear_Flags(tc, flags) ((tc)->INTFLAGS = (flags))
+#define Hal_Timer_Count(tc, cnt) ((tc)->CNT = (cnt))
+#define Hal_Timer_Get_Count(tc) ((tc)->CNT)
+#define Hal_Timer_Period(tc, per) ((tc)->PER = (per))
+#define Hal_Timer_Get_Period(tc) ((tc)->PER)
+#define HAL_CCA 0
+#define HAL_CCB 1
+#define HAL_CCC 2
+#define HAL_CCD 3
+#define Hal_Timer_Cc(tc, ch, value) ((&(tc)->CCA)[ch] = (value))
+#define Hal_Timer_Get_Cc(tc, ch) ((&(tc)->CCA)[ch])
+
+// event system. mux is the EVSYS_CHMUX_ value of what drives channel ch
+#define Hal_Event_Mux(ch, mux) ((&EVSYS.CH0MUX)[ch] = (mux))
+
+// rtc and its clock. src, ctrl and intctrl are the values of CLK.RTCCTRL, RTC.CTRL and RTC.INTCTRL. writes to CNT and CTRL
+// take a couple of RTC cycles to get across to its clock, and so does a wakeup: Hal_Rtc_Wait waits them out
+#define Hal_Rtc_Source(src) (CLK.RTCCTRL = (src))
+#define Hal_Rtc_Wait() while(RTC.STATUS & RTC_SYNCBUSY_bm)
+#define Hal_Rtc_Ctrl(ctrl) (RTC.CTRL = (ctrl))
+#define Hal_Rtc_Period(per) (RTC.PER = (per))
+#define Hal_Rtc_Count(cnt) (RTC.CNT = (cnt))
+#define Hal_Rtc_Get_Count() (RTC.CNT)
+#define Hal_Rtc_Compare(comp) (RTC.COMP = (comp))
+#define Hal_Rtc_Int_Ctrl(intctrl) (RTC.INTCTRL = (intctrl))
+#define Hal_Rtc_Get_Int_Ctrl() (RTC.INTCTRL)
+#define Hal_Rtc_Clear_Flags(flags) (RTC.INTFLAGS = (flags))
+
+// system clock. the oscillator setup is set_32MHz_Calibrated in utility_functions.c (on clksys_driver.c), the prescalers
+// take the CLK_PSADIV_ and CLK_PSBCDIV_ values
+#define Hal_Clock_32MHz_Calibrated() set_32MHz_Calibrated()
+#define Hal_Clock_Prescalers(psadiv, psbcdiv) CLKSYS_Prescalers_Config(psadiv, psbcdiv)
+
+// sleep in mode (SLEEP_SMODE_IDLE_gc, SLEEP_SMODE_PSAVE_gc) until an interrupt comes in. called with interrupts off and
+// returns with them off. they go on in the instruction before the sleep, which always runs first, so one that comes in after
+// the caller last looked still wakes the core
+#define Hal_Sleep(mode) do{ set_sleep_mode(mode); sleep_enable(); sei(); sleep_cpu(); sleep_disable(); cli(); } while(0)
+
+#define Hal_Delay_Us(us) _delay_us(us)
+#define Hal_Delay_Ms(ms) _delay_ms(ms)
+#define Hal_Nop() __asm__ __volatile__ ("nop")
+// the body of a loop waiting on an interrupt. nothing here, the simulation moves its clock on
+#define Hal_Spin()
+
+#endif /* HAL_SIM */
+
+#endif /* HAL_H_ */
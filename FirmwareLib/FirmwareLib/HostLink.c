@@ -0,0 +1,186 @@
+/*
+ * HostLink.c
+ *
+ * Created: 10/19/2026
+ */
+#include "HostLink.h"
+#include <string.h>
+#include <util/crc16.h>
+
+static uint8_t RxFrame[HOSTLINK_MAX_FRAME];
+static uint16_t RxLength;	// decoded bytes of the frame coming in
+static uint8_t RxCode;	// COBS code of the block being decoded
+static uint8_t RxLeft;	// bytes left in the block
+static uint8_t RxDiscard;	// frame overran the buffer, skip to the next zero
+static uint8_t RxReady;	// RxFrame holds a good frame
+static uint16_t RxPos;	// next message in it
+static uint16_t RxEnd;	// end of its messages
+static uint8_t RxSeq;	// seq of the last good frame
+static uint16_t RxErrors;
+
+static uint8_t TxFrame[HOSTLINK_MAX_FRAME];
+static uint16_t TxLength;
+static uint8_t TxSeq;
+
+static uint16_t HostLink_CRC(uint8_t* data, uint16_t length){
+	uint16_t crc = 0xFFFF;
+	for(uint16_t i = 0; i < length; i++) crc = _crc_xmodem_update(crc, data[i]);
+	return crc;
+}
+
+//COBS encode the frame straight into the serial buffer followed by the zero that ends it
+static void HostLink_Send_Frame(uint8_t* frame, uint16_t length){
+
+	uint16_t start = 0, end;
+
+	while(1){
+		//a block is up to 254 bytes without a zero. the code in front of it is its length + 1
+		for(end = start; end < length && end - start < 254 && frame[end] != 0; end++);
+		SerialWriteByte(end - start + 1);
+		SerialWriteBuffer(frame + start, end - start);
+		if(end >= length) break;
+		//the zero that ended the block is implied by the code. a full block didn't take one
+		start = (end - start == 254) ? end : end + 1;
+	}
+	SerialWriteByte(0);
+}
+
+static void HostLink_Nak(){
+
+	uint8_t frame[HOSTLINK_HEADER_LENGTH + 1 + HOSTLINK_CRC_LENGTH];
+	uint16_t crc;
+
+	frame[0] = HOSTLINK_NAK;
+	frame[1] = TxSeq++;
+	frame[2] = RxSeq;
+	crc = HostLink_CRC(frame, 3);
+	frame[3] = (uint8_t)crc;
+	frame[4] = (uint8_t)(crc >> 8);
+	HostLink_Send_Frame(frame, sizeof(frame));
+}
+
+void HostLink_Init(){
+	RxLength = 0;
+	RxCode = RxLeft = 0;
+	RxDiscard = FALSE;
+	RxReady = FALSE;
+	RxSeq = 0xFF;
+	RxErrors = 0;
+	TxLength = HOSTLINK_HEADER_LENGTH;
+}
+
+//a zero came in: check the frame
+static void HostLink_End_Frame(){
+
+	uint16_t crc;
+
+	if(!RxDiscard && RxLength >= HOSTLINK_HEADER_LENGTH + HOSTLINK_CRC_LENGTH){
+		RxLength -= HOSTLINK_CRC_LENGTH;
+		crc = HostLink_CRC(RxFrame, RxLength);
+		if(RxFrame[RxLength] == (uint8_t)crc && RxFrame[RxLength+1] == (uint8_t)(crc >> 8) && RxFrame[0] == HOSTLINK_COMMANDS){
+			//a gap in the seq means the frame before this one was lost
+			if(RxFrame[1] != (uint8_t)(RxSeq + 1)) RxErrors++;
+			RxSeq = RxFrame[1];
+			RxPos = HOSTLINK_HEADER_LENGTH;
+			RxEnd = RxLength;
+			RxReady = TRUE;
+		}
+		else{
+			RxErrors++;
+			HostLink_Nak();
+		}
+	}
+	else if(RxLength || RxDiscard){
+		RxErrors++;
+		HostLink_Nak();
+	}
+	RxLength = 0;
+	RxCode = RxLeft = 0;
+	RxDiscard = FALSE;
+}
+
+static void HostLink_Put(uint8_t byte){
+	//too long for a frame, skip to the next zero
+	if(RxLength >= HOSTLINK_MAX_FRAME) RxDiscard = TRUE;
+	else RxFrame[RxLength++] = byte;
+}
+
+uint8_t HostLink_Poll(){
+
+	uint8_t byte;
+
+	while(!RxReady){
+		if(TxLength > HOSTLINK_HEADER_LENGTH) HostLink_Flush();
+		if(!SerialAvailable()) return FALSE;
+		byte = SerialReadByte();
+		if(byte == 0){
+			HostLink_End_Frame();
+			continue;
+		}
+		if(RxDiscard) continue;
+		if(RxLeft == 0){
+			//start of a block. the block before it ended in a zero unless it was a full one
+			if(RxCode && RxCode != 0xFF) HostLink_Put(0);
+			RxCode = byte;
+			RxLeft = byte - 1;
+		}
+		else{
+			HostLink_Put(byte);
+			RxLeft--;
+		}
+	}
+	return TRUE;
+}
+
+uint8_t HostLink_Next_Message(uint8_t* message){
+
+	uint8_t length;
+
+	if(!RxReady) return 0;
+	length = RxFrame[RxPos];
+	if(RxPos >= RxEnd || length == 0 || RxPos + 1 + length > RxEnd){
+		RxReady = FALSE;
+		return 0;
+	}
+	memcpy(message, RxFrame + RxPos + 1, length);
+	RxPos += 1 + length;
+	if(RxPos >= RxEnd) RxReady = FALSE;
+	return length;
+}
+
+void HostLink_Write(uint8_t* data, uint16_t length){
+
+	uint16_t chunk;
+
+	while(length){
+		chunk = HOSTLINK_HEADER_LENGTH + HOSTLINK_MAX_PAYLOAD - TxLength;
+		if(chunk > length) chunk = length;
+		memcpy(TxFrame + TxLength, data, chunk);
+		TxLength += chunk;
+		data += chunk;
+		length -= chunk;
+		if(TxLength == HOSTLINK_HEADER_LENGTH + HOSTLINK_MAX_PAYLOAD) HostLink_Flush();
+	}
+}
+
+void HostLink_Write_Byte(uint8_t byte){
+	HostLink_Write(&byte, 1);
+}
+
+void HostLink_Flush(){
+
+	uint16_t crc;
+
+	if(TxLength <= HOSTLINK_HEADER_LENGTH) return;
+	TxFrame[0] = HOSTLINK_DATA;
+	TxFrame[1] = TxSeq++;
+	crc = HostLink_CRC(TxFrame, TxLength);
+	TxFrame[TxLength] = (uint8_t)crc;
+	TxFrame[TxLength+1] = (uint8_t)(crc >> 8);
+	HostLink_Send_Frame(TxFrame, TxLength + HOSTLINK_CRC_LENGTH);
+	TxLength = HOSTLINK_HEADER_LENGTH;
+}
+
+uint16_t HostLink_Get_Errors(){
+	return RxErrors;
+}
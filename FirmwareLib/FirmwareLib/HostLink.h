@@ -0,0 +1,48 @@
+/*
+ * HostLink.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef HOSTLINK_H_
+#define HOSTLINK_H_
+
+#include "constants_and_globals.h"
+#include "SerialUSB.h"
+
+// Framed serial link between the base station and the host
+// every frame is [type, seq, payload..., crc (2 bytes)], COBS encoded so it has no zero bytes, and followed by a zero that
+// ends it. a lost or corrupted byte costs only the frame it is in: the receiver drops anything failing the crc and starts
+// over at the next zero. the crc is CRC-16/CCITT-FALSE (polynomial 0x1021, starting at 0xFFFF) over type, seq and payload,
+// little endian. each end numbers its own frames so the other can tell when one went missing.
+// host to base station: HOSTLINK_COMMANDS with messages [length, destination (2 bytes), command...] the way they used to be
+// sent one at a time. the base station runs them in order.
+// base station to host: HOSTLINK_DATA with the bytes the base station sends back, as many as fit in a frame, so the payloads
+// strung together in seq order are the same stream the host used to get. the replies to all the messages of a frame go out
+// together once the last one is done. HOSTLINK_NAK [last seq taken from the host] says a frame from the host was dropped.
+#define HOSTLINK_COMMANDS 0x01
+#define HOSTLINK_DATA 0x02
+#define HOSTLINK_NAK 0x03
+#define HOSTLINK_HEADER_LENGTH 2
+#define HOSTLINK_CRC_LENGTH 2
+#define HOSTLINK_MAX_PAYLOAD 250
+#define HOSTLINK_MAX_FRAME (HOSTLINK_HEADER_LENGTH + HOSTLINK_MAX_PAYLOAD + HOSTLINK_CRC_LENGTH)
+#define HOSTLINK_BAUD 1000000
+
+void HostLink_Init();
+// take in what came over serial. returns TRUE while a frame from the host has messages left. when there are none, whatever
+// is queued for the host goes out first
+uint8_t HostLink_Poll();
+// copy the next message of the frame (destination and command) into message (at least HOSTLINK_MAX_PAYLOAD bytes).
+// returns its length, 0 if there is none
+uint8_t HostLink_Next_Message(uint8_t* message);
+// queue data for the host. a frame goes out whenever one fills up
+void HostLink_Write(uint8_t* data, uint16_t length);
+void HostLink_Write_Byte(uint8_t byte);
+// send what is queued now
+void HostLink_Flush();
+// frames from the host dropped for a bad crc, bad length or missing seq
+uint16_t HostLink_Get_Errors();
+
+#endif /* HOSTLINK_H_ */
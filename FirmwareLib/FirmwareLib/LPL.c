@@ -0,0 +1,162 @@
+/*
+ * LPL.c
+ *
+ * Created: 10/19/2026
+ */
+#include "LPL.h"
+#include "chb.h"
+#include "chb_drvr.h"
+#include "Event.h"
+
+static uint16_t Interval;	// ms
+static uint32_t IntervalTicks, WindowTicks;
+static uint8_t RadioAwake = TRUE;
+static uint8_t Holding;
+static uint32_t HoldUntil;	// local time
+static uint16_t LastAddr = 0xFFFF;
+static uint32_t LastAck;	// local time
+
+static void LPL_Radio(uint8_t on){
+	if(on != RadioAwake){
+		chb_sleep(!on);
+		RadioAwake = on;
+	}
+}
+
+uint8_t LPL_Check(uint16_t IntervalMs, uint16_t WindowMs){
+
+	uint32_t window = (uint32_t)WindowMs*LPL_TICKS_PER_MS;
+
+	//the window plus the margins around it has to leave some time asleep
+	return !IntervalMs || (IntervalMs <= LPL_MAX_INTERVAL && window > LPL_GUARD_TICKS
+		&& window + 2*LPL_GUARD_TICKS + LPL_WAKEUP_TICKS < (uint32_t)IntervalMs*LPL_TICKS_PER_MS);
+}
+
+uint8_t LPL_Init(uint16_t IntervalMs, uint16_t WindowMs){
+
+	uint32_t window = (uint32_t)WindowMs*LPL_TICKS_PER_MS;
+
+	if(!LPL_Check(IntervalMs, WindowMs)) return FALSE;
+	Interval = IntervalMs;
+	IntervalTicks = (uint32_t)IntervalMs*LPL_TICKS_PER_MS;
+	WindowTicks = window;
+	Holding = FALSE;
+	LastAddr = 0xFFFF;
+	LPL_Radio(TRUE);
+	return TRUE;
+}
+
+uint16_t LPL_Get_Interval(){
+	return Interval;
+}
+
+uint8_t LPL_Window_Open(){
+
+	uint32_t phase;
+
+	if(!IntervalTicks) return TRUE;
+	phase = TimeSynch_Get_Global_Time() % IntervalTicks;
+	return phase >= LPL_GUARD_TICKS && phase < WindowTicks;
+}
+
+uint32_t LPL_Next_Window(uint32_t t){
+
+	uint32_t phase;
+
+	if(!IntervalTicks) return t;
+	phase = t % IntervalTicks;
+	if(phase >= LPL_GUARD_TICKS && phase < WindowTicks) return t;
+	if(phase < LPL_GUARD_TICKS) return t - phase + LPL_GUARD_TICKS;
+	return t - phase + IntervalTicks + LPL_GUARD_TICKS;
+}
+
+uint8_t LPL_Poll(){
+
+	pcb_t* pcb = chb_get_pcb();
+	uint32_t now, phase;
+	uint8_t listen;
+
+	//listen all the time until synched, the window times mean nothing before that
+	if(!IntervalTicks || !TimeSynch_Is_Synched()){
+		LPL_Radio(TRUE);
+		return TRUE;
+	}
+	now = TimeSynch_Get_Local_Time();
+	if(pcb->data_rcv || (RadioAwake && chb_rx_busy())){
+		Holding = TRUE;
+		HoldUntil = now + LPL_HANG_MS*LPL_TICKS_PER_MS;
+	}
+	else if(Holding && (int32_t)(HoldUntil - now) <= 0){
+		Holding = FALSE;
+	}
+	//listen from a bit before the window (wakeup time and synch error) to a bit after it
+	phase = TimeSynch_Local_To_Global(now) % IntervalTicks;
+	listen = phase >= IntervalTicks - LPL_GUARD_TICKS - LPL_WAKEUP_TICKS || phase < WindowTicks + LPL_GUARD_TICKS;
+	LPL_Radio(Holding || listen);
+	//wake up for the next change: the end of the hold or the next edge of the listening part of the interval
+	if(Holding) Event_Wake_At(HoldUntil);
+	else if(phase < WindowTicks + LPL_GUARD_TICKS) Event_Wake_At(now + WindowTicks + LPL_GUARD_TICKS - phase);
+	else if(listen) Event_Wake_At(now + IntervalTicks - phase + WindowTicks + LPL_GUARD_TICKS);
+	else Event_Wake_At(now + IntervalTicks - LPL_GUARD_TICKS - LPL_WAKEUP_TICKS - phase);
+	return RadioAwake;
+}
+
+void LPL_Wake_At_Window(){
+
+	uint32_t global;
+
+	if(!IntervalTicks) return;
+	global = TimeSynch_Get_Global_Time();
+	Event_Wake_At(TimeSynch_Get_Local_Time() + (LPL_Next_Window(global) - global));
+}
+
+//repeat the frame for a whole interval so the receiver hears a copy whenever it wakes up. the copies have the same sequence
+//number so chb_read passes up all but the first one. unicasts stop at the first ack.
+static uint8_t LPL_Strobe(uint16_t addr, uint8_t* data, uint8_t length){
+
+	uint32_t start = TimeSynch_Get_Local_Time();
+	uint8_t status;
+
+	chb_hold_seq(TRUE);
+	do{
+		status = chb_write(addr, data, length);
+	} while((addr == 0xFFFF || status != CHB_SUCCESS) && TimeSynch_Get_Local_Time() - start < IntervalTicks + WindowTicks);
+	chb_hold_seq(FALSE);
+	return status;
+}
+
+uint8_t LPL_Send(uint16_t addr, uint8_t* data, uint8_t length){
+
+	uint8_t first, status = CHB_NO_ACK;
+
+	if(!IntervalTicks) return chb_write(addr, data, length);
+	LPL_Radio(TRUE);
+	//only the first frame has to wake the receiver up
+	first = chb_get_max_payload(addr);
+	if(first > length) first = length;
+
+	if(!TimeSynch_Is_Synched()){
+		status = LPL_Strobe(addr, data, first);
+	}
+	else{
+		//the receiver is still awake if it acked a frame a moment ago
+		if(addr != 0xFFFF && addr == LastAddr && TimeSynch_Get_Local_Time() - LastAck < (LPL_HANG_MS/2)*LPL_TICKS_PER_MS){
+			status = chb_write(addr, data, first);
+		}
+		if(status != CHB_SUCCESS){
+			while(!LPL_Window_Open()){
+				LPL_Wake_At_Window();
+				Event_Wait(EVENT_TIMER);
+			}
+			do{
+				status = chb_write(addr, data, first);
+			} while(status != CHB_SUCCESS && addr != 0xFFFF && LPL_Window_Open());
+		}
+	}
+	if(status == CHB_SUCCESS && addr != 0xFFFF){
+		LastAddr = addr;
+		LastAck = TimeSynch_Get_Local_Time();
+	}
+	if(status == CHB_SUCCESS && length > first) status = chb_write(addr, data + first, length - first);
+	return status;
+}
@@ -0,0 +1,49 @@
+/*
+ * LPL.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef LPL_H_
+#define LPL_H_
+
+#include "constants_and_globals.h"
+#include "TimeSynch.h"
+
+// Low power listening
+// motes keep the radio asleep and wake it every Interval ms to listen for Window ms. the wakeups are lined up on network time
+// (every multiple of Interval) so a synched sender just waits for the next window and sends its frame once. a sender that
+// isn't synched strobes instead: it repeats the frame (same sequence number) for a whole interval so the receiver hears it
+// whenever it wakes up. motes that aren't synched listen all the time, so beacons always get through.
+// the radio is on for about (Window + 2*guard + wakeup)/Interval of the time and a command waits Interval/2 on average
+// before it gets through, so pick Interval for the latency the deployment can live with. Interval 0 turns it off.
+// after receiving a frame a mote stays awake LPL_HANG_MS so the rest of an exchange goes through without waiting.
+#define LPL_DEFAULT_INTERVAL 0	// ms, off. both the base station and the motes have to use the same interval and window
+#define LPL_DEFAULT_WINDOW 10	// ms
+#define LPL_MAX_INTERVAL 1500	// ms, keeps a command from the base station inside its 2 sec reply timeout
+#define LPL_HANG_MS 50
+#define LPL_TICKS_PER_MS (TS_TICKS_PER_SEC/1000)
+#define LPL_GUARD_TICKS (1*LPL_TICKS_PER_MS)	// covers the synch error at both ends of a window
+#define LPL_WAKEUP_TICKS (1*LPL_TICKS_PER_MS)	// radio wakes up this early (sleep to rx takes ~0.4ms)
+
+// set the wake interval and listen window (ms). returns FALSE and leaves the settings alone if they don't fit together
+uint8_t LPL_Init(uint16_t IntervalMs, uint16_t WindowMs);
+// returns TRUE if LPL_Init would take the settings
+uint8_t LPL_Check(uint16_t IntervalMs, uint16_t WindowMs);
+// mote: put the radio to sleep or wake it up according to the schedule. call from the main loop. returns TRUE while the radio is
+// listening. asks for a wakeup (Event_Wake_At) at the next change so the main loop can sleep in between
+uint8_t LPL_Poll();
+// send a frame to a mote that may be duty cycling. waits for the receiver's next window (or strobes). returns the chb_write status
+// broadcasts should fit in a single frame since the receivers may go back to sleep before the rest of a long one
+uint8_t LPL_Send(uint16_t addr, uint8_t* data, uint8_t length);
+// returns TRUE while synched motes are listening (always if low power listening is off). the base station checks this before
+// sending frames that must not wait, like synch beacons
+uint8_t LPL_Window_Open();
+// network time of the first moment at or after t that the motes are listening
+uint32_t LPL_Next_Window(uint32_t t);
+// ask for a wakeup (Event_Wake_At) when the next window opens
+void LPL_Wake_At_Window();
+uint16_t LPL_Get_Interval();
+
+#endif /* LPL_H_ */
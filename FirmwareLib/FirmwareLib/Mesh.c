@@ -0,0 +1,336 @@
+/*
+ * Mesh.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Mesh.h"
+#include <string.h>
+#include "chb_drvr.h"
+#include "chb_eeprom.h"
+#include "FRAM.h"
+#include "ADC.h"
+#include "LPL.h"
+
+// all the mesh state in one place
+static struct{
+	mesh_neighbor_t neighbors[MESH_MAX_NEIGHBORS];
+	uint8_t NumNeighbors;
+	uint8_t IsBase;
+	uint8_t hops;
+	uint16_t parent;
+	uint8_t FloodEpoch;
+	uint8_t FloodSeq;
+	uint8_t FloodSeen;
+	uint16_t head, tail, length;	// queue offsets into the FRAM region and number of queued bytes
+	mesh_stats_t stats;
+} Mesh;
+
+// FRAM is shared with the ADC which writes to it from its ISRs. that's fine through the bus manager, but readFRAM goes through
+// FRAMReadBuffer so leave FRAM alone while an acquisition keeps its samples there
+#define MESH_FRAM_FREE() (ADC_Sampling_Finished || ADC_BUFFER != (int32_t*)FRAMReadBuffer)
+
+void Mesh_Init(uint8_t IsBase){
+	memset(&Mesh, 0, sizeof(Mesh));
+	Mesh.IsBase = IsBase;
+	Mesh.hops = IsBase ? 0 : MESH_NO_ROUTE;
+	Mesh.parent = MESH_BASE_ADDR;
+	if(IsBase){
+		chb_eeprom_read(MESH_EEPROM_EPOCH_ADDR, &Mesh.FloodEpoch, 1);
+		Mesh.FloodEpoch++;
+		chb_eeprom_update(MESH_EEPROM_EPOCH_ADDR, &Mesh.FloodEpoch, 1);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// neighbor table
+
+static mesh_neighbor_t* Mesh_Find_Neighbor(uint16_t addr, uint8_t add){
+
+	uint8_t i, worst = MESH_MAX_NEIGHBORS;
+
+	for(i=0;i<Mesh.NumNeighbors;i++){
+		if(Mesh.neighbors[i].addr == addr) return &Mesh.neighbors[i];
+	}
+	if(!add) return NULL;
+	//table full: replace the stalest (then weakest) neighbor that isn't the parent
+	if(Mesh.NumNeighbors == MESH_MAX_NEIGHBORS){
+		for(i=0;i<MESH_MAX_NEIGHBORS;i++){
+			mesh_neighbor_t* n = &Mesh.neighbors[i];
+			if(n->addr == Mesh.parent) continue;
+			if(worst == MESH_MAX_NEIGHBORS || n->age > Mesh.neighbors[worst].age
+				|| (n->age == Mesh.neighbors[worst].age && n->ed < Mesh.neighbors[worst].ed)) worst = i;
+		}
+		i = worst;
+	}
+	else{
+		i = Mesh.NumNeighbors++;
+	}
+	memset(&Mesh.neighbors[i], 0, sizeof(mesh_neighbor_t));
+	Mesh.neighbors[i].addr = addr;
+	Mesh.neighbors[i].hops = MESH_NO_ROUTE;
+	return &Mesh.neighbors[i];
+}
+
+static void Mesh_Remove_Neighbor(uint8_t i){
+	Mesh.neighbors[i] = Mesh.neighbors[--Mesh.NumNeighbors];
+}
+
+//average the ed of frames heard from the neighbor
+static void Mesh_Update_Link(mesh_neighbor_t* n, uint8_t ed){
+	if(n->ed == 0) n->ed = ed;
+	else n->ed = (uint8_t)((3*(uint16_t)n->ed + ed)/4);
+	n->age = 0;
+}
+
+static uint8_t Mesh_Usable(mesh_neighbor_t* n){
+	return n && !n->child && n->hops < MESH_NO_ROUTE - 1 && n->ed >= MESH_MIN_ED;
+}
+
+//pick the neighbor with the fewest hops to the base station, best link breaking ties
+static void Mesh_Update_Parent(){
+
+	mesh_neighbor_t* best = NULL;
+	mesh_neighbor_t* current = Mesh_Find_Neighbor(Mesh.parent, FALSE);
+	uint8_t i;
+
+	if(Mesh.IsBase) return;
+	for(i=0;i<Mesh.NumNeighbors;i++){
+		mesh_neighbor_t* n = &Mesh.neighbors[i];
+		if(!Mesh_Usable(n)) continue;
+		if(!best || n->hops < best->hops || (n->hops == best->hops && n->ed > best->ed)) best = n;
+	}
+	//stay with the current parent unless the new one is clearly better, to keep the tree from flapping
+	if(best && best != current && Mesh.hops != MESH_NO_ROUTE && Mesh_Usable(current)
+		&& best->hops == current->hops && best->ed < current->ed + MESH_ED_HYSTERESIS){
+		best = current;
+	}
+	if(!best){
+		Mesh.hops = MESH_NO_ROUTE;
+		return;
+	}
+	if(best->addr != Mesh.parent || Mesh.hops == MESH_NO_ROUTE) Mesh.stats.parent_changes++;
+	Mesh.parent = best->addr;
+	Mesh.hops = best->hops + 1;
+}
+
+uint8_t Mesh_Send_Hello(){
+
+	uint8_t hello[MESH_HELLO_LENGTH];
+	uint8_t i;
+
+	//age the table and drop the neighbors that went quiet
+	for(i=0;i<Mesh.NumNeighbors;){
+		if(++Mesh.neighbors[i].age > MESH_NEIGHBOR_TIMEOUT) Mesh_Remove_Neighbor(i);
+		else i++;
+	}
+	Mesh_Update_Parent();
+	hello[0] = MESH_HELLO;
+	hello[1] = Mesh.hops;
+	*(uint16_t*)(hello+2) = Mesh.parent;
+	return LPL_Send(0xFFFF, hello, MESH_HELLO_LENGTH);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// store-and-forward queue (ring in FRAM holding whole records)
+
+static void Mesh_Queue_Write(uint8_t* data, uint16_t length){
+
+	uint16_t first = FR_MESH_SIZE - Mesh.head;
+
+	if(first > length) first = length;
+	writeFRAMAt(data, first, FR_MESH_BASEADD + Mesh.head);
+	if(length > first) writeFRAMAt(data + first, length - first, FR_MESH_BASEADD);
+	Mesh.head = (Mesh.head + length) % FR_MESH_SIZE;
+	Mesh.length += length;
+}
+
+//copy length bytes from the front of the queue without taking them off
+static void Mesh_Queue_Peek(uint8_t* buffer, uint16_t length){
+
+	uint16_t first = FR_MESH_SIZE - Mesh.tail;
+
+	if(first > length) first = length;
+	readFRAM(first, FR_MESH_BASEADD + Mesh.tail);
+	memcpy(buffer, FRAMReadBuffer, first);
+	if(length > first){
+		readFRAM(length - first, FR_MESH_BASEADD);
+		memcpy(buffer + first, FRAMReadBuffer, length - first);
+	}
+}
+
+static void Mesh_Queue_Pop(uint16_t length){
+	Mesh.tail = (Mesh.tail + length) % FR_MESH_SIZE;
+	Mesh.length -= length;
+}
+
+uint16_t Mesh_Queue_Length(){
+	return Mesh.length;
+}
+
+uint16_t Mesh_Queue_Space(){
+	return FR_MESH_SIZE - Mesh.length;
+}
+
+uint8_t Mesh_Enqueue(uint16_t origin, uint8_t* data, uint8_t length){
+
+	uint8_t header[MESH_RECORD_HEADER_LENGTH];
+
+	if(length > MESH_MAX_RECORD || Mesh_Queue_Space() < MESH_RECORD_HEADER_LENGTH + length || !MESH_FRAM_FREE()){
+		Mesh.stats.dropped++;
+		return FALSE;
+	}
+	*(uint16_t*)header = origin;
+	header[2] = length;
+	Mesh_Queue_Write(header, MESH_RECORD_HEADER_LENGTH);
+	Mesh_Queue_Write(data, length);
+	Mesh.stats.queued++;
+	return TRUE;
+}
+
+uint8_t Mesh_Dequeue(uint8_t* record){
+
+	uint8_t length;
+
+	if(Mesh.length < MESH_RECORD_HEADER_LENGTH || !MESH_FRAM_FREE()) return 0;
+	Mesh_Queue_Peek(record, MESH_RECORD_HEADER_LENGTH);
+	length = MESH_RECORD_HEADER_LENGTH + record[2];
+	if(length > Mesh.length){
+		Mesh_Queue_Pop(Mesh.length);
+		return 0;
+	}
+	Mesh_Queue_Peek(record, length);
+	Mesh_Queue_Pop(length);
+	Mesh.stats.forwarded++;
+	return length;
+}
+
+uint8_t Mesh_Forward(){
+
+	uint8_t frame[CHB_MAX_PSDU];
+	uint8_t n, used = 0, count = 0, status;
+	mesh_neighbor_t* parent;
+
+	if(Mesh.IsBase || Mesh.hops == MESH_NO_ROUTE) return MESH_NO_ROUTE;
+	if(Mesh.length == 0 || !MESH_FRAM_FREE()) return CHB_SUCCESS;
+
+	//aggregate as many whole records as fit into one frame
+	n = chb_get_max_payload(Mesh.parent) - 1;
+	if(n > Mesh.length) n = Mesh.length;
+	Mesh_Queue_Peek(frame + 1, n);
+	while(used + MESH_RECORD_HEADER_LENGTH <= n && used + MESH_RECORD_HEADER_LENGTH + frame[1 + used + 2] <= n){
+		used += MESH_RECORD_HEADER_LENGTH + frame[1 + used + 2];
+		count++;
+	}
+	if(used == 0){
+		//can't happen with records from Mesh_Enqueue. don't let a corrupt queue block forwarding forever
+		Mesh.stats.dropped++;
+		Mesh_Queue_Pop(Mesh.length);
+		return CHB_SUCCESS;
+	}
+	frame[0] = MESH_DATA;
+	status = LPL_Send(Mesh.parent, frame, used + 1);
+
+	parent = Mesh_Find_Neighbor(Mesh.parent, FALSE);
+	if(status == CHB_SUCCESS){
+		Mesh_Queue_Pop(used);
+		Mesh.stats.forwarded += count;
+		if(parent) parent->failures = 0;
+	}
+	else{
+		Mesh.stats.tx_failures++;
+		//give up on a parent that keeps failing and look for another one
+		if(parent && ++parent->failures >= MESH_MAX_FAILURES){
+			Mesh_Remove_Neighbor(parent - Mesh.neighbors);
+			Mesh.hops = MESH_NO_ROUTE;
+			Mesh_Update_Parent();
+		}
+	}
+	return status;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// frames
+
+uint8_t Mesh_Flood(uint8_t* command, uint8_t length){
+
+	uint8_t frame[CHB_MAX_PSDU];
+
+	if(length > CHB_MAX_PAYLOAD - MESH_FLOOD_HEADER_LENGTH) return CHB_NO_ACK;
+	frame[0] = MESH_FLOOD;
+	frame[1] = Mesh.FloodEpoch;
+	frame[2] = ++Mesh.FloodSeq;
+	memcpy(frame + MESH_FLOOD_HEADER_LENGTH, command, length);
+	return LPL_Send(0xFFFF, frame, length + MESH_FLOOD_HEADER_LENGTH);
+}
+
+uint8_t Mesh_Handle_Frame(uint8_t* frame, uint8_t* length){
+
+	pcb_t* pcb = chb_get_pcb();
+	mesh_neighbor_t* n;
+	uint8_t offset, RecordLength;
+
+	if(*length == 0) return FALSE;
+
+	switch(frame[0]){
+	case MESH_HELLO:
+		if(*length < MESH_HELLO_LENGTH) return TRUE;
+		n = Mesh_Find_Neighbor(pcb->sender_addr, TRUE);
+		n->hops = frame[1];
+		n->child = (*(uint16_t*)(frame+2) == chb_get_short_addr()) && !Mesh.IsBase;
+		Mesh_Update_Link(n, pcb->ed);
+		Mesh_Update_Parent();
+		return TRUE;
+
+	case MESH_DATA:
+		n = Mesh_Find_Neighbor(pcb->sender_addr, FALSE);
+		if(n) Mesh_Update_Link(n, pcb->ed);
+		//queue the records again as they are so the origin stays with the data. the base station's queue is emptied by
+		//Mesh_Dequeue instead of going to a parent
+		offset = 1;
+		while(offset + MESH_RECORD_HEADER_LENGTH <= *length){
+			RecordLength = frame[offset + 2];
+			if(offset + MESH_RECORD_HEADER_LENGTH + RecordLength > *length) break;
+			Mesh_Enqueue(*(uint16_t*)(frame + offset), frame + offset + MESH_RECORD_HEADER_LENGTH, RecordLength);
+			offset += MESH_RECORD_HEADER_LENGTH + RecordLength;
+		}
+		return TRUE;
+
+	case MESH_FLOOD:
+		if(Mesh.IsBase || *length < MESH_FLOOD_HEADER_LENGTH) return TRUE;
+		//floods come down the tree: take them from the base station or a neighbor closer to it than this mote, so a frame
+		//from anyone else that starts with MESH_FLOOD isn't run as a command from the base station
+		n = Mesh_Find_Neighbor(pcb->sender_addr, FALSE);
+		if(pcb->sender_addr != MESH_BASE_ADDR && (!n || n->hops >= Mesh.hops)) return TRUE;
+		//only the first copy of each flood counts. a newer epoch means the base station was reset and counts from 1 again, a
+		//copy from an older one is still going round from before the reset
+		if(Mesh.FloodSeen){
+			if((int8_t)(frame[1] - Mesh.FloodEpoch) < 0) return TRUE;
+			if(frame[1] == Mesh.FloodEpoch && (int8_t)(frame[2] - Mesh.FloodSeq) <= 0) return TRUE;
+		}
+		Mesh.FloodSeen = TRUE;
+		Mesh.FloodEpoch = frame[1];
+		Mesh.FloodSeq = frame[2];
+		LPL_Send(0xFFFF, frame, *length);
+		//hand the command to the app as if the base station had broadcast it directly
+		*length -= MESH_FLOOD_HEADER_LENGTH;
+		memmove(frame, frame + MESH_FLOOD_HEADER_LENGTH, *length);
+		pcb->sender_addr = MESH_BASE_ADDR;
+		pcb->destination_addr = 0xFFFF;
+		return FALSE;
+
+	default:
+		return FALSE;
+	}
+}
+
+uint16_t Mesh_Get_Parent(){
+	return Mesh.parent;
+}
+
+uint8_t Mesh_Get_Hops(){
+	return Mesh.hops;
+}
+
+mesh_stats_t* Mesh_Get_Stats(){
+	return &Mesh.stats;
+}
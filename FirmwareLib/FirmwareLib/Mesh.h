@@ -0,0 +1,88 @@
+/*
+ * Mesh.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef MESH_H_
+#define MESH_H_
+
+#include "constants_and_globals.h"
+#include "chb.h"
+
+// Multi-hop forwarding toward the base station (address 0x0000)
+// every mote broadcasts a hello with its hop count and parent. motes pick as parent the neighbor with the fewest hops
+// to the base station among those heard well enough (averaged ed), the best ed breaking ties. data is kept as records
+// [origin (2 bytes), length, data] in a store-and-forward queue in FRAM and as many records as fit go to the parent in a
+// single frame. the parent just queues the records again, so the base station gets them with the origin intact.
+// commands for the whole network are flooded: every mote rebroadcasts a flood frame with a new sequence number once.
+// the base station counts its boots in EEPROM and floods carry the count (epoch), so after a reset of the base station
+// motes take its sequence numbers starting over instead of dropping them as copies of floods they already had.
+// a flood is only taken from the base station or a neighbor with fewer hops to it, never from motes further out.
+#define MESH_HELLO 'H'	// 'H', hops, parent (2 bytes). broadcast
+#define MESH_DATA 'A'	// 'A', records... sent to the parent
+#define MESH_FLOOD 'W'	// 'W', epoch, seq, command... broadcast, originated by the base station
+#define MESH_FLOOD_HEADER_LENGTH 3
+#define MESH_HELLO_LENGTH 4
+#define MESH_RECORD_HEADER_LENGTH 3
+#define MESH_MAX_RECORD (CHB_MAX_PAYLOAD - 1 - MESH_RECORD_HEADER_LENGTH)	// max data bytes in a record
+#define MESH_BASE_ADDR 0x0000
+#define MESH_NO_ROUTE 0xFF
+#define MESH_EEPROM_EPOCH_ADDR 0x40	// third EEPROM page, after the saved configuration (CONFIG_EEPROM_ADDR)
+
+#define MESH_HELLO_PERIOD 5	// sec between hellos
+#define MESH_RETRY_MS 10	// wait after a failed forward before trying again
+#define MESH_MAX_NEIGHBORS 8
+#define MESH_MIN_ED 12	// neighbors heard weaker than this (averaged) aren't used as parents
+#define MESH_ED_HYSTERESIS 6	// a parent with the same hop count has to be this much better to switch to it
+#define MESH_NEIGHBOR_TIMEOUT 4	// hello periods without hearing from a neighbor before it is dropped
+#define MESH_MAX_FAILURES 3	// failed forwards in a row before the parent is dropped
+
+// queue in the top of FRAM. ADC acquisitions start at FR_BASEADD and have to stay below FR_MESH_BASEADD on motes that relay.
+#define FR_MESH_BASEADD 0xC000
+#define FR_MESH_SIZE 0x4000
+
+typedef struct{
+	uint16_t addr;
+	uint8_t hops;
+	uint8_t ed;	// averaged
+	uint8_t age;	// hello periods since last heard
+	uint8_t failures;
+	uint8_t child;	// the neighbor uses this mote as its parent
+} mesh_neighbor_t;
+
+typedef struct{
+	uint32_t forwarded;	// records sent on to the parent (taken off the queue on the base station)
+	uint32_t queued;	// records accepted into the queue (own and relayed)
+	uint16_t dropped;	// records lost because the queue was full or FRAM was busy
+	uint16_t tx_failures;
+	uint16_t parent_changes;
+} mesh_stats_t;
+
+// set up the routing state. the base station is the root of the tree (0 hops) and starts a new flood epoch
+void Mesh_Init(uint8_t IsBase);
+// broadcast a hello and age the neighbor table. call periodically (every few seconds)
+uint8_t Mesh_Send_Hello();
+// process a received frame. call right after chb_read. returns TRUE if the frame was used up by the mesh. a flooded command
+// is rebroadcast, moved to the start of frame with *length updated and FALSE returned so the app handles it like a broadcast
+// from the base station (pcb->sender_addr is set to the base station). the base station queues received records like any
+// other mote, to be taken off with Mesh_Dequeue.
+uint8_t Mesh_Handle_Frame(uint8_t* frame, uint8_t* length);
+// base station: flood a command to every mote
+uint8_t Mesh_Flood(uint8_t* command, uint8_t length);
+// queue length bytes of data from origin for forwarding. returns FALSE if it had to be dropped
+uint8_t Mesh_Enqueue(uint16_t origin, uint8_t* data, uint8_t length);
+// base station: take the oldest record off the queue into record (at least MESH_RECORD_HEADER_LENGTH + MESH_MAX_RECORD bytes).
+// returns the length of the record including its header, 0 if there is none
+uint8_t Mesh_Dequeue(uint8_t* record);
+// send one frame worth of queued records to the parent. returns the chb_write status or MESH_NO_ROUTE
+uint8_t Mesh_Forward();
+// number of queued bytes and free bytes in the queue
+uint16_t Mesh_Queue_Length();
+uint16_t Mesh_Queue_Space();
+uint16_t Mesh_Get_Parent();
+uint8_t Mesh_Get_Hops();
+mesh_stats_t* Mesh_Get_Stats();
+
+#endif /* MESH_H_ */
@@ -0,0 +1,82 @@
+/*
+ * Queue.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Queue.h"
+#include <string.h>
+#include <avr/interrupt.h>
+#include "Event.h"
+
+void Queue_Init(queue_t* queue, void* buffer, uint8_t size, uint8_t capacity, uint8_t event){
+	queue->buffer = buffer;
+	queue->size = size;
+	queue->capacity = capacity;
+	queue->head = 0;
+	queue->tail = 0;
+	queue->count = 0;
+	queue->event = event;
+}
+
+uint8_t Queue_Put(queue_t* queue, const void* item){
+
+	uint8_t sreg = SREG;
+
+	cli();
+	if(queue->count >= queue->capacity){
+		SREG = sreg;
+		return FALSE;
+	}
+	memcpy(queue->buffer + (uint16_t)queue->head*queue->size, item, queue->size);
+	if(++queue->head == queue->capacity) queue->head = 0;
+	queue->count++;
+	SREG = sreg;
+	Event_Post(queue->event);
+	return TRUE;
+}
+
+uint8_t Queue_Peek(queue_t* queue, void* item){
+
+	uint8_t sreg = SREG;
+
+	cli();
+	if(!queue->count){
+		SREG = sreg;
+		return FALSE;
+	}
+	memcpy(item, queue->buffer + (uint16_t)queue->tail*queue->size, queue->size);
+	SREG = sreg;
+	return TRUE;
+}
+
+void Queue_Pop(queue_t* queue){
+
+	uint8_t sreg = SREG;
+
+	cli();
+	if(queue->count){
+		if(++queue->tail == queue->capacity) queue->tail = 0;
+		queue->count--;
+	}
+	SREG = sreg;
+}
+
+uint8_t Queue_Get(queue_t* queue, void* item){
+
+	uint8_t sreg = SREG;
+	uint8_t got;
+
+	cli();
+	got = Queue_Peek(queue, item);
+	if(got) Queue_Pop(queue);
+	SREG = sreg;
+	return got;
+}
+
+uint8_t Queue_Length(queue_t* queue){
+	return queue->count;
+}
+
+uint8_t Queue_Space(queue_t* queue){
+	return queue->capacity - queue->count;
+}
@@ -0,0 +1,36 @@
+/*
+ * Queue.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include "constants_and_globals.h"
+
+// Message queues
+// fixed size items in a ring in RAM, passed from one task (or ISR) to another in order. every put posts the queue's event
+// (see Event.h) so the task taking from it can wait on that. safe to use from ISRs on either end.
+typedef struct{
+	uint8_t* buffer;	// capacity*size bytes
+	uint8_t size;	// bytes per item
+	uint8_t capacity;	// items
+	uint8_t head, tail, count;
+	uint8_t event;
+} queue_t;
+
+void Queue_Init(queue_t* queue, void* buffer, uint8_t size, uint8_t capacity, uint8_t event);
+// add an item at the back. returns FALSE and leaves the queue alone if it is full
+uint8_t Queue_Put(queue_t* queue, const void* item);
+// copy the item at the front without taking it off. returns FALSE if the queue is empty
+uint8_t Queue_Peek(queue_t* queue, void* item);
+// take the item at the front off
+void Queue_Pop(queue_t* queue);
+// Queue_Peek and Queue_Pop together
+uint8_t Queue_Get(queue_t* queue, void* item);
+uint8_t Queue_Length(queue_t* queue);
+uint8_t Queue_Space(queue_t* queue);
+
+#endif /* QUEUE_H_ */
@@ -1,34 +1,62 @@
 # include "SD_Card.h"
 
+static uint8_t SDHold;	//nesting depth of SD_Hold
+static const SPIBus_Device_t* SDHoldPrev;
+
+//sd card chip select for SPIBus, through the port expander
+void SD_CS(uint8_t on){
+	if(on) PortEx_OUTCLR(BIT3_bm, PS_BANKB);	//pull SD cs low
+	else PortEx_OUTSET(BIT3_bm, PS_BANKB);	//pull SD cs high
+}
+
+//keeps the sd card selected from SD_Hold(TRUE) to SD_Hold(FALSE) so the block reads and writes in between don't each cost
+//two port expander transactions for the cs. the card keeps the bus in between, so the interrupts that use the bus wait
+//except where the functions below yield (see SD_Wait_Busy); keep the work between them short
+void SD_Hold(uint8_t hold){
+	if(hold){
+		if(!SDHold) SDHoldPrev = SPIBus_Acquire(&SPIBus_SD);
+		SDHold++;
+	}
+	else if(SDHold && !--SDHold){
+		SPIBus_Release(&SPIBus_SD, SDHoldPrev);
+	}
+}
+
+//the card can be deselected for the ADC interrupt between commands (SD_command yields before sending one) and while it
+//is busy, but not in the middle of a command and its response or of a data block: the port expander bytes that deselect
+//it would be clocked into it or clock part of it out. so interrupts wait for one command or block at most
+static void SD_Wait_Busy(){
+	do{
+		SPIBus_Yield();
+		Buffer[0] = SPI_write(SDHC_DUMMY_BYTE);
+	} while(Buffer[0] != SDHC_DUMMY_BYTE);
+}
+
 //the following function turns on power to the sd card and port expander and initializes the sdhc card in spi mode
 //returns 0 if successful or 1 if not
 uint8_t SD_init(void){
 	
 	ADCPower(TRUE);				//power up portEX
 	Ext1Power(TRUE);			//power up SD card
-	_delay_ms(100);				//wait for bootup
+	Hal_Delay_Ms(100);				//wait for bootup
 	uint8_t errorCode = 0;
+	const SPIBus_Device_t* prev;
 	
+	PortEx_Begin();
 	PortEx_DIRSET(BIT3_bm, PS_BANKB); //SD card CS
 	PortEx_OUTSET(BIT3_bm, PS_BANKB); //pull SD cs high
+	PortEx_End();
 	
-	SPIInit2(SPI_MODE_0_gc, SPI_LOWEST_CLOCKRATE_PRESCALAR);
-	SPICS(TRUE);
+	prev = SPIBus_Acquire(&SPIBus_SD_Idle);
 	
 	//idle for 10 bytes / 80 clocks
 	for(int i=0; i<10; i++){
-		SPIC.DATA = SDHC_DUMMY_BYTE;
-		while(!(SPIC.STATUS & SPI_IF_bm));
-		Buffer[12] = SPIC.DATA;
+		Buffer[12] = SPI_write(SDHC_DUMMY_BYTE);
 	}
 	
-	SPICS(FALSE);
-	SPIDisable();
+	SPIBus_Release(&SPIBus_SD_Idle, prev);
 	
-	PortEx_OUTCLR(BIT3_bm, PS_BANKB);	//pull SD cs low
-
-	SPIInit2(SPI_MODE_0_gc,SPI_LOWEST_CLOCKRATE_PRESCALAR);
-	SPICS(TRUE);
+	prev = SPIBus_Acquire(&SPIBus_SD_Slow);	//pull SD cs low
 	//send command 0 to put card in idle state and read 8 next bytes sent back or until response read
 	for(int i=0; SD_command(SDHC_CMD_RESET,SDHC_NO_ARGUMENTS,SDHC_CMD_RESET_CRC,8) != SDHC_IDLE_STATE; i++){
 		//try command 10 times before timing out
@@ -38,7 +66,10 @@ uint8_t SD_init(void){
 			break;
 		}
 	}
-	_delay_ms(100);
+	//let go of the bus for the wait, it would keep the data ready interrupt off
+	SPIBus_Release(&SPIBus_SD_Slow, prev);
+	Hal_Delay_Ms(100);
+	prev = SPIBus_Acquire(&SPIBus_SD_Slow);
 	//check voltage range (used to indicate to sd card that we know it is an sdhc card)
 	for(int i=0;SD_command(SDHC_CHECK_VOLTAGE_CMD,SDHC_CHECK_VOLTAGE_ARGUMENT,SDHC_CHECK_VOLTAGE_CRC,8) != SDHC_IDLE_STATE; i++){
 		if (i >= 10) {
@@ -77,10 +108,7 @@ uint8_t SD_init(void){
 	if (Buffer[0] & 0x40){
 		//the card is addressed in 512 byte sectors
 	}
-	SPICS(FALSE);
-	SPIDisable();
-	//pull SD cs high
-	PortEx_OUTSET(BIT3_bm, PS_BANKB);
+	SPIBus_Release(&SPIBus_SD_Slow, prev);	//pull SD cs high
 	
 	return errorCode;					
 }
@@ -97,6 +125,7 @@ uint8_t SD_init(void){
 //the following command writes a command to the sd card and returns a response (if any) or 0xFF if no response
 uint8_t SD_command(uint8_t cmd, uint32_t arg, uint8_t crc, int read) {
 	
+	SPIBus_Yield();
 	SPI_write(SDHC_COMMAND_START | cmd);
 	SPI_write(arg>>24 & LSBYTE_MASK);
 	SPI_write(arg>>16 & LSBYTE_MASK);
@@ -116,9 +145,7 @@ uint8_t SD_command(uint8_t cmd, uint32_t arg, uint8_t crc, int read) {
 
 //the following command writes one sector to the sdhc card
 void SD_write_block(uint32_t sector,uint8_t* data, int lengthOfData){
-	PortEx_OUTCLR(BIT3_bm, PS_BANKB);	//pull SD cs low
-	SPIInit(SPI_MODE_0_gc);
-	SPICS(TRUE);
+	const SPIBus_Device_t* prev = SPIBus_Acquire(&SPIBus_SD);	//pull SD cs low
 	int fillerBytes = SDHC_SECTOR_SIZE - lengthOfData;
 	if (fillerBytes==SDHC_SECTOR_SIZE) fillerBytes = 0;
 	for(int i=0;SD_command(SDHC_CMD_WRITE_SINGLE_BLOCK,sector,SDHC_DUMMY_BYTE,8) != SDHC_CMD_SUCCESS; i++){		//write to specified sector
@@ -142,17 +169,13 @@ Buffer[i%13] = SPI_write(data[i]);
 	if ((Buffer[0] & SDHC_RESPONSE_STATUS_MASK) == 0x02){
 		//data was written successfully
 	}
-	while(Buffer[0] != SDHC_DUMMY_BYTE) Buffer[0] = SPI_write(SDHC_DUMMY_BYTE);	//wait for card to finish internal processes
-	SPICS(FALSE);
-	SPIDisable();
-	PortEx_OUTSET(BIT3_bm, PS_BANKB);	//pull SD cs high	
+	SD_Wait_Busy();	//wait for card to finish internal processes
+	SPIBus_Release(&SPIBus_SD, prev);	//pull SD cs high
 }
 
 //the following command reads one sector from the sdhc card
 void SD_read_block(uint32_t sector,uint8_t* arrayOf512Bytes){
-	PortEx_OUTCLR(BIT3_bm, PS_BANKB);	//pull SD cs low
-	SPIInit(SPI_MODE_0_gc);
-	SPICS(TRUE);
+	const SPIBus_Device_t* prev = SPIBus_Acquire(&SPIBus_SD);	//pull SD cs low
 	
 	for(int i=0;SD_command(SDHC_CMD_READ_SINGLE_BLOCK,sector,SDHC_DUMMY_BYTE,8) != SDHC_CMD_SUCCESS; i++) {	//send command to read data
 		if (i >= 10) {
@@ -171,91 +194,41 @@ void SD_read_block(uint32_t sector,uint8_t* arrayOf512Bytes){
 		Buffer[12] = SPI_write(SDHC_DUMMY_BYTE);	
 	}
 
-	SPICS(FALSE);
-	SPIDisable();
-	PortEx_OUTSET(BIT3_bm, PS_BANKB);	//pull SD cs high
+	SPIBus_Release(&SPIBus_SD, prev);	//pull SD cs high
 }
 
-//the following command writes multiple blocks/sectors to the sd card starting at a specified sector (in the sd card)
+//the following command writes multiple blocks/sectors to the sd card starting at a specified sector (in the sd card).
+//one single block write after another: the card can't be deselected between the blocks of a multiple block write
+//(CMD25), which would keep the data ready interrupt off for all of them
 void SD_write_multiple_blocks(uint32_t sector,uint8_t* data,int lengthOfData){
-	PortEx_OUTCLR(BIT3_bm, PS_BANKB);	//pull SD cs low
-	SPIInit(SPI_MODE_0_gc);
-	SPICS(TRUE);
-	int numSectors = lengthOfData/SDHC_SECTOR_SIZE;
-	int fillerBytes = SDHC_SECTOR_SIZE - lengthOfData%SDHC_SECTOR_SIZE;
-	if (fillerBytes==SDHC_SECTOR_SIZE) fillerBytes = 0;
-	else numSectors++;
-	while(SD_command(SDHC_CMD_WRITE_MULTIPLE_BLOCKS,sector,SDHC_DUMMY_BYTE,8) != SDHC_CMD_SUCCESS);	//write starting at specified sector
-	for (int j=0;j<numSectors;j++){
-		Buffer[1] = SPI_write(SDHC_DUMMY_BYTE);	//send dummy byte
-		Buffer[1] = SPI_write(SDHC_MULT_WRITE_DATA_TOKEN);	//send data token
-		if(j == (numSectors-1)){
-			for (int i=0;i<(SDHC_SECTOR_SIZE-fillerBytes);i++){
-				Buffer[i%12] = SPI_write(data[(i+(j*SDHC_SECTOR_SIZE))]);
-			}
-			for (int i=0;i<fillerBytes;i++){
-				Buffer[i%12] = SPI_write(FILLER_BYTE);
-			}
-		}
-		else{
-			for (int i=0;i<SDHC_SECTOR_SIZE;i++){
-				Buffer[i%12] = SPI_write(data[(i+(j*SDHC_SECTOR_SIZE))]);
-			}
-		}
-		for (int i=0;i<2;i++) Buffer[1] = SPI_write(SDHC_DUMMY_BYTE);	//write 2 CRC token
-		Buffer[1] = FILLER_BYTE;
-		while(Buffer[1] != SDHC_DUMMY_BYTE) Buffer[1] = SPI_write(SDHC_DUMMY_BYTE);	//wait for card to store the data it received
-	}
-	for(int i=0;i<4;i++){
-		Buffer[1] = SPI_write(SDHC_DUMMY_BYTE);	//write dummy byte
+	SD_Hold(TRUE);
+	for(;lengthOfData > 0;lengthOfData -= SDHC_SECTOR_SIZE){
+		SD_write_block(sector++, data, (lengthOfData < SDHC_SECTOR_SIZE) ? lengthOfData : SDHC_SECTOR_SIZE);
+		data += SDHC_SECTOR_SIZE;
 	}
-	Buffer[1] = SPI_write(SDHC_MULT_WRITE_STOP_TOKEN);	//write stop token
-	for(int i=0;i<4;i++){
-		Buffer[1] = SPI_write(SDHC_DUMMY_BYTE);	//write dummy byte
-	}
-	Buffer[1] = FILLER_BYTE;
-	while (Buffer[1] != SDHC_DUMMY_BYTE) Buffer[1] = SPI_write(SDHC_DUMMY_BYTE); //wait for card to finish internal processes
-	SPICS(FALSE);
-	SPIDisable();
-	PortEx_OUTSET(BIT3_bm, PS_BANKB);	//pull SD cs high
+	SD_Hold(FALSE);
 }
-//the following command reads multiple blocks from the sd card starting at the specified block/sector
+//the following command reads multiple blocks from the sd card starting at the specified block/sector.
+//one single block read after another, for the same reason as the writes (the card streams the blocks of CMD18)
 void SD_read_multiple_blocks(uint32_t sector,uint8_t* data,int numOfBlocks){
-	PortEx_OUTCLR(BIT3_bm, PS_BANKB);	//pull SD cs low
-	SPIInit(SPI_MODE_0_gc);
-	SPICS(TRUE);
-	while(SD_command(SDHC_CMD_READ_MULTIPLE_BLOCKS,sector,SDHC_DUMMY_BYTE,8) != SDHC_CMD_SUCCESS);	//send command to read data
-	//do the following for however many sectors to be read in
+	SD_Hold(TRUE);
 	for (int j=0;j<numOfBlocks;j++){
-		Buffer[1]=SDHC_DUMMY_BYTE;
-		while(Buffer[1] != SDHC_DATA_TOKEN){
-			Buffer[1] = SPI_write(SDHC_DUMMY_BYTE);	//wait for start of data token
-		}
-		for (int i=0;i<SDHC_SECTOR_SIZE;i++){
-			data[(i+(j*SDHC_SECTOR_SIZE))] = SPI_write(SDHC_DUMMY_BYTE);	//read in the data
-		}
-		
-		for (int i=0;i<2;i++){
-			Buffer[i] = SPI_write(SDHC_DUMMY_BYTE);	//read in the 2 CRC bytes
-		}
+		SD_read_block(sector + j, data + j*SDHC_SECTOR_SIZE);
 	}
-	SD_command(SDHC_CMD_STOP_TRANSMISSION,SDHC_NO_ARGUMENTS,SDHC_DUMMY_BYTE,8);	//send command to stop reading data
-	Buffer[0] = SPI_write(SDHC_DUMMY_BYTE);	//read the stuff byte
-	Buffer[1] = FILLER_BYTE;
-	while (Buffer[1] != SDHC_DUMMY_BYTE) Buffer[1] = SPI_write(SDHC_DUMMY_BYTE); //wait for card to finish internal processes
-	SPICS(FALSE);
-	SPIDisable();
-	PortEx_OUTSET(BIT3_bm, PS_BANKB);	//pull SD cs high
+	SD_Hold(FALSE);
 }
 //this function deselects the sd card and turns off power to the port expander and the sd card
 void SD_disable(){
+	const SPIBus_Device_t* prev;
+	
+	while(SDHold) SD_Hold(FALSE);
+	PortEx_Begin();
 	PortEx_DIRSET(BIT3_bm, PS_BANKB);  //pull SD card CS high
 	PortEx_OUTSET(BIT3_bm, PS_BANKB);
-	SPIInit(SPI_MODE_0_gc);
-	SPICS(TRUE);
+	PortEx_End();
+	prev = SPIBus_Acquire(&SPIBus_SD_Idle);
 	SPI_write(SDHC_DUMMY_BYTE);	//must write a byte to spi when cd card cs is high to have sd card release MISO line
-	SPICS(FALSE);	//stop spi
-	SPIDisable();
+	SPIBus_Release(&SPIBus_SD_Idle, prev);	//stop spi
 	
 	ADCPower(FALSE);		//turn off portEX power
 	Ext1Power(FALSE);			//power down SD card
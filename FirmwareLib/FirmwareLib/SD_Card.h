@@ -72,6 +72,8 @@ uint8_t SD_init(void);
 void SD_write_multiple_blocks(uint32_t sector,uint8_t* data,int lengthOfData);
 void SD_read_multiple_blocks(uint32_t sector,uint8_t* data,int numOfBlocks);
 void SD_disable();
+void SD_Hold(uint8_t hold);
+void SD_CS(uint8_t on);
 void SD_write_and_read_knowns();
 void SD_write_and_read_knowns_FAT();
 
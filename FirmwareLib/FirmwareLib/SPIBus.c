@@ -0,0 +1,148 @@
+/*
+ * SPIBus.c
+ *
+ * Created: 10/19/2026
+ */
+#include "SPIBus.h"
+#include "utility_functions.h"
+#include "SD_Card.h"
+
+#define SPIBUS_CTRL(prescaler, mode) ((prescaler) | SPI_ENABLE_bm | SPI_MASTER_bm | (mode))
+
+static void SPIBus_ADC_CS(uint8_t on){
+	if(on) Hal_Gpio_Clr(HAL_PORTF, PIN1_bm);	// pull ADC_CS down to enable data read
+	else Hal_Gpio_Set(HAL_PORTF, PIN1_bm);
+}
+
+const SPIBus_Device_t SPIBus_PortEx = {SPIBUS_CTRL(SPI_PRESCALER, PS_SPI_MODE), portExCS, FALSE};
+const SPIBus_Device_t SPIBus_Mux = {SPIBUS_CTRL(SPI_PRESCALER, SPI_MODE_1_gc), NULL, FALSE};
+const SPIBus_Device_t SPIBus_FRAM = {FR_SPI_CONFIG_gc, NULL, FALSE};
+const SPIBus_Device_t SPIBus_ADC = {ADC_SPI_CONFIG_gc, SPIBus_ADC_CS, FALSE};
+const SPIBus_Device_t SPIBus_SD = {SPIBUS_CTRL(SPI_PRESCALER, SPI_MODE_0_gc), SD_CS, TRUE};
+const SPIBus_Device_t SPIBus_SD_Slow = {SPIBUS_CTRL(SPI_LOWEST_CLOCKRATE_PRESCALAR, SPI_MODE_0_gc), SD_CS, TRUE};
+const SPIBus_Device_t SPIBus_SD_Idle = {SPIBUS_CTRL(SPI_LOWEST_CLOCKRATE_PRESCALAR, SPI_MODE_0_gc), NULL, TRUE};
+
+// the levels of the interrupts that take the bus themselves: the ADC's data ready (PORTF INT0) and the accelerometer's
+// averaging points (the TCC0 and TCD0 compares). only these are held off while a device has the bus, the radio, USART and
+// clock interrupts go on. a request that comes in meanwhile stays flagged and is taken when its level is put back
+typedef struct{
+	uint8_t Drdy;	// PORTF.INTCTRL's INT0 level
+	uint8_t Tcc0;	// TCC0.INTCTRLB
+	uint8_t Tcd0;	// TCD0.INTCTRLB
+} SPIBus_Irq_t;
+
+static const SPIBus_Device_t* Owner;
+static uint8_t Ctrl;	// what SPIC.CTRL is set to, 0 while the bus is off
+static SPIBus_Irq_t SavedIrq[SPIBUS_MAX_DEPTH];
+static SPIBus_Irq_t OwnerIrq[SPIBUS_MAX_DEPTH];	// the levels as they were when the owner at each depth took the bus
+static uint8_t Depth;
+
+static void SPIBus_Irq_Restore(const SPIBus_Irq_t* irq){
+	Hal_Gpio_Int_Ctrl(HAL_PORTF, (Hal_Gpio_Get_Int_Ctrl(HAL_PORTF) & ~PORT_INT0LVL_gm) | irq->Drdy);
+	Hal_Timer_Int_Ctrlb(HAL_TCC0, irq->Tcc0);
+	Hal_Timer_Int_Ctrlb(HAL_TCD0, irq->Tcd0);
+}
+
+// an interrupt that comes in between reading a level and clearing it puts back what it found, so this needs no global lock
+static void SPIBus_Irq_Off(SPIBus_Irq_t* saved){
+
+	static const SPIBus_Irq_t off = {0, 0, 0};
+
+	saved->Drdy = Hal_Gpio_Get_Int_Ctrl(HAL_PORTF) & PORT_INT0LVL_gm;
+	saved->Tcc0 = Hal_Timer_Get_Int_Ctrlb(HAL_TCC0);
+	saved->Tcd0 = Hal_Timer_Get_Int_Ctrlb(HAL_TCD0);
+	SPIBus_Irq_Restore(&off);
+}
+
+static void SPIBus_Configure(uint8_t ctrl){
+
+	if(ctrl == Ctrl) return;
+	if(!Ctrl){
+		// SPI-SS as a pulled up output so it can't put SPIC in slave mode, SPI-MOSI and SPI-SCK as outputs
+		Hal_Gpio_Pullup(HAL_PORTC, 4);
+		Hal_Gpio_Set(HAL_PORTC, PIN4_bm);
+		Hal_Gpio_Output(HAL_PORTC, PIN4_bm | PIN5_bm | PIN7_bm);
+		Hal_Spi_Int_Off(HAL_SPIC);
+	}
+	Hal_Spi_Ctrl(HAL_SPIC, ctrl);
+	Ctrl = ctrl;
+}
+
+// selecting or deselecting a device can take the bus itself (the sd card's chip select is on the port expander), so nobody
+// owns it while the select runs
+static void SPIBus_Select(const SPIBus_Device_t* device, uint8_t on){
+	if(!device->Select) return;
+	Owner = NULL;
+	if(on) SPIBus_Configure(device->Ctrl);
+	device->Select(on);
+}
+
+const SPIBus_Device_t* SPIBus_Acquire(const SPIBus_Device_t* device){
+
+	SPIBus_Irq_t irq;
+	const SPIBus_Device_t* prev;
+
+	SPIBus_Irq_Off(&irq);
+	// deeper than the drivers and interrupts ever go: a release is missing somewhere, don't go on over the saved levels
+	if(Depth == SPIBUS_MAX_DEPTH) Hal_Reset();
+	prev = Owner;
+	SavedIrq[Depth] = irq;
+	OwnerIrq[Depth] = (prev == device) ? OwnerIrq[Depth-1] : irq;
+	Depth++;
+	if(prev != device){
+		if(prev) SPIBus_Select(prev, FALSE);
+		SPIBus_Select(device, TRUE);
+	}
+	SPIBus_Configure(device->Ctrl);
+	Hal_Gpio_Clr(HAL_PORTC, PIN4_bm);	// SPI-SS
+	Owner = device;
+	return prev;
+}
+
+void SPIBus_Release(const SPIBus_Device_t* device, const SPIBus_Device_t* prev){
+
+	if(!Depth) Hal_Reset();	// released more often than acquired
+	if(prev != device){
+		SPIBus_Select(device, FALSE);
+		if(prev){
+			SPIBus_Select(prev, TRUE);
+			SPIBus_Configure(prev->Ctrl);
+		}
+	}
+	if(!prev) Hal_Gpio_Set(HAL_PORTC, PIN4_bm);	// SPI-SS
+	Owner = prev;
+	SPIBus_Irq_Restore(&SavedIrq[--Depth]);
+}
+
+uint8_t SPIBus_Transfer(uint8_t data){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	data = Hal_Spi_Transfer(HAL_SPIC, data);
+	Hal_Irq_Restore(irq);
+	return data;
+}
+
+void SPIBus_Yield(){
+
+	SPIBus_Irq_t irq;
+
+	if(!Owner || !Owner->Preemptible) return;
+	SPIBus_Irq_Restore(&OwnerIrq[Depth-1]);
+	Hal_Nop();	// the cpu runs one more instruction after a level comes on before it takes a pending request
+	SPIBus_Irq_Off(&irq);
+}
+
+void SPIBus_Off(){
+
+	hal_irq_t irq = Hal_Irq_Save();
+
+	if(!Owner && Ctrl){
+		Hal_Gpio_Set(HAL_PORTC, PIN4_bm);
+		Hal_Spi_Ctrl(HAL_SPIC, 0x00);
+		Hal_Gpio_Clr(HAL_PORTC, PIN4_bm);
+		Hal_Gpio_Input(HAL_PORTC, PIN4_bm | PIN5_bm | PIN7_bm);
+		Ctrl = 0;
+	}
+	Hal_Irq_Restore(irq);
+}
@@ -0,0 +1,48 @@
+/*
+ * SPIBus.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef SPIBUS_H_
+#define SPIBUS_H_
+
+#include "constants_and_globals.h"
+#include "Hal.h"
+
+// Sharing SPIC between the port expander, filter mux, FRAM, ADC and SD card
+// a driver takes the bus with SPIBus_Acquire(&device) and gives it back with SPIBus_Release(&device, what acquire returned).
+// acquire deselects whoever had the bus, sets SPIC.CTRL for the device (only if it isn't already) and selects the device;
+// release undoes it, so an interrupt can take the bus in the middle of a transfer and hand it back the way it found it.
+// the interrupts that take the bus themselves (the ADC's data ready and the accelerometer's sampling timers) are held off
+// while a device has the bus, the others aren't. a preemptible device (the sd card) lets them in where its driver calls
+// SPIBus_Yield: points where the chip can be deselected and pick up where it left off, never in the middle of a command
+// and its response or of a data block, as deselecting the sd card clocks the port expander bytes into it. the ADC's data
+// ready interrupt takes the bus this way while a file is written.
+#define SPIBUS_MAX_DEPTH 8	// acquisitions in progress at once (interrupts and selects that go through the port expander).
+							// going deeper resets the chip
+
+typedef struct{
+	uint8_t Ctrl;	// SPIC.CTRL for the device
+	void (*Select)(uint8_t on);	// chip select, NULL if the driver works its chip selects itself
+	uint8_t Preemptible;	// lets interrupts in at SPIBus_Yield
+} SPIBus_Device_t;
+
+extern const SPIBus_Device_t SPIBus_PortEx;
+extern const SPIBus_Device_t SPIBus_Mux;	// filter mux, the driver picks the upper or lower chip select
+extern const SPIBus_Device_t SPIBus_FRAM;	// the driver toggles CS_FRAM between opcodes
+extern const SPIBus_Device_t SPIBus_ADC;
+extern const SPIBus_Device_t SPIBus_SD;
+extern const SPIBus_Device_t SPIBus_SD_Slow;	// the sd card while it is being initialized
+extern const SPIBus_Device_t SPIBus_SD_Idle;	// clocks for the sd card with its chip select high
+
+const SPIBus_Device_t* SPIBus_Acquire(const SPIBus_Device_t* device);
+void SPIBus_Release(const SPIBus_Device_t* device, const SPIBus_Device_t* prev);
+uint8_t SPIBus_Transfer(uint8_t data);
+// let pending interrupts run if the device that has the bus is preemptible and they were on when it took the bus
+void SPIBus_Yield();
+// SPIC off and its pins let go, for when the chips on the bus lose power. does nothing while a device has the bus
+void SPIBus_Off();
+
+#endif /* SPIBUS_H_ */
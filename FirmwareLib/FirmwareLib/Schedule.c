@@ -0,0 +1,48 @@
+/*
+ * Schedule.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Schedule.h"
+#include "Event.h"
+
+static uint32_t Period = 0;	// sec, 0 without a schedule
+static int64_t Left;	// network time ticks to the next run
+static uint32_t Mark;	// network time Left counts from
+
+//skip the runs that are already due, up to the next one to come
+static void Schedule_Catch_Up(){
+
+	int64_t period = (int64_t)Period*TS_TICKS_PER_SEC;
+
+	if(Left <= 0) Left += (-Left/period + 1)*period;
+}
+
+void Schedule_Set(uint32_t Start, uint32_t PeriodSec){
+	Period = PeriodSec;
+	if(!Period) return;
+	Mark = TimeSynch_Get_Global_Time();
+	Left = (int32_t)(Start - Mark);
+	if(Left < 0) Schedule_Catch_Up();
+}
+
+uint8_t Schedule_Poll(){
+
+	uint32_t now;
+	uint8_t due = FALSE;
+
+	if(!Period) return FALSE;
+	now = TimeSynch_Get_Global_Time();
+	Left -= (int32_t)(now - Mark);
+	Mark = now;
+	if(Left <= 0){
+		due = TRUE;
+		Schedule_Catch_Up();
+	}
+	Event_Wake_At(TimeSynch_Get_Local_Time() + ((Left < SCHEDULE_MAX_WAIT) ? (uint32_t)Left : SCHEDULE_MAX_WAIT));
+	return due;
+}
+
+uint8_t Schedule_Is_Set(){
+	return Period != 0;
+}
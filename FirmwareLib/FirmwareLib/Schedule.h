@@ -0,0 +1,32 @@
+/*
+ * Schedule.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef SCHEDULE_H_
+#define SCHEDULE_H_
+
+#include "constants_and_globals.h"
+#include "TimeSynch.h"
+
+// Scheduled acquisition
+// runs come round every period from a start given in network time, so motes given the same schedule (a flooded command batch)
+// sample together. the wait to the next run is counted down on network time, which keeps periods longer than the local clock
+// wrap (~18 min) working as long as Schedule_Poll runs at least once a wrap; it asks for a wakeup at most SCHEDULE_MAX_WAIT
+// away so it does. a mote that isn't synched counts on its own clock, and the first run after it synchs can move by the
+// offset it takes up. runs missed while busy are skipped, not made up.
+// in between the core sleeps in power-save when nothing else holds the clock running (see Clock.h), so an app that wants the
+// most out of it powers down the ADC rail once its samples are out and keeps the radio on a low power listening schedule.
+#define SCHEDULE_MAX_WAIT (60*TS_TICKS_PER_SEC)
+
+// run every PeriodSec seconds from network time Start, which has to be within half a wrap (~9 min) of now either way.
+// PeriodSec 0 stops the schedule
+void Schedule_Set(uint32_t Start, uint32_t PeriodSec);
+// TRUE once for every run that comes due. call from the main loop: it asks for a wakeup at the next run (Event_Wake_At)
+uint8_t Schedule_Poll();
+// TRUE while there is a schedule
+uint8_t Schedule_Is_Set();
+
+#endif /* SCHEDULE_H_ */
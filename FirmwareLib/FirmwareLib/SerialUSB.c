@@ -5,69 +5,160 @@
  *  Author: Vlad
  */ 
 #include "SerialUSB.h"
+#include "Event.h"
+#include "Clock.h"
+
+//ring buffers filled and emptied by the USART interrupts. the indexes are 8 bits so they are read and written atomically
+static uint8_t RxBuffer[SERIAL_BUF_SIZE];
+static uint8_t TxBuffer[SERIAL_BUF_SIZE];
+static volatile uint8_t RxHead, RxTail, TxHead, TxTail;
+static volatile uint16_t RxOverruns;
+static volatile uint8_t TxPending;	// a byte went out since the last flush
 
 bool StartSerial(uint32_t BaudRate){
-	uint16_t prescaler;
-	if(BaudRate <600 || BaudRate >1000000){
+	uint32_t scaler;
+	uint8_t clk2x = 0;
+	if(BaudRate <600 || BaudRate >SERIAL_MAX_BAUD){
 		//baud rate too fast or too slow
 		return false;
 	}
-	//set F_CPU/F_PER to 32 MHz (default is the 2 MHz RC oscillator)
-	set_32MHz();
+	//let anything still queued go out at the old baud rate
+	if(Hal_Usart_Get_Ctrlb(HAL_USARTC0) & USART_TXEN_bm) SerialFlush();
+	//full speed while the link is open (see Clock.h)
+	Clock_Hold(CLOCK_HOLD_SERIAL);
 	//set output on transmit pin
-	PORTC.DIRSET = PIN3_bm;
-	PORTC.OUTSET = PIN3_bm;
+	Hal_Gpio_Output(HAL_PORTC, PIN3_bm);
+	Hal_Gpio_Set(HAL_PORTC, PIN3_bm);
 	//set input on receive pin
-	PORTC.DIRCLR = PIN2_bm;
-	//prescalar of 15: baud = F_CPU/((2^bscale)*16*(scaler+1)) = 125000 (almost 128000)
-	prescaler = (uint32_t)((((float)F_CPU)/((float)(16*BaudRate)))-1);
-	//increment prescaler if truncated part was >= 0.5
-	if((((float)F_CPU/((float)(16*BaudRate)))-1)-prescaler >= 0.5) prescaler++;
+	Hal_Gpio_Input(HAL_PORTC, PIN2_bm);
+	//baud = F_PER/((2^bscale)*16*(scaler+1)), or 8 instead of 16 with double speed (CLK2X). use double speed only when it gets
+	//closer to the requested rate since the receiver takes fewer samples per bit then
+	scaler = (CLOCK_FAST_HZ + 8*BaudRate)/(16*BaudRate);
+	if(scaler == 0 || (CLOCK_FAST_HZ + 4*BaudRate)/(8*BaudRate) != 2*scaler){
+		scaler = (CLOCK_FAST_HZ + 4*BaudRate)/(8*BaudRate);
+		clk2x = USART_CLK2X_bm;
+	}
+	scaler--;
 	
-	USARTC0.BAUDCTRLA = prescaler & 0xFF;
-	USARTC0.BAUDCTRLB = prescaler >>8;
+	Hal_Usart_Ctrlb(HAL_USARTC0, 0);
+	Hal_Usart_Baud(HAL_USARTC0, scaler);
 	//8 data bits no parity 1 stop bit
-	USARTC0.CTRLC = 3;
+	Hal_Usart_Ctrlc(HAL_USARTC0, 3);
+	RxHead = RxTail = TxHead = TxTail = 0;
+	RxOverruns = 0;
+	TxPending = 0;
+	//receive interrupt above the transmit one so incoming bytes don't wait on outgoing ones. the radio is higher still
+	Hal_Usart_Ctrla(HAL_USARTC0, USART_RXCINTLVL_MED_gc);
+	Hal_Irq_Levels_On(PMIC_MEDLVLEN_bm | PMIC_LOLVLEN_bm);
 	//turn on Rx and Tx for USART
-	USARTC0.CTRLB = BIT4_bm | BIT3_bm;
+	Hal_Usart_Ctrlb(HAL_USARTC0, USART_RXEN_bm | USART_TXEN_bm | clk2x);
 	return true;
 }
 
+uint8_t SerialTxSpace(){
+	//one slot stays empty so a full buffer doesn't look empty
+	return SERIAL_BUF_SIZE - 1 - (uint8_t)(TxHead - TxTail);
+}
+
 void SerialWriteByte(uint8_t byte){
-	//wait for transmit buffer to become available
-	while((USARTC0.STATUS & BIT5_bm) != BIT5_bm){
-		//wait
+	//wait for room in the transmit buffer
+	while(!SerialTxSpace()){
+		Hal_Spin();
 	}
-	//send byte
-	USARTC0.DATA = byte;
-	//wait for transmit to finish
-	//while((USARTC0.STATUS & BIT6_bm) != BIT6_bm) {
-		//wait
-	//}
+	TxBuffer[TxHead] = byte;
+	TxHead++;
+	//data register empty interrupt takes it from here
+	Hal_Usart_Ctrla(HAL_USARTC0, (Hal_Usart_Get_Ctrla(HAL_USARTC0) & ~USART_DREINTLVL_gm) | USART_DREINTLVL_LO_gc);
+}
+
+uint8_t SerialWriteNonBlocking(uint8_t* buffer, uint8_t length){
+	uint8_t space = SerialTxSpace();
+	if(length > space) length = space;
+	for(uint8_t i=0;i<length;i++){
+		TxBuffer[(uint8_t)(TxHead + i)] = buffer[i];
+	}
+	TxHead += length;
+	if(length) Hal_Usart_Ctrla(HAL_USARTC0, (Hal_Usart_Get_Ctrla(HAL_USARTC0) & ~USART_DREINTLVL_gm) | USART_DREINTLVL_LO_gc);
+	return length;
+}
+
+uint8_t SerialAvailable(){
+	return RxHead - RxTail;
 }
 
 uint8_t SerialReadByte(){
 	uint8_t byte;
 	//wait for reception of message
-	while ((USARTC0.STATUS & BIT7_bm) != BIT7_bm){
+	while (RxHead == RxTail){
 		//add timeout logic
+		Hal_Spin();
 	}	
 	//read in byte
-	byte = USARTC0.DATA;
+	byte = RxBuffer[RxTail];
+	RxTail++;
 	return byte;	
 }
 
 void SerialWriteBuffer(uint8_t* buffer, uint32_t length){
-	uint32_t i;
-	for(i=0;i<length;i++){
-		SerialWriteByte(buffer[i]);
+	uint8_t sent;
+	while(length){
+		sent = SerialWriteNonBlocking(buffer, length > 0xFF ? 0xFF : length);
+		buffer += sent;
+		length -= sent;
+	}
+}
+
+void SerialFlush(){
+	//wait for the buffer to empty and the last byte to leave the shift register
+	while(TxHead != TxTail || (Hal_Usart_Get_Ctrla(HAL_USARTC0) & USART_DREINTLVL_gm)){
+		Hal_Spin();
+	}
+	while(TxPending && !(Hal_Usart_Status(HAL_USARTC0) & USART_TXCIF_bm)){
+		Hal_Spin();
 	}
+	TxPending = 0;
+}
+
+uint16_t SerialRxOverruns(){
+	uint16_t overruns;
+	hal_irq_t irq = Hal_Irq_Save();
+	overruns = RxOverruns;
+	Hal_Irq_Restore(irq);
+	return overruns;
 }
 
 void StopSerial(){
-	//turn off Rx and Tx for USART
-	USARTC0.CTRLB &= ~(BIT4_bm | BIT3_bm);
+	SerialFlush();
+	//turn off Rx and Tx for USART and their interrupts
+	Hal_Usart_Ctrla(HAL_USARTC0, 0);
+	Hal_Usart_Ctrlb(HAL_USARTC0, Hal_Usart_Get_Ctrlb(HAL_USARTC0) & ~(USART_RXEN_bm | USART_TXEN_bm));
 	//clear output pin
-	PORTC.OUTCLR = PIN3_bm;
-	PORTC.DIRCLR = PIN3_bm;
-}
\ No newline at end of file
+	Hal_Gpio_Clr(HAL_PORTC, PIN3_bm);
+	Hal_Gpio_Input(HAL_PORTC, PIN3_bm);
+	Clock_Release(CLOCK_HOLD_SERIAL);
+}
+
+ISR(USARTC0_RXC_vect){
+	uint8_t byte = Hal_Usart_Get(HAL_USARTC0);
+	if((uint8_t)(RxHead - RxTail) >= SERIAL_BUF_SIZE - 1){
+		//host is sending faster than the main loop reads
+		RxOverruns++;
+		return;
+	}
+	RxBuffer[RxHead] = byte;
+	RxHead++;
+	Event_Post(EVENT_HOST);
+}
+
+ISR(USARTC0_DRE_vect){
+	if(TxHead == TxTail){
+		//nothing left, stop the interrupt until the next write
+		Hal_Usart_Ctrla(HAL_USARTC0, Hal_Usart_Get_Ctrla(HAL_USARTC0) & ~USART_DREINTLVL_gm);
+		return;
+	}
+	//clear the transmit complete flag so SerialFlush waits for this byte
+	Hal_Usart_Clear_Status(HAL_USARTC0, USART_TXCIF_bm);
+	TxPending = 1;
+	Hal_Usart_Put(HAL_USARTC0, TxBuffer[TxTail]);
+	TxTail++;
+}
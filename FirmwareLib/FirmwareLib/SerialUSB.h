@@ -12,11 +12,32 @@
 #include "constants_and_globals.h"
 #include "utility_functions.h"
 
+//the USART runs off interrupts: bytes written are queued and sent by the data register empty interrupt, and bytes
+//received are queued by the receive interrupt until read. the radio interrupt is lower priority than the receive
+//interrupt, so reading a frame out doesn't cost incoming bytes (those lost are counted by SerialRxOverruns). writing
+//the sd card only holds off the interrupts that use the SPI bus (see SPIBus.h), so bytes from the host keep coming in
+//meanwhile
+#define SERIAL_BUF_SIZE 256	//each way. has to be 256, the indexes wrap on their own
+#define SERIAL_MAX_BAUD 2000000
+
 bool StartSerial(uint32_t BaudRate);
 void StopSerial();
+//queue a byte, waiting for room if the buffer is full
 void SerialWriteByte(uint8_t byte);
+//queue a buffer, waiting for room as it goes
 void SerialWriteBuffer(uint8_t* buffer, uint32_t length);
+//queue as much of the buffer as fits right now. returns the number of bytes taken
+uint8_t SerialWriteNonBlocking(uint8_t* buffer, uint8_t length);
+//room in the transmit buffer
+uint8_t SerialTxSpace();
+//wait until everything queued has gone out
+void SerialFlush();
+//wait for a byte and read it
 uint8_t SerialReadByte();
+//number of received bytes waiting to be read
+uint8_t SerialAvailable();
+//bytes lost because the receive buffer was full
+uint16_t SerialRxOverruns();
 
 
 
@@ -0,0 +1,80 @@
+/*
+ * Sniffer.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Sniffer.h"
+#include "chb.h"
+#include "chb_drvr.h"
+
+static uint8_t SnifferBuffer[SNIFFER_BUF_SIZE];
+static volatile uint16_t ReadIndex, WriteIndex;	// WriteIndex only moves in the isr, ReadIndex only in the main loop
+static uint8_t Dropped;	// since the last record, saturates
+static uint32_t TotalCaptured, TotalDropped;
+
+static void Sniffer_Put(uint8_t byte){
+	SnifferBuffer[WriteIndex] = byte;
+	WriteIndex = (WriteIndex + 1) % SNIFFER_BUF_SIZE;
+}
+
+void Sniffer_Capture(uint8_t* frame, uint8_t length, uint8_t ed, uint8_t lqi, uint8_t crc, uint32_t ts, uint8_t TsValid){
+
+	uint16_t used = (WriteIndex - ReadIndex + SNIFFER_BUF_SIZE) % SNIFFER_BUF_SIZE;
+
+	//leave one byte free so a full buffer doesn't look empty
+	if(SNIFFER_BUF_SIZE - 1 - used < SNIFFER_HEADER_LENGTH + length){
+		if(Dropped < 0xFF) Dropped++;
+		TotalDropped++;
+		return;
+	}
+	Sniffer_Put(SNIFFER_SYNC);
+	Sniffer_Put(length);
+	Sniffer_Put((crc ? SNIFFER_CRC_OK : 0) | (TsValid ? SNIFFER_TS_VALID : 0));
+	Sniffer_Put(ed);
+	Sniffer_Put(lqi);
+	Sniffer_Put(Dropped);
+	for(uint8_t i = 0; i < 4; i++) Sniffer_Put(((uint8_t*)&ts)[i]);
+	for(uint8_t i = 0; i < length; i++) Sniffer_Put(frame[i]);
+	Dropped = 0;
+	TotalCaptured++;
+}
+
+void Sniffer_Run(uint8_t channel){
+
+	uint8_t PrevChannel = chb_get_channel();
+	uint8_t trailer[SNIFFER_HEADER_LENGTH + 8];
+	uint16_t read, write;
+
+	ReadIndex = WriteIndex = 0;
+	Dropped = 0;
+	TotalCaptured = TotalDropped = 0;
+	StartSerial(SNIFFER_BAUD);
+	if(channel) chb_set_channel(channel);
+	chb_set_sniffer(TRUE);
+
+	//stream until the host sends something. the indexes are 16 bits so they are only touched with interrupts off
+	while(!SerialAvailable()){
+		Hal_Irq_Off();
+		write = WriteIndex;
+		Hal_Irq_On();
+		for(read = ReadIndex; read != write; read = (read + 1) % SNIFFER_BUF_SIZE){
+			SerialWriteByte(SnifferBuffer[read]);
+		}
+		Hal_Irq_Off();
+		ReadIndex = read;
+		Hal_Irq_On();
+	}
+	SerialReadByte();
+
+	chb_set_sniffer(FALSE);
+	chb_set_channel(PrevChannel);
+	//records still in the buffer are dropped, the totals go in the end record
+	trailer[0] = SNIFFER_SYNC;
+	trailer[1] = 8;
+	trailer[2] = SNIFFER_END;
+	trailer[3] = trailer[4] = trailer[5] = 0;
+	trailer[6] = trailer[7] = trailer[8] = trailer[9] = 0;
+	*(uint32_t*)(trailer + SNIFFER_HEADER_LENGTH) = TotalCaptured;
+	*(uint32_t*)(trailer + SNIFFER_HEADER_LENGTH + 4) = TotalDropped;
+	SerialWriteBuffer(trailer, sizeof(trailer));
+}
@@ -0,0 +1,35 @@
+/*
+ * Sniffer.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef SNIFFER_H_
+#define SNIFFER_H_
+
+#include "constants_and_globals.h"
+#include "SerialUSB.h"
+
+// Sniffer
+// a spare mote (flashed with the base station firmware) listens on a channel without acking anything and streams every
+// frame it hears to the host, so the real traffic, retries and collisions (bad crc) can be seen without touching the network.
+// the radio isr puts each frame in a ring buffer as a record and the main loop streams the records over USARTC0:
+// [0xA5, frame length, flags, ed, lqi, frames dropped since the last record, timestamp (4 bytes, local clock ticks), frame]
+// the frame is the whole 802.15.4 frame including the fcs. when sniffing stops, a last record with SNIFFER_END set carries
+// the number of frames captured and dropped (4 bytes each) instead of a frame.
+#define SNIFFER_SYNC 0xA5
+#define SNIFFER_HEADER_LENGTH 10
+#define SNIFFER_CRC_OK 0x01
+#define SNIFFER_TS_VALID 0x02
+#define SNIFFER_END 0x80
+#define SNIFFER_BUF_SIZE 2048	// ~15 full frames
+#define SNIFFER_BAUD 2000000
+
+// radio isr: keep a frame for streaming. dropped (and counted) if the buffer is full
+void Sniffer_Capture(uint8_t* frame, uint8_t length, uint8_t ed, uint8_t lqi, uint8_t crc, uint32_t ts, uint8_t TsValid);
+// sniff channel (0 for the current one) and stream to the host at SNIFFER_BAUD until it sends a byte. the radio goes back to
+// normal afterwards and the host link has to be restarted at its usual baud rate
+void Sniffer_Run(uint8_t channel);
+
+#endif /* SNIFFER_H_ */
@@ -0,0 +1,206 @@
+/*
+ * TDMA.c
+ *
+ * Created: 10/19/2026
+ */
+#include "TDMA.h"
+#include "chb.h"
+#include "chb_drvr.h"
+#include "LPL.h"
+#include "Event.h"
+
+#define TDMA_FRAME_PHY_BYTES 28	// preamble, sfd, phr, mac header and fcs of a data frame plus the whole ack frame
+
+static uint16_t SlotOwner[TDMA_MAX_SLOTS];
+static uint8_t NumSlots, MySlot, SuperframesLeft, SlotUsed, RadioAsleep;
+static uint8_t Listening;	// mote: moved on to the next superframe and not through its slot 0 yet
+static uint16_t SlotLength;	// ms
+static uint32_t SlotTicks, SuperframeStart, SlotEnd;
+
+//ticks from now (network time) until t, negative if t has passed
+static int32_t TDMA_Until(uint32_t t){
+	return (int32_t)(t - TimeSynch_Get_Global_Time());
+}
+
+//sleep until network time t
+static void TDMA_Wait_Until(uint32_t t){
+
+	int32_t left;
+
+	while((left = TDMA_Until(t)) > 0){
+		Event_Wake_At(TimeSynch_Get_Local_Time() + left);
+		Event_Wait(EVENT_TIMER);
+	}
+}
+
+static void TDMA_Radio_Sleep(uint8_t sleep){
+	if(sleep != RadioAsleep){
+		chb_sleep(sleep);
+		RadioAsleep = sleep;
+	}
+}
+
+//keep the radio asleep until just before t and listening from then on. returns TRUE once t has come, otherwise asks for a
+//wakeup at the next step
+static uint8_t TDMA_Sleep_Until(uint32_t t){
+
+	int32_t left = TDMA_Until(t);
+
+	if(left > TDMA_WAKEUP_TICKS){
+		TDMA_Radio_Sleep(TRUE);
+		Event_Wake_At(TimeSynch_Get_Local_Time() + left - TDMA_WAKEUP_TICKS);
+		return FALSE;
+	}
+	TDMA_Radio_Sleep(FALSE);
+	if(left > 0){
+		Event_Wake_At(TimeSynch_Get_Local_Time() + left);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static uint32_t TDMA_Superframe_Ticks(){
+	return (NumSlots + 1)*SlotTicks;
+}
+
+static uint8_t TDMA_Send_Schedule(){
+
+	uint8_t schedule[TDMA_SCHEDULE_HEADER_LENGTH + 2*TDMA_MAX_SLOTS];
+
+	schedule[0] = TDMA_SCHEDULE;
+	schedule[1] = NumSlots;
+	*(uint16_t*)(schedule+2) = SlotLength;
+	*(uint32_t*)(schedule+4) = SuperframeStart;
+	schedule[8] = SuperframesLeft;
+	for(uint8_t i=0;i<NumSlots;i++){
+		((uint16_t*)(schedule+TDMA_SCHEDULE_HEADER_LENGTH))[i] = SlotOwner[i];
+	}
+	return chb_write(0xFFFF, schedule, TDMA_SCHEDULE_HEADER_LENGTH + 2*NumSlots);
+}
+
+void TDMA_Set_Schedule(uint16_t* motes, uint8_t NumMotes, uint16_t SlotLengthMs, uint8_t NumSuperframes){
+
+	if(NumMotes > TDMA_MAX_SLOTS) NumMotes = TDMA_MAX_SLOTS;
+	for(uint8_t i=0;i<NumMotes;i++){
+		SlotOwner[i] = motes[i];
+	}
+	NumSlots = NumMotes;
+	SlotLength = SlotLengthMs;
+	SlotTicks = (uint32_t)SlotLengthMs*TDMA_TICKS_PER_MS;
+	SuperframesLeft = NumSuperframes;
+	//start in a low power listening window so duty cycling motes hear the first schedule
+	SuperframeStart = LPL_Next_Window(TimeSynch_Get_Global_Time() + TDMA_LEAD_TICKS);
+}
+
+uint8_t TDMA_Start_Superframe(){
+
+	if(SuperframesLeft == 0) return FALSE;
+	TDMA_Wait_Until(SuperframeStart);
+	//slot 0: keep the motes synched and tell them the schedule (they may have missed earlier ones)
+	TimeSynch_Send_Beacon();
+	TDMA_Send_Schedule();
+	return TRUE;
+}
+
+uint8_t TDMA_Superframe_Running(){
+
+	int32_t left = TDMA_Until(SuperframeStart + TDMA_Superframe_Ticks());
+
+	if(left > 0){
+		Event_Wake_At(TimeSynch_Get_Local_Time() + left);
+		return TRUE;
+	}
+	SuperframeStart += TDMA_Superframe_Ticks();
+	SuperframesLeft--;
+	return FALSE;
+}
+
+uint8_t TDMA_Handle_Schedule(uint8_t* schedule, uint8_t length){
+
+	uint16_t addr = chb_get_short_addr();
+
+	if(length < TDMA_SCHEDULE_HEADER_LENGTH || schedule[0] != TDMA_SCHEDULE) return 0;
+	MySlot = 0;
+	SlotUsed = FALSE;
+	NumSlots = schedule[1];
+	if(NumSlots > TDMA_MAX_SLOTS || length < TDMA_SCHEDULE_HEADER_LENGTH + 2*NumSlots){
+		SuperframesLeft = 0;
+		return 0;
+	}
+	SlotLength = *(uint16_t*)(schedule+2);
+	SlotTicks = (uint32_t)SlotLength*TDMA_TICKS_PER_MS;
+	SuperframeStart = *(uint32_t*)(schedule+4);
+	SuperframesLeft = schedule[8];
+	for(uint8_t i=0;i<NumSlots;i++){
+		SlotOwner[i] = ((uint16_t*)(schedule+TDMA_SCHEDULE_HEADER_LENGTH))[i];
+		if(SlotOwner[i] == addr) MySlot = i + 1;
+	}
+	//slot times are on network time so they mean nothing until the mote is synched
+	if(!TimeSynch_Is_Synched()) MySlot = 0;
+	return MySlot;
+}
+
+//listen through slot 0 of the current superframe for the base station's beacon and schedule, the radio asleep until just
+//before it. returns TRUE once the slot is over, otherwise asks for a wakeup at its end
+static uint8_t TDMA_Listen_Beacon_Slot(){
+
+	uint8_t buffer[sizeof(chb_rx_data_t)];
+	uint8_t length;
+	int32_t left;
+	pcb_t* pcb = chb_get_pcb();
+
+	if(!TDMA_Sleep_Until(SuperframeStart - TDMA_GUARD_TICKS)) return FALSE;
+	while(pcb->data_rcv && (length = chb_read((chb_rx_data_t*)buffer)) != 0){
+		if(pcb->sender_addr != 0x0000) continue;
+		if(buffer[0] == TS_BEACON) TimeSynch_Handle_Beacon(buffer, length);
+		else if(buffer[0] == TDMA_SCHEDULE) TDMA_Handle_Schedule(buffer, length);
+	}
+	if((left = TDMA_Until(SuperframeStart + SlotTicks)) <= 0) return TRUE;
+	Event_Wake_At(TimeSynch_Get_Local_Time() + left);
+	return FALSE;
+}
+
+uint8_t TDMA_Poll_Slot(){
+
+	if(!MySlot){
+		TDMA_Stop();
+		return TDMA_DONE;
+	}
+	//move on to the next superframe once the slot in this one is used up or gone
+	while(Listening || SlotUsed || TDMA_Until(SuperframeStart + (MySlot + 1)*SlotTicks - TDMA_GUARD_TICKS) <= 0){
+		if(!Listening){
+			SlotUsed = FALSE;
+			if(SuperframesLeft <= 1){
+				TDMA_Stop();
+				return TDMA_DONE;
+			}
+			SuperframesLeft--;
+			SuperframeStart += TDMA_Superframe_Ticks();
+			Listening = TRUE;
+		}
+		if(!TDMA_Listen_Beacon_Slot()) return TDMA_WAIT;
+		Listening = FALSE;
+		if(!MySlot || !SuperframesLeft){
+			TDMA_Stop();
+			return TDMA_DONE;
+		}
+	}
+	SlotEnd = SuperframeStart + (MySlot + 1)*SlotTicks - TDMA_GUARD_TICKS;
+	if(!TDMA_Sleep_Until(SuperframeStart + MySlot*SlotTicks + TDMA_GUARD_TICKS)) return TDMA_WAIT;
+	SlotUsed = TRUE;
+	return TDMA_SLOT;
+}
+
+uint8_t TDMA_Frame_Fits(uint8_t length){
+
+	//airtime of the frame and its ack at the current rate (kbps = bits per ms) plus the per frame overhead
+	uint32_t ticks = ((uint32_t)(length + TDMA_FRAME_PHY_BYTES)*8*TDMA_TICKS_PER_MS)/chb_get_bitrate() + TDMA_FRAME_OVERHEAD_TICKS;
+	return TDMA_Until(SlotEnd) > (int32_t)ticks;
+}
+
+void TDMA_Stop(){
+	TDMA_Radio_Sleep(FALSE);
+	MySlot = 0;
+	SuperframesLeft = 0;
+	Listening = FALSE;
+}
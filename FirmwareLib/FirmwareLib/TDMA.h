@@ -0,0 +1,48 @@
+/*
+ * TDMA.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef TDMA_H_
+#define TDMA_H_
+
+#include "constants_and_globals.h"
+#include "TimeSynch.h"
+
+// Superframe layout (all times on network time, see TimeSynch.h)
+// | slot 0: base station beacon + schedule | slot 1: mote | slot 2: mote | ... | slot NumSlots: mote |
+// every slot is SlotLength ms long. motes only transmit in their own slot and keep the radio asleep in the slots of other motes.
+// they wake up for slot 0 to stay synched and pick up schedule changes.
+#define TDMA_SCHEDULE 'D'	// first byte of a schedule: 'D', NumSlots, SlotLength (2 bytes, ms), superframe start (4 bytes), superframes left, slot owners (2 bytes each)
+#define TDMA_SCHEDULE_HEADER_LENGTH 9
+#define TDMA_MAX_SLOTS 32
+#define TDMA_TICKS_PER_MS (TS_TICKS_PER_SEC/1000)
+#define TDMA_GUARD_TICKS (1*TDMA_TICKS_PER_MS)	// dead time at both ends of a slot to cover synch error
+#define TDMA_WAKEUP_TICKS (1*TDMA_TICKS_PER_MS)	// radio wakes up this early before a slot (sleep to rx takes ~0.4ms)
+#define TDMA_FRAME_OVERHEAD_TICKS (2*TDMA_TICKS_PER_MS)	// csma backoff, spi upload, ack turnaround per frame
+#define TDMA_LEAD_TICKS (20*TDMA_TICKS_PER_MS)	// time from setting a schedule to the start of its first superframe
+
+// base station: set up a schedule giving one slot per mote in motes[] SlotLengthMs long, for NumSuperframes superframes, starting shortly
+void TDMA_Set_Schedule(uint16_t* motes, uint8_t NumMotes, uint16_t SlotLengthMs, uint8_t NumSuperframes);
+// base station: wait for the next superframe and send the synch beacon and schedule in slot 0. returns FALSE when the schedule is done
+uint8_t TDMA_Start_Superframe();
+// base station: returns TRUE while the current superframe is still running, and asks for a wakeup (Event_Wake_At) at its end
+uint8_t TDMA_Superframe_Running();
+// mote: take a received schedule. returns the mote's slot number (0 if it has no slot or isn't synched)
+uint8_t TDMA_Handle_Schedule(uint8_t* schedule, uint8_t length);
+// mote: where the mote is in the schedule, for a task to wait on. TDMA_SLOT: the mote's next slot has come and the radio
+// listens. TDMA_WAIT: it hasn't, a wakeup is asked for (Event_Wake_At), wait on EVENT_RADIO_RX | EVENT_TIMER and call again.
+// the radio sleeps in the slots of other motes and the beacon and schedule in slot 0 are taken in between. TDMA_DONE: the
+// schedule is done (the radio is awake again then)
+#define TDMA_WAIT 0
+#define TDMA_SLOT 1
+#define TDMA_DONE 2
+uint8_t TDMA_Poll_Slot();
+// mote: returns TRUE if a frame with length bytes of payload can still be sent in the current slot
+uint8_t TDMA_Frame_Fits(uint8_t length);
+// mote: leave the schedule early and go back to listening
+void TDMA_Stop();
+
+#endif /* TDMA_H_ */
@@ -0,0 +1,45 @@
+/*
+ * Task.c
+ *
+ * Created: 10/19/2026
+ */
+#include "Task.h"
+
+static task_t* Tasks;	// by priority
+
+void Task_Add(task_t* task, uint8_t (*run)(task_t* task), uint8_t priority){
+
+	task_t** p = &Tasks;
+
+	task->run = run;
+	task->lc = 0;
+	task->priority = priority;
+	task->waiting = 0;
+	//after the tasks of the same priority added before it
+	while(*p && (*p)->priority <= priority) p = &(*p)->next;
+	task->next = *p;
+	*p = task;
+}
+
+void Task_Run(){
+
+	task_t* task;
+	uint8_t waiting, ready, events;
+
+	while(1){
+		//take the events that came in for the waiting tasks, sleeping until one does if nobody is ready
+		waiting = 0;
+		ready = FALSE;
+		for(task = Tasks; task; task = task->next){
+			waiting |= task->waiting;
+			if(!task->waiting) ready = TRUE;
+		}
+		events = ready ? Event_Get(waiting) : Event_Wait(waiting);
+		for(task = Tasks; task; task = task->next){
+			if(task->waiting & events) task->waiting = 0;
+		}
+		//then run the first one in line
+		for(task = Tasks; task && task->waiting; task = task->next);
+		if(task) task->waiting = task->run(task);
+	}
+}
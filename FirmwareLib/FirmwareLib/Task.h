@@ -0,0 +1,51 @@
+/*
+ * Task.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "constants_and_globals.h"
+#include "Event.h"
+
+// Cooperative tasks
+// tasks share the stack and take turns: the scheduler calls a task's function, which does a bit of work and returns the events
+// it is waiting on (see Event.h), or 0 to be called again right away. the highest priority task that isn't waiting runs
+// first, so a task that never waits starves the ones below it. with every task waiting the core sleeps until one of their
+// events comes in. a task with a deadline asks for a wakeup with Event_Wake_At and waits on EVENT_TIMER.
+// interrupts keep running while a task blocks (chb_write, writeFile), so sampling carries on; the other tasks wait their turn.
+//
+// a task that has to pick up where it left off across waits is written as a protothread:
+//	static uint8_t My_Task(task_t* task){
+//		TASK_BEGIN(task);
+//		while(1){
+//			TASK_WAIT_UNTIL(task, Queue_Get(&queue, &item), EVENT_QUEUE);
+//			...
+//		}
+//		TASK_END(task);
+//	}
+// the task returns at a wait and the next call jumps back to it, so locals don't survive a wait: keep them static.
+// TASK_YIELD returns ready to run, so the tasks ahead of it in line get a turn first (e.g. between the frames of a transfer).
+// no switch statements between TASK_BEGIN and TASK_END.
+#define TASK_BEGIN(task) switch((task)->lc){ case 0:
+#define TASK_WAIT_UNTIL(task, condition, events) do{ (task)->lc = __LINE__; case __LINE__: if(!(condition)) return (events); }while(0)
+#define TASK_YIELD(task) do{ (task)->lc = __LINE__; return 0; case __LINE__:; }while(0)
+#define TASK_END(task) } (task)->lc = 0; return 0;
+
+typedef struct task_s{
+	uint8_t (*run)(struct task_s* task);
+	uint16_t lc;	// line of the wait a protothread left off at, 0 at the top
+	uint8_t priority;	// 0 runs first
+	uint8_t waiting;	// events the task waits on, 0 if it wants to run
+	struct task_s* next;
+} task_t;
+
+// add a task, ready to run
+void Task_Add(task_t* task, uint8_t (*run)(task_t* task), uint8_t priority);
+// run the tasks. doesn't return
+void Task_Run();
+
+#endif /* TASK_H_ */
@@ -0,0 +1,225 @@
+/*
+ * TimeSynch.c
+ *
+ * Created: 10/19/2026
+ */
+#include "TimeSynch.h"
+#include "Hal.h"
+#include <stdlib.h>
+#include "chb.h"
+#include "chb_drvr.h"
+#include "Event.h"
+
+// reference points: local receive time of a beacon and global - local offset at that time
+static uint32_t LocalRef[TS_TABLE_SIZE];
+static int32_t OffsetRef[TS_TABLE_SIZE];
+static uint8_t NumRefs, NextRef;
+// current estimate: global = local + OffsetAvg + Skew*(local - LocalAvg)
+static uint32_t LocalAvg;
+static int32_t OffsetAvg;
+static float Skew;
+static uint8_t IsRoot;
+// beacon state
+static uint16_t BeaconPeriodTicks;	// in high word ticks (65536 cpu cycles)
+static uint8_t BeaconSeq, PrevBeaconValid, PrevRxSeq, PrevRxValid;
+static uint32_t PrevBeaconTime, PrevRxTime;
+
+void TimeSynch_Init(uint8_t root, uint16_t BeaconPeriod){
+
+	IsRoot = root;
+	NumRefs = 0;
+	NextRef = 0;
+	LocalAvg = 0;
+	OffsetAvg = 0;
+	Skew = 0;
+	BeaconSeq = 0;
+	PrevBeaconValid = FALSE;
+	PrevRxValid = FALSE;
+	TimeSynchBeaconDue = 0;
+
+	//stop and reset both halves of the clock
+	Hal_Timer_Clksel(HAL_TCD1, TC_CLKSEL_OFF_gc);
+	Hal_Timer_Clksel(HAL_TCF0, TC_CLKSEL_OFF_gc);
+	Hal_Timer_Reset(HAL_TCD1);
+	Hal_Timer_Reset(HAL_TCF0);
+
+	//route the radio IRQ pin (PD2) and ADC DRDY pin (PF0) to the capture event channels. the edge is the one selected in the pin's
+	//sense configuration, the same one that triggers the pin interrupts. the low word overflow clocks the high word.
+	Hal_Event_Mux(TS_RADIO_EVCH, EVSYS_CHMUX_PORTD_PIN2_gc);
+	Hal_Event_Mux(TS_DRDY_EVCH, EVSYS_CHMUX_PORTF_PIN0_gc);
+	Hal_Event_Mux(TS_OVF_EVCH, EVSYS_CHMUX_TCD1_OVF_gc);
+
+	//capture A on event channel 2 and capture B on event channel 3 for both words. the high word events are delayed by a cycle so
+	//a capture right at the low word overflow still sees the carry (32-bit input capture)
+	Hal_Timer_Period(HAL_TCD1, 0xFFFF);
+	Hal_Timer_Period(HAL_TCF0, 0xFFFF);
+	Hal_Timer_Ctrlb(HAL_TCD1, TC1_CCAEN_bm | TC1_CCBEN_bm);
+	Hal_Timer_Ctrld(HAL_TCD1, TC_EVACT_CAPT_gc | TC_EVSEL_CH2_gc);
+	Hal_Timer_Ctrlb(HAL_TCF0, TC0_CCAEN_bm | TC0_CCBEN_bm);
+	Hal_Timer_Ctrld(HAL_TCF0, TC_EVACT_CAPT_gc | TC0_EVDLY_bm | TC_EVSEL_CH2_gc);
+
+	//flag a beacon every BeaconPeriod sec with a compare on the high word
+	if(root && BeaconPeriod){
+		BeaconPeriodTicks = BeaconPeriod*(uint16_t)(TS_TICKS_PER_SEC >> 16);
+		Hal_Timer_Cc(HAL_TCF0, HAL_CCC, BeaconPeriodTicks);
+		Hal_Timer_Int_Ctrlb(HAL_TCF0, TC_CCCINTLVL_LO_gc);
+		Hal_Irq_Levels_On(PMIC_LOLVLEN_bm);
+	}
+
+	//start the clock
+	Hal_Timer_Clksel(HAL_TCF0, TC_CLKSEL_EVCH4_gc);
+	Hal_Timer_Clksel(HAL_TCD1, Clock_Tick_Clksel());
+}
+
+uint32_t TimeSynch_Get_Local_Time(){
+
+	uint16_t lo, hi;
+	hal_irq_t irq;
+
+	//16-bit timer registers share the TEMP register with the capture reads done in ISRs so keep interrupts off
+	irq = Hal_Irq_Save();
+	//re-read if the low word rolled over in between
+	do{
+		hi = Hal_Timer_Get_Count(HAL_TCF0);
+		lo = Hal_Timer_Get_Count(HAL_TCD1);
+	} while(hi != Hal_Timer_Get_Count(HAL_TCF0));
+	Hal_Irq_Restore(irq);
+	return ((uint32_t)hi << 16) | lo;
+}
+
+uint32_t TimeSynch_Local_To_Global(uint32_t local){
+
+	uint32_t global;
+	hal_irq_t irq;
+
+	if(IsRoot) return local;
+	irq = Hal_Irq_Save();
+	global = local + OffsetAvg + (int32_t)(Skew*(float)(int32_t)(local - LocalAvg));
+	Hal_Irq_Restore(irq);
+	return global;
+}
+
+uint32_t TimeSynch_Get_Global_Time(){
+	return TimeSynch_Local_To_Global(TimeSynch_Get_Local_Time());
+}
+
+uint8_t TimeSynch_Is_Synched(){
+	return IsRoot || (NumRefs >= TS_MIN_REFS);
+}
+
+//least squares fit of offset vs. local time over the reference table. differences are taken from the newest point so
+//they stay small and survive the clock wrapping around.
+static void TimeSynch_Regression(){
+
+	uint8_t i;
+	uint8_t newest = (NextRef + TS_TABLE_SIZE - 1) % TS_TABLE_SIZE;
+	uint32_t LocalBase = LocalRef[newest];
+	int32_t OffsetBase = OffsetRef[newest];
+	int64_t LocalSum = 0, OffsetSum = 0;
+	int32_t LocalMean, OffsetMean, dLocal, dOffset;
+	float num = 0, den = 0;
+	hal_irq_t irq;
+
+	for(i=0;i<NumRefs;i++){
+		LocalSum += (int32_t)(LocalRef[i] - LocalBase);
+		OffsetSum += OffsetRef[i] - OffsetBase;
+	}
+	LocalMean = LocalSum/NumRefs;
+	OffsetMean = OffsetSum/NumRefs;
+
+	for(i=0;i<NumRefs;i++){
+		dLocal = (int32_t)(LocalRef[i] - LocalBase) - LocalMean;
+		dOffset = (OffsetRef[i] - OffsetBase) - OffsetMean;
+		num += (float)dLocal*dOffset;
+		den += (float)dLocal*dLocal;
+	}
+
+	irq = Hal_Irq_Save();
+	LocalAvg = LocalBase + LocalMean;
+	OffsetAvg = OffsetBase + OffsetMean;
+	Skew = (den > 0) ? num/den : 0;
+	Hal_Irq_Restore(irq);
+}
+
+static void TimeSynch_Add_Ref(uint32_t local, uint32_t global){
+
+	//throw out the table if the new point is way off the current estimate (root rebooted, missed beacons for too long...)
+	if(NumRefs && labs((int32_t)(TimeSynch_Local_To_Global(local) - global)) > TS_MAX_ERROR){
+		NumRefs = 0;
+		NextRef = 0;
+	}
+	LocalRef[NextRef] = local;
+	OffsetRef[NextRef] = (int32_t)(global - local);
+	NextRef = (NextRef + 1) % TS_TABLE_SIZE;
+	if(NumRefs < TS_TABLE_SIZE) NumRefs++;
+	TimeSynch_Regression();
+}
+
+uint8_t TimeSynch_Send_Beacon(){
+
+	uint8_t beacon[TS_BEACON_LENGTH];
+	uint8_t status;
+	pcb_t* pcb = chb_get_pcb();
+
+	TimeSynchBeaconDue = 0;
+	beacon[0] = TS_BEACON;
+	beacon[1] = BeaconSeq;
+	beacon[2] = PrevBeaconValid;
+	*(uint32_t*)(beacon+3) = PrevBeaconTime;
+	status = chb_write(0xFFFF, beacon, TS_BEACON_LENGTH);
+	//the end of this beacon's transmission goes out with the next one
+	PrevBeaconValid = (status == CHB_SUCCESS) && pcb->tx_ts_valid;
+	PrevBeaconTime = TimeSynch_Local_To_Global(pcb->tx_ts);
+	BeaconSeq++;
+	return status;
+}
+
+void TimeSynch_Handle_Beacon(uint8_t* beacon, uint8_t length){
+
+	pcb_t* pcb = chb_get_pcb();
+
+	if(IsRoot || length < TS_BEACON_LENGTH || beacon[0] != TS_BEACON) return;
+	//the beacon carries the time the previous beacon was sent. pair it up with the time that one was received here
+	if(beacon[2] && PrevRxValid && beacon[1] == (uint8_t)(PrevRxSeq + 1)){
+		TimeSynch_Add_Ref(PrevRxTime, *(uint32_t*)(beacon+3) + TS_RX_DELAY);
+	}
+	PrevRxSeq = beacon[1];
+	PrevRxTime = pcb->rx_ts;
+	PrevRxValid = pcb->rx_ts_valid;
+}
+
+uint32_t TimeSynch_Radio_Capture(){
+
+	uint16_t lo, hi;
+	hal_irq_t irq = Hal_Irq_Save();
+
+	//the capture registers are double buffered so read until empty to get the newest edge
+	do{
+		lo = Hal_Timer_Get_Cc(HAL_TCD1, HAL_CCA);
+		hi = Hal_Timer_Get_Cc(HAL_TCF0, HAL_CCA);
+	} while((Hal_Timer_Flags(HAL_TCD1) & TC1_CCAIF_bm) || (Hal_Timer_Flags(HAL_TCF0) & TC0_CCAIF_bm));
+	Hal_Irq_Restore(irq);
+	return ((uint32_t)hi << 16) | lo;
+}
+
+uint32_t TimeSynch_Sample_Capture(){
+
+	uint16_t lo, hi;
+	hal_irq_t irq = Hal_Irq_Save();
+
+	do{
+		lo = Hal_Timer_Get_Cc(HAL_TCD1, HAL_CCB);
+		hi = Hal_Timer_Get_Cc(HAL_TCF0, HAL_CCB);
+	} while((Hal_Timer_Flags(HAL_TCD1) & TC1_CCBIF_bm) || (Hal_Timer_Flags(HAL_TCF0) & TC0_CCBIF_bm));
+	Hal_Irq_Restore(irq);
+	return ((uint32_t)hi << 16) | lo;
+}
+
+//beacon period timer for the root
+ISR(TCF0_CCC_vect){
+	Hal_Irq_Off();
+	Hal_Timer_Cc(HAL_TCF0, HAL_CCC, Hal_Timer_Get_Cc(HAL_TCF0, HAL_CCC) + BeaconPeriodTicks);
+	Hal_Irq_On();
+	TimeSynchBeaconDue = 1;
+	Event_Post(EVENT_TIMER);
+}
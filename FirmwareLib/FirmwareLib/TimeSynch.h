@@ -0,0 +1,55 @@
+/*
+ * TimeSynch.h
+ *
+ * Created: 10/19/2026
+ */
+
+
+#ifndef TIMESYNCH_H_
+#define TIMESYNCH_H_
+
+#include "constants_and_globals.h"
+#include "Clock.h"
+
+// Local clock
+// free running 32-bit counter at CLOCK_TICK_HZ whatever the cpu clock (see Clock.h): TCD1 is the low word, TCF0 the high word
+// (clocked by TCD1 overflow on event channel 4).
+// both words input capture the radio IRQ pin (event channel 2, capture A) and the ADC DRDY pin (event channel 3, capture B)
+// so timestamps don't depend on interrupt latency. wraps around every ~1074 sec at 4MHz.
+#define TS_TICKS_PER_SEC CLOCK_TICK_HZ
+#define TS_RADIO_EVCH 2
+#define TS_DRDY_EVCH 3
+#define TS_OVF_EVCH 4
+
+// Synch protocol
+// the root (base station) broadcasts a beacon every beacon period containing the global time at which its previous beacon
+// finished transmitting. motes pair that with the local time they received the previous beacon and fit offset and skew
+// to the last TS_TABLE_SIZE pairs by linear regression.
+#define TS_BEACON 'Y'	// first byte of a beacon: 'Y', seq, prev valid, global time of prev beacon (4 bytes)
+#define TS_BEACON_LENGTH 7
+#define TS_TABLE_SIZE 8	// number of reference points in the regression
+#define TS_MIN_REFS 4	// number of reference points needed before the mote counts as synched
+#define TS_MAX_ERROR (TS_TICKS_PER_SEC/1000)	// (ticks) predicted vs. received time error that throws out the table (1ms)
+#define TS_RX_DELAY 0	// (ticks) receiver trx end latency minus sender trx end latency for the same frame, calibrate on hardware
+
+// set up the local clock and the synch state. the root's local time is the network time. if BeaconPeriod (sec) is
+// non zero, TimeSynchBeaconDue gets set every BeaconPeriod seconds and the app should call TimeSynch_Send_Beacon().
+void TimeSynch_Init(uint8_t root, uint16_t BeaconPeriod);
+// current local time
+uint32_t TimeSynch_Get_Local_Time();
+// convert local time to network time using the current offset and skew estimate
+uint32_t TimeSynch_Local_To_Global(uint32_t local);
+// current network time
+uint32_t TimeSynch_Get_Global_Time();
+// returns TRUE if the mote has enough reference points to trust the network time
+uint8_t TimeSynch_Is_Synched();
+// broadcast a beacon. returns the chb_write status
+uint8_t TimeSynch_Send_Beacon();
+// process a received beacon. call right after the chb_read that returned it since the rx time is taken from the pcb
+void TimeSynch_Handle_Beacon(uint8_t* beacon, uint8_t length);
+// local time of the last radio IRQ edge. used by the radio driver
+uint32_t TimeSynch_Radio_Capture();
+// local time of the last ADC DRDY edge. used by the ADC ISR to stamp samples
+uint32_t TimeSynch_Sample_Capture();
+
+#endif /* TIMESYNCH_H_ */
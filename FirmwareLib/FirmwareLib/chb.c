@@ -39,12 +39,27 @@
 
 #include "chb_drvr.h"
 #include "chb_buf.h"
+#include "TimeSynch.h"
+#if (CHB_LINK_STATS)
+#include "chb_link.h"
+#endif
 
 static pcb_t pcb;
 
 // these are for the duplicate checking and rejection
-static U8 prev_seq = 0xFF;
-static U16 prev_src_addr = 0xFFFE;
+typedef struct
+{
+    U16 src_addr;
+    U8 seq;
+    U8 used;        // lru stamp
+    U32 ts;         // rx timestamp of the last frame
+} chb_dupe_t;
+
+static chb_dupe_t dupes[CHB_DUPE_TABLE_SZ];
+static U8 num_dupes, dupe_clock;
+
+// while set, frames go out with the same sequence number so the receiver drops repeats as retries
+static U8 hold_seq = false;
 
 /**************************************************************************/
 /*!
@@ -54,21 +69,25 @@ static U16 prev_src_addr = 0xFFFE;
 void chb_init()
 {
     memset(&pcb, 0, sizeof(pcb_t));
-    pcb.src_addr = chb_get_short_addr();
+    pcb.src_addr = chb_load_short_addr();
+    num_dupes = 0;
+#if (CHB_LINK_STATS)
+    chb_link_init();
+#endif
     chb_drvr_init();
 	//radio_msg_received_int_enable();
 }
 
 // Configure PE2 to use as proxy interrupt for data being stored in radio buffer
 void radio_msg_received_int_enable(){
-	PORTE.DIRSET = PIN2_bm;
-	PORTE.OUTCLR = PIN2_bm;
-	PORTE.PIN0CTRL = PORT_ISC_FALLING_gc | PORT_OPC_TOTEM_gc;
-	PORTE.INT0MASK = PIN2_bm;
-	PORTE.INTCTRL = PORT_INT0LVL_HI_gc;
+	Hal_Gpio_Output(HAL_PORTE, PIN2_bm);
+	Hal_Gpio_Clr(HAL_PORTE, PIN2_bm);
+	Hal_Gpio_Pin_Ctrl(HAL_PORTE, 0, PORT_ISC_FALLING_gc | PORT_OPC_TOTEM_gc);
+	Hal_Gpio_Int0_Mask(HAL_PORTE, PIN2_bm);
+	Hal_Gpio_Int_Ctrl(HAL_PORTE, PORT_INT0LVL_HI_gc);
 	// Enable low level interrupts.
-	PMIC.CTRL |= PMIC_HILVLEN_bm;
-	sei();
+	Hal_Irq_Levels_On(PMIC_HILVLEN_bm);
+	Hal_Irq_On();
 }
 
 /**************************************************************************/
@@ -81,34 +100,98 @@ pcb_t *chb_get_pcb()
     return &pcb;
 }
 
+/**************************************************************************/
+/*!
+    Returns the header size used for frames sent to addr. With header compression,
+    the coordinator address is left out since it is implied by the frame.
+*/
+/**************************************************************************/
+static U8 chb_get_hdr_sz(U16 addr)
+{
+#if (CHB_HDR_COMPRESS)
+    if ((addr == CHB_COORD_ADDR) && (pcb.src_addr != CHB_COORD_ADDR))
+    {
+        return CHB_HDR_SZ_SHORT;
+    }
+    if ((pcb.src_addr == CHB_COORD_ADDR) && (addr != 0xFFFF))
+    {
+        return CHB_HDR_SZ_SHORT;
+    }
+#endif
+    return CHB_HDR_SZ;
+}
+
+/**************************************************************************/
+/*!
+    Returns the max payload that fits in one frame sent to addr.
+*/
+/**************************************************************************/
+U8 chb_get_max_payload(U16 addr)
+{
+    return CHB_MAX_PSDU - chb_get_hdr_sz(addr) - CHB_FCS_LEN;
+}
+
+/**************************************************************************/
+/*!
+    Keep sending frames with the same sequence number while hold is set. Used
+    to repeat one frame several times (strobing a sleeping receiver) without
+    the receiver passing up the copies. Releasing the hold moves on to the
+    next sequence number.
+*/
+/**************************************************************************/
+void chb_hold_seq(U8 hold)
+{
+    if (hold_seq && !hold)
+    {
+        pcb.seq++;
+    }
+    hold_seq = hold;
+}
+
 /**************************************************************************/
 /*! 
     Requires the dest addr, location to store data, and len of payload.
-    Returns the length of the hdr. 
+    Returns the length of the hdr (including the frame length byte). 
 */
 /**************************************************************************/
 static U8 chb_gen_hdr(U8 *hdr, U16 addr, U8 len)
 {
     U8 *hdr_ptr = hdr;
+    U8 hdr_sz = chb_get_hdr_sz(addr);
 
     // calc frame size and put in 0 position of array
     // frame size = hdr sz + payload len + fcs len
-    *hdr_ptr++ = CHB_HDR_SZ + len + CHB_FCS_LEN;
+    *hdr_ptr++ = hdr_sz + len + CHB_FCS_LEN;
 
     // use default fcf byte 0 val but test for ack request. we won't request
     // ack if broadcast. all other cases we will.
-    *hdr_ptr++ = CHB_FCF_BYTE_0 | ((addr != 0xFFFF) << CHB_ACK_REQ_POS);
-    *hdr_ptr++ = CHB_FCF_BYTE_1;
+    if (hdr_sz == CHB_HDR_SZ)
+    {
+        *hdr_ptr++ = CHB_FCF_BYTE_0 | ((addr != 0xFFFF) << CHB_ACK_REQ_POS);
+        *hdr_ptr++ = CHB_FCF_BYTE_1;
+    }
+    else
+    {
+        // only one address is present so the pan ID can't be compressed
+        *hdr_ptr++ = (CHB_FCF_BYTE_0 & ~(1 << CHB_PAN_ID_COMP_POS)) | (1 << CHB_ACK_REQ_POS);
+        *hdr_ptr++ = (addr == CHB_COORD_ADDR) ? CHB_FCF_BYTE_1_NO_DEST : CHB_FCF_BYTE_1_NO_SRC;
+    }
 
-    *hdr_ptr++ = pcb.seq++;
+    *hdr_ptr++ = hold_seq ? pcb.seq : pcb.seq++;
 
-    // fill out dest pan ID, dest addr, src addr
+    // fill out pan ID, then dest addr and src addr (whichever are present)
     *(U16 *)hdr_ptr = CHB_PAN_ID;
     hdr_ptr += sizeof(U16);
-    *(U16 *)hdr_ptr = addr;
-    hdr_ptr += sizeof(U16);
-    *(U16 *)hdr_ptr = pcb.src_addr;
-    hdr_ptr += sizeof(U16);
+    if ((hdr_sz == CHB_HDR_SZ) || (addr != CHB_COORD_ADDR))
+    {
+        *(U16 *)hdr_ptr = addr;
+        hdr_ptr += sizeof(U16);
+    }
+    if ((hdr_sz == CHB_HDR_SZ) || (addr == CHB_COORD_ADDR))
+    {
+        *(U16 *)hdr_ptr = pcb.src_addr;
+        hdr_ptr += sizeof(U16);
+    }
     
     // return the len of the header
     return hdr_ptr - hdr;
@@ -121,26 +204,31 @@ static U8 chb_gen_hdr(U8 *hdr, U16 addr, U8 len)
 /**************************************************************************/
 U8 chb_write(U16 addr, U8 *data, U32 len)
 {
-    U8 status, frm_len, hdr[CHB_HDR_SZ + 1];
+    U8 status, frm_len, hdr_len, max_payload, hdr[CHB_HDR_SZ + 1];
 	U32 frm_offset;
-	//U8 hdr_len;
     //int rtry;
 	
 	frm_offset = 0;
+	max_payload = chb_get_max_payload(addr);
     while (len > 0)
     {
         // calculate which frame len to use. if greater than max payload, split
         // up operation.
-        frm_len = (len > CHB_MAX_PAYLOAD) ? CHB_MAX_PAYLOAD : len;
+        frm_len = (len > max_payload) ? max_payload : len;
 
         // gen frame header
-        //hdr_len = chb_gen_hdr(hdr, addr, frm_len);
-		chb_gen_hdr(hdr, addr, frm_len);
+        hdr_len = chb_gen_hdr(hdr, addr, frm_len);
 
         // send data to chip
 		//rtry = 0;
 		//do{
-        status = chb_tx(hdr, data+frm_offset, frm_len);			
+#if (CHB_LINK_STATS)
+        chb_link_tx_start(addr);
+#endif
+        status = chb_tx(hdr, hdr_len, data+frm_offset, frm_len);			
+#if (CHB_LINK_STATS)
+        chb_link_tx_done(addr, status);
+#endif
 		if (status != CHB_SUCCESS){
              switch (status)
              {
@@ -176,6 +264,63 @@ U8 chb_write(U16 addr, U8 *data, U32 len)
 	return CHB_SUCCESS;
 }
 
+/**************************************************************************/
+/*!
+    Duplicate check. Returns true if seq is the last sequence number heard
+    from src_addr, otherwise remembers it, replacing the least recently
+    heard sender if the table is full.
+*/
+/**************************************************************************/
+static U8 chb_is_dupe(U16 src_addr, U8 seq)
+{
+    U8 i, oldest = 0;
+    chb_dupe_t *dupe = NULL;
+
+    for (i=0; i<num_dupes; i++)
+    {
+        if (dupes[i].src_addr == src_addr)
+        {
+            dupe = &dupes[i];
+            break;
+        }
+    }
+
+    if (dupe)
+    {
+#if (CHB_TIMESTAMP)
+        if ((dupe->seq == seq) && (!pcb.rx_ts_valid ||
+            ((U32)(pcb.rx_ts - dupe->ts) < (U32)CHB_DUPE_TIMEOUT_MS*(TS_TICKS_PER_SEC/1000))))
+#else
+        if (dupe->seq == seq)
+#endif
+        {
+            return true;
+        }
+    }
+    else if (num_dupes < CHB_DUPE_TABLE_SZ)
+    {
+        dupe = &dupes[num_dupes++];
+    }
+    else
+    {
+        for (i=1; i<CHB_DUPE_TABLE_SZ; i++)
+        {
+            if ((U8)(dupe_clock - dupes[i].used) > (U8)(dupe_clock - dupes[oldest].used))
+            {
+                oldest = i;
+            }
+        }
+        dupe = &dupes[oldest];
+    }
+    dupe->src_addr = src_addr;
+    dupe->seq = seq;
+    dupe->used = ++dupe_clock;
+#if (CHB_TIMESTAMP)
+    dupe->ts = pcb.rx_ts;
+#endif
+    return false;
+}
+
 /**************************************************************************/
 /*!
     Read data from the buffer. Need to pass in a buffer of at leasts max frame
@@ -187,7 +332,7 @@ U8 chb_write(U16 addr, U8 *data, U32 len)
 /**************************************************************************/
 U8 chb_read(chb_rx_data_t *rx)
 {
-    U8 i, len, seq, *data_ptr;
+    U8 i, len, seq, fcf0, fcf1, hdr_len, *data_ptr;
 
     data_ptr = rx->data;
 
@@ -205,23 +350,69 @@ U8 chb_read(chb_rx_data_t *rx)
         *data_ptr++ = chb_buf_read();
     }
 
+#if (CHB_TIMESTAMP)
+    // the rx timestamp follows the frame in the buffer
+    pcb.rx_ts_valid = chb_buf_read();
+    for (i=0; i<sizeof(U32); i++)
+    {
+        ((U8 *)&pcb.rx_ts)[i] = chb_buf_read();
+    }
+#endif
+#if (CHB_LINK_STATS)
+    // then the ed and lqi of the frame. pcb->ed is only the last frame received by the isr otherwise
+    pcb.ed = chb_buf_read();
+    pcb.lqi = chb_buf_read();
+#endif
+
     // we're using the buffer that's fed in as an argument as a temp
     // buffer as well to save resources.
     // we'll use it as temp storage to parse the frame. then move the frame
     // down so that only the payload will be in the buffer.
 
-    // extract the sequence number
-    data_ptr = rx->data + 3;    // location of sequence number
-    seq = *data_ptr;
+    // extract the frame control field and the sequence number
+    fcf0 = rx->data[1];
+    fcf1 = rx->data[2];
+    seq = rx->data[3];          // location of sequence number
 
-    // parse the buffer and extract the dest and src addresses
-    data_ptr = rx->data + 6;                // location of dest addr
-    rx->dest_addr = *(U16 *)data_ptr;
+    // parse the buffer and extract the dest and src addresses. either one can be left
+    // out if it's the coordinator (header compression). only short addresses are supported.
+    data_ptr = rx->data + 4;    // location of dest pan ID
+    if (((fcf1 >> CHB_DEST_MODE_POS) & 0x3) == CHB_ADDR_MODE_SHORT)
+    {
+        data_ptr += sizeof(U16);                // skip dest pan ID
+        rx->dest_addr = *(U16 *)data_ptr;
+        data_ptr += sizeof(U16);
+    }
+    else
+    {
+        rx->dest_addr = CHB_COORD_ADDR;
+    }
 	pcb.destination_addr = rx->dest_addr;
-    data_ptr += sizeof(U16);
-    rx->src_addr = *(U16 *)data_ptr;
+
+    if (((fcf1 >> CHB_SRC_MODE_POS) & 0x3) == CHB_ADDR_MODE_SHORT)
+    {
+        if (!(fcf0 & (1 << CHB_PAN_ID_COMP_POS)))
+        {
+            data_ptr += sizeof(U16);            // skip src pan ID
+        }
+        rx->src_addr = *(U16 *)data_ptr;
+        data_ptr += sizeof(U16);
+    }
+    else
+    {
+        rx->src_addr = CHB_COORD_ADDR;
+    }
+#if (CHB_LINK_STATS)
+    chb_link_rx(rx->src_addr, pcb.ed, pcb.lqi);
+#endif
 	pcb.sender_addr = rx->src_addr;
-    data_ptr += sizeof(U16);
+
+    // header len doesn't include the frame length byte
+    hdr_len = data_ptr - (rx->data + 1);
+    if (len < (hdr_len + CHB_FCS_LEN))
+    {
+        return 0;
+    }
 
     // if the data in the rx buf is 0, then clear the rx_flag. otherwise, keep it raised
     if (!chb_buf_get_len())
@@ -235,25 +426,19 @@ U8 chb_read(chb_rx_data_t *rx)
     return len;
 #else
     // duplicate frame check (dupe check). we want to remove frames that have been already been received since they 
-    // are just retries. 
-    // note: this dupe check only removes duplicate frames from the previous transfer. if another frame from a different
-    // node comes in between the dupes, then the dupe will show up as a received frame.
-    if ((seq == prev_seq) && (rx->src_addr == prev_src_addr))
+    // are just retries. the last sequence number of each recent sender is kept, so frames from other nodes coming
+    // in between the dupes don't let them through.
+    if (chb_is_dupe(rx->src_addr, seq))
     {
         // this is a duplicate frame from a retry. the remote node thinks we didn't receive 
         // it properly. discard.
         return 0;
     }
-    else
-    {
-        prev_seq = seq;
-        prev_src_addr = rx->src_addr;
-    }
 
     // move the payload down to the beginning of the data buffer
-    //memmove(rx->data, data_ptr, len - CHB_HDR_SZ);
-	memmove(rx, data_ptr, len - CHB_HDR_SZ);
+    //memmove(rx->data, data_ptr, len - hdr_len);
+	memmove(rx, data_ptr, len - hdr_len);
     // finally, return the len of the payload
-    return len - CHB_HDR_SZ - CHB_FCS_LEN;
+    return len - hdr_len - CHB_FCS_LEN;
 #endif
 }
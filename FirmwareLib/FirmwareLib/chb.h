@@ -42,9 +42,51 @@
 // usage, this should not be enabled.
 #define CHB_PROMISCUOUS   0
 
+// this enables header compression. frames sent to the coordinator (base station) leave out the
+// dest addr and frames sent by the coordinator leave out the src addr since 802.15.4 lets both be
+// implied. this gives 2 more bytes of payload per frame. all motes in a network must use the same setting.
+#define CHB_HDR_COMPRESS  0
+
+// this enables hardware timestamps of the radio interrupts for time synchronization (see TimeSynch.c).
+// the end of every received frame is stamped against the free running 32-bit clock and stored in the
+// rx buffer along with the frame. chb_read puts the stamp of the frame it returns into pcb->rx_ts.
+#define CHB_TIMESTAMP     1
+
+#if (CHB_TIMESTAMP)
+#define CHB_RX_TS_LEN     5    // valid flag + 32-bit timestamp stored after each frame in the rx buffer
+#else
+#define CHB_RX_TS_LEN     0
+#endif
+
+// this keeps per neighbor link statistics (ed and lqi averages, sent/no ack counts) and adapts the transmit power
+// to each neighbor (see chb_link.c). the ed and lqi of every received frame are stored in the rx buffer with it.
+#define CHB_LINK_STATS    1
+
+// this lets a mote be switched into a sniffer at runtime (chb_set_sniffer). the radio listens without acking and
+// hands every frame, bad crc included, to Sniffer_Capture (see Sniffer.c) straight from the isr instead of the
+// rx buffer. unlike CHB_PROMISCUOUS, the normal stack stays in the build.
+#define CHB_SNIFFER       1
+
+#if (CHB_LINK_STATS)
+#define CHB_RX_LINK_LEN   2    // ed + lqi stored after each frame in the rx buffer
+#else
+#define CHB_RX_LINK_LEN   0
+#endif
+
+// duplicate rejection. chb_read keeps the last sequence number heard from each of the last CHB_DUPE_TABLE_SZ senders
+// and drops frames repeating it, so retries still get dropped when frames from other motes come in between. with
+// CHB_TIMESTAMP an entry is forgotten after CHB_DUPE_TIMEOUT_MS so a sender that restarted isn't dropped for reusing a
+// sequence number. has to be longer than a low power listening strobe (LPL.h).
+#define CHB_DUPE_TABLE_SZ   8
+#define CHB_DUPE_TIMEOUT_MS 4000
+
+#define CHB_COORD_ADDR    0x0000    // short address of the base station (PAN coordinator)
+
 #define CHB_HDR_SZ        9    // FCF + seq + pan_id + dest_addr + src_addr (2 + 1 + 2 + 2 + 2)
+#define CHB_HDR_SZ_SHORT  7    // FCF + seq + pan_id + addr (2 + 1 + 2 + 2), one address implied
 #define CHB_FCS_LEN       2
-#define CHB_MAX_PAYLOAD   100
+#define CHB_MAX_PSDU      127  // max 802.15.4 frame length (aMaxPHYPacketSize), includes the FCS
+#define CHB_MAX_PAYLOAD   (CHB_MAX_PSDU - CHB_HDR_SZ - CHB_FCS_LEN)    // 116 bytes with a full header
 
 
 // frame_type = data
@@ -59,6 +101,16 @@
 // src addr = 16-bit
 #define CHB_FCF_BYTE_1    0x98
 
+// same as above but without the dest addr (implied to be the coordinator)
+#define CHB_FCF_BYTE_1_NO_DEST  0x90
+// same as above but without the src addr (implied to be the coordinator)
+#define CHB_FCF_BYTE_1_NO_SRC   0x18
+
+#define CHB_PAN_ID_COMP_POS 6
+#define CHB_DEST_MODE_POS   2    // dest addr mode position in fcf byte 1
+#define CHB_SRC_MODE_POS    6    // src addr mode position in fcf byte 1
+#define CHB_ADDR_MODE_SHORT 2
+
 #define CHB_ACK_REQ_POS   5
 
 enum
@@ -89,6 +141,14 @@ typedef struct
     U8 battlow;
     U8 ed;
     U8 crc;
+    U8 lqi;
+
+    // timestamps (local clock ticks) of the end of the last frame read by chb_read and the last
+    // frame sent. the valid flags are cleared if the radio interrupt couldn't be stamped accurately.
+    U32 rx_ts;
+    U32 tx_ts;
+    bool rx_ts_valid;
+    bool tx_ts_valid;
 } pcb_t;
 
 typedef struct
@@ -96,7 +156,7 @@ typedef struct
     U8 len;
     U16 src_addr;
     U16 dest_addr;
-    U8 data[CHB_MAX_PAYLOAD];
+    U8 data[CHB_MAX_PSDU + 1];   // chb_read uses this as scratch space for the whole frame (len byte + frame)
 } chb_rx_data_t;
 //initialize radio and put it into listen mode
 void chb_init();
@@ -105,8 +165,13 @@ pcb_t *chb_get_pcb();
 //send a message using the radio. Takes a mote address (0xFFFF to broadcast), a pointer to the data to send and the length of the data to send.
 //the function returns the status of the transmition: 0 if success, 5 if no acknowledgement received (only valid if non broadcast message) and 3 if channel access violation.
 U8 chb_write(U16 addr, U8 *data, U32 len);
+//get the max number of payload bytes that fit in a single frame sent to the given address. Data longer than this is
+//split up by chb_write so bulk transfers should be chunked with this size to get one frame per chunk.
+U8 chb_get_max_payload(U16 addr);
+//send the following frames with the same sequence number (hold = true) so the receiver treats repeats as retries, or go back to normal
+void chb_hold_seq(U8 hold);
 //read the data from the buffer where message is copied to when it is received. Should be done automatically when a message is received and the contents of the buffer are written to the FRAMReadBuffer.
-//the function takes pointer to an array (min length of 128 bytes) and writes the contents of the buffer to it returning the status of the command (0 if successful). 
+//the function takes pointer to an array (min length of sizeof(chb_rx_data_t) bytes) and writes the payload to the start of it, returning the length of the payload (0 if no valid data). 
 U8 chb_read(chb_rx_data_t *rx);
 //enable pseudo interrupt on portE which triggers every time incoming radio message is stored in the message buffer
 void radio_msg_received_int_enable();
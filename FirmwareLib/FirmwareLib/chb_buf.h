@@ -41,7 +41,8 @@
     // use a large size buffer for promiscuous mode in case of high traffic
     #define CHB_BUF_SZ 1024
 #else
-    #define CHB_BUF_SZ 128
+    // room for a full size frame with its length byte and the timestamp and link info stored after it
+    #define CHB_BUF_SZ 255
 #endif
 
 void chb_buf_init();
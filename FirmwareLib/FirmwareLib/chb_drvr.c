@@ -41,11 +41,26 @@
 #include "chb_buf.h"
 #include "chb_spi.h"
 #include "chb_eeprom.h"
+#if (CHB_TIMESTAMP)
+#include "TimeSynch.h"
+#include "Event.h"
+#include "Energy.h"
+#include "Clock.h"
+#endif
+#if (CHB_SNIFFER)
+#include "Sniffer.h"
+#endif
 
 // store string messages in flash rather than RAM
 const char chb_err_overflow[] PROGMEM = "BUFFER FULL. TOSSING INCOMING DATA\n";
 const char chb_err_init[] PROGMEM = "RADIO NOT INITIALIZED PROPERLY\n";
 
+// current transceiver mode
+static U8 chb_mode = CHB_INIT_MODE;
+
+// power level set with chb_set_pwr and the level currently in the PHY_TX_PWR register
+static U8 chb_pwr, chb_pwr_reg;
+
 /**************************************************************************/
 /*!
 
@@ -72,9 +87,9 @@ static U8 chb_get_status()
 */
 /**************************************************************************/
 /*
-static void chb_delay_us(U16 usec)
+static void chbHal_Delay_Us(U16 usec)
 {
-    _delay_us((double)usec);
+    Hal_Delay_Us((double)usec);
 }
 */
 /**************************************************************************/
@@ -88,11 +103,11 @@ void chb_reset()
     CHB_SLPTR_DISABLE();
 
     // wait a bit while transceiver wakes up
-    _delay_us(TIME_P_ON_TO_CLKM_AVAIL);
+    Hal_Delay_Us(TIME_P_ON_TO_CLKM_AVAIL);
 
     // reset the device
     CHB_RST_ENABLE();
-    _delay_us(TIME_RST_PULSE_WIDTH);
+    Hal_Delay_Us(TIME_RST_PULSE_WIDTH);
     CHB_RST_DISABLE();
 
     // check that we have the part number that we're expecting
@@ -232,40 +247,31 @@ void chb_reg_read_mod_write(U8 addr, U8 val, U8 mask)
 /**************************************************************************/
 void chb_frame_write(U8 *hdr, U8 hdr_len, U8 *data, U8 data_len)
 {
-    U8 i;
-	//U8 dummy;
-	
-    // dont allow transmission longer than max frame size
-    if ((hdr_len + data_len) > 127)
+    // dont allow transmission longer than max frame size. hdr_len includes the frame length
+    // byte and the fcs is added by the radio.
+    if ((hdr_len - 1 + data_len + CHB_FCS_LEN) > CHB_MAX_FRAME_LENGTH)
     {
         return;
     }
 
-    // initiate spi transaction
+    // keep the radio isr off the spi bus while we hold the chip select. only the
+    // command byte needs a real critical section, the rest of the frame is moved
+    // by dma with the other interrupts (adc drdy, timers) still running.
     CHB_ENTER_CRIT();
+    CHB_IRQ_DISABLE();
     RadioCS(TRUE); 
 
     // send fifo write command
-    //dummy = SPID_write(CHB_SPI_CMD_FW);
 	SPID_write(CHB_SPI_CMD_FW);
+    CHB_LEAVE_CRIT();
 
-    // write hdr contents to fifo
-    for (i=0; i<hdr_len; i++)
-    {
-        //dummy = SPID_write(*hdr++);
-		SPID_write(*hdr++);
-    }
-
-    // write data contents to fifo
-    for (i=0; i<data_len; i++)
-    {
-        //dummy = SPID_write(*data++);
-		SPID_write(*data++);
-    }
+    // write hdr and data contents to fifo
+    SPID_write_block(hdr, NULL, hdr_len);
+    SPID_write_block(data, NULL, data_len);
 
     // terminate spi transaction
     RadioCS(FALSE); 
-    CHB_LEAVE_CRIT();
+    CHB_IRQ_ENABLE();
 }
 
 /**************************************************************************/
@@ -273,30 +279,97 @@ void chb_frame_write(U8 *hdr, U8 hdr_len, U8 *data, U8 data_len)
 
 */
 /**************************************************************************/
+#if (CHB_TIMESTAMP)
+static U32 chb_rx_ts;
+static U8 chb_rx_ts_valid;
+#endif
+
+// frame and the lqi byte following it as read out of the radio
+static U8 frame[CHB_MAX_FRAME_LENGTH + 1];
+
+#if (CHB_SNIFFER)
+static U8 chb_sniff = false;
+
+/**************************************************************************/
+/*!
+    Sniffer frame read. Reads out any frame, whatever its crc, and passes it
+    to the sniffer along with its ed, lqi and timestamp. Nothing goes into
+    the rx buffer.
+*/
+/**************************************************************************/
+static void chb_sniff_frame_read(U8 ed, U8 crc)
+{
+    U8 len;
+
+    // only the command and length bytes in a critical section, see chb_frame_read
+    CHB_ENTER_CRIT();
+    RadioCS(TRUE);
+
+    SPID_write(CHB_SPI_CMD_FR);
+    len = SPID_write(0);
+    CHB_LEAVE_CRIT();
+
+    if (len <= CHB_MAX_FRAME_LENGTH)
+    {
+        SPID_write_block(NULL, frame, len + 1);
+    }
+
+    RadioCS(FALSE);
+
+    if (len <= CHB_MAX_FRAME_LENGTH)
+    {
+#if (CHB_TIMESTAMP)
+        Sniffer_Capture(frame, len, ed, frame[len], crc, chb_rx_ts, chb_rx_ts_valid);
+#else
+        Sniffer_Capture(frame, len, ed, frame[len], crc, 0, false);
+#endif
+    }
+}
+#endif
+
 static void chb_frame_read()
 {
-    U8 i, len, data;
+    U8 i, len;
 
+    // called from the radio isr, so the other spi d users (all in the main loop) can't
+    // get in while we hold the chip select. like chb_frame_write, only the command byte
+    // goes in a critical section and the frame comes out by dma with the higher level
+    // interrupts (adc drdy, usart, sampling timers) still running.
     CHB_ENTER_CRIT();
     RadioCS(TRUE);
 
     /*Send frame read command and read the length.*/
     SPID_write(CHB_SPI_CMD_FR);
     len = SPID_write(0);
+    CHB_LEAVE_CRIT();
 
     /*Check for correct frame length.*/
     if ((len >= CHB_MIN_FRAME_LENGTH) && (len <= CHB_MAX_FRAME_LENGTH))
     {
         // check to see if there is room to write the frame in the buffer. if not, then drop it
-        if (len < (CHB_BUF_SZ - chb_buf_get_len()))
+        if ((len + CHB_RX_TS_LEN + CHB_RX_LINK_LEN) < (CHB_BUF_SZ - chb_buf_get_len()))
         {
+            // pull the frame and the lqi byte following it out in one dma block and then copy the frame into the ring buffer
+            SPID_write_block(NULL, frame, len + 1);
+
             chb_buf_write(len);
-            
             for (i=0; i<len; i++)
             {
-                data = SPID_write(0);
-                chb_buf_write(data);
+                chb_buf_write(frame[i]);
             }
+
+#if (CHB_TIMESTAMP)
+            // store the timestamp right after the frame so chb_read can pair them up
+            chb_buf_write(chb_rx_ts_valid);
+            for (i=0; i<sizeof(U32); i++)
+            {
+                chb_buf_write(((U8 *)&chb_rx_ts)[i]);
+            }
+#endif
+#if (CHB_LINK_STATS)
+            chb_buf_write(chb_get_pcb()->ed);
+            chb_buf_write(frame[len]);
+#endif
 			//generate message received event here
 			//EVSYS.STROBE = 0x04;  //generate event on channel 3
 			//generate interrupt on port E by toggling pin 2
@@ -309,11 +382,8 @@ static void chb_frame_read()
             pcb_t *pcb = chb_get_pcb();
             //char buf[50];
 
-            // read out the data and throw it away
-            for (i=0; i<len; i++)
-            {
-                data = SPID_write(0);
-            }
+            // no need to read out the data. raising the chip select below ends the frame
+            // buffer access and the rest of the frame gets thrown away.
 
             // Increment the overflow stat
             pcb->overflow++;
@@ -325,7 +395,6 @@ static void chb_frame_read()
     }
 
     RadioCS(FALSE);
-    CHB_LEAVE_CRIT();
 }
 
 /**************************************************************************/
@@ -410,6 +479,98 @@ void chb_set_mode(U8 mode)
         chb_reg_read_mod_write(TRX_CTRL_2, 0x00, 0x3f);                 // 802.15.4-2006, BPSK, 40 kbps
         chb_reg_read_mod_write(RF_CTRL_0, CHB_BPSK_TX_OFFSET, 0x3);     // this is according to table 7-16 in at86rf212 datasheet
         break;
+    case OQPSK_868MHZ_200KBPS:
+        chb_reg_read_mod_write(TRX_CTRL_2, 0x09, 0x3f);                 // O-QPSK 100 kchip/s, high data rate 200 kbps (868 MHz)
+        chb_reg_read_mod_write(RF_CTRL_0, CHB_OQPSK_TX_OFFSET, 0x3);
+        break;
+    case OQPSK_868MHZ_400KBPS:
+        chb_reg_read_mod_write(TRX_CTRL_2, 0x0a, 0x3f);                 // O-QPSK 100 kchip/s, high data rate 400 kbps (868 MHz)
+        chb_reg_read_mod_write(RF_CTRL_0, CHB_OQPSK_TX_OFFSET, 0x3);
+        break;
+    case OQPSK_915MHZ_500KBPS:
+        // O-QPSK 1000 kchip/s, high data rate 500 kbps (915 MHz), scrambler on for the 1000 kchip/s high data rate modes
+        chb_reg_read_mod_write(TRX_CTRL_2, 0x0d | (1 << CHB_OQPSK_SCRAM_EN_POS), 0x3f);
+        chb_reg_read_mod_write(RF_CTRL_0, CHB_OQPSK_TX_OFFSET, 0x3);
+        break;
+    case OQPSK_915MHZ_1000KBPS:
+        // O-QPSK 1000 kchip/s, high data rate 1000 kbps (915 MHz)
+        chb_reg_read_mod_write(TRX_CTRL_2, 0x0e | (1 << CHB_OQPSK_SCRAM_EN_POS), 0x3f);
+        chb_reg_read_mod_write(RF_CTRL_0, CHB_OQPSK_TX_OFFSET, 0x3);
+        break;
+    default:
+        return;
+    }
+    chb_mode = mode;
+}
+
+/**************************************************************************/
+/*!
+    Switch the mode while the radio is running. The modulation can only be
+    changed when the transceiver is off so go to TRX_OFF first and then
+    back to the receive state.
+*/
+/**************************************************************************/
+void chb_change_mode(U8 mode)
+{
+    if (mode == chb_mode)
+    {
+        return;
+    }
+
+    chb_set_state(CHB_TRX_OFF);
+    chb_set_mode(mode);
+    chb_set_state(RX_STATE);
+}
+
+/**************************************************************************/
+/*!
+
+*/
+/**************************************************************************/
+U8 chb_get_mode()
+{
+    return chb_mode;
+}
+
+/**************************************************************************/
+/*!
+    Return the PSDU data rate of the current mode in kbps. The preamble and
+    SFD of the high data rate modes still go out at the base rate so use this
+    for rough airtime estimates only.
+*/
+/**************************************************************************/
+U16 chb_get_bitrate()
+{
+    switch (chb_mode)
+    {
+    case OQPSK_868MHZ:          return 100;
+    case BPSK40_915MHZ:         return 40;
+    case OQPSK_868MHZ_200KBPS:  return 200;
+    case OQPSK_868MHZ_400KBPS:  return 400;
+    case OQPSK_915MHZ_500KBPS:  return 500;
+    case OQPSK_915MHZ_1000KBPS: return 1000;
+    default:                    return 250;
+    }
+}
+
+/**************************************************************************/
+/*!
+    Decide if a link with the given ed level can support the mode. The base
+    rate modes are always allowed so there is always something to fall back to.
+*/
+/**************************************************************************/
+U8 chb_check_link(U8 mode, U8 ed)
+{
+    switch (mode)
+    {
+    case OQPSK_868MHZ_200KBPS:
+    case OQPSK_915MHZ_500KBPS:
+        return (ed >= CHB_ED_THRES_HDR_LOW);
+    case OQPSK_868MHZ_400KBPS:
+    case OQPSK_915MHZ_1000KBPS:
+        return (ed >= CHB_ED_THRES_HDR_HIGH);
+    default:
+        return TRUE;
     }
 }
 
@@ -474,14 +635,72 @@ U8 chb_set_channel(U8 channel)
 
     // add a delay to allow the PLL to lock if in active mode.
     state = chb_get_state();
-    if ((state == CHB_RX_ON) || (state == CHB_PLL_ON))
+    if ((state == CHB_RX_ON) || (state == CHB_PLL_ON) || (state == CHB_RX_AACK_ON))
     {
-        _delay_us(TIME_PLL_LOCK_TIME);
+        Hal_Delay_Us(TIME_PLL_LOCK_TIME);
     }
 
     return ((chb_reg_read(PHY_CC_CCA) & 0x1f) == channel) ? RADIO_SUCCESS : RADIO_TIMED_OUT;
 }
 
+/**************************************************************************/
+/*!
+    Get the current channel
+*/
+/**************************************************************************/
+U8 chb_get_channel()
+{
+    return chb_reg_read(PHY_CC_CCA) & 0x1f;
+}
+
+/**************************************************************************/
+/*!
+    Manual energy detection. Writing PHY_ED_LEVEL starts a measurement over
+    8 symbols and the result is read back from the same register. Frames
+    received in the meantime leave their own ed level there, which counts
+    as energy on the channel just the same.
+*/
+/**************************************************************************/
+U8 chb_ed_measure()
+{
+    chb_reg_write(PHY_ED_LEVEL, 0);
+    Hal_Delay_Us(TIME_ED_MEASUREMENT);
+    return chb_reg_read(PHY_ED_LEVEL);
+}
+
+/**************************************************************************/
+/*!
+    Channel survey. Hop through the channels of the band and take samples ed
+    measurements about a ms apart on each so bursty interferers show up too.
+    The radio goes back to its channel afterwards. Frames sent to this node
+    while it is away are lost, so keep it short.
+*/
+/**************************************************************************/
+void chb_channel_survey(U8 *ed_avg, U8 *ed_max, U8 samples)
+{
+    U8 i, ch, ed, prev = chb_get_channel();
+    U16 sum;
+
+    for (ch=CHB_MIN_CHANNEL; ch<=CHB_MAX_CHANNEL; ch++)
+    {
+        chb_set_channel(ch);
+        sum = 0;
+        ed_max[ch] = 0;
+        for (i=0; i<samples; i++)
+        {
+            ed = chb_ed_measure();
+            sum += ed;
+            if (ed > ed_max[ch])
+            {
+                ed_max[ch] = ed;
+            }
+            Hal_Delay_Us(1000 - TIME_ED_MEASUREMENT);
+        }
+        ed_avg[ch] = samples ? sum/samples : 0;
+    }
+    chb_set_channel(prev);
+}
+
 /**************************************************************************/
 /*!
     Set the power level
@@ -489,9 +708,44 @@ U8 chb_set_channel(U8 channel)
 /**************************************************************************/
 void chb_set_pwr(U8 val)
 {
+    chb_pwr = val;
+    chb_pwr_reg = val;
     chb_reg_write(PHY_TX_PWR, val);
 }
 
+/**************************************************************************/
+/*!
+    Get the power level set with chb_set_pwr
+*/
+/**************************************************************************/
+U8 chb_get_pwr()
+{
+    return chb_pwr;
+}
+
+/**************************************************************************/
+/*!
+    Transmit atten steps below the power level set with chb_set_pwr by
+    raising the TX_PWR field (~1 dB per step). The register is only written
+    when the level changes.
+*/
+/**************************************************************************/
+void chb_set_pwr_atten(U8 atten)
+{
+    U8 pwr, field = (chb_pwr & CHB_TX_PWR_MASK) + atten;
+
+    if (field > CHB_TX_PWR_MASK)
+    {
+        field = CHB_TX_PWR_MASK;
+    }
+    pwr = (chb_pwr & ~CHB_TX_PWR_MASK) | field;
+    if (pwr != chb_pwr_reg)
+    {
+        chb_reg_write(PHY_TX_PWR, pwr);
+        chb_pwr_reg = pwr;
+    }
+}
+
 /**************************************************************************/
 /*!
     Set the TX/RX state machine state. Some manual manipulation is required 
@@ -504,7 +758,7 @@ U8 chb_set_state(U8 state)
     U8 curr_state;
 
     // if we're sleeping then don't allow transition
-    if (CHB_SLPTR_PORT & _BV(CHB_SLPTR_PIN))
+    if (Hal_Gpio_Get_Out(CHB_SLPTR_PORT) & _BV(CHB_SLPTR_PIN))
     {
         return RADIO_WRONG_STATE;
     }
@@ -525,7 +779,7 @@ U8 chb_set_state(U8 state)
         /* Go to TRX_OFF from any state. */
         CHB_SLPTR_DISABLE();
         chb_reg_read_mod_write(TRX_STATE, CMD_FORCE_TRX_OFF, 0x1f);
-        _delay_us(TIME_ALL_STATES_TRX_OFF);
+        Hal_Delay_Us(TIME_ALL_STATES_TRX_OFF);
         break;
 
     case CHB_TX_ARET_ON:
@@ -533,7 +787,7 @@ U8 chb_set_state(U8 state)
         {
             /* First do intermediate state transition to PLL_ON, then to TX_ARET_ON. */
             chb_reg_read_mod_write(TRX_STATE, CMD_PLL_ON, 0x1f);
-            _delay_us(TIME_RX_ON_PLL_ON);
+            Hal_Delay_Us(TIME_RX_ON_PLL_ON);
         }
         break;
 
@@ -542,7 +796,7 @@ U8 chb_set_state(U8 state)
         {
             /* First do intermediate state transition to RX_ON, then to RX_AACK_ON. */
             chb_reg_read_mod_write(TRX_STATE, CMD_PLL_ON, 0x1f);
-            _delay_us(TIME_RX_ON_PLL_ON);
+            Hal_Delay_Us(TIME_RX_ON_PLL_ON);
         }
         break;
     }
@@ -553,12 +807,13 @@ U8 chb_set_state(U8 state)
     /* When the PLL is active most states can be reached in 1us. However, from */
     /* TRX_OFF the PLL needs time to activate. */
 	if(curr_state == CHB_TRX_OFF){
-		_delay_us(TIME_TRX_OFF_PLL_ON);	
+		Hal_Delay_Us(TIME_TRX_OFF_PLL_ON);	
 	}
 	else{
-		_delay_us(TIME_RX_ON_PLL_ON);
+		Hal_Delay_Us(TIME_RX_ON_PLL_ON);
 	}				
 
+    Energy_Set(ENERGY_RADIO, (state == CHB_TRX_OFF) ? ENERGY_RADIO_IDLE : ENERGY_RADIO_RX);
     if (chb_get_state() == state)
     {
         return RADIO_SUCCESS;
@@ -573,7 +828,7 @@ U8 chb_set_state(U8 state)
 /**************************************************************************/
 void chb_set_ieee_addr(U8 *addr)
 {
-    chb_eeprom_write(CHB_EEPROM_IEEE_ADDR, addr, 8); 
+    chb_eeprom_update(CHB_EEPROM_IEEE_ADDR, addr, 8); 
     chb_reg_write64(IEEE_ADDR_0, addr); 
 }
 
@@ -597,17 +852,23 @@ void chb_set_short_addr(U16 addr)
     U8 *addr_ptr = (U8 *)&addr;
     pcb_t *pcb = chb_get_pcb();
 
-    chb_eeprom_write(CHB_EEPROM_SHORT_ADDR, addr_ptr, 2);
+    chb_eeprom_update(CHB_EEPROM_SHORT_ADDR, addr_ptr, 2);
     chb_reg_write16(SHORT_ADDR_0, addr);
     pcb->src_addr = addr;
+
+#if (CHB_HDR_COMPRESS)
+    // the coordinator has to accept frames that don't have a dest addr
+    chb_reg_read_mod_write(CSMA_SEED_1, (addr == CHB_COORD_ADDR) << CHB_I_AM_COORD_POS, 1 << CHB_I_AM_COORD_POS);
+#endif
 }
 
 /**************************************************************************/
 /*!
-
+    Read the short address saved in the eeprom. chb_init keeps it in the
+    pcb so chb_get_short_addr doesn't have to go to the eeprom every time.
 */
 /**************************************************************************/
-U16 chb_get_short_addr()
+U16 chb_load_short_addr()
 {
     U8 addr[2];
 
@@ -615,6 +876,16 @@ U16 chb_get_short_addr()
     return *(U16 *)addr;
 }
 
+/**************************************************************************/
+/*!
+
+*/
+/**************************************************************************/
+U16 chb_get_short_addr()
+{
+    return chb_get_pcb()->src_addr;
+}
+
 /**************************************************************************/
 /*!
     Set the high gain mode pin for the CC1190
@@ -625,11 +896,11 @@ void chb_set_hgm(U8 enb)
 {
     if (enb)
     {
-        CHB_CC1190_HGM_PORT |= 1<<CHB_CC1190_HGM_PIN;
+        Hal_Gpio_Set(CHB_CC1190_HGM_PORT, 1<<CHB_CC1190_HGM_PIN);
     }
     else
     {
-        CHB_CC1190_HGM_PORT &= ~(1<<CHB_CC1190_HGM_PIN);
+        Hal_Gpio_Clr(CHB_CC1190_HGM_PORT, 1<<CHB_CC1190_HGM_PIN);
     }
 }
 #endif
@@ -640,7 +911,7 @@ void chb_set_hgm(U8 enb)
     and return the status of the transmission attempt.
 */
 /**************************************************************************/
-U8 chb_tx(U8 *hdr, U8 *data, U8 len)
+U8 chb_tx(U8 *hdr, U8 hdr_len, U8 *data, U8 len)
 {
     U8 state = chb_get_state();
     pcb_t *pcb = chb_get_pcb();
@@ -657,16 +928,21 @@ U8 chb_tx(U8 *hdr, U8 *data, U8 len)
     // TODO: try and start the frame transmission by writing TX_START command instead of toggling
     // sleep pin...i just feel like it's kind of weird...
 
-    // write frame to buffer. first write header into buffer (add 1 for len byte), then data. 
-    chb_frame_write(hdr, CHB_HDR_SZ + 1, data, len);
+    // write frame to buffer. first write header into buffer (hdr_len includes the len byte), then data. 
+    chb_frame_write(hdr, hdr_len, data, len);
 
     //Do frame transmission. 
 	pcb->tx_end = false;
+    Energy_Set(ENERGY_RADIO, ENERGY_RADIO_TX);
     chb_reg_read_mod_write(TRX_STATE, CMD_TX_START, 0x1F);
 
-    // wait for the transmission to end, signaled by the TRX END flag
-    while (!pcb->tx_end);
+    // wait for the transmission to end, signaled by the TRX END flag. sleep in the meantime
+    while (!pcb->tx_end)
+    {
+        Event_Wait(EVENT_RADIO_TX);
+    }
     pcb->tx_end = false;
+    Energy_Set(ENERGY_RADIO, ENERGY_RADIO_RX);
 
     // check the status of the transmission
     return chb_get_status();
@@ -685,21 +961,63 @@ void chb_sleep(U8 enb)
         chb_set_state(CHB_TRX_OFF);
 
         // set the SLPTR pin
-        CHB_SLPTR_PORT |= _BV(CHB_SLPTR_PIN);
+        CHB_SLPTR_ENABLE();
+        Energy_Set(ENERGY_RADIO, ENERGY_RADIO_SLEEP);
+        // nothing to timestamp or interrupt until it wakes up, so the core can stop its clock
+        Clock_Release_Running(CLOCK_HOLD_RADIO);
     }
     else
     {
+        Clock_Hold_Running(CLOCK_HOLD_RADIO);
+
         // make sure the SLPTR pin is low first
-        CHB_SLPTR_PORT &= ~(_BV(CHB_SLPTR_PIN));
+        CHB_SLPTR_DISABLE();
 
         // we need to allow some time for the PLL to lock
-        _delay_us(TIME_SLEEP_TO_TRX_OFF);
+        Hal_Delay_Us(TIME_SLEEP_TO_TRX_OFF);
 
         // Turn the transceiver back on
         chb_set_state(RX_STATE);
     }
 }
 
+/**************************************************************************/
+/*!
+    Returns true if the radio is in the middle of receiving a frame so it
+    doesn't get put to sleep mid frame.
+*/
+/**************************************************************************/
+U8 chb_rx_busy()
+{
+    U8 state = chb_get_state();
+    return (state == CHB_BUSY_RX) || (state == CHB_BUSY_RX_AACK);
+}
+
+#if (CHB_SNIFFER)
+/**************************************************************************/
+/*!
+    Switch the sniffer on or off. The radio goes through TRX_OFF since there
+    is no direct transition between RX_AACK_ON and RX_ON.
+*/
+/**************************************************************************/
+void chb_set_sniffer(U8 on)
+{
+    chb_set_state(CHB_TRX_OFF);
+    chb_sniff = on;
+    chb_set_state(RX_STATE);
+}
+
+/**************************************************************************/
+/*!
+
+*/
+/**************************************************************************/
+U8 chb_get_sniffer()
+{
+    return chb_sniff;
+}
+#endif
+
 /**************************************************************************/
 /*!
 
@@ -758,6 +1076,9 @@ static void chb_radio_init()
     // set short addr
     // NOTE: Possibly get this from EEPROM
     chb_reg_write16(SHORT_ADDR_0, chb_get_short_addr());
+#if (CHB_HDR_COMPRESS)
+    chb_reg_read_mod_write(CSMA_SEED_1, (chb_get_short_addr() == CHB_COORD_ADDR) << CHB_I_AM_COORD_POS, 1 << CHB_I_AM_COORD_POS);
+#endif
 
     // set long addr
     // NOTE: Possibly get this from EEPROM
@@ -766,8 +1087,8 @@ static void chb_radio_init()
 
 #if (CHB_CC1190_PRESENT)
     // set high gain mode pin to output and init to zero
-    CHB_CC1190_HGM_DDIR |= 1<<CHB_CC1190_HGM_PIN;
-    CHB_CC1190_HGM_PORT &= ~(1<<CHB_CC1190_HGM_PIN);
+    Hal_Gpio_Output(CHB_CC1190_HGM_PORT, 1<<CHB_CC1190_HGM_PIN);
+    Hal_Gpio_Clr(CHB_CC1190_HGM_PORT, 1<<CHB_CC1190_HGM_PIN);
 
     // set external power amp on AT86RF212
     chb_reg_read_mod_write(TRX_CTRL_1, 1<<CHB_PA_EXT_EN_POS, 1<<CHB_PA_EXT_EN_POS);
@@ -778,7 +1099,7 @@ static void chb_radio_init()
 
     // enable mcu intp pin
     CFG_CHB_INTP_RISE_EDGE();
-	PMIC.CTRL |= 0x07;	//enable interrupts on MCU
+	Hal_Irq_Levels_On(PMIC_HILVLEN_bm | PMIC_MEDLVLEN_bm | PMIC_LOLVLEN_bm);	//enable interrupts on MCU
 
     if (chb_get_state() != RX_STATE)
     {
@@ -804,8 +1125,8 @@ void chb_drvr_init()
 	//SPIDInit(SPI_MODE0_bm);
 	//RadioCS(FALSE);
     // configure IOs
-    CHB_SLPTR_DDIR |= (_BV(CHB_SLPTR_PIN));
-    CHB_RST_DDIR |= (_BV(CHB_RST_PIN));
+    Hal_Gpio_Output(CHB_SLPTR_PORT, _BV(CHB_SLPTR_PIN));
+    Hal_Gpio_Output(CHB_RST_PORT, _BV(CHB_RST_PIN));
 
     // config radio
     chb_radio_init();
@@ -821,10 +1142,22 @@ ISR(CHB_RADIO_IRQ)
     U8 state, intp_src = 0;
 	//U8 dummy;
     pcb_t *pcb = chb_get_pcb();
+#if (CHB_TIMESTAMP)
+    U32 ts;
+    U8 ts_valid;
+#endif
 
-    CHB_ENTER_CRIT();
+    // no critical section around the whole isr: the interrupts that can come in on top of it
+    // (see CHB_IRQ_LVL) don't use spi d. the register and frame accesses below each lock just
+    // their command bytes.
+#if (CHB_TIMESTAMP)
+    // get the captured time of the IRQ edge. this has to happen before the irq status is read since
+    // reading it lets the IRQ line drop and the next interrupt would capture a new edge.
+    ts = TimeSynch_Radio_Capture();
+#endif
 
     /*Read Interrupt source.*/
+    CHB_ENTER_CRIT();
     RadioCS(TRUE);   
 
     /*Send Register address and read register content.*/
@@ -833,6 +1166,13 @@ ISR(CHB_RADIO_IRQ)
     intp_src = SPID_write(0);
 
     RadioCS(FALSE);
+    CHB_LEAVE_CRIT();
+
+#if (CHB_TIMESTAMP)
+    // if rx start and trx end are pending together, there was only one edge and the capture belongs
+    // to rx start. the end of the frame can't be stamped then.
+    ts_valid = !(intp_src & CHB_IRQ_RX_START_MASK);
+#endif
 
     while (intp_src)
     {
@@ -852,20 +1192,45 @@ ISR(CHB_RADIO_IRQ)
                 // get the crc
                 pcb->crc = (chb_reg_read(PHY_RSSI) & (1<<7)) ? 1 : 0;
 
+#if (CHB_SNIFFER)
+                // the sniffer takes every frame, good crc or not
+                if (chb_sniff){
+#if (CHB_TIMESTAMP)
+                    chb_rx_ts = ts;
+                    chb_rx_ts_valid = ts_valid;
+#endif
+                    chb_sniff_frame_read(pcb->ed, pcb->crc);
+                    pcb->rcvd_xfers++;
+                }
+                else
+#endif
                 // if the crc is not valid, then do not read the frame and set the rx flag
                 if (pcb->crc){
+#if (CHB_TIMESTAMP)
+                    chb_rx_ts = ts;
+                    chb_rx_ts_valid = ts_valid;
+#endif
                     // get the data
                     chb_frame_read();
                     pcb->rcvd_xfers++;
                     pcb->data_rcv = true;
+                    Event_Post(EVENT_RADIO_RX);
 					/*
 					StartOfFreeSpace += chb_read(FRAMReadBuffer+StartOfFreeSpace);	//read the data into the FRAM buffer right away --vlad
 					if(StartOfFreeSpace+128 >= FR_READ_BUFFER_SIZE) StartOfFreeSpace = 0;	//wrap around to the start of the buffer (making circular buffer). This should be avoided as data in the buffer will be overwritten (i.e. lost).
 					*/			
                 }
             }
+#if (CHB_TIMESTAMP)
+            else{
+                // end of our own transmission
+                pcb->tx_ts = ts;
+                pcb->tx_ts_valid = ts_valid;
+            }
+#endif
             //else{
                 pcb->tx_end = true;
+                Event_Post(EVENT_RADIO_TX);
             //}
             intp_src &= ~CHB_IRQ_TRX_END_MASK;
 			//go to receive state
@@ -895,13 +1260,12 @@ ISR(CHB_RADIO_IRQ)
         {
         }
     }
-    CHB_LEAVE_CRIT();
 }
 
 //select radio SPI on port D with cs
 void RadioCS(uint8_t status){
-	if (status) PORTD.OUTCLR = PIN4_bm;
+	if (status) Hal_Gpio_Clr(CHB_SPI_PORT, PIN4_bm);
 	else {
-		PORTD.OUTSET = PIN4_bm;
+		Hal_Gpio_Set(CHB_SPI_PORT, PIN4_bm);
 	}
 }
\ No newline at end of file
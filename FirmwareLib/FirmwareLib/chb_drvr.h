@@ -38,6 +38,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "types.h"
+#include "Hal.h"
 
 
 #define TRUE 1
@@ -68,37 +69,40 @@
 
 // if CC1190 present, set up the ports and pins for high gain mode control
 #if (CHB_CC1190_PRESENT)
-    #define CHB_CC1190_HGM_PORT     PORTA_OUT
-    #define CHB_CC1190_HGM_DDIR     PORTA_DIR
+    #define CHB_CC1190_HGM_PORT     HAL_PORTA
     #define CHB_CC1190_HGM_PIN      4
 #endif
 
-#define CHB_RST_PORT     PORTD_OUT
+#define CHB_RST_PORT     HAL_PORTD
 #define CHB_RST_PIN      0           
-#define CHB_SLPTR_PORT   PORTD_OUT
+#define CHB_SLPTR_PORT   HAL_PORTD
 #define CHB_SLPTR_PIN    1
-#define CHB_SLPTR_DDIR   PORTD_DIR
-#define CHB_RST_DDIR     PORTD_DIR
 #define CHB_RADIO_IRQ   PORTD_INT0_vect
-#define CHB_PINCTRL     PORTD_PIN2CTRL
-#define CHB_INTCTRL     PORTD_INTCTRL
-#define CHB_INTMASK     PORTD_INT0MASK
+#define CHB_IRQ_PORT    HAL_PORTD
 #define CHB_IRQ_PIN     2
+// the radio isr runs at the low level so the adc drdy, usart and sampling timer
+// interrupts can come in on top of it while it reads a frame out
+#define CHB_IRQ_LVL     PORT_INT0LVL_LO_gc
 
 // enable rising edge interrupt on IRQ PIN
 #define CFG_CHB_INTP_RISE_EDGE() do {       \
-    CHB_PINCTRL |= PORT_ISC_RISING_gc;      \
-    CHB_INTCTRL |=  PORT_INT0LVL_HI_gc;    \
-    CHB_INTMASK |= (1<<CHB_IRQ_PIN);}       \
+    Hal_Gpio_Pin_Ctrl(CHB_IRQ_PORT, CHB_IRQ_PIN, Hal_Gpio_Get_Pin_Ctrl(CHB_IRQ_PORT, CHB_IRQ_PIN) | PORT_ISC_RISING_gc); \
+    Hal_Gpio_Int_Ctrl(CHB_IRQ_PORT, Hal_Gpio_Get_Int_Ctrl(CHB_IRQ_PORT) | CHB_IRQ_LVL);    \
+    Hal_Gpio_Int0_Mask(CHB_IRQ_PORT, Hal_Gpio_Get_Int0_Mask(CHB_IRQ_PORT) | (1<<CHB_IRQ_PIN));}    \
     while(0)
 
+// turn the radio interrupt level off/on without touching the pin mask so that an
+// edge on the IRQ pin still sets the flag and gets serviced once re-enabled
+#define CHB_IRQ_DISABLE()   do {Hal_Gpio_Int_Ctrl(CHB_IRQ_PORT, Hal_Gpio_Get_Int_Ctrl(CHB_IRQ_PORT) & ~PORT_INT0LVL_gm);} while (0)
+#define CHB_IRQ_ENABLE()    do {Hal_Gpio_Int_Ctrl(CHB_IRQ_PORT, Hal_Gpio_Get_Int_Ctrl(CHB_IRQ_PORT) | CHB_IRQ_LVL);} while (0)
+
 U8 volatile saved_sreg;
-#define CHB_ENTER_CRIT()    {saved_sreg = SREG; cli();}
-#define CHB_LEAVE_CRIT()    {SREG = saved_sreg; sei();}
-#define CHB_RST_ENABLE()    do {CHB_RST_PORT &= ~(_BV(CHB_RST_PIN));} while (0)
-#define CHB_RST_DISABLE()   do {CHB_RST_PORT |= (_BV(CHB_RST_PIN));} while (0)
-#define CHB_SLPTR_ENABLE()  do {CHB_SLPTR_PORT |= (_BV(CHB_SLPTR_PIN));} while (0)
-#define CHB_SLPTR_DISABLE() do {CHB_SLPTR_PORT &= ~(_BV(CHB_SLPTR_PIN));} while (0)
+#define CHB_ENTER_CRIT()    {saved_sreg = Hal_Irq_Save();}
+#define CHB_LEAVE_CRIT()    {Hal_Irq_Restore(saved_sreg); Hal_Irq_On();}
+#define CHB_RST_ENABLE()    Hal_Gpio_Clr(CHB_RST_PORT, _BV(CHB_RST_PIN))
+#define CHB_RST_DISABLE()   Hal_Gpio_Set(CHB_RST_PORT, _BV(CHB_RST_PIN))
+#define CHB_SLPTR_ENABLE()  Hal_Gpio_Set(CHB_SLPTR_PORT, _BV(CHB_SLPTR_PIN))
+#define CHB_SLPTR_DISABLE() Hal_Gpio_Clr(CHB_SLPTR_PORT, _BV(CHB_SLPTR_PIN))
 
 // CCA constants
 enum
@@ -185,12 +189,14 @@ enum
     CHB_MAX_FRAME_RETRIES_POS   = 4,
     CHB_MAX_CSMA_RETIRES_POS    = 1,
     CHB_CSMA_SEED1_POS          = 0,
+    CHB_I_AM_COORD_POS          = 3,
     CHB_CCA_MODE_POS            = 5,
     CHB_AUTO_CRC_POS            = 5,
     CHB_TRX_END_POS             = 3,
     CHB_TRAC_STATUS_POS         = 5,
     CHB_FVN_POS                 = 6,
     CHB_OQPSK_TX_OFFSET         = 2,
+    CHB_OQPSK_SCRAM_EN_POS      = 5,
     CHB_BPSK_TX_OFFSET          = 3,
     CHB_MIN_FRAME_LENGTH        = 3,
     CHB_MAX_FRAME_LENGTH        = 0x7f,
@@ -209,6 +215,7 @@ enum{
     TIME_PLL_ON_RX_ON           = 1,
     TIME_RX_ON_PLL_ON           = 1,
     TIME_PLL_LOCK_TIME          = 110,
+    TIME_ED_MEASUREMENT         = 400,  // 8 symbols in the slowest mode (BPSK 20 kbps)
     TIME_BUSY_TX_PLL_ON         = 32,
     TIME_ALL_STATES_TRX_OFF     = 1,
     TIME_RESET_TRX_OFF          = 26,
@@ -294,14 +301,35 @@ enum
 }; 
 
 // transceiver modes
+// the high data rate O-QPSK modes are Atmel proprietary (not part of 802.15.4) so both ends of the
+// link have to be switched to the same mode. chb_change_mode() should be used to switch at runtime.
+enum
+{
+    OQPSK_868MHZ            = 0,
+    OQPSK_915MHZ            = 1,
+    OQPSK_780MHZ            = 2,
+    BPSK40_915MHZ           = 3,
+    OQPSK_868MHZ_200KBPS    = 4,
+    OQPSK_868MHZ_400KBPS    = 5,
+    OQPSK_915MHZ_500KBPS    = 6,
+    OQPSK_915MHZ_1000KBPS   = 7
+};
+
+// min ED level (PHY_ED_LEVEL, ~1 dB per step) of received frames needed before switching to a
+// high data rate mode. the higher rates have less sensitivity so they need a stronger link.
 enum
 {
-    OQPSK_868MHZ    = 0,
-    OQPSK_915MHZ    = 1,
-    OQPSK_780MHZ    = 2,
-    BPSK40_915MHZ   = 3
+    CHB_ED_THRES_HDR_LOW    = 30,       // 200/500 kbps modes
+    CHB_ED_THRES_HDR_HIGH   = 40        // 400/1000 kbps modes
 };
 
+// channels of the 915 MHz band (channel page 2)
+#define CHB_MIN_CHANNEL 1
+#define CHB_MAX_CHANNEL 10
+
+// TX_PWR field of the PHY_TX_PWR register. bigger values are less power, ~1 dB per step
+#define CHB_TX_PWR_MASK 0x1F
+
 #if (CHB_BPSK == 1)
     #define CHB_INIT_MODE BPSK40_915MHZ
 #else
@@ -311,6 +339,9 @@ enum
 // define receive state based on promiscuous mode setting
 #if (CHB_PROMISCUOUS)
     #define RX_STATE CHB_RX_ON
+#elif (CHB_SNIFFER)
+    // the sniffer listens without acking anything
+    #define RX_STATE (chb_get_sniffer() ? CHB_RX_ON : CHB_RX_AACK_ON)
 #else
     #define RX_STATE CHB_RX_AACK_ON
 #endif
@@ -339,10 +370,26 @@ void chb_frame_write(U8 *hdr, U8 hdr_len, U8 *data, U8 data_len);
 // general configuration
 //set transceiver mode (possible modes defined above).
 void chb_set_mode(U8 mode);
+//switch the transceiver mode while the radio is running. The radio is turned off while switching and put back into receive mode.
+void chb_change_mode(U8 mode);
+//get the current transceiver mode
+U8 chb_get_mode();
+//get the data rate of the current mode in kbps
+U16 chb_get_bitrate();
+//check if the link quality (ed level of a received frame) is good enough to use the given mode. Returns TRUE if it is.
+U8 chb_check_link(U8 mode, U8 ed);
 //set channel that radio will use (0-10 available for U.S.).
 U8 chb_set_channel(U8 channel);
+U8 chb_get_channel();
+//measure the energy on the current channel (ed level, ~1 dB steps). the radio has to be listening
+U8 chb_ed_measure();
+//measure the energy on every channel samples times. ed_avg and ed_max get the average and max for each channel, indexed by channel (CHB_MAX_CHANNEL + 1 entries)
+void chb_channel_survey(U8 *ed_avg, U8 *ed_max, U8 samples);
 //set transmitter power (0 to 13).
 void chb_set_pwr(U8 val);
+U8 chb_get_pwr();
+//transmit this many steps (~1 dB) below the level set with chb_set_pwr. used by the link power adaptation
+void chb_set_pwr_atten(U8 atten);
 //set ieee address of mote
 void chb_set_ieee_addr(U8 *addr);
 void chb_get_ieee_addr(U8 *addr);
@@ -350,13 +397,21 @@ void chb_get_ieee_addr(U8 *addr);
 void chb_set_short_addr(U16 addr);
 //get the short address of the mote
 U16 chb_get_short_addr();
+U16 chb_load_short_addr();
 //set transceiver state (states defined above)
 U8 chb_set_state(U8 state);
 //put the radio into sleep mode or take it out of sleep
 void chb_sleep(U8 enb);
+//returns true while the radio is receiving a frame
+U8 chb_rx_busy();
+#if (CHB_SNIFFER)
+//switch sniffing on or off. while on, received frames go to Sniffer_Capture and nothing gets acked
+void chb_set_sniffer(U8 on);
+U8 chb_get_sniffer();
+#endif
 
 // data transmit
-U8 chb_tx(U8 *hdr, U8 *data, U8 len);
+U8 chb_tx(U8 *hdr, U8 hdr_len, U8 *data, U8 len);
 
 #if (CHB_CC1190_PRESENT)
     void chb_set_hgm(U8 enb);
@@ -45,70 +45,35 @@
 
 */
 /**************************************************************************/
-static void chb_eep_write_byte( U16 addr, U8 value )
+void chb_eeprom_write(U16 addr, U8 *buf, U16 size)
 {
-    // flush the eeprom buffers
-    /* Wait until NVM is not busy. */
-    while ((NVM.STATUS & NVM_NVMBUSY_bm) == NVM_NVMBUSY_bm);
+    // disable memory mapping
+    Hal_Eeprom_Unmap();
 
-    /* Flush EEPROM page buffer if necessary. */
-    if ((NVM.STATUS & NVM_EELOAD_bm) != 0) {
-        NVM.CMD = NVM_CMD_ERASE_EEPROM_BUFFER_gc;
-        NVM_EXEC();
+    // Write bytes
+    for(U16 i=0; i<size; i++)
+    {
+        Hal_Eeprom_Write(addr+i, buf[i]);
     }
-
-    // tell the non-volatile regs that we're going to load the eeprom addr
-    NVM.CMD = NVM_CMD_LOAD_EEPROM_BUFFER_gc;
-
-    // load the address
-    NVM.ADDR0 = addr & 0xFF;
-    NVM.ADDR1 = (addr >> 8) & 0x1F;
-    NVM.ADDR2 = 0x00;
-
-    // load the data to write
-    NVM.DATA0 = value;
-
-    // execute the eeprom write command
-    NVM.CMD = NVM_CMD_ERASE_WRITE_EEPROM_PAGE_gc;
-    NVM_EXEC();
-}
-
-/**************************************************************************/
-/*!
-
-*/
-/**************************************************************************/
-static U8 chb_eep_read_byte(U16 addr)
-{
-    /* Wait until NVM is not busy. */
-    while ((NVM.STATUS & NVM_NVMBUSY_bm) == NVM_NVMBUSY_bm);
-
-    /* Set address to read from. */
-    NVM.ADDR0 = addr & 0xFF;
-    NVM.ADDR1 = (addr >> 8) & 0x1F;
-    NVM.ADDR2 = 0x00;
-
-    /* Issue EEPROM Read command. */
-    NVM.CMD = NVM_CMD_READ_EEPROM_gc;
-    NVM_EXEC();
-
-    return NVM.DATA0;
 }
 
 /**************************************************************************/
 /*!
-
+    Write only the bytes that differ from what is already in the eeprom.
+    Saves the erase/write time and wear of rewriting the same settings.
 */
 /**************************************************************************/
-void chb_eeprom_write(U16 addr, U8 *buf, U16 size)
+void chb_eeprom_update(U16 addr, U8 *buf, U16 size)
 {
     // disable memory mapping
-    NVM.CTRLB &= ~NVM_EEMAPEN_bm;
+    Hal_Eeprom_Unmap();
 
-    // Write bytes
-    for(U8 i=0; i<size; i++)
+    for(U16 i=0; i<size; i++)
     {
-        chb_eep_write_byte(addr+i, buf[i]);
+        if (Hal_Eeprom_Read(addr+i) != buf[i])
+        {
+            Hal_Eeprom_Write(addr+i, buf[i]);
+        }
     }
 }
 
@@ -120,11 +85,11 @@ void chb_eeprom_write(U16 addr, U8 *buf, U16 size)
 void chb_eeprom_read(U16 addr, U8 *buf, U16 size)
 {
     // disable memory mapping
-    NVM.CTRLB &= ~NVM_EEMAPEN_bm;
+    Hal_Eeprom_Unmap();
 
     /* Write bytes.*/
-    for(U8 i=0; i<size; i++)
+    for(U16 i=0; i<size; i++)
     {
-        buf[i] = chb_eep_read_byte(addr+i);
+        buf[i] = Hal_Eeprom_Read(addr+i);
     }
 }
@@ -70,33 +70,10 @@
 
 #include <avr/io.h>
 #include "types.h"
+#include "Hal.h"
 
 #define EEPROM_PAGESIZE 32
 
-/*! \brief Non-Volatile Memory Execute Command
- *
- *  This macro set the CCP register before setting the CMDEX bit in the
- *  NVM.CTRLA register.
- *
- *  \note The CMDEX bit must be set within 4 clock cycles after setting the
- *        protection byte in the CCP register.
- */
-#define NVM_EXEC()  asm("push r30"      "\n\t"  \
-                "push r31"      "\n\t"  \
-                    "push r16"      "\n\t"  \
-                    "push r18"      "\n\t"  \
-                "ldi r30, 0xCB" "\n\t"  \
-                "ldi r31, 0x01" "\n\t"  \
-                "ldi r16, 0xD8" "\n\t"  \
-                "ldi r18, 0x01" "\n\t"  \
-                "out 0x34, r16" "\n\t"  \
-                "st Z, r18"     "\n\t"  \
-                    "pop r18"       "\n\t"  \
-                "pop r16"       "\n\t"  \
-                "pop r31"       "\n\t"  \
-                "pop r30"       "\n\t"  \
-                )
-
 /*! \brief Enable EEPROM block sleep-when-not-used mode.
  *
  *  This macro enables power reduction mode for EEPROM.
@@ -114,5 +91,6 @@
 
 void chb_eeprom_write(U16 addr, U8 *buf, U16 size);
 void chb_eeprom_read(U16 addr, U8 *buf, U16 size);
+void chb_eeprom_update(U16 addr, U8 *buf, U16 size);
 
 #endif
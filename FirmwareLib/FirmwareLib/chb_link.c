@@ -0,0 +1,228 @@
+/*
+ * chb_link.c
+ *
+ * Created: 10/19/2026
+ */
+#include <string.h>
+#include "chb_link.h"
+#include "chb_drvr.h"
+
+static chb_link_t links[CHB_LINK_TABLE_SZ];
+static U8 num_links, lru_clock;
+
+/**************************************************************************/
+/*!
+    Clear the link table.
+*/
+/**************************************************************************/
+void chb_link_init()
+{
+    num_links = 0;
+    lru_clock = 0;
+}
+
+/**************************************************************************/
+/*!
+    Find the entry for addr. If add is set and there is none, make one,
+    replacing the least recently used neighbor if the table is full.
+*/
+/**************************************************************************/
+static chb_link_t *chb_link_find(U16 addr, U8 add)
+{
+    U8 i, oldest = 0;
+    chb_link_t *link;
+
+    for (i=0; i<num_links; i++)
+    {
+        if (links[i].addr == addr)
+        {
+            links[i].used = ++lru_clock;
+            return &links[i];
+        }
+    }
+    if (!add)
+    {
+        return NULL;
+    }
+
+    if (num_links < CHB_LINK_TABLE_SZ)
+    {
+        link = &links[num_links++];
+    }
+    else
+    {
+        for (i=1; i<CHB_LINK_TABLE_SZ; i++)
+        {
+            if ((U8)(lru_clock - links[i].used) > (U8)(lru_clock - links[oldest].used))
+            {
+                oldest = i;
+            }
+        }
+        link = &links[oldest];
+    }
+    memset(link, 0, sizeof(chb_link_t));
+    link->addr = addr;
+    link->pdr = 255;
+    link->used = ++lru_clock;
+    return link;
+}
+
+/**************************************************************************/
+/*!
+    Returns the link table entry for addr or NULL if nothing was heard from
+    or sent to it lately.
+*/
+/**************************************************************************/
+chb_link_t *chb_link_get(U16 addr)
+{
+    return chb_link_find(addr, false);
+}
+
+/**************************************************************************/
+/*!
+    Returns entry i of the link table or NULL past the end of it. For
+    reporting the whole table.
+*/
+/**************************************************************************/
+chb_link_t *chb_link_get_index(U8 i)
+{
+    return (i < num_links) ? &links[i] : NULL;
+}
+
+/**************************************************************************/
+/*!
+    Account a received frame. Called by chb_read with the ed and lqi the
+    radio isr stored with the frame.
+*/
+/**************************************************************************/
+void chb_link_rx(U16 addr, U8 ed, U8 lqi)
+{
+    chb_link_t *link = chb_link_find(addr, true);
+
+    // moving averages (1/8 weight) kept x16 so small changes don't get truncated away
+    if (link->rx == 0)
+    {
+        link->ed = (U16)ed << 4;
+        link->lqi = (U16)lqi << 4;
+    }
+    else
+    {
+        link->ed = link->ed - (link->ed >> 3) + ((U16)ed << 1);
+        link->lqi = link->lqi - (link->lqi >> 3) + ((U16)lqi << 1);
+    }
+    link->rx++;
+}
+
+/**************************************************************************/
+/*!
+    Set the transmit power for a frame to addr. Called by chb_write right
+    before the frame goes to the radio.
+*/
+/**************************************************************************/
+void chb_link_tx_start(U16 addr)
+{
+#if (CHB_LINK_ADAPT_PWR)
+    chb_link_t *link = (addr == 0xFFFF) ? NULL : chb_link_find(addr, false);
+
+    chb_set_pwr_atten(link ? link->atten : 0);
+#endif
+}
+
+/**************************************************************************/
+/*!
+    Account the result of a frame sent to addr and adapt the transmit power
+    for it. Goes back to full power afterwards so the auto acks sent for
+    other motes' frames aren't attenuated.
+*/
+/**************************************************************************/
+void chb_link_tx_done(U16 addr, U8 status)
+{
+    chb_link_t *link;
+    U8 pdr;
+
+    if (addr == 0xFFFF)
+    {
+        return;
+    }
+    link = chb_link_find(addr, true);
+    link->tx++;
+
+    switch (status)
+    {
+    case CHB_CHANNEL_ACCESS_FAILURE:
+        // a busy channel says nothing about the link
+        link->ch_fail++;
+        break;
+
+    case CHB_NO_ACK:
+        link->noack++;
+        link->sent++;
+#if (CHB_LINK_ADAPT_PWR)
+        // back off right away and start a new window
+        link->atten = (link->atten > CHB_LINK_PWR_UP) ? link->atten - CHB_LINK_PWR_UP : 0;
+        link->pdr = (U8)(((U16)link->pdr*3 + ((U16)link->acked*255)/link->sent)/4);
+        link->sent = 0;
+        link->acked = 0;
+#endif
+        break;
+
+    default:
+        link->sent++;
+        link->acked++;
+        break;
+    }
+
+    if (link->sent >= CHB_LINK_WINDOW)
+    {
+        pdr = ((U16)link->acked*255)/link->sent;
+        link->pdr = (U8)(((U16)link->pdr*3 + pdr)/4);
+#if (CHB_LINK_ADAPT_PWR)
+        if ((link->acked == link->sent) && (link->atten < CHB_LINK_MAX_ATTEN))
+        {
+            link->atten++;
+        }
+        else if (link->pdr < CHB_LINK_PDR_TARGET)
+        {
+            link->atten = (link->atten > CHB_LINK_PWR_UP) ? link->atten - CHB_LINK_PWR_UP : 0;
+        }
+#endif
+        link->sent = 0;
+        link->acked = 0;
+    }
+
+#if (CHB_LINK_ADAPT_PWR)
+    chb_set_pwr_atten(0);
+#endif
+}
+
+/**************************************************************************/
+/*!
+    Pick the fastest mode of the current band that the averaged ed of the
+    frames heard from addr supports (see chb_check_link). The ed is measured
+    on the neighbor's frames so it reads low if the neighbor is attenuating
+    its power, which errs on the safe side.
+*/
+/**************************************************************************/
+U8 chb_link_best_mode(U16 addr)
+{
+    chb_link_t *link = chb_link_find(addr, false);
+    U8 ed;
+
+    if (!link || !link->rx)
+    {
+        return CHB_INIT_MODE;
+    }
+    ed = link->ed >> 4;
+
+    if (CHB_INIT_MODE == OQPSK_915MHZ)
+    {
+        if (chb_check_link(OQPSK_915MHZ_1000KBPS, ed)) return OQPSK_915MHZ_1000KBPS;
+        if (chb_check_link(OQPSK_915MHZ_500KBPS, ed)) return OQPSK_915MHZ_500KBPS;
+    }
+    else if (CHB_INIT_MODE == OQPSK_868MHZ)
+    {
+        if (chb_check_link(OQPSK_868MHZ_400KBPS, ed)) return OQPSK_868MHZ_400KBPS;
+        if (chb_check_link(OQPSK_868MHZ_200KBPS, ed)) return OQPSK_868MHZ_200KBPS;
+    }
+    return CHB_INIT_MODE;
+}
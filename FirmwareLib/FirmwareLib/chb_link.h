@@ -0,0 +1,53 @@
+/*
+ * chb_link.h
+ *
+ * Created: 10/19/2026
+ */
+#ifndef CHB_LINK_H
+#define CHB_LINK_H
+
+#include "chb.h"
+#include "types.h"
+
+// number of neighbors kept in the link table. the least recently used one gets replaced
+#define CHB_LINK_TABLE_SZ       8
+
+// transmit power adaptation. frames to a neighbor go out attenuated by the neighbor's number of steps from the
+// power set with chb_set_pwr() (~1 dB per step of the TX_PWR field). after CHB_LINK_WINDOW unicasts that all got
+// acked, the attenuation goes up a step. a frame that wasn't acked after the radio's retries brings the power back
+// up CHB_LINK_PWR_UP steps right away, and so does a window delivering less than CHB_LINK_PDR_TARGET.
+// broadcasts and acks always go out at full power.
+#define CHB_LINK_ADAPT_PWR      1
+#define CHB_LINK_WINDOW         16
+#define CHB_LINK_PDR_TARGET     230     // delivery ratio (255 = all acked), ~90%
+#define CHB_LINK_PWR_UP         2
+#define CHB_LINK_MAX_ATTEN      20
+
+// ask chb_link_best_mode() to pick the data rate for a link
+#define CHB_MODE_AUTO           0xFF
+
+typedef struct
+{
+    U16 addr;
+    U16 ed;         // average ed level of frames from the neighbor x16
+    U16 lqi;        // average lqi x16
+    U16 rx;         // frames received
+    U16 tx;         // frames sent
+    U16 noack;      // frames not acked after the radio's retries
+    U16 ch_fail;    // frames not sent because the channel was busy
+    U8 pdr;         // average delivery ratio of the frames sent (255 = all acked)
+    U8 atten;       // transmit power attenuation steps used for this neighbor
+    U8 sent;        // frames sent and acked in the current adaptation window
+    U8 acked;
+    U8 used;        // lru stamp
+} chb_link_t;
+
+void chb_link_init();
+void chb_link_rx(U16 addr, U8 ed, U8 lqi);
+void chb_link_tx_start(U16 addr);
+void chb_link_tx_done(U16 addr, U8 status);
+chb_link_t *chb_link_get(U16 addr);
+chb_link_t *chb_link_get_index(U8 i);
+U8 chb_link_best_mode(U16 addr);
+
+#endif
@@ -39,6 +39,7 @@
 */
 /**************************************************************************/
 //#include "chb.h"
+#include <stddef.h>
 #include "chb_spi.h"
 
 /**************************************************************************/
@@ -51,12 +52,20 @@ void chb_spi_init()
 {
     // configure the SPI slave_select, spi clk, and mosi pins as output. the miso pin
     // is cleared since its an input.
-    CHB_SPI_DDIR |= (1<<CHB_SSPIN) | (1<<CHB_MOSI) | (1<<CHB_SCK);
-    CHB_SPI_PORT |= (1<<CHB_SSPIN);
+    Hal_Gpio_Output(CHB_SPI_PORT, (1<<CHB_SSPIN) | (1<<CHB_MOSI) | (1<<CHB_SCK));
+    Hal_Gpio_Set(CHB_SPI_PORT, 1<<CHB_SSPIN);
 
     // set to master mode
-    // set the clock freq to fck/16
-    CHB_CTRL |= (1<<SPI_MASTER_bp) | (1<<SPI_ENABLE_bp) | (1<<SPI_PRESCALER_gp);
+    // set the clock freq to fck/4. at 32 MHz that's 8 MHz which is the max spi clock
+    // the AT86RF212 allows. don't use CLK2X here, it would push the clock past that.
+    Hal_Spi_Ctrl(CHB_SPI, SPI_MASTER_bm | SPI_ENABLE_bm | SPI_PRESCALER_DIV4_gc);
+
+#if (CHB_SPI_DMA == 1)
+    // the rx channel has to run before the tx channel on each spi trigger so that
+    // the received byte gets read out before the next one is clocked in. use fixed
+    // channel priority (CH0 highest) to guarantee that.
+    DMA.CTRL = DMA_ENABLE_bm | DMA_PRIMODE_CH0123_gc;
+#endif
 
     // set the slave select to idle
     CHB_SPI_DISABLE();
@@ -68,11 +77,99 @@ void chb_spi_init()
     to be written as argument. For read ops, use dummy data as arg. Returned
     data is read byte val.
 */
-/**************************************************************************/
-uint8_t SPID_write(uint8_t byteToSend){
-	uint8_t data;
-	SPID.DATA = byteToSend;
-	while(!(SPID.STATUS & SPI_IF_bm)); //wait for byte to be sent
-	data = SPID.DATA; //read SPI data register to reset status flag
-	return data;
-}
\ No newline at end of file
+/**************************************************************************/
+uint8_t SPID_write(uint8_t byteToSend){
+	return Hal_Spi_Transfer(CHB_SPI, byteToSend);
+}
+
+#if (CHB_SPI_DMA == 1)
+// dummy locations for the half of the transfer we don't care about
+static U8 chb_dma_tx_dummy = 0;
+static U8 chb_dma_rx_dummy;
+
+/**************************************************************************/
+/*!
+    Set up a DMA channel to move bytes between a buffer and the SPI data register.
+    If the buffer is NULL, the channel uses a single fixed dummy location instead.
+*/
+/**************************************************************************/
+static void chb_dma_ch_setup(DMA_CH_t *ch, U16 src, U8 src_dir, U16 dest, U8 dest_dir, U8 len)
+{
+    ch->CTRLA = 0;
+    ch->ADDRCTRL = src_dir | dest_dir;
+    ch->TRIGSRC = CHB_DMA_TRIGSRC;
+    ch->TRFCNT = len;
+    ch->SRCADDR0 = src & 0xff;
+    ch->SRCADDR1 = src >> 8;
+    ch->SRCADDR2 = 0;
+    ch->DESTADDR0 = dest & 0xff;
+    ch->DESTADDR1 = dest >> 8;
+    ch->DESTADDR2 = 0;
+    ch->CTRLB = DMA_CH_TRNIF_bm | DMA_CH_ERRIF_bm;
+
+    // one byte per spi transfer complete trigger
+    ch->CTRLA = DMA_CH_ENABLE_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    Transfer a block of bytes over SPID. Bytes from txbuf are sent and the bytes
+    clocked in are stored to rxbuf. Either one can be NULL: a NULL txbuf sends
+    zeros and a NULL rxbuf throws away the received data.
+
+    With CHB_SPI_DMA enabled, the block is moved by two DMA channels triggered
+    off the SPI transfer complete flag so the CPU only has to kick off the
+    first byte. Interrupts are not masked while the transfer is running. The
+    caller is responsible for holding the chip select.
+*/
+/**************************************************************************/
+void SPID_write_block(U8 *txbuf, U8 *rxbuf, U8 len)
+{
+#if (CHB_SPI_DMA == 1)
+    U8 first;
+
+    if (len == 0)
+    {
+        return;
+    }
+
+    // the cpu sends the first byte, the tx channel handles the remaining len-1
+    first = txbuf ? txbuf[0] : 0;
+
+    chb_dma_ch_setup(&CHB_DMA_RX_CH, (U16)&CHB_DATA, DMA_CH_SRCDIR_FIXED_gc,
+                     rxbuf ? (U16)rxbuf : (U16)&chb_dma_rx_dummy,
+                     rxbuf ? DMA_CH_DESTDIR_INC_gc : DMA_CH_DESTDIR_FIXED_gc, len);
+
+    if (len > 1)
+    {
+        chb_dma_ch_setup(&CHB_DMA_TX_CH, txbuf ? (U16)(txbuf + 1) : (U16)&chb_dma_tx_dummy,
+                         txbuf ? DMA_CH_SRCDIR_INC_gc : DMA_CH_SRCDIR_FIXED_gc,
+                         (U16)&CHB_DATA, DMA_CH_DESTDIR_FIXED_gc, len - 1);
+    }
+
+    CHB_DATA = first;
+
+    // the rx channel finishes last. the channel enable bit gets cleared by
+    // hardware at the end of the block.
+    while (CHB_DMA_RX_CH.CTRLA & DMA_CH_ENABLE_bm);
+
+    CHB_DMA_RX_CH.CTRLB = DMA_CH_TRNIF_bm;
+    CHB_DMA_TX_CH.CTRLB = DMA_CH_TRNIF_bm;
+
+    // clear the spi flag so the polled SPID_write starts from a clean state
+    (void)CHB_STATUS;
+    (void)CHB_DATA;
+#else
+    U8 i, data;
+
+    for (i=0; i<len; i++)
+    {
+        data = SPID_write(txbuf ? txbuf[i] : 0);
+        if (rxbuf)
+        {
+            rxbuf[i] = data;
+        }
+    }
+#endif
+}
@@ -44,9 +44,10 @@
 
 #include "types.h"
 #include <avr/io.h>
+#include "Hal.h"
 
-#define CHB_SPI_PORT    PORTD_OUT
-#define CHB_SPI_DDIR    PORTD_DIR
+#define CHB_SPI         HAL_SPID
+#define CHB_SPI_PORT    HAL_PORTD
 
 #define CHB_SSPIN       4
 #define CHB_SCK         7              
@@ -59,10 +60,25 @@
 
 #define CHB_SPIF        SPI_IF_bp
 
-#define CHB_SPI_ENABLE()    do {CHB_SPI_PORT &= ~(1<<CHB_SSPIN);} while (0)
-#define CHB_SPI_DISABLE()   do {CHB_SPI_PORT |= (1<<CHB_SSPIN);} while (0)
+// use DMA for the frame buffer transfers. set to 0 to fall back to polled spi.
+// the host build (HAL_SIM) has no DMA and always polls.
+#ifdef HAL_SIM
+#define CHB_SPI_DMA     0
+#else
+#define CHB_SPI_DMA     1
+#endif
+
+// DMA channels reserved for the radio. the rx channel must be the higher
+// priority one (lower channel number).
+#define CHB_DMA_RX_CH   DMA.CH0
+#define CHB_DMA_TX_CH   DMA.CH1
+#define CHB_DMA_TRIGSRC DMA_CH_TRIGSRC_SPID_gc
+
+#define CHB_SPI_ENABLE()    do {Hal_Gpio_Clr(CHB_SPI_PORT, 1<<CHB_SSPIN);} while (0)
+#define CHB_SPI_DISABLE()   do {Hal_Gpio_Set(CHB_SPI_PORT, 1<<CHB_SSPIN);} while (0)
 
 void chb_spi_init();
 uint8_t SPID_write(uint8_t data);
+void SPID_write_block(U8 *txbuf, U8 *rxbuf, U8 len);
 
 #endif
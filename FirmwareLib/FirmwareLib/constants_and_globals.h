@@ -93,6 +93,7 @@ volatile uint16_t FRAMAddress;  // address counters for FRAM write/read
 volatile uint8_t RadioMonitorMode;	//used by synch module
 volatile uint16_t MotesReadyToSynch;	//used by synch module
 uint8_t moteID;	//used by synch module
+volatile uint8_t TimeSynchBeaconDue;	//set by the time synch module when the root should send a beacon
 volatile uint8_t SPIBuffer[13];
 volatile uint8_t channelStatus;  // copy of channel filter configuration to allow bit level changes
 
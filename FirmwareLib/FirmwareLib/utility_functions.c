@@ -6,6 +6,12 @@
  */ 
 
 #include "utility_functions.h"
+#include "Energy.h"
+#include "TimeSynch.h"
+
+static uint32_t RailOn;	// local time the ADC rail came on
+static uint8_t RailTimed = FALSE;	// RailOn is good: the local clock was running
+static uint8_t RailSettled = FALSE;
 
 // Sets the external 16MHz crystal on XTAL1 and XTAL2 as the system clock.
 // There was a problem with some of the hardware modules not having the crystal
@@ -18,6 +24,9 @@ void init(){
 	ADC_POWER_ON = 0;
 }
 
+// the clock setup stays on the registers, the host has no clock to set
+#ifndef HAL_SIM
+
 void setXOSC_32MHz() {
 	// configure the crystal to match the chip
 	CLKSYS_XOSC_Config( OSC_FRQRANGE_12TO16_gc,
@@ -84,151 +93,113 @@ void set_32MHz() {
 	
 }
 
+#endif /* HAL_SIM */
 
 void portExCS(uint8_t write) {
-	if (write) PORTA.OUTCLR = PIN3_bm;
+	if (write) Hal_Gpio_Clr(HAL_PORTA, PIN3_bm);
 	else {
-		PORTA.OUTSET = PIN3_bm;
+		Hal_Gpio_Set(HAL_PORTA, PIN3_bm);
 	}
-	_delay_us(10);
+	Hal_Delay_Us(10);
 }
 
-// 1 in bitmap sets the selected pins to output
-// Port Expander must be powered on (VDC-2)
-// all other pins are unaffected
-void PortEx_DIRSET(uint8_t pins, uint8_t bank) {
-	SPIInit(PS_SPI_MODE);
-	SPICS(TRUE);
-	portExCS(TRUE);
+//what the port expander registers hold, in register order IODIRA, IODIRB and OLATA, OLATB. the bankX_DIR/bankX_OUT shadows
+//are what the pins should be, PortEx_Flush sends the registers that differ from these
+static uint8_t PortExDIR[2] = {0xFF, 0xFF}, PortExOUT[2];
+static uint8_t PortExBatch;
 
-	if(bank) bankA_DIR = (uint8_t) (pins | bankA_DIR);
-	else bankB_DIR = (uint8_t) (pins | bankB_DIR);
+//the port expander is back to its power on state (all pins input, latches low), e.g. after VDC-2 was switched
+void PortEx_Reset() {
+	bankA_DIR = bankA_OUT = bankB_DIR = bankB_OUT = 0x00;
+	PortExDIR[0] = PortExDIR[1] = 0xFF;
+	PortExOUT[0] = PortExOUT[1] = 0x00;
+}
+
+//writes the A and/or B register starting at reg if it changed. with both changed they go out in one transaction since
+//IOCON.SEQOP is 0 after reset and the B register follows the A one
+static void PortEx_Sync(uint8_t reg, uint8_t* value, uint8_t* chip) {
 	
-	SPIBuffer[0] = PS_WRITE;
-	if(bank) {
-		SPIBuffer[1]=PS_IODIRA;
-		SPIBuffer[2] = ~bankA_DIR; 
-	} else {
-		SPIBuffer[1]=PS_IODIRB;
-		SPIBuffer[2] = ~bankB_DIR;
-	}	
-
-	for(uint8_t bufIndex = 0; bufIndex < 3; bufIndex++) {
-		SPIC.DATA = SPIBuffer[bufIndex];
-		while(!(SPIC.STATUS & SPI_IF_bm));	//wait for the byte to be sent
-		SPIBuffer[12] = SPIC.DATA;			//read the data register to clear status flag
+	uint8_t first = (value[0] != chip[0]) ? 0 : 1;
+	uint8_t last = (value[1] != chip[1]) ? 1 : 0;
+	const SPIBus_Device_t* prev;
+	
+	if(first > last) return;
+	prev = SPIBus_Acquire(&SPIBus_PortEx);
+	SPI_write(PS_WRITE);
+	SPI_write(reg + first);
+	for(uint8_t i = first; i <= last; i++) {
+		SPI_write(value[i]);
+		chip[i] = value[i];
 	}
+	SPIBus_Release(&SPIBus_PortEx, prev);
+}
+
+//sends the shadows to the port expander. the latches go first so a pin turned into an output comes up at its new level
+static void PortEx_Flush() {
+	
+	uint8_t dir[2], out[2];
+	
+	if(PortExBatch) return;
+	out[0] = bankA_OUT;
+	out[1] = bankB_OUT;
+	PortEx_Sync(PS_OLATA, out, PortExOUT);
+	dir[0] = ~bankA_DIR;
+	dir[1] = ~bankB_DIR;
+	PortEx_Sync(PS_IODIRA, dir, PortExDIR);
+}
 
-	portExCS(FALSE);
-	SPICS(FALSE);
-	SPIDisable();
+//the PortEx_ calls between PortEx_Begin and PortEx_End only change the shadows, PortEx_End sends all of it at once
+void PortEx_Begin() {
+	PortExBatch++;
+}
 
+void PortEx_End() {
+	if(PortExBatch) PortExBatch--;
+	PortEx_Flush();
+}
 
+// 1 in bitmap sets the selected pins to output
+// Port Expander must be powered on (VDC-2)
+// all other pins are unaffected
+void PortEx_DIRSET(uint8_t pins, uint8_t bank) {
+	if(bank) bankA_DIR = (uint8_t) (pins | bankA_DIR);
+	else bankB_DIR = (uint8_t) (pins | bankB_DIR);
+	PortEx_Flush();
 }
 
 // 1 in bitmap sets the selected pins to input
 // Port Expander must be powered on (VDC-2)
 // all other pins are unaffected
 void PortEx_DIRCLR(uint8_t pins, uint8_t bank) {
-	
-	SPIInit(PS_SPI_MODE);
-	SPICS(TRUE);
-	portExCS(TRUE);
-	
-	if(bank) bankA_DIR = (uint8_t) (pins & ~bankA_DIR);
-	else bankB_DIR = (uint8_t) (pins & ~bankB_DIR);
-	
-	SPIBuffer[0] = PS_WRITE;
-	if(bank) {
-		SPIBuffer[1]=PS_IODIRA;
-		SPIBuffer[2] = ~bankA_DIR; 
-	} else {
-		SPIBuffer[1]=PS_IODIRB;
-		SPIBuffer[2] = ~bankB_DIR;
-	}	
-
-	for(uint8_t bufIndex = 0; bufIndex < 3; bufIndex++) {
-		SPIC.DATA = SPIBuffer[bufIndex];
-		while(!(SPIC.STATUS & SPI_IF_bm));
-		SPIBuffer[12] = SPIC.DATA;
-	}
-
-	SPICS(FALSE);
-	portExCS(FALSE);
-	SPIDisable();
+	if(bank) bankA_DIR = (uint8_t) (bankA_DIR & ~pins);
+	else bankB_DIR = (uint8_t) (bankB_DIR & ~pins);
+	PortEx_Flush();
 }
 
 void PortEx_OUTSET(uint8_t pins, uint8_t bank) {
-	
-	SPIInit(PS_SPI_MODE);
-	SPICS(TRUE);
-	portExCS(TRUE);
-	
 	if(bank) bankA_OUT = (uint8_t) (pins | bankA_OUT);
 	else bankB_OUT = (uint8_t) (pins | bankB_OUT);
-	
-	SPIBuffer[0] = PS_WRITE;
-	if(bank) {
-		SPIBuffer[1]=PS_OLATA;
-		SPIBuffer[2] = bankA_OUT;
-	} else {
-		SPIBuffer[1]=PS_OLATB;
-		SPIBuffer[2] = bankB_OUT; 
-	}
-
-	for(uint8_t bufIndex = 0; bufIndex < 3; bufIndex++) {
-		SPIC.DATA = SPIBuffer[bufIndex];
-		while(!(SPIC.STATUS & SPI_IF_bm));
-		SPIBuffer[12] = SPIC.DATA;
-	}
-
-	SPICS(FALSE);
-	portExCS(FALSE);
-	SPIDisable();
+	PortEx_Flush();
 }
 
-
 void PortEx_OUTCLR(uint8_t pins, uint8_t bank) {
-	
-	SPIInit(PS_SPI_MODE);
-	SPICS(TRUE);
-	portExCS(TRUE);
-	
 	if(bank) bankA_OUT = (uint8_t) (bankA_OUT & ~pins);
 	else bankB_OUT = (uint8_t) (bankB_OUT & ~pins);
-	
-	SPIBuffer[0] = PS_WRITE;
-	if(bank) {
-		SPIBuffer[1]=PS_OLATA;
-		SPIBuffer[2] = bankA_OUT;
-	} else {
-		SPIBuffer[1]=PS_OLATB;
-		SPIBuffer[2] = bankB_OUT; 
-	}
-
-	for(uint8_t bufIndex = 0; bufIndex < 3; bufIndex++) {
-		SPIC.DATA = SPIBuffer[bufIndex];
-		while(!(SPIC.STATUS & SPI_IF_bm));
-		SPIBuffer[12] = SPIC.DATA;
-	}
-
-	SPICS(FALSE);
-	portExCS(FALSE);
-	SPIDisable();
+	PortEx_Flush();
 }
 
 void Ext1Power(uint8_t on) {
 	
 	if (on) {
-		PORTF.DIRSET = PIN5_bm;
-		PORTF.OUTSET = PIN5_bm;
+		Hal_Gpio_Output(HAL_PORTF, PIN5_bm);
+		Hal_Gpio_Set(HAL_PORTF, PIN5_bm);
 		//PortEx_DIRSET(PIN3_bm, PS_BANKB);
 		//PortEx_OUTSET(PIN3_bm, PS_BANKB);  //write protect SDHC
-		_delay_ms(100);
+		Hal_Delay_Ms(100);
 		
 	} else {
-		PORTF.OUTCLR = PIN5_bm;
-		PORTF.DIRCLR = PIN5_bm;
+		Hal_Gpio_Clr(HAL_PORTF, PIN5_bm);
+		Hal_Gpio_Input(HAL_PORTF, PIN5_bm);
 		//PortEx_OUTCLR(PIN3_bm, PS_BANKB);  //no need to write protect SDHC
 	}
 }
@@ -236,94 +207,114 @@ void Ext1Power(uint8_t on) {
 void Ext2Power(uint8_t on) {
 	
 	if (on) {
-		PORTF.DIRSET = PIN6_bm;
-		PORTF.OUTSET = PIN6_bm;
-		_delay_ms(100);
+		Hal_Gpio_Output(HAL_PORTF, PIN6_bm);
+		Hal_Gpio_Set(HAL_PORTF, PIN6_bm);
+		Hal_Delay_Ms(100);
 	} else {
-		PORTF.OUTCLR = PIN6_bm;
-		PORTF.DIRCLR = PIN6_bm;
+		Hal_Gpio_Clr(HAL_PORTF, PIN6_bm);
+		Hal_Gpio_Input(HAL_PORTF, PIN6_bm);
 	}
 }
 
 void HVPower(uint8_t on) {
 	
 	if (on) {
-		PORTF.DIRSET = PIN7_bm;
-		PORTF.OUTSET = PIN7_bm;
-		_delay_ms(100);
+		Hal_Gpio_Output(HAL_PORTF, PIN7_bm);
+		Hal_Gpio_Set(HAL_PORTF, PIN7_bm);
+		Hal_Delay_Ms(100);
 	} else {
-		PORTF.OUTCLR = PIN7_bm;
-		PORTF.DIRCLR = PIN7_bm;
+		Hal_Gpio_Clr(HAL_PORTF, PIN7_bm);
+		Hal_Gpio_Input(HAL_PORTF, PIN7_bm);
 	}
-	_delay_us(1000);
+	Hal_Delay_Us(1000);
 }
 
 
 void lowerMuxCS(uint8_t write) {
 	
 	// take IO15(PE4) low to enable write
-	if (write) PORTE.OUTCLR = PIN4_bm;
-	else PORTE.OUTSET = PIN4_bm;
+	if (write) Hal_Gpio_Clr(HAL_PORTE, PIN4_bm);
+	else Hal_Gpio_Set(HAL_PORTE, PIN4_bm);
 }
 
 void upperMuxCS(uint8_t write) {
 	
 	// take IO16(PC
-	if (write) PORTC.OUTCLR = PIN1_bm;
-	else PORTC.OUTSET = PIN1_bm;
+	if (write) Hal_Gpio_Clr(HAL_PORTC, PIN1_bm);
+	else Hal_Gpio_Set(HAL_PORTC, PIN1_bm);
 }
 
 void ADCPower(uint8_t on) {
 	
 	if (on && !ADC_POWER_ON) {
-		PORTA.DIRSET = PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN6_bm | PIN7_bm; // portEx-CS and HV1/HV2 and A0
-		PORTB.DIRSET = PIN1_bm| PIN2_bm | PIN3_bm; // FRAM-CS and A1/A2
-		PORTC.DIRSET = PIN0_bm | PIN1_bm;// VDCA and VDC-2 and MUX-SYNC1
-		PORTE.DIRSET = PIN4_bm; // MUX-SYNC2
-		PORTF.DIRSET = PIN1_bm | PIN2_bm | PIN3_bm; // DAC LDAC and CS
+		Hal_Gpio_Output(HAL_PORTA, PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN6_bm | PIN7_bm); // portEx-CS and HV1/HV2 and A0
+		Hal_Gpio_Output(HAL_PORTB, PIN1_bm| PIN2_bm | PIN3_bm); // FRAM-CS and A1/A2
+		Hal_Gpio_Output(HAL_PORTC, PIN0_bm | PIN1_bm);// VDCA and VDC-2 and MUX-SYNC1
+		Hal_Gpio_Output(HAL_PORTE, PIN4_bm); // MUX-SYNC2
+		Hal_Gpio_Output(HAL_PORTF, PIN1_bm | PIN2_bm | PIN3_bm); // DAC LDAC and CS
 
 		// high signal to write protect
-		PORTA.OUTSET = PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN7_bm; // portEx-CS
-		PORTB.OUTSET = PIN3_bm; // FRAM-CS
-		PORTC.OUTSET = PIN0_bm | PIN1_bm; // VDCA and VDC-2 on and MUX-SYNC1
-		PORTE.OUTSET = PIN4_bm; // MUX-SYNC2
-		PORTF.OUTSET = PIN1_bm | PIN2_bm | PIN3_bm;  // ADC-CS and DAC write/latch
+		Hal_Gpio_Set(HAL_PORTA, PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN7_bm); // portEx-CS
+		Hal_Gpio_Set(HAL_PORTB, PIN3_bm); // FRAM-CS
+		Hal_Gpio_Set(HAL_PORTC, PIN0_bm | PIN1_bm); // VDCA and VDC-2 on and MUX-SYNC1
+		Hal_Gpio_Set(HAL_PORTE, PIN4_bm); // MUX-SYNC2
+		Hal_Gpio_Set(HAL_PORTF, PIN1_bm | PIN2_bm | PIN3_bm);  // ADC-CS and DAC write/latch
 		channelStatus = 0x00; // POR to zeros
-		_delay_ms(100);
+		RailSettled = FALSE;
+		RailTimed = Hal_Timer_Running(HAL_TCD1);
+		if(RailTimed) RailOn = TimeSynch_Get_Local_Time();
+		Hal_Delay_Ms(ADC_RAIL_DIGITAL_MS);
 
 		// set SPI-MISO as input
-		PORTC.DIRCLR = PIN6_bm;
+		Hal_Gpio_Input(HAL_PORTC, PIN6_bm);
 		
-		bankA_DIR = bankA_OUT = bankB_DIR = bankB_OUT = 0x00; // all pins input on reset
+		PortEx_Reset(); // all pins input on reset
+		PortEx_Begin();
 		PortEx_DIRSET(0xFF, PS_BANKA);
 		PortEx_OUTSET(0xFF, PS_BANKA);  //write protect IN-AMP 1 thru 8
+		PortEx_End();
 		//setPortEx(0xFF, PS_BANKA);
 		set_filter(0xFF);  // set filters initially to ensure data out pulled high
 		ADC_POWER_ON = TRUE;
+		Energy_Set(ENERGY_ADC, ENERGY_ON);
 
 	} else if(!on && ADC_POWER_ON) {
+		SPIBus_Off();
 		// low signal for low power
-		PORTA.OUTCLR = PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN6_bm | PIN7_bm; // portEx-CS and A0
-		PORTB.OUTCLR = PIN1_bm | PIN2_bm | PIN3_bm; // FRAM-CS and A1/A2
-		PORTC.OUTCLR = PIN0_bm | PIN1_bm; // VDCA and VDC-2 on and MUX-SYNC1
-		PORTE.OUTCLR = PIN4_bm; // MUX-SYNC2
-		PORTF.OUTCLR = PIN1_bm | PIN2_bm | PIN3_bm;  // ADC-CS and DAC write/latch
-
-
-		PORTA.DIRCLR = PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN7_bm | PIN6_bm;
-		PORTB.DIRCLR = PIN1_bm | PIN2_bm| PIN3_bm;
-		PORTC.DIRCLR = PIN0_bm | PIN1_bm;
-		PORTE.DIRCLR = PIN4_bm;
-		PORTF.DIRCLR = PIN1_bm | PIN2_bm | PIN3_bm;
+		Hal_Gpio_Clr(HAL_PORTA, PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN6_bm | PIN7_bm); // portEx-CS and A0
+		Hal_Gpio_Clr(HAL_PORTB, PIN1_bm | PIN2_bm | PIN3_bm); // FRAM-CS and A1/A2
+		Hal_Gpio_Clr(HAL_PORTC, PIN0_bm | PIN1_bm); // VDCA and VDC-2 on and MUX-SYNC1
+		Hal_Gpio_Clr(HAL_PORTE, PIN4_bm); // MUX-SYNC2
+		Hal_Gpio_Clr(HAL_PORTF, PIN1_bm | PIN2_bm | PIN3_bm);  // ADC-CS and DAC write/latch
+
+
+		Hal_Gpio_Input(HAL_PORTA, PIN1_bm| PIN2_bm | PIN3_bm | PIN4_bm | PIN7_bm | PIN6_bm);
+		Hal_Gpio_Input(HAL_PORTB, PIN1_bm | PIN2_bm| PIN3_bm);
+		Hal_Gpio_Input(HAL_PORTC, PIN0_bm | PIN1_bm);
+		Hal_Gpio_Input(HAL_PORTE, PIN4_bm);
+		Hal_Gpio_Input(HAL_PORTF, PIN1_bm | PIN2_bm | PIN3_bm);
 		
 		// set SPI-MISO as input
-		PORTC.DIRCLR = PIN6_bm;
+		Hal_Gpio_Input(HAL_PORTC, PIN6_bm);
 		
 		
-		bankA_DIR = bankA_OUT = bankB_DIR = bankB_OUT = 0x00; // all pins input on reset
+		PortEx_Reset(); // all pins input on reset
 		channelStatus = 0x00;
 		ADC_POWER_ON = FALSE;
+		Energy_Set(ENERGY_ADC, ENERGY_OFF);
+	}
+}
+
+void ADC_Rail_Settle() {
+	
+	if (!ADC_POWER_ON || RailSettled) return;
+	if (RailTimed) {
+		while ((int32_t)(TimeSynch_Get_Local_Time() - RailOn) < (int32_t)(ADC_RAIL_SETTLE_MS*(TS_TICKS_PER_SEC/1000))) Hal_Spin();
+	} else {
+		// no clock to tell how long it has been on, so the full time
+		Hal_Delay_Ms(ADC_RAIL_SETTLE_MS - ADC_RAIL_DIGITAL_MS);
 	}
+	RailSettled = TRUE;
 }
 
 /*  \brief Sets input analog filters
@@ -348,6 +339,7 @@ void set_filter(uint8_t filterConfig) {
 	// boolean flags for upper/lower channels CS
 	uint8_t lowerCS = filterConfig & 0x03; 
 	uint8_t upperCS = filterConfig & 0x0C;
+	const SPIBus_Device_t* prev;
 
 	// update left and right channel status
 	if (filterConfig & (BIT0_bm | BIT2_bm)) channelStatus = 
@@ -355,8 +347,7 @@ void set_filter(uint8_t filterConfig) {
 	if (filterConfig & (BIT1_bm | BIT3_bm)) channelStatus =
 		(0xF0 & filterConfig) | (0x0F & channelStatus); //left
 		
-	SPIInit(SPI_MODE_1_gc);
-
+	prev = SPIBus_Acquire(&SPIBus_Mux);
 	
 	SPIBuffer[0] = channelStatus;
 	
@@ -364,91 +355,19 @@ void set_filter(uint8_t filterConfig) {
 	if (lowerCS) lowerMuxCS(TRUE);
 	if (upperCS) upperMuxCS(TRUE);
 
-	SPICS(TRUE);
-
 	// Send all logic high to ensure that the SDO line on the chip is
 	// left in high Z state after SPI transaction.
 	// The t-1 SDI transaction is output on the SDO and the pin left in the configuration.
 	// of the last bit
-	SPIC.DATA = 0xFF;
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
+	SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, 0xFF);
 
-	nop();
+	Hal_Nop();
 
-	SPIC.DATA = SPIBuffer[0];
-	while(!(SPIC.STATUS & SPI_IF_bm));
-	SPIBuffer[12] = SPIC.DATA;
-	SPICS(FALSE);
+	SPIBuffer[12] = Hal_Spi_Transfer(HAL_SPIC, SPIBuffer[0]);
 
 	if (lowerCS) lowerMuxCS(FALSE);
 	if (upperCS) upperMuxCS(FALSE);
-	SPIDisable();
-}
-
-void SPIInit(uint8_t mode) {
-	
-	// init SPI SS pin
-	PORTC.DIRSET = PIN4_bm;
-	PORTC.PIN4CTRL = PORT_OPC_WIREDANDPULL_gc;
-	PORTC.OUTSET = PIN4_bm;
-
-	// init SPI
-	SPIC.CTRL =	SPI_PRESCALER |  // set clock speed
-	0x00 |  // disable clock double
-	SPI_ENABLE_bm | // Enable SPI module
-	0x00 |  // set data order msb first
-	SPI_MASTER_bm | // set SPI master
-	mode; // set SPI mode
-
-	// disable SPI Interrupts
-	SPIC.INTCTRL = SPI_INTLVL_OFF_gc;
-
-	// set SPI-MOSI and SPI-SCK as output
-	PORTC.DIRSET  = PIN5_bm | PIN7_bm;
-
-	
-}
-
-//use this if using a prescalar
-void SPIInit2(uint8_t mode, uint8_t prescalar) {
-	
-	// init SPI SS pin
-	PORTC.DIRSET = PIN4_bm;
-	PORTC.PIN4CTRL = PORT_OPC_WIREDANDPULL_gc;
-	PORTC.OUTSET = PIN4_bm;
-	
-
-	// init SPI
-	SPIC.CTRL =	prescalar |  // set clock speed
-	0x00 |  // disable clock double
-	SPI_ENABLE_bm | // Enable SPI module
-	0x00 |  // set data order msb first
-	SPI_MASTER_bm | // set SPI master
-	mode; // set SPI mode
-
-	// disable SPI Interrupts
-	SPIC.INTCTRL = SPI_INTLVL_OFF_gc;
-
-	// set SPI-MOSI and SPI-SCK as output
-	PORTC.DIRSET  = PIN5_bm | PIN7_bm;
-}
-
-void SPICS(uint8_t enable) {
-	
-	if (enable) PORTC.OUTCLR = PIN4_bm;
-	else {
-		PORTC.OUTSET = PIN4_bm;
-	}
-}
-
-void SPIDisable() {
-	
-	PORTC.OUTSET = PIN4_bm;
-	SPIC.CTRL = 0x00;
-	PORTC.OUTCLR = PIN4_bm;
-	PORTC.DIRCLR = PIN4_bm | PIN5_bm | PIN7_bm;
-
+	SPIBus_Release(&SPIBus_Mux, prev);
 }
 
 void DeciToString(int32_t* DecimalArray, uint32_t length, char* ReturnString){
@@ -458,18 +377,14 @@ void DeciToString(int32_t* DecimalArray, uint32_t length, char* ReturnString){
 	ReturnString[0] = 0;
 	for(i=0;i<length;i++){
 		//written = sprintf(b,"%ld",DecimalArray[i]);
-		sprintf(b,"%ld",DecimalArray[i]);
+		sprintf(b,"%ld",(long)DecimalArray[i]);	//int32_t is only long on the AVR
 		strcat(ReturnString,b);
 		//add a space between each value
 		strcat(ReturnString,"\n");
 	}
 }
 
-//the following command writes/reads a byte via spi
+//the following command writes/reads a byte via spi. the bus has to be taken with SPIBus_Acquire
 uint8_t SPI_write(uint8_t byteToSend){
-	uint8_t data;
-	SPIC.DATA = byteToSend;
-	while(!(SPIC.STATUS & SPI_IF_bm)); //wait for byte to be sent
-	data = SPIC.DATA; //read SPI data register to reset status flag
-	return data;
+	return SPIBus_Transfer(byteToSend);
 }
\ No newline at end of file
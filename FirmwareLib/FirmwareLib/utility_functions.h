@@ -14,6 +14,7 @@
 #include <avr/pgmspace.h>
 #include <util/delay.h>
 #include "clksys_driver.h"
+#include "SPIBus.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -27,6 +28,9 @@ void PortEx_DIRSET(uint8_t portMask, uint8_t bank);
 void PortEx_DIRCLR(uint8_t portMask, uint8_t bank);
 void PortEx_OUTSET(uint8_t portMask, uint8_t bank);
 void PortEx_OUTCLR(uint8_t portMask, uint8_t bank);
+void PortEx_Begin();
+void PortEx_End();
+void PortEx_Reset();
 
 void portExCS(uint8_t write);
 
@@ -35,14 +39,16 @@ void Ext2Power(uint8_t on);
 void HVPower(uint8_t on);
 void lowerMuxCS(uint8_t write);
 void upperMuxCS(uint8_t write);
+// the rail ADCPower switches runs the port expander and FRAM, which are up ADC_RAIL_DIGITAL_MS after it comes on. the analog
+// front end takes ADC_RAIL_SETTLE_MS: ADC_Rail_Settle waits out what is left of that before sampling, so reading FRAM or
+// setting up the port expander doesn't pay for it
+#define ADC_RAIL_DIGITAL_MS 2
+#define ADC_RAIL_SETTLE_MS 100
 void ADCPower(uint8_t on);
+void ADC_Rail_Settle();
 void set_filter(uint8_t filterConfig);
 
 uint8_t readPortEx(uint8_t readRegister);
-void SPIInit(uint8_t mode);
-void SPIInit2(uint8_t mode, uint8_t prescalar);
-void SPICS(uint8_t enable);
-void SPIDisable();
 uint8_t SPI_write(uint8_t byteToSend);
 
 void DeciToString(int32_t* DecimalArray, uint32_t length, char* ReturnString);
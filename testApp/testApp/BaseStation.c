@@ -5,27 +5,46 @@
  *  Author: Vlad
  */ 
 # include "E-000001-000009_firmware_rev_1_0.h"
+# include "Synch.h"
 
 volatile uint8_t TimedOut = 0;
 
+//read a received frame while talking to the mote at from. frames from other motes are mesh traffic (hellos, relayed data) and
+//go to the mesh instead. returns the length of the reply, 0 if the frame wasn't one
+static uint8_t Read_Reply(uint16_t from, uint8_t* buffer){
+	
+	pcb_t* pcb = chb_get_pcb();
+	uint8_t length = chb_read((chb_rx_data_t*)buffer);
+	
+	if(pcb->sender_addr != from){
+		Mesh_Handle_Frame(buffer, &length);
+		return 0;
+	}
+	return length;
+}
+
 int main(){
 
 	uint32_t length;
 	uint16_t dest_addr;
 	uint16_t ack = 0;
-	uint8_t  MessageBuffer[100];
+	uint8_t  MessageBuffer[256];
 	uint16_t NumReceivedMessages, NumMessages, TimeoutCount;
 	//set timeout about 2 sec
 	uint16_t timeout = 4000;
+	uint32_t NextHello;
+	uint8_t RecordLength;
 	
-	set_32MHz_Calibrated();
+	//calibrated 32MHz oscillator, slowed down while asleep (see Clock.h)
+	Clock_Init();
 	
 	//chb_set_pwr(0xe1);
 	chb_init();
 	chb_set_short_addr(0x0000);
 	chb_set_channel(1);
 	//chb_set_pwr(0);
-	StartSerial((uint32_t)57600);
+	StartSerial(HOSTLINK_BAUD);
+	HostLink_Init();
 
 	while(!chb_set_state(CHB_RX_AACK_ON) == RADIO_SUCCESS);
 	pcb_t* pcb = chb_get_pcb();
@@ -39,26 +58,164 @@ int main(){
 	PMIC.CTRL |= PMIC_LOLVLEN_bm;
 	sei();
 	
+	//act as the network time reference, one synch beacon per second
+	synch(1);
+	//root of the mesh. data relayed by the motes is kept in the FRAM queue until the host asks for it
+	ADC_Sampling_Finished = 1;
+	Mesh_Init(TRUE);
+	//the base station always listens but has to know when the motes do
+	LPL_Init(LPL_DEFAULT_INTERVAL, LPL_DEFAULT_WINDOW);
+	NextHello = TimeSynch_Get_Local_Time();
+	
 	while(1){
 		length = 0;
-		//wait for inputs over serial
-		while(!(USARTC0.STATUS & BIT7_bm));
-		length = SerialReadByte();
-		for(uint32_t i = 0; i<length; i++){
-			MessageBuffer[i] = SerialReadByte();
+		//wait for the next message from the host, sending synch beacons and mesh hellos and taking in mesh traffic in the
+		//meantime. beacons and hellos wait for the motes' listen window instead of blocking in LPL_Send so no serial input is
+		//missed. the replies to a frame of messages go out together before waiting on the next frame (see HostLink.h).
+		//sleeps until serial input, a frame or the next beacon, hello or window comes up
+		while(!HostLink_Poll()){
+			Channel_Poll(TRUE);
+			if(TimeSynchBeaconDue && LPL_Window_Open()) TimeSynch_Send_Beacon();
+			if((int32_t)(TimeSynch_Get_Local_Time() - NextHello) >= 0 && LPL_Window_Open()){
+				Mesh_Send_Hello();
+				NextHello += MESH_HELLO_PERIOD*TS_TICKS_PER_SEC;
+			}
+			if(pcb->data_rcv){
+				RecordLength = chb_read((chb_rx_data_t*)FRAMReadBuffer);
+				Mesh_Handle_Frame(FRAMReadBuffer, &RecordLength);
+				continue;
+			}
+			if(TimeSynchBeaconDue || (int32_t)(TimeSynch_Get_Local_Time() - NextHello) >= 0) LPL_Wake_At_Window();
+			else Event_Wake_At(NextHello);
+			Event_Wait(EVENT_HOST | EVENT_RADIO_RX | EVENT_TIMER);
 		}
+		length = HostLink_Next_Message(MessageBuffer);
+		if(length < 2) continue;
 		dest_addr = ((uint16_t*)MessageBuffer)[0];
+		
+		//TDMA collection round run by the base station itself: ['D', superframes, slot length (ms, 2 bytes), mote addresses (2 bytes each)]
+		//each mote sends its data in its own slot. frames go to the host as [sender address (2 bytes), length, data] since the
+		//motes' data is interleaved, followed by an end of round marker with address 0xFFFF and length 0.
+		if(dest_addr == 0x0000 && length >= 6 && MessageBuffer[2] == TDMA_SCHEDULE){
+			TDMA_Set_Schedule((uint16_t*)(MessageBuffer+6), (length-6)/2, *(uint16_t*)(MessageBuffer+4), MessageBuffer[3]);
+			while(TDMA_Start_Superframe()){
+				while(TDMA_Superframe_Running()){
+					if(pcb->data_rcv){
+						length = chb_read((chb_rx_data_t*)FRAMReadBuffer);
+						if(length == 0) continue;
+						HostLink_Write((uint8_t*)&pcb->sender_addr,2);
+						HostLink_Write_Byte(length);
+						HostLink_Write(FRAMReadBuffer,length);
+					}
+					else Event_Wait(EVENT_RADIO_RX | EVENT_TIMER);
+				}
+			}
+			HostLink_Write_Byte(0xFF);
+			HostLink_Write_Byte(0xFF);
+			HostLink_Write_Byte(0);
+			continue;
+		}
+		
+		//mesh data relayed to the base station: ['A']. the queued records go to the host in the same [sender address (2 bytes),
+		//length, data] format as above (the sender being the mote the data came from), followed by the end marker
+		if(dest_addr == 0x0000 && length == 3 && MessageBuffer[2] == MESH_DATA){
+			while((RecordLength = Mesh_Dequeue(MessageBuffer)) != 0){
+				HostLink_Write(MessageBuffer,RecordLength);
+			}
+			HostLink_Write_Byte(0xFF);
+			HostLink_Write_Byte(0xFF);
+			HostLink_Write_Byte(0);
+			continue;
+		}
+		
+		//low power listening schedule for the whole network: ['L', wake interval (2 bytes, ms), listen window (2 bytes, ms)]
+		//flooded to the motes on the old schedule, then taken up here. the interval in use goes back to the host (2 bytes)
+		if(dest_addr == 0x0000 && length == 7 && MessageBuffer[2] == 'L'){
+			Mesh_Flood(MessageBuffer+2, 5);
+			LPL_Init(*(uint16_t*)(MessageBuffer+3), *(uint16_t*)(MessageBuffer+5));
+			uint16_t interval = LPL_Get_Interval();
+			HostLink_Write((uint8_t*)&interval, 2);
+			continue;
+		}
+		
+		//link table: ['K']. goes to the host as the number of neighbors followed by [address (2 bytes), average ed, average lqi,
+		//delivery ratio (255 = all acked), tx power attenuation steps, received (2 bytes), sent (2 bytes), not acked (2 bytes)] each
+		if(dest_addr == 0x0000 && length == 3 && MessageBuffer[2] == 'K'){
+			chb_link_t* link;
+			uint8_t NumLinks = 0;
+			while(chb_link_get_index(NumLinks)) NumLinks++;
+			HostLink_Write_Byte(NumLinks);
+			for(uint8_t i=0;i<NumLinks;i++){
+				link = chb_link_get_index(i);
+				*(uint16_t*)MessageBuffer = link->addr;
+				MessageBuffer[2] = link->ed >> 4;
+				MessageBuffer[3] = link->lqi >> 4;
+				MessageBuffer[4] = link->pdr;
+				MessageBuffer[5] = link->atten;
+				*(uint16_t*)(MessageBuffer+6) = link->rx;
+				*(uint16_t*)(MessageBuffer+8) = link->tx;
+				*(uint16_t*)(MessageBuffer+10) = link->noack;
+				HostLink_Write(MessageBuffer,12);
+			}
+			continue;
+		}
+		
+		//channel survey: ['E']. the average and max ed level of each channel go to the host as [channel, average, max] per channel
+		if(dest_addr == 0x0000 && length == 3 && MessageBuffer[2] == 'E'){
+			uint8_t EdAvg[CHB_MAX_CHANNEL+1], EdMax[CHB_MAX_CHANNEL+1];
+			Channel_Survey(EdAvg, EdMax);
+			for(uint8_t ch=CHB_MIN_CHANNEL;ch<=CHB_MAX_CHANNEL;ch++){
+				HostLink_Write_Byte(ch);
+				HostLink_Write_Byte(EdAvg[ch]);
+				HostLink_Write_Byte(EdMax[ch]);
+			}
+			continue;
+		}
+		
+		//move the network to another channel: ['C', channel], channel 0xFF for the quietest one. flooded to the motes, and the
+		//base station follows once the delay runs out. the new channel goes back to the host, 0 if it was not a valid one
+		if(dest_addr == 0x0000 && length == 4 && MessageBuffer[2] == CHANNEL_MIGRATE){
+			uint8_t channel = MessageBuffer[3];
+			if(channel == CHANNEL_AUTO){
+				uint8_t EdAvg[CHB_MAX_CHANNEL+1], EdMax[CHB_MAX_CHANNEL+1];
+				channel = Channel_Survey(EdAvg, EdMax);
+			}
+			if(Channel_Migrate(channel) == CHB_INVALID) channel = 0;
+			HostLink_Write_Byte(channel);
+			continue;
+		}
+		
+		//sniffer: ['Z', channel (0 for the current one)]. for a spare base station board, not the one running the network: it stops
+		//beaconing and streams every frame it hears at SNIFFER_BAUD (see Sniffer.h, the records have their own sync byte and aren't
+		//framed) until the host sends a byte, then comes back to the framed link at the usual baud rate
+		if(dest_addr == 0x0000 && length == 4 && MessageBuffer[2] == 'Z'){
+			HostLink_Flush();
+			Sniffer_Run(MessageBuffer[3]);
+			StartSerial(HOSTLINK_BAUD);
+			HostLink_Init();
+			continue;
+		}
+		
+		//command for every mote in the mesh: ['W', command...]. flooded through the relays, no replies
+		if(dest_addr == 0x0000 && length > 3 && MessageBuffer[2] == MESH_FLOOD){
+			Mesh_Flood(MessageBuffer+3, length-3);
+			continue;
+		}
 			
 		
 		if(length > 2){
 			//clear out message buffer in case any stray message was received
 			if(pcb->data_rcv){ 
-				chb_read((chb_rx_data_t*)FRAMReadBuffer);
+				Read_Reply(dest_addr, FRAMReadBuffer);
+			}
+			//mode change with the mode left to the base station: take the fastest one the link to the mote supports
+			if(MessageBuffer[2] == 'M' && length > 3 && MessageBuffer[3] == CHB_MODE_AUTO){
+				MessageBuffer[3] = chb_link_best_mode(dest_addr);
 			}
 			TCE0.CTRLA = 0x07;
 			TimedOut = 0;				
 			//process/send the bytes over radio
-			while(chb_write(dest_addr,MessageBuffer+2,length-2) != CHB_SUCCESS){
+			while(LPL_Send(dest_addr,MessageBuffer+2,length-2) != CHB_SUCCESS){
 				if(TimedOut) break;
 			}
 			if(TimedOut) {
@@ -73,9 +230,11 @@ int main(){
 			//TCE0.CTRLA = 0x07;
 			//wait for response/data over radio if the message was sent to only 1 mote and not broadcast
 			if(dest_addr != 0xFFFF){
-				while(!pcb->data_rcv){
+				length = 0;
+				while(!pcb->data_rcv || (length = Read_Reply(dest_addr, FRAMReadBuffer)) == 0){
 					//no response detected so go back to waiting for next serial command
 					if(TimedOut) break;
+					if(!pcb->data_rcv) Event_Wait(EVENT_RADIO_RX | EVENT_TIMEOUT);
 					//if(TCF0.CNT - TimeoutCount >= timeout) break;
 				}
  				if(TimedOut) {
@@ -84,9 +243,34 @@ int main(){
  					continue;
  				}			
 				//if(TCF0.CNT - TimeoutCount >= timeout) continue;
-				//read the data. expecting a 1 byte message containing number of messages that follow
-				length = chb_read((chb_rx_data_t*)FRAMReadBuffer);
-				if (length == 2){
+				//the data was read above. expecting a 2 byte message containing number of messages that follow
+				//mode change request: the node switched if it replied with 0, so follow it and probe the link at the new rate.
+				//if the probe doesn't get through, fall back to the default rate (the node falls back on its own timeout).
+				//the resulting mode is reported to the host.
+				if ((MessageBuffer[2] == 'M') && (length == 2)){
+					if(((uint16_t*)FRAMReadBuffer)[0] == 0){
+						chb_change_mode(MessageBuffer[3]);
+						TCE0.CTRLFSET = 0x08;
+						TimedOut = 0;
+						while(chb_write(dest_addr,(uint8_t*)"P",1) != CHB_SUCCESS){
+							if(TimedOut) break;
+						}
+						if(TimedOut) chb_change_mode(CHB_INIT_MODE);
+					}
+					HostLink_Write_Byte(chb_get_mode());
+					length = 0;
+				}
+				//sample start time request: pass the network time and synch status on to the host
+				else if (MessageBuffer[2] == 'N'){
+					HostLink_Write(FRAMReadBuffer,length);
+					length = 0;
+				}
+				//batch of binary commands: the reply with all the results goes to the host as is (see Command.h)
+				else if (MessageBuffer[2] == CMD_BATCH){
+					HostLink_Write(FRAMReadBuffer,length);
+					length = 0;
+				}
+				else if (length == 2){
 					length = 0;
 					NumReceivedMessages = 0;
 					//get the number of messages (2 bytes)
@@ -101,10 +285,9 @@ int main(){
 					//TCE0.CTRLA = 0x07;
 					while(NumReceivedMessages <NumMessages){
 						//wait for all messages to come in
-						if(pcb->data_rcv){
-							length = chb_read((chb_rx_data_t*)(FRAMReadBuffer));
+						if(pcb->data_rcv && (length = Read_Reply(dest_addr, FRAMReadBuffer)) != 0){
 							//pass the data to USB
-							SerialWriteBuffer(FRAMReadBuffer,length);
+							HostLink_Write(FRAMReadBuffer,length);
 							NumReceivedMessages++;
 							//reset timeout count
 							//TimeoutCount = TCF0.CNT;
@@ -123,7 +306,12 @@ int main(){
 							//TCE0.CTRLA = 0x07;
 						}
 						//if(TCF0.CNT - TimeoutCount >= timeout) break;
-						if(TimedOut) break;		
+						if(TimedOut){
+							//transfer stalled, so if a high data rate was negotiated go back to the default rate (the node does the same)
+							chb_change_mode(CHB_INIT_MODE);
+							break;
+						}
+						if(!pcb->data_rcv) Event_Wait(EVENT_RADIO_RX | EVENT_TIMEOUT);
 					}
 					//SerialWriteBuffer(FRAMReadBuffer,length);
 					//check if timed out
@@ -141,4 +329,5 @@ ISR(TCE0_OVF_vect){
 	//TCE0.CTRLFSET = 0x0C;
 	//set timeout flag
 	TimedOut = 1;
+	Event_Post(EVENT_TIMEOUT);
 }
\ No newline at end of file
@@ -9,27 +9,670 @@
 
 volatile uint8_t TimedOut = 0;
 
-int main(){
+static uint8_t gain = GAIN_1_gc;
+static uint16_t freq = 2000;
+//collected samples being queued for the mesh ('Q')
+static uint16_t MeshQueued = 0, MeshTotal = 0, MeshStart = 0;
+//low power listening schedule from a batch, taken up once the reply is out on the old schedule
+static uint8_t LPLPending = FALSE;
+static uint16_t LPLInterval, LPLWindow;
+
+//continuous sampling (CMD_STREAM) goes round FR_STREAM_SIZE bytes of FRAM. the stream task hands each block of
+//ADC_BLOCK_SAMPLES samples the ISR finishes to the uplink task (and the store task), which send it on while sampling carries on
+#define STREAM_BLOCK_BYTES (ADC_BLOCK_SAMPLES*4)
+#define STREAM_BLOCKS (FR_STREAM_SIZE/STREAM_BLOCK_BYTES)
+//also append the stream to a file on the sd card
+#define NODE_STORE_SD 0
+#define STORE_BLOCKS 8	// blocks per write to the card
+static uint8_t Streaming = FALSE;
+static uint16_t StreamNext;	// next block to hand out
+static int32_t StreamBuffer[ADC_BLOCK_SAMPLES];
+static uint16_t UplinkBlocks[STREAM_BLOCKS];
+static queue_t UplinkQueue;
+static uint16_t UplinkPos = 0;	// bytes of the block at the front of UplinkQueue already in the mesh queue
+#if NODE_STORE_SD
+static uint16_t StoreBlocks[STREAM_BLOCKS];
+static queue_t StoreQueue;
+static uint8_t StoreBuffer[STORE_BLOCKS*STREAM_BLOCK_BYTES];
+static unsigned char StoreFile[] = "stream.dat";
+static task_t StoreTask;
+#endif
+static task_t StreamTask, RadioTask, UplinkTask, ScheduleTask;
+//acquisitions on the schedule from CMD_SCHEDULE (its settings are in Config)
+#define ACQUISITION_SAMPLES 10000	// for 'R' and CMD_ARM
+static uint8_t ScheduledRun = FALSE;	// sampling for the schedule
+//settings kept across resets, the defaults until the first save
+static config_t Config = {CONFIG_VERSION, GAIN_1_gc, 2000, LPL_DEFAULT_INTERVAL, LPL_DEFAULT_WINDOW, 0, 0, 0, GAIN_1_gc,
+	ADC_NO_OFFSET, ADC_NO_OFFSET, 0};
+static uint32_t NextHello;
+//the collected samples are going out with 'T' or in TDMA slots: nothing may sample over them, power FRAM off or send in between
+static uint8_t Sending = FALSE;
+
+//set a gain from its value (1, 2, 4 ... 128). returns FALSE and leaves the gain alone for any other value
+static uint8_t Set_Gain(uint8_t RawGain, uint8_t* code){
+	switch(RawGain){
+		case 1:
+			*code = GAIN_1_gc;
+			break;
+		case 2:
+			*code = GAIN_2_gc;
+			break;
+		case 4:
+			*code = GAIN_4_gc;
+			break;
+		case 8:
+			*code = GAIN_8_gc;
+			break;
+		case 16:
+			*code = GAIN_16_gc;
+			break;
+		case 32:
+			*code = GAIN_32_gc;
+			break;
+		case 64:
+			*code = GAIN_64_gc;
+			break;
+		case 128:
+			*code = GAIN_128_gc;
+			break;
+		default:
+			//chb_write(0x0000,(uint8_t*)"invalid gain",strlen("invalid gain"));
+			return FALSE;
+	}
+	return TRUE;
+}
+
+//keep the current settings for the next boot (see Config.h)
+static void Save_Config(){
+	Config.gain = gain;
+	Config.rate = freq;
+	ADC_Get_Internal_Offsets(&Config.offset_a, &Config.offset_b);
+	Config_Save(&Config);
+}
+
+//a stream is running or still has blocks to send. an acquisition started now would write over them
+static uint8_t Stream_Busy(){
+#if NODE_STORE_SD
+	if(Queue_Length(&StoreQueue)) return TRUE;
+#endif
+	return Streaming || Queue_Length(&UplinkQueue);
+}
+
+//start sampling until CMD_STREAM stops it, sending the samples over the mesh as they come in. returns FALSE if the ADC is
+//busy, the last samples asked for with 'Q' are still going into the mesh queue or the last acquisition is going out
+static uint8_t Start_Stream(){
+	if(!ADC_Sampling_Finished || Stream_Busy() || Sending || MeshQueued < MeshTotal) return FALSE;
+	StreamNext = 0;
+	UplinkPos = 0;
+	Streaming = TRUE;
+	CO_collectSeismic1Channel(ADC_CH_8_gc, gain, freq, 6, FALSE, 1, 2, 3, 4, 0, StreamBuffer, ADC_BLOCK_SAMPLES, TRUE);
+	return TRUE;
+}
+
+//bytes of a block of the stream in FRAM: all of them, fewer for the last one of a stopped stream, or 0 if the ISR has come
+//round to it again
+static uint16_t Stream_Bytes(uint16_t block){
+	uint32_t count = ADC_Get_Sample_Count();
+	uint16_t behind = (uint16_t)(count/ADC_BLOCK_SAMPLES) - block;
+	if(behind == 0) return (count%ADC_BLOCK_SAMPLES)*4;
+	if(behind >= STREAM_BLOCKS) return 0;
+	return STREAM_BLOCK_BYTES;
+}
+
+//read length bytes from pos in a block of the stream into FRAMReadBuffer. returns FALSE if the ISR came round to the block
+//before the read was done
+static uint8_t Stream_Read(uint16_t block, uint16_t pos, uint8_t length){
+	readFRAM(length, FR_BASEADD + (block%STREAM_BLOCKS)*STREAM_BLOCK_BYTES + pos);
+	return Stream_Bytes(block) >= pos + length;
+}
+
+//collect data if the ADC is not collecting any data right now. returns FALSE if it is, or a stream or the last acquisition
+//still has samples to send
+static uint8_t Start_Acquisition(uint8_t AcqGain, uint16_t rate, uint16_t samples){
+	if(!ADC_Sampling_Finished || Stream_Busy() || Sending) return FALSE;
+	//CO_collectADC(ADC_CH_1_gc, AcqGain, rate, samples, (int32_t*)FRAMReadBuffer, FR_READ_BUFFER_SIZE/4, TRUE);
+	CO_collectSeismic1Channel(ADC_CH_8_gc, AcqGain, rate, 6, FALSE, 1, 2, 3, 4, samples,(int32_t*)FRAMReadBuffer, FR_READ_BUFFER_SIZE/4, TRUE);
+	return TRUE;
+}
+
+//send the collected samples to the base station over the mesh. they go into the forwarding queue bit by bit
+//from the main loop so this works the same for motes out of direct range of the base station. returns FALSE if there are none
+static uint8_t Queue_Samples(){
+	if(!ADC_Sampling_Finished || !DataAvailable) return FALSE;
+	MeshTotal = ADC_Get_Num_Samples()*4;
+	MeshStart = FRAMAddress - MeshTotal;
+	MeshQueued = 0;
+	DataAvailable = 0;
+	return TRUE;
+}
+
+//run a batch of binary commands (see Command.h) and fill in the reply. returns the length of the reply
+static uint8_t Run_Batch(uint8_t* frame, uint8_t length, uint8_t* reply){
 	
-	uint8_t length;
-	uint8_t gain = GAIN_1_gc;
-	uint16_t ack = 0;
+	cmd_batch_t batch;
+	uint8_t opcode, ParamLength, status, ReplyLength;
+	uint8_t* params;
+	uint8_t data[CMD_ENERGY_LENGTH];
+	uint8_t i;
+	
+	if(!Command_Begin(&batch, frame, length, reply, CHB_MAX_PAYLOAD)) return Command_End(&batch);
+	while(Command_Next(&batch, &opcode, &params, &ParamLength)){
+		status = CMD_OK;
+		ReplyLength = 0;
+		switch(opcode){
+			case CMD_SET_GAIN:
+				if(ParamLength != 1) status = CMD_BAD_LENGTH;
+				else if(!Set_Gain(params[0], &gain)) status = CMD_BAD_VALUE;
+				else Save_Config();
+				break;
+			case CMD_SET_RATE:
+				if(ParamLength != 2) status = CMD_BAD_LENGTH;
+				else{
+					freq = Command_Get_U16(params);
+					Save_Config();
+				}
+				break;
+			case CMD_ARM:
+				if(!Start_Acquisition(gain, freq, ACQUISITION_SAMPLES)) status = CMD_BUSY;
+				break;
+			case CMD_STOP:
+				if(!ADC_Sampling_Finished) ADC_Stop_Sampling();
+				break;
+			case CMD_STATUS:
+				data[0] = !ADC_Sampling_Finished;
+				data[1] = DataAvailable;
+				Command_Put_U32(data+2, ADC_Get_Num_Samples());
+				data[6] = TimeSynch_Is_Synched();
+				data[7] = chb_get_channel();
+				Command_Put_U16(data+8, Mesh_Queue_Length());
+				ReplyLength = CMD_STATUS_LENGTH;
+				break;
+			case CMD_QUEUE:
+				if(!Queue_Samples()) status = CMD_BUSY;
+				break;
+			case CMD_TIME:
+				Command_Put_U32(data, TimeSynch_Local_To_Global(SampleStartTime));
+				data[4] = TimeSynch_Is_Synched();
+				ReplyLength = 5;
+				break;
+			case CMD_STREAM:
+				if(ParamLength != 1) status = CMD_BAD_LENGTH;
+				else if(params[0]){
+					if(!Start_Stream()) status = CMD_BUSY;
+				}
+				else if(Streaming && !ADC_Sampling_Finished) ADC_Stop_Sampling();
+				break;
+			case CMD_ENERGY:
+				if(ParamLength > 1) status = CMD_BAD_LENGTH;
+				else{
+					Command_Put_U32(data, Energy_Get_Elapsed());
+					for(i=0;i<ENERGY_SUBSYSTEMS;i++) Command_Put_U32(data+4+4*i, Energy_Get_Charge(i));
+					ReplyLength = CMD_ENERGY_LENGTH;
+					if(ParamLength && params[0]) Energy_Reset();
+				}
+				break;
+			case CMD_SCHEDULE:
+				if(ParamLength != 13) status = CMD_BAD_LENGTH;
+				else if(Command_Get_U32(params+4) && (!Command_Get_U16(params+8) || !Command_Get_U16(params+10)
+					|| !Set_Gain(params[12], &Config.schedule_gain))) status = CMD_BAD_VALUE;
+				else{
+					Config.schedule_period = Command_Get_U32(params+4);
+					Config.schedule_samples = Command_Get_U16(params+8);
+					Config.schedule_rate = Command_Get_U16(params+10);
+					Save_Config();
+					Schedule_Set(Command_Get_U32(params), Config.schedule_period);
+					//the schedule task takes it up
+					Event_Post(EVENT_TIMER);
+				}
+				break;
+			case CMD_SET_LPL:
+				//taken up after the reply goes out on the old schedule
+				if(ParamLength != 4) status = CMD_BAD_LENGTH;
+				else if(!LPL_Check(Command_Get_U16(params), Command_Get_U16(params+2))) status = CMD_BAD_VALUE;
+				else{
+					LPLInterval = Command_Get_U16(params);
+					LPLWindow = Command_Get_U16(params+2);
+					LPLPending = TRUE;
+				}
+				break;
+			default:
+				status = CMD_UNKNOWN;
+				break;
+		}
+		Command_Reply(&batch, opcode, status, data, ReplyLength);
+	}
+	return Command_End(&batch);
+}
+
+
+//hand the blocks the ISR filled to the queues of the tasks sending them on. a queue without room for a block loses it
+static uint8_t Stream_Task(task_t* task){
+	
+	uint32_t count;
+	uint16_t done;
+	
+	if(!Streaming) return EVENT_SAMPLES;
+	count = ADC_Get_Sample_Count();
+	done = count/ADC_BLOCK_SAMPLES;
+	//the last, partial block once the stream is stopped
+	if(ADC_Sampling_Finished && count%ADC_BLOCK_SAMPLES) done++;
+	while(StreamNext != done){
+		Queue_Put(&UplinkQueue, &StreamNext);
+#if NODE_STORE_SD
+		Queue_Put(&StoreQueue, &StreamNext);
+#endif
+		StreamNext++;
+	}
+	if(ADC_Sampling_Finished){
+		//the samples went out as the stream, there is no acquisition left to send with 'T' or 'Q'
+		Streaming = FALSE;
+		DataAvailable = 0;
+	}
+	return EVENT_SAMPLES;
+}
+
+//what a command leaves the radio task to do over several frames. the task waits between the frames, so the other tasks
+//and sampling carry on
+#define RADIO_JOB_NONE 0
+#define RADIO_JOB_PROBE 1	// 'M': wait for the base station's probe at the new rate
+#define RADIO_JOB_SEND 2	// 'T': send the collected samples, each frame answered by the base station
+#define RADIO_JOB_TDMA 3	// send the collected samples in our TDMA slots
+#define RADIO_SEND_TRIES 5	// chb_write calls a frame of a transfer gets before the transfer gives up
+
+static uint8_t RadioMessageBuffer[sizeof(chb_rx_data_t)];
+
+//run a command from the base station. returns the job it leaves for the radio task
+static uint8_t Radio_Command(uint8_t length){
+	
+	static uint8_t BatchReply[CHB_MAX_PAYLOAD];
+	static uint16_t ack = 0;
+	static uint16_t refused = 1;
+	uint8_t RequestedMode;
+	uint8_t TimeReply[5];
 	volatile uint8_t RawGain;
-	uint16_t freq = 2000;
-	volatile uint32_t samples = 0;
+	pcb_t* pcb = chb_get_pcb();
+	
+	switch ( RadioMessageBuffer[0]){
+		
+	case 'R':
+		//collect data if the ADC is not collecting any data right now
+		Start_Acquisition(gain, freq, ACQUISITION_SAMPLES);
+		//send acknowledgment if not a broadcast message
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,(uint8_t*)(&ack),2);
+		}											
+		break;
+		
+	case 'G':
+		//while(!pcb->data_rcv);
+		//length = chb_read((chb_rx_data_t*)RadioMessageBuffer);
+		//set gain to what is specified
+		RawGain = (uint8_t)(*(int32_t*)(RadioMessageBuffer+1));
+		if(Set_Gain(RawGain, &gain)) Save_Config();
+		//send acknowledgment if not a broadcast message
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,(uint8_t*)(&ack),2);
+		}					
+		break;
+		
+	case 'F':
+
+		//while(!pcb->data_rcv);
+		//length = chb_read((chb_rx_data_t*)RadioMessageBuffer);
+		//set sampling frequency to what is specified
+		freq = (uint16_t)(*(int32_t*)(RadioMessageBuffer+1));
+		Save_Config();
+		//send acknowledgment if not a broadcast message
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,(uint8_t*)(&ack),2);
+		}
+		break;
+		
+	case 'M':
+		//switch the radio to the requested mode (data rate) if the link quality of the request is good enough.
+		//reply at the current rate, then switch and wait for a probe from the base station at the new rate.
+		RequestedMode = RadioMessageBuffer[1];
+		if(pcb->destination_addr == 0xFFFF) break;
+		if(!chb_check_link(RequestedMode, pcb->ed)){
+			chb_write(0x0000,(uint8_t*)(&refused),2);
+			break;
+		}
+		chb_write(0x0000,(uint8_t*)(&ack),2);
+		chb_change_mode(RequestedMode);
+		return RADIO_JOB_PROBE;
+		
+	case TS_BEACON:
+		//time synch beacon from the base station (always broadcast, no ack)
+		TimeSynch_Handle_Beacon(RadioMessageBuffer, length);
+		break;
+		
+	case TDMA_SCHEDULE:
+		//collection round with a TDMA schedule: send the collected samples in our own slots, no per chunk acks from
+		//the base station since nobody else transmits in the slot (the radio still retries until the mac ack).
+		if(TDMA_Handle_Schedule(RadioMessageBuffer, length) && ADC_Sampling_Finished && DataAvailable) return RADIO_JOB_TDMA;
+		break;
+		
+	case 'Q':
+		//send the collected samples to the base station over the mesh
+		Queue_Samples();
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,(uint8_t*)(&ack),2);
+		}
+		break;
+		
+	case 'L':
+		//low power listening schedule: wake interval (2 bytes, ms, 0 for always listening) and listen window (2 bytes, ms).
+		//acknowledge first so the reply still goes out on the old schedule
+		if(length < 5) break;
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,(uint8_t*)(&ack),2);
+		}
+		if(LPL_Init(*(uint16_t*)(RadioMessageBuffer+1), *(uint16_t*)(RadioMessageBuffer+3))){
+			Config.lpl_interval = *(uint16_t*)(RadioMessageBuffer+1);
+			Config.lpl_window = *(uint16_t*)(RadioMessageBuffer+3);
+			Save_Config();
+		}
+		break;
+		
+	case CHANNEL_MIGRATE:
+		//move to another channel: channel, delay (2 bytes, ms). flooded, no reply
+		Channel_Handle(RadioMessageBuffer, length);
+		break;
+		
+	case CMD_BATCH:
+		//several binary commands in one frame, one reply with all the results (see Command.h)
+		length = Run_Batch(RadioMessageBuffer, length, BatchReply);
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,BatchReply,length);
+		}
+		if(LPLPending){
+			LPL_Init(LPLInterval, LPLWindow);
+			LPLPending = FALSE;
+			Config.lpl_interval = LPLInterval;
+			Config.lpl_window = LPLWindow;
+			Save_Config();
+		}
+		break;
+		
+	case 'N':
+		//reply with the network time of the first sample of the last acquisition (4 bytes) and whether this mote is synched
+		if(pcb->destination_addr != 0xFFFF){
+			*(uint32_t*)TimeReply = TimeSynch_Local_To_Global(SampleStartTime);
+			TimeReply[4] = TimeSynch_Is_Synched();
+			chb_write(0x0000,TimeReply,5);
+		}
+		break;
+		
+	case 'S':
+		//stop the ADC if it is not already
+		if(!ADC_Sampling_Finished){
+			ADC_Stop_Sampling();
+		}
+		//otherwise, the ADC has finished sampling on its own and the data is ready to be transmitted
+		//send acknowledgment if not a broadcast message
+		if(pcb->destination_addr != 0xFFFF){
+			chb_write(0x0000,(uint8_t*)(&ack),2);
+		}
+		break;
+		
+	case 'T':
+		//send the collected samples
+		if(ADC_Sampling_Finished && DataAvailable && pcb->destination_addr != 0xFFFF && ADC_Get_Num_Samples() > 0){
+			return RADIO_JOB_SEND;
+		}
+		break;
+	}
+
+	return RADIO_JOB_NONE;
+}
+
+//the radio and mesh upkeep between frames. returns TRUE if a frame came in
+static uint8_t Radio_Upkeep(){
+	//sleep or wake the radio on the low power listening schedule
+	LPL_Poll();
+	//keep the energy totals from overflowing between reports
+	Energy_Poll();
+	//channel moves announced by the base station, and looking for the network if it went quiet
+	Channel_Poll(FALSE);
+	//hellos for the neighbours
+	if((int32_t)(TimeSynch_Get_Local_Time() - NextHello) >= 0){
+		Mesh_Send_Hello();
+		NextHello += MESH_HELLO_PERIOD*TS_TICKS_PER_SEC;
+	}
+	Event_Wake_At(NextHello);
+	return chb_get_pcb()->data_rcv;
+}
+
+//commands from the base station, and the radio and mesh upkeep around them. a command that takes several frames ('M', 'T',
+//a TDMA round) waits for the base station or its slot with TASK_WAIT_UNTIL instead of blocking the other tasks
+static uint8_t Radio_Task(task_t* task){
+	
+	static uint8_t job, tries, ChunkSize, chunk, slot;
+	static uint16_t NumMessages;
+	static uint32_t total, sent;
+	uint8_t length;
+	pcb_t* pcb = chb_get_pcb();
+	
+	TASK_BEGIN(task);
+	while(1){
+		TASK_WAIT_UNTIL(task, Radio_Upkeep(), EVENT_RADIO_RX | EVENT_TIMER);
+		//read the data
+		length = chb_read((chb_rx_data_t*)RadioMessageBuffer);
+		Channel_Heard();
+		job = RADIO_JOB_NONE;
+		//frames for the mesh (hellos, data to relay) stop here. flooded commands come out looking like broadcasts from the base station
+		//process received message if it is from the base station (node id 0)
+		if(!Mesh_Handle_Frame(RadioMessageBuffer, &length) && pcb->sender_addr == 0x0000) job = Radio_Command(length);
+		
+		if(job == RADIO_JOB_PROBE){
+			//the probe is left for the next round. if it doesn't come, fall back to the default rate
+			TCE0.CTRLFSET = 0x08;
+			TCE0.CTRLA = 0x07;
+			TimedOut = 0;
+			TASK_WAIT_UNTIL(task, pcb->data_rcv || TimedOut, EVENT_RADIO_RX | EVENT_TIMEOUT);
+			TCE0.CTRLA = 0;
+			if(TimedOut){
+				TimedOut = 0;
+				chb_change_mode(CHB_INIT_MODE);
+			}
+		}
+		else if(job == RADIO_JOB_SEND){
+			//the number of messages the base station should expect, then the data from FRAM in the largest chunks that
+			//fit in a single frame, each answered by the base station before the next one goes
+			Sending = TRUE;
+			total = ADC_Get_Num_Samples()*4;
+			ChunkSize = chb_get_max_payload(0x0000);
+			NumMessages = total/ChunkSize;
+			if(total%ChunkSize > 0) NumMessages++;
+			for(tries = 0; chb_write(0x0000,(uint8_t*)(&NumMessages),2) != CHB_SUCCESS;){
+				if(++tries == RADIO_SEND_TRIES) break;
+				TASK_YIELD(task);
+			}
+			if(tries < RADIO_SEND_TRIES){
+				//start timeout timer
+				TCE0.CTRLFSET = 0x08;
+				TCE0.CTRLA = 0x07;
+				for(sent = 0; sent < total; sent += chunk){
+					chunk = (total - sent >= ChunkSize) ? ChunkSize : total - sent;
+					//the other tasks use FRAMReadBuffer too, so the chunk is read again for every try
+					for(tries = 0; tries < RADIO_SEND_TRIES; tries++){
+						readFRAM(chunk,(FRAMAddress-total)+sent);
+						if(chb_write(0x0000,FRAMReadBuffer,chunk) == CHB_SUCCESS) break;
+						TASK_YIELD(task);
+					}
+					if(tries == RADIO_SEND_TRIES) break;
+					//reset timeout timer and wait for the response
+					TimedOut = 0;
+					TCE0.CTRLFSET = 0x08;
+					TASK_WAIT_UNTIL(task, pcb->data_rcv || TimedOut, EVENT_RADIO_RX | EVENT_TIMEOUT);
+					if(TimedOut) break;
+					chb_read((chb_rx_data_t*)RadioMessageBuffer);
+				}
+				//stop timeout counter
+				TCE0.CTRLA = 0;
+				TimedOut = 0;
+				if(sent >= total) DataAvailable = 0;
+				//the link can't keep up at a high data rate so fall back to the default rate
+				else chb_change_mode(CHB_INIT_MODE);
+			}
+			Sending = FALSE;
+			//the uplink held off its queue meanwhile
+			Event_Post(EVENT_QUEUE);
+		}
+		else if(job == RADIO_JOB_TDMA){
+			//our slots until the samples are out or the schedule is done. the radio sleeps through the other slots
+			Sending = TRUE;
+			total = ADC_Get_Num_Samples()*4;
+			ChunkSize = chb_get_max_payload(0x0000);
+			sent = 0;
+			tries = 0;
+			while(sent < total && tries < RADIO_SEND_TRIES){
+				TASK_WAIT_UNTIL(task, (slot = TDMA_Poll_Slot()) != TDMA_WAIT, EVENT_RADIO_RX | EVENT_TIMER);
+				if(slot == TDMA_DONE) break;
+				while(sent < total && tries < RADIO_SEND_TRIES && TDMA_Frame_Fits(ChunkSize)){
+					chunk = (total - sent >= ChunkSize) ? ChunkSize : total - sent;
+					readFRAM(chunk,(FRAMAddress-total)+sent);
+					if(chb_write(0x0000,FRAMReadBuffer,chunk) == CHB_SUCCESS){
+						sent += chunk;
+						tries = 0;
+					}
+					else tries++;
+					TASK_YIELD(task);
+				}
+			}
+			TDMA_Stop();
+			if(sent >= total) DataAvailable = 0;
+			Sending = FALSE;
+			Event_Post(EVENT_QUEUE);
+		}
+		//let the tasks ahead in line in before the next frame
+		TASK_YIELD(task);
+	}
+	TASK_END(task);
+}
+
+//mesh uplink: the samples asked for with 'Q' and the blocks of the stream go into the forwarding queue as space frees up,
+//and from there to the parent
+static uint8_t Uplink_Task(task_t* task){
+	
+	static uint8_t MeshRecord[MESH_MAX_RECORD];
+	uint16_t QueueLength, block, bytes;
+	uint8_t chunk, status;
+	pcb_t* pcb = chb_get_pcb();
+	
+	while(MeshQueued < MeshTotal && ADC_Sampling_Finished){
+		//records are the offset of the data in the acquisition (2 bytes) followed by the data
+		chunk = (MeshTotal - MeshQueued >= MESH_MAX_RECORD - 2) ? MESH_MAX_RECORD - 2 : MeshTotal - MeshQueued;
+		if(Mesh_Queue_Space() < MESH_RECORD_HEADER_LENGTH + 2 + chunk) break;
+		readFRAM(chunk, MeshStart + MeshQueued);
+		*(uint16_t*)MeshRecord = MeshQueued;
+		memcpy(MeshRecord + 2, FRAMReadBuffer, chunk);
+		if(!Mesh_Enqueue(chb_get_short_addr(), MeshRecord, chunk + 2)) break;
+		MeshQueued += chunk;
+	}
+	//the same for the stream, with the offset counted from the start of the stream (it wraps at 64K)
+	while(Queue_Peek(&UplinkQueue, &block)){
+		bytes = Stream_Bytes(block);
+		if(UplinkPos >= bytes){
+			//all of it is queued, or it was written over before it could be
+			Queue_Pop(&UplinkQueue);
+			UplinkPos = 0;
+			continue;
+		}
+		chunk = (bytes - UplinkPos >= MESH_MAX_RECORD - 2) ? MESH_MAX_RECORD - 2 : bytes - UplinkPos;
+		if(Mesh_Queue_Space() < MESH_RECORD_HEADER_LENGTH + 2 + chunk) break;
+		if(!Stream_Read(block, UplinkPos, chunk)) continue;
+		*(uint16_t*)MeshRecord = block*STREAM_BLOCK_BYTES + UplinkPos;
+		memcpy(MeshRecord + 2, FRAMReadBuffer, chunk);
+		if(!Mesh_Enqueue(chb_get_short_addr(), MeshRecord, chunk + 2)) break;
+		UplinkPos += chunk;
+	}
+	QueueLength = Mesh_Queue_Length();
+	if(QueueLength && !pcb->data_rcv && !Sending){
+		status = Mesh_Forward();
+		//keep going while records go out. a failed send is tried again a bit later, without a route it waits for a hello
+		if(status == CHB_SUCCESS && Mesh_Queue_Length() < QueueLength) return 0;
+		if(status != CHB_SUCCESS && status != MESH_NO_ROUTE) Event_Wake_At(TimeSynch_Get_Local_Time() + MESH_RETRY_MS*(TS_TICKS_PER_SEC/1000));
+	}
+	return EVENT_RADIO_RX | EVENT_SAMPLES | EVENT_QUEUE | EVENT_TIMER;
+}
+
+//acquisitions on the schedule from CMD_SCHEDULE. the samples of a run go into the mesh queue once it is done and out in the
+//parent's listening windows. a run that comes due while the last one is still going out is skipped. with everything out the
+//ADC rail (ADC, port expander and FRAM) goes off until the next run, and the core can stop its clock in between (see Clock.h)
+static uint8_t Schedule_Task(task_t* task){
+	if(Schedule_Poll() && MeshQueued >= MeshTotal){
+		ScheduledRun = Start_Acquisition(Config.schedule_gain, Config.schedule_rate, Config.schedule_samples);
+	}
+	if(ScheduledRun && ADC_Sampling_Finished){
+		ScheduledRun = FALSE;
+		Queue_Samples();
+	}
+	if(Schedule_Is_Set() && ADC_Sampling_Finished && !Stream_Busy() && !Sending && MeshQueued >= MeshTotal && !Mesh_Queue_Length()){
+		ADCPower(FALSE);
+	}
+	return EVENT_TIMER | EVENT_SAMPLES | EVENT_RADIO_TX;
+}
+
+#if NODE_STORE_SD
+//append the stream to StoreFile, STORE_BLOCKS blocks at a time (fewer at the end of the stream)
+static uint8_t Store_Task(task_t* task){
+	
+	static uint16_t block, length, bytes;
+	
+	TASK_BEGIN(task);
+	while(1){
+		TASK_WAIT_UNTIL(task, Queue_Length(&StoreQueue) >= STORE_BLOCKS || (!Streaming && Queue_Length(&StoreQueue)), EVENT_QUEUE | EVENT_SAMPLES);
+		length = 0;
+		while(length + STREAM_BLOCK_BYTES <= sizeof(StoreBuffer) && Queue_Get(&StoreQueue, &block)){
+			bytes = Stream_Bytes(block);
+			if(bytes && Stream_Read(block, 0, bytes)){
+				memcpy(StoreBuffer + length, FRAMReadBuffer, bytes);
+				length += bytes;
+			}
+		}
+		if(length) writeFile(StoreFile, StoreBuffer, length);
+	}
+	TASK_END(task);
+}
+#endif
+
+int main(){
+	
 	DataAvailable = 0;
 	ADC_Sampling_Finished = 1;
-	uint8_t RadioMessageBuffer[20];
-	unsigned char ofile[] = {'o','u','t','p','u','t'};
-	set_32MHz_Calibrated();
+	//calibrated 32MHz oscillator, slowed down while asleep (see Clock.h)
+	Clock_Init();
+	//settings saved before the last reset (see Config.h)
+	if(Config_Load(&Config)){
+		gain = Config.gain;
+		freq = Config.rate;
+		ADC_Set_Internal_Offsets(Config.offset_a, Config.offset_b);
+	}
 	//chb_set_pwr(0xe1);
 	chb_init();
 	chb_set_channel(1);
 	chb_set_short_addr(0x0001);
 	//chb_set_pwr(0);
-	pcb_t* pcb = chb_get_pcb();
+	//follow the base station's clock
+	TimeSynch_Init(FALSE, 0);
+	//time and charge per subsystem for CMD_ENERGY
+	Energy_Reset();
+	//relay for motes further out and forward data toward the base station
+	Mesh_Init(FALSE);
+	//duty cycle the radio once synched (see LPL.h). 'L' changes the schedule
+	if(!LPL_Init(Config.lpl_interval, Config.lpl_window)) LPL_Init(LPL_DEFAULT_INTERVAL, LPL_DEFAULT_WINDOW);
+	//a saved acquisition schedule starts over with a run right away. it lines up with the other motes again when the base
+	//station next sends it
+	if(Config.schedule_period) Schedule_Set(TimeSynch_Get_Global_Time(), Config.schedule_period);
+	NextHello = TimeSynch_Get_Local_Time();
+#if NODE_STORE_SD
+	SD_init();
+	getBootSectorData();
+#else
 	//SD_init();
 	//getBootSectorData();
+#endif
 	
 	//setup timeout timer
 	//approx 2 seconds to wait (using largest prescaler of 1024)
@@ -38,156 +681,25 @@ int main(){
 	TCE0.INTCTRLA = TC_OVFINTLVL_LO_gc;
 	PMIC.CTRL |= PMIC_LOLVLEN_bm;
 	sei();
-
-	while(1){
-		if(pcb->data_rcv){
-			//read the data
-			length = chb_read((chb_rx_data_t*)RadioMessageBuffer);
-			//length should be >1 for setting gain/freq commands: the value is likely sent in a separate message
-			//process received message if it is from the base station (node id 0)
-			if(pcb->sender_addr == 0x0000){
-				switch ( RadioMessageBuffer[0]){
-					
-				case 'R':
-					//collect data if the ADC is not collecting any data right now
-					if(ADC_Sampling_Finished){
-						//CO_collectADC(ADC_CH_1_gc, gain, freq, 10000, (int32_t*)FRAMReadBuffer, FR_READ_BUFFER_SIZE/4, TRUE);
-						CO_collectSeismic1Channel(ADC_CH_8_gc, gain, freq, 6, FALSE, 1, 2, 3, 4, 10000,(int32_t*)FRAMReadBuffer, FR_READ_BUFFER_SIZE/4, TRUE);
-					}
-					//send acknowledgment if not a broadcast message
-					if(pcb->destination_addr != 0xFFFF){
-						chb_write(0x0000,(uint8_t*)(&ack),2);
-					}											
-					break;
-					
-				case 'G':
-					//while(!pcb->data_rcv);
-					//length = chb_read((chb_rx_data_t*)RadioMessageBuffer);
-					//set gain to what is specified
-					RawGain = (uint8_t)(*(int32_t*)(RadioMessageBuffer+1));
-					switch(RawGain){
-						case 1:
-							gain = GAIN_1_gc;
-							break;
-						case 2:
-							gain = GAIN_2_gc;
-							break;
-						case 4:
-							gain = GAIN_4_gc;
-							break;
-						case 8:
-							gain = GAIN_8_gc;
-							break;
-						case 16:
-							gain = GAIN_16_gc;
-							break;
-						case 32:
-							gain = GAIN_32_gc;
-							break;
-						case 64:
-							gain = GAIN_64_gc;
-							break;
-						case 128:
-							gain = GAIN_128_gc;
-							break;
-						default:
-							//chb_write(0x0000,(uint8_t*)"invalid gain",strlen("invalid gain"));
-							break;
-					}
-					//send acknowledgment if not a broadcast message
-					if(pcb->destination_addr != 0xFFFF){
-						chb_write(0x0000,(uint8_t*)(&ack),2);
-					}					
-					break;
-					
-				case 'F':
-
-					//while(!pcb->data_rcv);
-					//length = chb_read((chb_rx_data_t*)RadioMessageBuffer);
-					//set sampling frequency to what is specified
-					freq = (uint16_t)(*(int32_t*)(RadioMessageBuffer+1));
-					//send acknowledgment if not a broadcast message
-					if(pcb->destination_addr != 0xFFFF){
-						chb_write(0x0000,(uint8_t*)(&ack),2);
-					}
-					break;
-					
-				case 'S':
-					//stop the ADC if it is not already
-					if(!ADC_Sampling_Finished){
-						ADC_Stop_Sampling();
-					}
-					//otherwise, the ADC has finished sampling on its own and the data is ready to be transmitted
-					//send acknowledgment if not a broadcast message
-					if(pcb->destination_addr != 0xFFFF){
-						chb_write(0x0000,(uint8_t*)(&ack),2);
-					}
-					break;
-					
-				case 'T':
-					if(ADC_Sampling_Finished && DataAvailable && pcb->destination_addr != 0xFFFF){
-						//get number of data points collected
-						samples = ADC_Get_Num_Samples();
-						if(samples > 0){	
-							uint16_t NumMessages = ((samples*4)/CHB_MAX_PAYLOAD);
-							if ((samples*4)%CHB_MAX_PAYLOAD > 0) NumMessages++;
-							//start timeout timer
-							TCE0.CTRLA = 0x07;
-							TimedOut = 0;
-							//send the number of messages the base station should expect after this message
-							while(chb_write(0x0000,(uint8_t*)(&NumMessages),2) != CHB_SUCCESS){
-								if(TimedOut) break;
-							}
-							if(TimedOut){
-								//stop timeout counter and go back to waiting for command
-								TimedOut = 0;
-								TCE0.CTRLA = 0;
-								break;
-							}
-							//reset timeout timer
-							TimedOut = 0;
-							TCE0.CTRLFSET = 0x08;  
-							//read the data from FRAM and send it
-							for(uint16_t i =0; i<(samples*4);){	
-								if(samples*4 - i >= 100){
-									readFRAM(100,(FRAMAddress-(samples*4))+i);						
-									while(chb_write(0x0000,FRAMReadBuffer,100) != CHB_SUCCESS);
-									i += 100;
-								}
-								else{
-									readFRAM(samples*4 - i,(FRAMAddress-(samples*4))+i);
-									while(chb_write(0x0000,FRAMReadBuffer,samples*4 - i) != CHB_SUCCESS);
-									i += samples*4 - i;
-								}
-								//reset timeout timer
-								TimedOut = 0;
-								TCE0.CTRLFSET = 0x08;
-								while(!pcb->data_rcv){
-									//break if timed out waiting for response
-									if(TimedOut) break;
-								}
-								if(TimedOut) break;		
-								length = chb_read((chb_rx_data_t*)RadioMessageBuffer);							
-							}
-							//chb_write(0x0000,FRAMReadBuffer,samples*4);								
-							//write the data to SD card for good measure (make sure transmitted and collected data is the same)	
-							//writeFile(ofile, FRAMReadBuffer, samples*4);			
-						}
-						if(TimedOut){
-							//stop timeout counter and go back to waiting for command
-							TimedOut = 0;
-							TCE0.CTRLA = 0; 
-							break;
-						}														
-						DataAvailable = 0;
-					}
-					break;
-				}	
-			}					
-		}		
-	}	
+	
+	//acquisition, radio, uplink and storage run side by side: sampling and staging to FRAM happen in the ADC ISRs and the
+	//tasks below pass the blocks on. the core sleeps whenever they are all waiting
+	Queue_Init(&UplinkQueue, UplinkBlocks, sizeof(uint16_t), STREAM_BLOCKS, EVENT_QUEUE);
+	Task_Add(&StreamTask, Stream_Task, 0);
+	Task_Add(&RadioTask, Radio_Task, 1);
+	Task_Add(&UplinkTask, Uplink_Task, 2);
+	Task_Add(&ScheduleTask, Schedule_Task, 4);
+#if NODE_STORE_SD
+	Queue_Init(&StoreQueue, StoreBlocks, sizeof(uint16_t), STREAM_BLOCKS, EVENT_QUEUE);
+	Task_Add(&StoreTask, Store_Task, 3);
+#endif
+	//nothing left that needs the timers running while the radio sleeps
+	Clock_Release_Running(CLOCK_HOLD_APP);
+	Task_Run();
 }
 
+
 ISR(TCE0_OVF_vect){
 	TimedOut = 1;
+	Event_Post(EVENT_TIMEOUT);
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+/*
+ * basesim.c
+ *
+ * Created: 10/19/2026
+ */
+// Stand-in for a base station and its motes behind a pty, for trying the collector without hardware and for benchmarking
+// it. It speaks the framed link and answers the few commands the collector uses the way BaseStation.c and Node.c do:
+// flooded batches arm every mote, unicast batches get status, time and queue replies, and 'A' drains the queued
+// acquisitions as mesh records, a record from each queued mote in turn, up to a mesh queue's worth per drain.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "collector.h"
+
+typedef struct{
+	uint16_t addr;
+	int ready;	// acquisition waiting to be queued
+	int queued;
+	uint32_t samples, sent;
+	uint32_t ts;
+	uint8_t gain;
+	uint16_t rate;
+} sim_mote_t;
+
+static sim_mote_t* motes;
+static int num_motes;
+static uint32_t arm_samples;
+static unsigned long pace;
+static int out_fd;
+static uint8_t out[HL_MAX_PAYLOAD];
+static size_t out_length;
+static uint8_t out_seq;
+
+static void sim_flush(){
+	uint8_t encoded[HL_MAX_ENCODED];
+	size_t n;
+	if(!out_length) return;
+	n = hl_encode(HL_DATA, out_seq++, out, out_length, encoded);
+	if(write(out_fd, encoded, n) != (ssize_t)n) exit(0);
+	// 10 bits a byte on the wire
+	if(pace) usleep((useconds_t)(n*10*1000000ULL/pace));
+	out_length = 0;
+}
+
+static void sim_write(const uint8_t* data, size_t length){
+	while(length){
+		size_t chunk = HL_MAX_PAYLOAD - out_length;
+		if(chunk > length) chunk = length;
+		memcpy(out + out_length, data, chunk);
+		out_length += chunk;
+		data += chunk;
+		length -= chunk;
+		if(out_length == HL_MAX_PAYLOAD) sim_flush();
+	}
+}
+
+static sim_mote_t* sim_find(uint16_t addr){
+	for(int i = 0; i < num_motes; i++) if(motes[i].addr == addr) return &motes[i];
+	return NULL;
+}
+
+// sample i of a mote: a tone a little different on every mote, in microvolts at the ADC
+static int32_t sim_sample(sim_mote_t* m, uint32_t i){
+	double f = 5.0 + m->addr;
+	return (int32_t)(100000.0*sin(2*M_PI*f*i/(m->rate ? m->rate : 2000)));
+}
+
+static void sim_flood(const uint8_t* batch, size_t length){
+	size_t pos = CMD_HEADER_LENGTH;
+	if(length < CMD_HEADER_LENGTH || batch[0] != CMD_BATCH) return;
+	for(int c = 0; c < batch[3] && pos + 2 <= length; c++){
+		uint8_t op = batch[pos], n = batch[pos+1];
+		for(int i = 0; i < num_motes; i++){
+			sim_mote_t* m = &motes[i];
+			if(op == CMD_SET_GAIN && n == 1) m->gain = batch[pos+2];
+			if(op == CMD_SET_RATE && n == 2) m->rate = batch[pos+2] | (batch[pos+3] << 8);
+			if(op == CMD_ARM){
+				m->ready = 1;
+				m->queued = 0;
+				m->samples = arm_samples;
+				m->sent = 0;
+				m->ts = (uint32_t)rand();
+			}
+		}
+		pos += 2 + n;
+	}
+}
+
+static void sim_batch(sim_mote_t* m, const uint8_t* batch, size_t length){
+
+	uint8_t reply[HL_MAX_PAYLOAD], data[CMD_STATUS_LENGTH];
+	size_t r = CMD_HEADER_LENGTH, pos = CMD_HEADER_LENGTH;
+
+	if(length < CMD_HEADER_LENGTH || batch[1] != CMD_VERSION) return;
+	reply[0] = CMD_BATCH_REPLY;
+	reply[1] = CMD_VERSION;
+	reply[2] = batch[2];
+	reply[3] = 0;
+	for(int c = 0; c < batch[3] && pos + 2 <= length; c++){
+		uint8_t op = batch[pos], n = batch[pos+1], status = CMD_OK, dl = 0;
+		switch(op){
+			case CMD_STATUS:
+				data[0] = 0;
+				data[1] = m->ready;
+				memcpy(data + 2, &m->samples, 4);
+				data[6] = 1;
+				data[7] = 1;
+				data[8] = data[9] = 0;
+				dl = CMD_STATUS_LENGTH;
+				break;
+			case CMD_TIME:
+				memcpy(data, &m->ts, 4);
+				data[4] = 1;
+				dl = 5;
+				break;
+			case CMD_QUEUE:
+				if(m->ready){
+					m->ready = 0;
+					m->queued = 1;
+					m->sent = 0;
+				}
+				else status = CMD_BUSY;
+				break;
+		}
+		reply[r++] = op;
+		reply[r++] = status;
+		reply[r++] = dl;
+		memcpy(reply + r, data, dl);
+		r += dl;
+		reply[3]++;
+		pos += 2 + n;
+	}
+	sim_write(reply, r);
+}
+
+static void sim_drain(){
+
+	uint8_t record[MESH_RECORD_HEADER_LENGTH + MESH_MAX_RECORD];
+	size_t budget = MESH_QUEUE_SIZE;
+	int any = 1;
+
+	while(any){
+		any = 0;
+		for(int i = 0; i < num_motes; i++){
+			sim_mote_t* m = &motes[i];
+			uint32_t total = m->samples*SAMPLE_SIZE, chunk, offset;
+			if(!m->queued) continue;
+			chunk = total - m->sent;
+			if(chunk > MESH_MAX_RECORD - 2) chunk = MESH_MAX_RECORD - 2;
+			if(budget < MESH_RECORD_HEADER_LENGTH + 2 + chunk) continue;
+			record[0] = (uint8_t)m->addr;
+			record[1] = (uint8_t)(m->addr >> 8);
+			record[2] = (uint8_t)(2 + chunk);
+			offset = m->sent;
+			record[3] = (uint8_t)offset;
+			record[4] = (uint8_t)(offset >> 8);
+			for(uint32_t b = 0; b < chunk; b++){
+				uint32_t byte = offset + b;
+				int32_t s = sim_sample(m, byte/SAMPLE_SIZE);
+				record[5 + b] = ((uint8_t*)&s)[byte % SAMPLE_SIZE];
+			}
+			sim_write(record, MESH_RECORD_HEADER_LENGTH + 2 + chunk);
+			budget -= MESH_RECORD_HEADER_LENGTH + 2 + chunk;
+			m->sent += chunk;
+			if(m->sent >= total) m->queued = 0;
+			any = 1;
+		}
+	}
+	sim_write((const uint8_t*)"\xFF\xFF\x00", 3);
+}
+
+void basesim_run(int fd, int count, uint32_t samples, unsigned long baud){
+
+	hl_decoder_t d;
+	uint8_t buf[1024];
+
+	num_motes = count;
+	arm_samples = samples;
+	pace = baud;
+	out_fd = fd;
+	motes = calloc(count, sizeof(sim_mote_t));
+	for(int i = 0; i < count; i++){
+		motes[i].addr = i + 1;
+		motes[i].rate = 2000;
+		motes[i].gain = 1;
+	}
+	hl_decoder_init(&d);
+	for(;;){
+		ssize_t got = read(fd, buf, sizeof(buf));
+		if(got <= 0) break;
+		for(ssize_t i = 0; i < got; i++){
+			size_t pos = 0;
+			if(!hl_decode_byte(&d, buf[i]) || d.type != HL_COMMANDS) continue;
+			// messages [length, destination (2), command...]
+			while(pos < d.payload_length){
+				uint8_t length = d.payload[pos];
+				const uint8_t* msg = d.payload + pos + 1;
+				uint16_t dest;
+				if(length < 3 || pos + 1 + length > d.payload_length) break;
+				dest = msg[0] | (msg[1] << 8);
+				if(dest == BASE_ADDR && msg[2] == LOCAL_FLOOD) sim_flood(msg + 3, length - 3);
+				else if(dest == BASE_ADDR && msg[2] == LOCAL_DRAIN) sim_drain();
+				else if(msg[2] == CMD_BATCH && sim_find(dest)) sim_batch(sim_find(dest), msg + 2, length - 2);
+				pos += 1 + length;
+			}
+			sim_flush();
+		}
+	}
+	free(motes);
+}
@@ -0,0 +1,566 @@
+/*
+ * collector.c
+ *
+ * Created: 10/19/2026
+ */
+// Collects acquisitions from the motes through the base station and files them per mote.
+// Every round it floods an arm batch (gain, rate, arm) to the whole network, waits for the acquisitions, asks every mote for
+// its status and first sample time (many motes per serial frame), then has up to -c motes at a time queue their samples
+// over the mesh and drains the base station's mesh queue, putting each mote's samples back together by offset. Only the
+// motes being transferred hold a buffer, so memory stays at -c acquisitions whatever the size of the network.
+// Each finished acquisition is scaled to volts at the sensor and appended to <out>/mote_XXXX.dat as a record_t header and
+// float samples (NaN where a piece never arrived), with <out>/mote_XXXX.idx getting an index_t so records can be found by
+// time without reading the data.
+//
+//   collector [options] device
+//   collector -S [options]           runs against a stand-in base station on a pty (basesim.c)
+//   collector -B [options]           benchmark: stand-in with -M motes, one round, prints throughput
+//
+// options: -m motes (1-20,31,...)  -g gain  -r rate (Hz)  -a seconds to wait for the acquisitions  -p round period (s)
+//          -n rounds (0 forever)  -c concurrent transfers  -o output directory  -k volts scale  -b baud
+//          -M stand-in motes  -N stand-in samples per acquisition
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include "collector.h"
+
+#define RECORD_MAGIC 0x524D5347	// "GSMR"
+#define STATUS_MOTES_PER_FRAME 16	// status batches per serial frame
+#define MOTE_TIMEOUT 2.5	// s the base station waits on a mote, plus some
+#define TRANSFER_TIMEOUT 20.0	// s without a new piece before a transfer is given up
+#define STREAM_MAX 65536	// reply bytes kept for one transaction (a drain is at most a mesh queue)
+
+typedef struct{
+	uint32_t magic;
+	uint32_t network_time;	// of the first sample, local clock ticks (4 MHz) of the base station's time base
+	uint64_t host_time_ns;	// when the round was armed (CLOCK_REALTIME)
+	uint32_t rate;	// Hz
+	uint32_t count;	// samples that follow
+	uint32_t missing;	// samples that never arrived (NaN)
+	uint8_t synched;	// network_time is good
+	uint8_t gain;
+	uint8_t pad[2];
+} record_t;
+
+typedef struct{
+	uint64_t host_time_ns;
+	uint32_t network_time;
+	uint32_t pad;
+	uint64_t offset;	// of the record in the .dat file
+} index_t;
+
+enum{ MOTE_IDLE, MOTE_READY, MOTE_TRANSFER };
+
+typedef struct{
+	uint16_t addr;
+	int state;
+	uint8_t seq;	// batch seq of the pending status request
+	uint32_t samples;
+	uint32_t network_time;
+	uint8_t synched;
+	uint8_t* data;	// transfer buffer
+	uint8_t* have;	// bit per byte received
+	uint32_t got;
+	double last_progress;
+	unsigned long rounds, complete, partial, failed;
+} mote_t;
+
+typedef struct{
+	int fd;
+	hl_decoder_t dec;
+	uint8_t seq;
+	unsigned long naks, timeouts;
+	uint64_t rx_bytes;
+} link_t;
+
+typedef struct{
+	uint8_t* buf;
+	size_t length;
+	size_t pos;	// parsed up to here
+} stream_t;
+
+typedef int (*parse_fn)(stream_t* s, void* ctx);	// returns 1 once the whole reply is in
+
+static mote_t* motes;
+static int num_motes;
+static uint8_t gain = 1;
+static uint16_t rate = 2000;
+static double scale = 1.0;
+static const char* outdir = ".";
+static uint64_t round_ns;
+static uint64_t samples_filed, bytes_filed;
+static volatile sig_atomic_t stop;
+
+static double now_s(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec/1e9;
+}
+
+static uint64_t wall_ns(){
+	struct timespec t;
+	clock_gettime(CLOCK_REALTIME, &t);
+	return (uint64_t)t.tv_sec*1000000000ULL + t.tv_nsec;
+}
+
+static void on_signal(int sig){
+	(void)sig;
+	stop = 1;
+}
+
+static mote_t* find_mote(uint16_t addr){
+	for(int i = 0; i < num_motes; i++) if(motes[i].addr == addr) return &motes[i];
+	return NULL;
+}
+
+// send one frame of messages and feed the replies to parse until it has all of them or nothing came for timeout seconds. with
+// no parser, waits a moment for a nak. a nak gets the frame sent once more. returns 0 when the reply is complete, -1 otherwise
+static int transact(link_t* L, const uint8_t* payload, size_t length, parse_fn parse, void* ctx, double timeout){
+
+	uint8_t encoded[HL_MAX_ENCODED], buf[1024];
+	static uint8_t stream[STREAM_MAX];
+	stream_t s = {stream, 0, 0};
+	size_t n = hl_encode(HL_COMMANDS, L->seq++, payload, length, encoded);
+	double deadline = now_s() + (parse ? timeout : 0.05);
+	int resent = 0;
+
+	if(write(L->fd, encoded, n) != (ssize_t)n) return -1;
+	for(;;){
+		fd_set fds;
+		struct timeval tv;
+		double left = deadline - now_s();
+		ssize_t got;
+		if(left <= 0) break;
+		tv.tv_sec = (time_t)left;
+		tv.tv_usec = (suseconds_t)((left - tv.tv_sec)*1e6);
+		FD_ZERO(&fds);
+		FD_SET(L->fd, &fds);
+		if(select(L->fd + 1, &fds, NULL, NULL, &tv) <= 0) continue;
+		got = read(L->fd, buf, sizeof(buf));
+		if(got <= 0) continue;
+		L->rx_bytes += got;
+		for(ssize_t i = 0; i < got; i++){
+			if(!hl_decode_byte(&L->dec, buf[i])) continue;
+			if(L->dec.type == HL_NAK){
+				L->naks++;
+				if(resent) return -1;
+				resent = 1;
+				n = hl_encode(HL_COMMANDS, L->seq++, payload, length, encoded);
+				if(write(L->fd, encoded, n) != (ssize_t)n) return -1;
+				continue;
+			}
+			if(L->dec.type != HL_DATA) continue;
+			if(s.length + L->dec.payload_length > STREAM_MAX) return -1;
+			if(parse) deadline = now_s() + timeout;
+			memcpy(s.buf + s.length, L->dec.payload, L->dec.payload_length);
+			s.length += L->dec.payload_length;
+		}
+		if(parse && parse(&s, ctx)) return 0;
+	}
+	if(parse){
+		L->timeouts++;
+		return -1;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------- status
+
+typedef struct{
+	int first, expected, parsed;	// motes[first] on were asked in this frame
+} status_ctx_t;
+
+static int parse_status(stream_t* s, void* p){
+
+	status_ctx_t* ctx = p;
+
+	// batch replies ['b', version, seq, count, [op, status, length, data]...] one after the other
+	while(s->length - s->pos >= CMD_HEADER_LENGTH){
+		const uint8_t* r = s->buf + s->pos;
+		size_t at = CMD_HEADER_LENGTH;
+		mote_t* m = NULL;
+		if(r[0] != CMD_BATCH_REPLY){
+			// lost track of the stream, nothing more can be made of it
+			s->pos = s->length;
+			return 1;
+		}
+		for(int c = 0; c < r[3]; c++){
+			if(s->length - s->pos < at + CMD_RESULT_HEADER_LENGTH) return 0;
+			at += CMD_RESULT_HEADER_LENGTH + r[at+2];
+			if(s->length - s->pos < at) return 0;
+		}
+		for(int i = ctx->first; i < ctx->first + ctx->expected && !m; i++) if(motes[i].seq == r[2]) m = &motes[i];
+		for(size_t q = CMD_HEADER_LENGTH; m && q < at; q += CMD_RESULT_HEADER_LENGTH + r[q+2]){
+			const uint8_t* data = r + q + CMD_RESULT_HEADER_LENGTH;
+			if(r[q] == CMD_STATUS && r[q+1] == CMD_OK && r[q+2] == CMD_STATUS_LENGTH){
+				memcpy(&m->samples, data + 2, 4);
+				if(data[1] && m->samples) m->state = MOTE_READY;
+			}
+			if(r[q] == CMD_TIME && r[q+1] == CMD_OK && r[q+2] == 5){
+				memcpy(&m->network_time, data, 4);
+				m->synched = data[4];
+			}
+		}
+		s->pos += at;
+		ctx->parsed++;
+	}
+	return ctx->parsed >= ctx->expected;
+}
+
+static void get_status(link_t* L){
+
+	static const uint8_t ops[] = {CMD_STATUS, 0, CMD_TIME, 0};
+	uint8_t payload[HL_MAX_PAYLOAD], batch[CMD_HEADER_LENGTH + sizeof(ops)];
+	int first = 0;
+
+	while(first < num_motes && !stop){
+		size_t length = 0;
+		status_ctx_t ctx = {first, 0, 0};
+		int i;
+		for(i = first; i < num_motes && ctx.expected < STATUS_MOTES_PER_FRAME; i++){
+			mote_t* m = &motes[i];
+			size_t next;
+			m->state = MOTE_IDLE;
+			m->seq = (uint8_t)i;
+			batch[0] = CMD_BATCH;
+			batch[1] = CMD_VERSION;
+			batch[2] = m->seq;
+			batch[3] = 2;
+			memcpy(batch + CMD_HEADER_LENGTH, ops, sizeof(ops));
+			next = hl_add_message(payload, length, m->addr, batch, sizeof(batch));
+			if(!next) break;
+			length = next;
+			ctx.expected++;
+		}
+		transact(L, payload, length, parse_status, &ctx, ctx.expected*MOTE_TIMEOUT + 1);
+		first = i;
+	}
+}
+
+//---------------------------------------------------------------- transfers
+
+static void file_acquisition(mote_t* m){
+
+	char path[512];
+	uint32_t count = m->samples, missing = 0;
+	float* values = malloc(count*sizeof(float));
+	record_t rec;
+	index_t idx;
+	FILE* f;
+	long offset;
+
+	for(uint32_t i = 0; i < count; i++){
+		uint32_t b = i*SAMPLE_SIZE;
+		int32_t raw;
+		// all four bytes of the sample have to be there
+		if((m->have[b/8] >> (b%8) & 0xF) != 0xF){
+			values[i] = NAN;
+			missing++;
+			continue;
+		}
+		memcpy(&raw, m->data + b, 4);
+		values[i] = (float)(raw*1e-6/gain*scale);
+	}
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = RECORD_MAGIC;
+	rec.network_time = m->network_time;
+	rec.host_time_ns = round_ns;
+	rec.rate = rate;
+	rec.count = count;
+	rec.missing = missing;
+	rec.synched = m->synched;
+	rec.gain = gain;
+
+	snprintf(path, sizeof(path), "%s/mote_%04x.dat", outdir, m->addr);
+	f = fopen(path, "ab");
+	if(f){
+		fseek(f, 0, SEEK_END);
+		offset = ftell(f);
+		fwrite(&rec, sizeof(rec), 1, f);
+		fwrite(values, sizeof(float), count, f);
+		fclose(f);
+		snprintf(path, sizeof(path), "%s/mote_%04x.idx", outdir, m->addr);
+		f = fopen(path, "ab");
+		if(f){
+			memset(&idx, 0, sizeof(idx));
+			idx.host_time_ns = rec.host_time_ns;
+			idx.network_time = rec.network_time;
+			idx.offset = offset;
+			fwrite(&idx, sizeof(idx), 1, f);
+			fclose(f);
+		}
+	}
+	else perror(path);
+	free(values);
+	samples_filed += count - missing;
+	bytes_filed += (uint64_t)(count - missing)*SAMPLE_SIZE;
+	if(missing) m->partial++;
+	else m->complete++;
+}
+
+static void end_transfer(mote_t* m, int file){
+	if(file) file_acquisition(m);
+	else m->failed++;
+	free(m->data);
+	free(m->have);
+	m->data = m->have = NULL;
+	m->state = MOTE_IDLE;
+}
+
+static int parse_drain(stream_t* s, void* ctx){
+
+	(void)ctx;
+	// mesh records [origin (2), length, data] ending with [0xFF, 0xFF, 0]
+	while(s->length - s->pos >= MESH_RECORD_HEADER_LENGTH){
+		const uint8_t* r = s->buf + s->pos;
+		uint16_t origin = r[0] | (r[1] << 8);
+		uint8_t length = r[2];
+		mote_t* m;
+		if(origin == 0xFFFF && length == 0){
+			s->pos += MESH_RECORD_HEADER_LENGTH;
+			return 1;
+		}
+		if(s->length - s->pos < (size_t)MESH_RECORD_HEADER_LENGTH + length) return 0;
+		m = find_mote(origin);
+		if(m && m->state == MOTE_TRANSFER && length >= 2){
+			uint32_t offset = r[3] | (r[4] << 8), total = m->samples*SAMPLE_SIZE;
+			for(uint32_t b = 0; b < (uint32_t)length - 2 && offset + b < total; b++){
+				uint32_t at = offset + b;
+				if(m->have[at/8] & (1 << (at%8))) continue;
+				m->data[at] = r[5 + b];
+				m->have[at/8] |= 1 << (at%8);
+				m->got++;
+			}
+			m->last_progress = now_s();
+		}
+		s->pos += MESH_RECORD_HEADER_LENGTH + length;
+	}
+	return 0;
+}
+
+static int start_transfer(link_t* L, mote_t* m){
+
+	uint8_t payload[HL_MAX_PAYLOAD], batch[CMD_HEADER_LENGTH + 2] = {CMD_BATCH, CMD_VERSION, 0, 1, CMD_QUEUE, 0};
+	size_t length;
+	uint32_t total = m->samples*SAMPLE_SIZE;
+
+	m->data = malloc(total);
+	m->have = calloc((total + 7)/8 + 1, 1);
+	m->got = 0;
+	m->last_progress = now_s();
+	m->state = MOTE_TRANSFER;
+	m->seq = batch[2] = (uint8_t)(m - motes);
+	length = hl_add_message(payload, 0, m->addr, batch, sizeof(batch));
+	// the reply only says whether the mote had anything, the status already did. the records show up in the drains
+	transact(L, payload, length, NULL, NULL, 0);
+	return 0;
+}
+
+static void run_transfers(link_t* L, int concurrency){
+
+	uint8_t payload[HL_MAX_PAYLOAD];
+	size_t length = hl_add_message(payload, 0, BASE_ADDR, (const uint8_t*)"A", 1);
+	int next = 0, active;
+
+	for(;;){
+		active = 0;
+		for(int i = 0; i < num_motes; i++) if(motes[i].state == MOTE_TRANSFER) active++;
+		while(active < concurrency && next < num_motes && !stop){
+			if(motes[next].state == MOTE_READY){
+				start_transfer(L, &motes[next]);
+				active++;
+			}
+			next++;
+		}
+		if(!active || stop) break;
+		transact(L, payload, length, parse_drain, NULL, 5.0);
+		for(int i = 0; i < num_motes; i++){
+			mote_t* m = &motes[i];
+			if(m->state != MOTE_TRANSFER) continue;
+			if(m->got >= m->samples*SAMPLE_SIZE) end_transfer(m, 1);
+			else if(now_s() - m->last_progress > TRANSFER_TIMEOUT) end_transfer(m, m->got > 0);
+		}
+	}
+	for(int i = 0; i < num_motes; i++) if(motes[i].state == MOTE_TRANSFER) end_transfer(&motes[i], motes[i].got > 0);
+}
+
+//---------------------------------------------------------------- rounds
+
+static void arm(link_t* L){
+
+	uint8_t payload[HL_MAX_PAYLOAD], command[1 + CMD_HEADER_LENGTH + 3 + 4 + 2];
+	size_t c = 0;
+
+	command[c++] = LOCAL_FLOOD;
+	command[c++] = CMD_BATCH;
+	command[c++] = CMD_VERSION;
+	command[c++] = 0;
+	command[c++] = 3;
+	command[c++] = CMD_SET_GAIN;
+	command[c++] = 1;
+	command[c++] = gain;
+	command[c++] = CMD_SET_RATE;
+	command[c++] = 2;
+	command[c++] = (uint8_t)rate;
+	command[c++] = (uint8_t)(rate >> 8);
+	command[c++] = CMD_ARM;
+	command[c++] = 0;
+	round_ns = wall_ns();
+	transact(L, payload, hl_add_message(payload, 0, BASE_ADDR, command, c), NULL, NULL, 0);
+}
+
+static int parse_motes(const char* list){
+
+	const char* p = list;
+	int capacity = 16;
+
+	motes = calloc(capacity, sizeof(mote_t));
+	while(*p){
+		char* end;
+		long a = strtol(p, &end, 0), b = a;
+		if(end == p) return -1;
+		if(*end == '-') b = strtol(end + 1, &end, 0);
+		for(long x = a; x <= b; x++){
+			if(num_motes == capacity){
+				capacity *= 2;
+				motes = realloc(motes, capacity*sizeof(mote_t));
+			}
+			memset(&motes[num_motes], 0, sizeof(mote_t));
+			motes[num_motes++].addr = (uint16_t)x;
+		}
+		p = (*end == ',') ? end + 1 : end;
+		if(*end && *end != ',') return -1;
+	}
+	return num_motes ? 0 : -1;
+}
+
+static int start_standin(int sim_motes, uint32_t sim_samples, unsigned long baud, pid_t* child){
+
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	char* slave;
+
+	if(master < 0 || grantpt(master) || unlockpt(master) || !(slave = ptsname(master))) return -1;
+	*child = fork();
+	if(*child == 0){
+		struct termios tio;
+		tcgetattr(master, &tio);
+		cfmakeraw(&tio);
+		tcsetattr(master, TCSANOW, &tio);
+		basesim_run(master, sim_motes, sim_samples, baud);
+		_exit(0);
+	}
+	return hl_open_serial(slave, HL_BAUD);
+}
+
+int main(int argc, char** argv){
+
+	const char* list = NULL;
+	double wait = -1, period = 0;
+	int rounds = 0, concurrency = 4, simulate = 0, bench = 0, sim_motes = 8, opt;
+	uint32_t sim_samples = 10000;
+	unsigned long baud = HL_BAUD;
+	pid_t child = 0;
+	link_t L;
+	double t0;
+
+	while((opt = getopt(argc, argv, "m:g:r:a:p:n:c:o:k:b:M:N:SB")) != -1){
+		switch(opt){
+			case 'm': list = optarg; break;
+			case 'g': gain = (uint8_t)atoi(optarg); break;
+			case 'r': rate = (uint16_t)atoi(optarg); break;
+			case 'a': wait = atof(optarg); break;
+			case 'p': period = atof(optarg); break;
+			case 'n': rounds = atoi(optarg); break;
+			case 'c': concurrency = atoi(optarg); break;
+			case 'o': outdir = optarg; break;
+			case 'k': scale = atof(optarg); break;
+			case 'b': baud = strtoul(optarg, NULL, 0); break;
+			case 'M': sim_motes = atoi(optarg); break;
+			case 'N': sim_samples = strtoul(optarg, NULL, 0); break;
+			case 'S': simulate = 1; break;
+			case 'B': simulate = bench = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-m motes] [-g gain] [-r rate] [-a wait] [-p period] [-n rounds] [-c concurrent] "
+					"[-o dir] [-k scale] [-b baud] [-S | -B [-M motes] [-N samples]] [device]\n", argv[0]);
+				return 1;
+		}
+	}
+	if(concurrency < 1) concurrency = 1;
+	if(bench){
+		rounds = 1;
+		if(!list){
+			static char all[32];
+			snprintf(all, sizeof(all), "1-%d", sim_motes);
+			list = all;
+		}
+	}
+	if(!list || parse_motes(list)){
+		fprintf(stderr, "no motes (-m 1-20,31)\n");
+		return 1;
+	}
+	// the motes take 10000 samples an acquisition
+	if(wait < 0) wait = simulate ? 0 : 10000.0/rate + 1;
+	mkdir(outdir, 0777);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	memset(&L, 0, sizeof(L));
+	hl_decoder_init(&L.dec);
+	if(simulate) L.fd = start_standin(sim_motes, sim_samples, bench ? 0 : baud, &child);
+	else if(optind < argc) L.fd = hl_open_serial(argv[optind], baud);
+	else{
+		fprintf(stderr, "no device\n");
+		return 1;
+	}
+	if(L.fd < 0){
+		perror(simulate ? "pty" : argv[optind]);
+		return 1;
+	}
+
+	t0 = now_s();
+	for(int r = 0; (!rounds || r < rounds) && !stop; r++){
+		double start = now_s();
+		int ready = 0;
+		arm(&L);
+		while(!stop && now_s() - start < wait) usleep(100000);
+		get_status(&L);
+		for(int i = 0; i < num_motes; i++){
+			motes[i].rounds++;
+			ready += motes[i].state == MOTE_READY;
+		}
+		run_transfers(&L, concurrency);
+		fprintf(stderr, "round %d: %d/%d motes had data, %.1f s\n", r + 1, ready, num_motes, now_s() - start);
+		while(!stop && (!rounds || r + 1 < rounds) && now_s() - start < period) usleep(100000);
+	}
+
+	for(int i = 0; i < num_motes; i++){
+		mote_t* m = &motes[i];
+		fprintf(stderr, "mote %04x: %lu complete %lu partial %lu failed of %lu rounds\n", m->addr, m->complete, m->partial, m->failed, m->rounds);
+	}
+	fprintf(stderr, "link: %lu frames %lu crc errors %lu seq gaps %lu naks %lu timeouts\n", L.dec.frames, L.dec.crc_errors, L.dec.seq_gaps, L.naks, L.timeouts);
+	if(bench){
+		double t = now_s() - t0;
+		printf("RESULT motes=%d samples=%llu seconds=%.3f samples_per_s=%.0f kbytes_per_s=%.1f link_kbytes_per_s=%.1f\n",
+			num_motes, (unsigned long long)samples_filed, t, samples_filed/t, bytes_filed/t/1000, L.rx_bytes/t/1000);
+	}
+	close(L.fd);
+	if(child){
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+	}
+	free(motes);
+	return 0;
+}
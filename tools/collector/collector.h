@@ -0,0 +1,48 @@
+/*
+ * collector.h
+ *
+ * Created: 10/19/2026
+ */
+// What the collector and the base station stand-in share: the parts of the base station protocol they use.
+
+#ifndef COLLECTOR_H_
+#define COLLECTOR_H_
+
+#include <stdint.h>
+#include "../hostlink/hostlink.h"
+
+#define BASE_ADDR 0x0000
+
+// local base station commands (BaseStation.c)
+#define LOCAL_FLOOD 'W'	// 'W', command... flooded to every mote, no reply
+#define LOCAL_DRAIN 'A'	// 'A' -> mesh records [origin (2), length, data] then [0xFF, 0xFF, 0]
+
+// command batches (FirmwareLib/FirmwareLib/Command.h)
+#define CMD_BATCH 'B'
+#define CMD_BATCH_REPLY 'b'
+#define CMD_VERSION 1
+#define CMD_HEADER_LENGTH 4
+#define CMD_RESULT_HEADER_LENGTH 3
+#define CMD_SET_GAIN 0x01
+#define CMD_SET_RATE 0x02
+#define CMD_ARM 0x03
+#define CMD_STATUS 0x05
+#define CMD_QUEUE 0x06
+#define CMD_TIME 0x07
+#define CMD_STATUS_LENGTH 10
+#define CMD_OK 0
+#define CMD_BUSY 3
+
+// mesh records (FirmwareLib/FirmwareLib/Mesh.h). the motes' records are [offset in the acquisition (2), samples...]
+#define MESH_RECORD_HEADER_LENGTH 3
+#define MESH_MAX_RECORD 112
+#define MESH_QUEUE_SIZE 0x4000
+
+// samples are int32 microvolts at the ADC (before the programmable gain)
+#define SAMPLE_SIZE 4
+
+// run a base station with motes motes (addresses 1...) on fd until the other end closes. every mote arms with samples
+// samples. replies are paced to baud (0 for as fast as possible)
+void basesim_run(int fd, int motes, uint32_t samples, unsigned long baud);
+
+#endif /* COLLECTOR_H_ */
@@ -0,0 +1,218 @@
+/*
+ * energysim.c
+ *
+ * Created: 10/19/2026
+ */
+// Host simulation of a mote's power budget with the energy accounting (FirmwareLib/FirmwareLib/Energy.c).
+// The real Energy.c is compiled in and fed the power state changes a mote on a duty cycle goes through: low power listening
+// windows, hellos, acquisitions sent up the mesh, frames relayed for motes further out and optionally the SD card. The same
+// ms are counted on the side to check the accounting, which runs on a local clock that wraps during the run. Prints where
+// the charge goes and how long a battery lasts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+// stand-ins for the firmware headers Energy.c includes. the include guards keep the real ones out.
+#define CONSTANTS_AND_GLOBALS_H_
+#define TIMESYNCH_H_
+#define HAL_H_
+
+#define TRUE 1
+#define FALSE 0
+#define TS_TICKS_PER_SEC 4000000UL
+static uint32_t LocalTime;
+static uint32_t TimeSynch_Get_Local_Time(){
+	return LocalTime;
+}
+
+//a single thread has nothing to shut out
+typedef uint8_t hal_irq_t;
+#define Hal_Irq_Save() 0
+#define Hal_Irq_Restore(irq) ((void)(irq))
+
+#include "../../FirmwareLib/FirmwareLib/Energy.c"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// simulation
+
+#define HELLO_PERIOD 5000	// ms (MESH_HELLO_PERIOD)
+#define WAKEUP_MS 1	// LPL_WAKEUP_TICKS
+#define GUARD_MS 1	// LPL_GUARD_TICKS
+#define HANG_MS 50	// LPL_HANG_MS
+#define FRAME_MS 4	// a full frame at 250kbps
+#define ACK_MS 1
+#define FRAME_BYTES 96	// samples per uplink frame, 4 bytes each
+#define ADC_WARMUP_MS 100	// filter settling before the first sample
+#define SD_MS_PER_KB 5	// write time with the card powered
+#define SD_POWERUP_MS 100
+#define START_TICKS ((uint32_t)(0x100000000ULL - 30*TS_TICKS_PER_SEC))	// the local clock wraps 30 s in
+
+static const char* Names[ENERGY_SUBSYSTEMS] = {"cpu", "radio", "adc", "sd", "hv"};
+static const char* StateNames[ENERGY_SUBSYSTEMS][ENERGY_STATES] = {
+	{"power-save", "sleep 4MHz", "sleep 32MHz", "active"},
+	{"sleep", "trx off", "rx", "tx"},
+	{"off", "on", "", ""},
+	{"off", "on", "", ""},
+	{"off", "on", "", ""}
+};
+
+static struct{
+	uint32_t duration;	// ms
+	uint32_t interval;	// LPL interval, ms. 0 listens all the time
+	uint32_t window;	// ms
+	uint32_t acquire;	// ms between acquisitions, 0 for none
+	uint32_t samples;	// per acquisition
+	uint32_t rate;	// Hz
+	uint32_t relays;	// frames relayed per minute
+	uint8_t sd;	// acquisitions also go to the SD card
+	uint32_t hv;	// ms the HV supply is on per acquisition
+	uint8_t scaling;	// CLOCK_SCALING
+	uint8_t deep;	// CLOCK_DEEP_SLEEP
+	uint32_t battery;	// mAh
+} cfg = {3600000, 1000, 10, 600000, 10000, 1000, 0, FALSE, 0, TRUE, TRUE, 2600};
+
+static uint64_t RefMs[ENERGY_SUBSYSTEMS][ENERGY_STATES];	// counted on the side
+
+static void Usage(){
+	fprintf(stderr, "usage: energysim [-d duration s] [-i lpl interval ms] [-w lpl window ms] [-a acquisition period s]\n"
+		"                 [-n samples] [-f rate Hz] [-R relayed frames/min] [-s (store on SD)] [-H hv ms per acquisition]\n"
+		"                 [-c clock scaling 0/1] [-p power-save 0/1] [-b battery mAh] [-m subsystem,state,uA ...]\n");
+	exit(1);
+}
+
+int main(int argc, char** argv){
+
+	int opt;
+	unsigned sub, state, uA;
+	uint8_t states[ENERGY_SUBSYSTEMS];
+	uint32_t t, phase, queued = 0, pos = 0, relays = 0;
+	uint32_t NextHello = HELLO_PERIOD/2, NextAcquire, NextRelay, AdcUntil = 0, SdUntil = 0, HvUntil = 0, HangUntil = 0;
+	uint32_t RxUntil = 0, CpuUntil = 0, frames = 0;
+	uint8_t burst = FALSE, sampling = FALSE;
+	uint64_t total = 0, ref = 0, RefCharge;
+	double avg;
+
+	while((opt = getopt(argc, argv, "d:i:w:a:n:f:R:sH:c:p:b:m:")) != -1){
+		switch(opt){
+		case 'd': cfg.duration = atoi(optarg)*1000; break;
+		case 'i': cfg.interval = atoi(optarg); break;
+		case 'w': cfg.window = atoi(optarg); break;
+		case 'a': cfg.acquire = atoi(optarg)*1000; break;
+		case 'n': cfg.samples = atoi(optarg); break;
+		case 'f': cfg.rate = atoi(optarg); break;
+		case 'R': cfg.relays = atoi(optarg); break;
+		case 's': cfg.sd = TRUE; break;
+		case 'H': cfg.hv = atoi(optarg); break;
+		case 'c': cfg.scaling = atoi(optarg) != 0; break;
+		case 'p': cfg.deep = atoi(optarg) != 0; break;
+		case 'b': cfg.battery = atoi(optarg); break;
+		case 'm':
+			if(sscanf(optarg, "%u,%u,%u", &sub, &state, &uA) != 3 || sub >= ENERGY_SUBSYSTEMS || state >= ENERGY_STATES
+				|| uA > 0xFFFF) Usage();
+			Energy_Set_Current(sub, state, uA);
+			break;
+		default: Usage();
+		}
+	}
+	if(!cfg.duration || !cfg.rate || (cfg.interval && cfg.window + 2*GUARD_MS + WAKEUP_MS >= cfg.interval)) Usage();
+	NextAcquire = cfg.acquire ? cfg.acquire/2 : 0xFFFFFFFF;
+	NextRelay = cfg.relays ? 60000/cfg.relays : 0xFFFFFFFF;
+
+	LocalTime = START_TICKS;
+	Energy_Reset();
+	memset(states, 0xFF, sizeof(states));
+	for(t=0;t<cfg.duration;t++){
+		uint8_t radio, cpu = ENERGY_CPU_SLEEP_SLOW, listening;
+
+		//the listen window, lined up on the interval
+		phase = cfg.interval ? t%cfg.interval : 0;
+		listening = !cfg.interval || (phase >= WAKEUP_MS && phase < WAKEUP_MS + 2*GUARD_MS + cfg.window);
+		radio = !cfg.interval ? ENERGY_RADIO_RX : (phase < WAKEUP_MS ? ENERGY_RADIO_IDLE :
+			(listening ? ENERGY_RADIO_RX : ENERGY_RADIO_SLEEP));
+		if(cfg.interval && phase == 0) CpuUntil = t + 1;	// LPL_Poll
+
+		//work that comes due: hellos, acquisitions and relayed frames go out one after another in the parent's windows
+		if(t >= NextHello){
+			queued++;
+			NextHello += HELLO_PERIOD;
+		}
+		if(t >= NextAcquire){
+			sampling = TRUE;
+			AdcUntil = t + ADC_WARMUP_MS + (uint64_t)cfg.samples*1000/cfg.rate;
+			HvUntil = t + cfg.hv;
+			NextAcquire += cfg.acquire;
+		}
+		if(sampling && t >= AdcUntil){
+			sampling = FALSE;
+			queued += (cfg.samples + FRAME_BYTES/4 - 1)/(FRAME_BYTES/4);
+			if(cfg.sd) SdUntil = t + SD_POWERUP_MS + (uint64_t)cfg.samples*4*SD_MS_PER_KB/1024;
+		}
+		if(t >= NextRelay){
+			relays++;
+			NextRelay += 60000/cfg.relays;
+		}
+		if(relays && listening && t >= RxUntil){
+			relays--;
+			RxUntil = t + FRAME_MS;
+			HangUntil = RxUntil + HANG_MS;
+			queued++;
+		}
+		if(!burst && queued && t >= RxUntil && (listening || t < HangUntil)){
+			burst = TRUE;
+			pos = 0;
+		}
+
+		//radio, above the listening schedule
+		if(t < HangUntil) radio = ENERGY_RADIO_RX;
+		if(t < RxUntil) cpu = ENERGY_CPU_ACTIVE;
+		if(burst){
+			radio = (pos < FRAME_MS) ? ENERGY_RADIO_TX : ENERGY_RADIO_RX;
+			cpu = ENERGY_CPU_ACTIVE;
+			if(++pos == FRAME_MS + ACK_MS){
+				pos = 0;
+				frames++;
+				if(!--queued){
+					burst = FALSE;
+					HangUntil = t + 1 + HANG_MS;
+				}
+			}
+		}
+		if(t < CpuUntil) cpu = ENERGY_CPU_ACTIVE;
+		//the ADC holds the clock fast while sampling, and the radio holds it running while awake
+		if(cpu == ENERGY_CPU_SLEEP_SLOW && (!cfg.scaling || sampling)) cpu = ENERGY_CPU_SLEEP;
+		if(cpu == ENERGY_CPU_SLEEP_SLOW && cfg.deep && radio == ENERGY_RADIO_SLEEP) cpu = ENERGY_CPU_STOP;
+
+		uint8_t now[ENERGY_SUBSYSTEMS] = {cpu, radio, sampling, t < SdUntil, t < HvUntil};
+		for(sub=0;sub<ENERGY_SUBSYSTEMS;sub++){
+			if(now[sub] != states[sub]) Energy_Set(sub, now[sub]);
+			states[sub] = now[sub];
+			RefMs[sub][now[sub]]++;
+		}
+		LocalTime += TS_TICKS_PER_SEC/1000;
+		if(t%HELLO_PERIOD == 0) Energy_Poll();
+	}
+
+	printf("subsystem  state         time_s    share     uA  charge_mC\n");
+	for(sub=0;sub<ENERGY_SUBSYSTEMS;sub++){
+		uint32_t charge = Energy_Get_Charge(sub);
+		RefCharge = 0;
+		for(state=0;state<ENERGY_STATES;state++){
+			uint32_t ms = Energy_Get_Ms(sub, state);
+			RefCharge += RefMs[sub][state]*Current[sub][state];
+			if(!StateNames[sub][state][0]) continue;
+			printf("%-10s %-12s %8.1f %7.3f%% %6u\n", Names[sub], StateNames[sub][state], ms/1000.0, ms*100.0/cfg.duration,
+				Current[sub][state]);
+		}
+		printf("%-10s %-12s %8s %8s %6s %10.1f\n", Names[sub], "total", "", "", "", charge/1000.0);
+		total += charge;
+		ref += RefCharge/1000;
+	}
+	avg = (double)total*1000/Energy_Get_Elapsed();
+	printf("RESULT duration=%u elapsed_ms=%u frames=%u charge_mC=%.1f reference_mC=%.1f avg_uA=%.1f battery_days=%.1f\n",
+		cfg.duration/1000, Energy_Get_Elapsed(), frames, total/1000.0, ref/1000.0, avg,
+		avg > 0 ? cfg.battery*1000.0/avg/24 : 0);
+	return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * hostdump.c
+ *
+ * Created: 10/19/2026
+ */
+// Talk to the base station over the framed link: send messages (one commands frame) and print the frames that come back.
+//   hostdump [-b baud] [-t seconds] [-m dest:hexcommand]... device
+// e.g. hostdump -m 0000:4b /dev/ttyUSB0 asks for the link table ('K'). device - reads frames from stdin instead.
+// the data frames' payloads are printed in hex, one frame per line, followed by the link stats.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include "hostlink.h"
+
+static size_t parse_hex(const char* s, uint8_t* out, size_t max){
+	size_t n = 0;
+	while(s[0] && s[1] && n < max){
+		unsigned v;
+		if(sscanf(s, "%2x", &v) != 1) break;
+		out[n++] = (uint8_t)v;
+		s += 2;
+	}
+	return n;
+}
+
+int main(int argc, char** argv){
+
+	unsigned long baud = HL_BAUD;
+	double seconds = 2;
+	uint8_t payload[HL_MAX_PAYLOAD], command[HL_MAX_PAYLOAD], encoded[HL_MAX_ENCODED], buf[512];
+	size_t length = 0, n;
+	hl_decoder_t d;
+	struct timeval start, now;
+	int fd, opt;
+
+	while((opt = getopt(argc, argv, "b:t:m:")) != -1){
+		switch(opt){
+			case 'b': baud = strtoul(optarg, NULL, 0); break;
+			case 't': seconds = atof(optarg); break;
+			case 'm':{
+				unsigned dest;
+				const char* colon = strchr(optarg, ':');
+				if(!colon || sscanf(optarg, "%x", &dest) != 1){
+					fprintf(stderr, "bad message %s\n", optarg);
+					return 1;
+				}
+				n = parse_hex(colon + 1, command, sizeof(command));
+				length = hl_add_message(payload, length, (uint16_t)dest, command, n);
+				if(!length){
+					fprintf(stderr, "messages don't fit in a frame\n");
+					return 1;
+				}
+				break;
+			}
+			default:
+				fprintf(stderr, "usage: %s [-b baud] [-t seconds] [-m dest:hexcommand]... device\n", argv[0]);
+				return 1;
+		}
+	}
+	if(optind >= argc){
+		fprintf(stderr, "no device\n");
+		return 1;
+	}
+	fd = strcmp(argv[optind], "-") ? hl_open_serial(argv[optind], baud) : 0;
+	if(fd < 0){
+		perror(argv[optind]);
+		return 1;
+	}
+	if(length){
+		n = hl_encode(HL_COMMANDS, 0, payload, length, encoded);
+		if(write(fd, encoded, n) != (ssize_t)n){
+			perror("write");
+			return 1;
+		}
+	}
+
+	hl_decoder_init(&d);
+	gettimeofday(&start, NULL);
+	for(;;){
+		fd_set fds;
+		struct timeval tv = {0, 100000};
+		ssize_t got;
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+		gettimeofday(&now, NULL);
+		if(fd && (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec)/1e6 > seconds) break;
+		if(select(fd + 1, &fds, NULL, NULL, &tv) <= 0) continue;
+		got = read(fd, buf, sizeof(buf));
+		if(got <= 0){
+			if(!fd) break;
+			continue;
+		}
+		for(ssize_t i = 0; i < got; i++){
+			if(!hl_decode_byte(&d, buf[i])) continue;
+			if(d.type == HL_NAK){
+				printf("nak seq %u last taken %u\n", d.seq, d.payload_length ? d.payload[0] : 0);
+				continue;
+			}
+			printf("seq %3u len %3zu:", d.seq, d.payload_length);
+			for(size_t j = 0; j < d.payload_length; j++) printf(" %02x", d.payload[j]);
+			printf("\n");
+		}
+	}
+	fprintf(stderr, "frames %lu crc errors %lu seq gaps %lu\n", d.frames, d.crc_errors, d.seq_gaps);
+	return 0;
+}
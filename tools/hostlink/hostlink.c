@@ -0,0 +1,141 @@
+/*
+ * hostlink.c
+ *
+ * Created: 10/19/2026
+ */
+#include "hostlink.h"
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+// CRC-16/CCITT-FALSE, same as _crc_xmodem_update starting at 0xFFFF on the base station
+uint16_t hl_crc16(const uint8_t* data, size_t length){
+	uint16_t crc = 0xFFFF;
+	for(size_t i = 0; i < length; i++){
+		crc ^= (uint16_t)data[i] << 8;
+		for(int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+void hl_decoder_init(hl_decoder_t* d){
+	memset(d, 0, sizeof(*d));
+}
+
+static int hl_end_frame(hl_decoder_t* d){
+
+	int good = 0;
+	uint16_t crc;
+
+	if(!d->discard && d->length >= HL_HEADER_LENGTH + HL_CRC_LENGTH){
+		size_t n = d->length - HL_CRC_LENGTH;
+		crc = hl_crc16(d->frame, n);
+		if(d->frame[n] == (uint8_t)crc && d->frame[n+1] == (uint8_t)(crc >> 8)){
+			d->type = d->frame[0];
+			d->seq = d->frame[1];
+			if(d->have_seq && d->seq != d->next_seq) d->seq_gaps++;
+			d->have_seq = 1;
+			d->next_seq = d->seq + 1;
+			d->payload = d->frame + HL_HEADER_LENGTH;
+			d->payload_length = n - HL_HEADER_LENGTH;
+			d->frames++;
+			good = 1;
+		}
+		else d->crc_errors++;
+	}
+	else if(d->length || d->discard) d->crc_errors++;
+	d->length = 0;
+	d->code = d->left = 0;
+	d->discard = 0;
+	return good;
+}
+
+static void hl_put(hl_decoder_t* d, uint8_t byte){
+	// too long for a frame, skip to the next zero
+	if(d->length >= HL_MAX_FRAME) d->discard = 1;
+	else d->frame[d->length++] = byte;
+}
+
+int hl_decode_byte(hl_decoder_t* d, uint8_t byte){
+	if(byte == 0) return hl_end_frame(d);
+	if(d->discard) return 0;
+	if(d->left == 0){
+		// start of a block. the block before it ended in a zero unless it was a full one
+		if(d->code && d->code != 0xFF) hl_put(d, 0);
+		d->code = byte;
+		d->left = byte - 1;
+	}
+	else{
+		hl_put(d, byte);
+		d->left--;
+	}
+	return 0;
+}
+
+size_t hl_encode(uint8_t type, uint8_t seq, const uint8_t* payload, size_t length, uint8_t* out){
+
+	uint8_t frame[HL_MAX_FRAME];
+	size_t n = 0, start = 0, end;
+	uint16_t crc;
+
+	if(length > HL_MAX_PAYLOAD) return 0;
+	frame[0] = type;
+	frame[1] = seq;
+	memcpy(frame + HL_HEADER_LENGTH, payload, length);
+	length += HL_HEADER_LENGTH;
+	crc = hl_crc16(frame, length);
+	frame[length++] = (uint8_t)crc;
+	frame[length++] = (uint8_t)(crc >> 8);
+
+	for(;;){
+		for(end = start; end < length && end - start < 254 && frame[end] != 0; end++);
+		out[n++] = (uint8_t)(end - start + 1);
+		memcpy(out + n, frame + start, end - start);
+		n += end - start;
+		if(end >= length) break;
+		start = (end - start == 254) ? end : end + 1;
+	}
+	out[n++] = 0;
+	return n;
+}
+
+size_t hl_add_message(uint8_t* payload, size_t length, uint16_t dest, const uint8_t* command, size_t command_length){
+	if(command_length + 2 > 0xFF || length + 3 + command_length > HL_MAX_PAYLOAD) return 0;
+	payload[length] = (uint8_t)(command_length + 2);
+	payload[length+1] = (uint8_t)dest;
+	payload[length+2] = (uint8_t)(dest >> 8);
+	memcpy(payload + length + 3, command, command_length);
+	return length + 3 + command_length;
+}
+
+int hl_open_serial(const char* path, unsigned long baud){
+
+	struct termios tio;
+	speed_t speed;
+	int fd;
+
+	switch(baud){
+		case 57600: speed = B57600; break;
+		case 115200: speed = B115200; break;
+		case 230400: speed = B230400; break;
+		case 460800: speed = B460800; break;
+		case 500000: speed = B500000; break;
+		case 921600: speed = B921600; break;
+		case 1000000: speed = B1000000; break;
+		case 2000000: speed = B2000000; break;
+		default: return -1;
+	}
+	fd = open(path, O_RDWR | O_NOCTTY);
+	if(fd < 0) return -1;
+	// a pty stand-in has no baud rate, so only the raw mode has to stick
+	if(tcgetattr(fd, &tio) == 0){
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 1;
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	return fd;
+}
@@ -0,0 +1,52 @@
+/*
+ * hostlink.h
+ *
+ * Created: 10/19/2026
+ */
+// Host side of the framed serial link to the base station (FirmwareLib/FirmwareLib/HostLink.h has the frame format).
+// Frames are [type, seq, payload..., crc (2 bytes)], COBS encoded and ended by a zero byte.
+
+#ifndef HOSTLINK_HOST_H_
+#define HOSTLINK_HOST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HL_COMMANDS 0x01
+#define HL_DATA 0x02
+#define HL_NAK 0x03
+#define HL_HEADER_LENGTH 2
+#define HL_CRC_LENGTH 2
+#define HL_MAX_PAYLOAD 250
+#define HL_MAX_FRAME (HL_HEADER_LENGTH + HL_MAX_PAYLOAD + HL_CRC_LENGTH)
+#define HL_MAX_ENCODED (HL_MAX_FRAME + HL_MAX_FRAME/254 + 2)	// codes and the ending zero
+#define HL_BAUD 1000000
+
+typedef struct{
+	uint8_t frame[HL_MAX_FRAME];
+	size_t length;
+	uint8_t code, left;
+	int discard;
+	// set when hl_decode_byte returns 1
+	uint8_t type, seq;
+	const uint8_t* payload;
+	size_t payload_length;
+	// stats
+	unsigned long frames, crc_errors, seq_gaps;
+	int have_seq;
+	uint8_t next_seq;
+} hl_decoder_t;
+
+uint16_t hl_crc16(const uint8_t* data, size_t length);
+void hl_decoder_init(hl_decoder_t* d);
+// feed a byte from the link. returns 1 when it completes a good frame (type, seq, payload filled in), 0 otherwise
+int hl_decode_byte(hl_decoder_t* d, uint8_t byte);
+// build an encoded frame in out (HL_MAX_ENCODED bytes). returns its length, 0 if the payload is too long
+size_t hl_encode(uint8_t type, uint8_t seq, const uint8_t* payload, size_t length, uint8_t* out);
+// add a message [length, destination, command] to a commands payload being built. returns the new payload length, 0 if it
+// doesn't fit
+size_t hl_add_message(uint8_t* payload, size_t length, uint16_t dest, const uint8_t* command, size_t command_length);
+// open a serial device raw at baud. returns the fd or -1
+int hl_open_serial(const char* path, unsigned long baud);
+
+#endif /* HOSTLINK_HOST_H_ */
@@ -0,0 +1,121 @@
+/*
+ * HalSim.h
+ *
+ * Created: 10/19/2026
+ */
+// Linux backend of FirmwareLib/FirmwareLib/Hal.h, pulled in when the firmware is built with HAL_SIM. the calls land in
+// halsim.c, which keeps the pins, SPI modules, USART, EEPROM, timers and RTC and passes the bytes on to the chip models in
+// chips.c. time is simulated: SPI and USART bytes take what they would at the module's clock, delays and wait loops
+// (Hal_Spin) move the clock on and a sleep lasts until the next interrupt, nothing else costs anything. the firmware's
+// ISR()s are plain functions that halsim.c calls as the interrupts come in.
+
+#ifndef HALSIM_H_
+#define HALSIM_H_
+
+#include <stdint.h>
+#include <avr/interrupt.h>	// ISR(), the stand-in in stub/
+
+typedef uint8_t hal_irq_t;
+hal_irq_t Hal_Irq_Save();
+void Hal_Irq_Restore(hal_irq_t irq);
+void Hal_Irq_Off();
+#define Hal_Irq_On() Hal_Irq_Restore(1)
+void Hal_Reset();	// ends the run
+void Hal_Irq_Levels_On(uint8_t levels);
+void Hal_Irq_Levels_Off(uint8_t levels);
+
+typedef uint8_t hal_port_t;
+#define HAL_PORTA 0
+#define HAL_PORTB 1
+#define HAL_PORTC 2
+#define HAL_PORTD 3
+#define HAL_PORTE 4
+#define HAL_PORTF 5
+void Hal_Gpio_Set(hal_port_t port, uint8_t pins);
+void Hal_Gpio_Clr(hal_port_t port, uint8_t pins);
+void Hal_Gpio_Output(hal_port_t port, uint8_t pins);
+void Hal_Gpio_Input(hal_port_t port, uint8_t pins);
+void Hal_Gpio_Pullup(hal_port_t port, uint8_t pin);
+uint8_t Hal_Gpio_Get_Out(hal_port_t port);
+void Hal_Gpio_Pin_Ctrl(hal_port_t port, uint8_t pin, uint8_t ctrl);
+uint8_t Hal_Gpio_Get_Pin_Ctrl(hal_port_t port, uint8_t pin);
+void Hal_Gpio_Int_Ctrl(hal_port_t port, uint8_t ctrl);
+uint8_t Hal_Gpio_Get_Int_Ctrl(hal_port_t port);
+void Hal_Gpio_Int0_Mask(hal_port_t port, uint8_t pins);
+uint8_t Hal_Gpio_Get_Int0_Mask(hal_port_t port);
+
+typedef uint8_t hal_spi_t;
+#define HAL_SPIC 0
+#define HAL_SPID 1
+void Hal_Spi_Ctrl(hal_spi_t spi, uint8_t ctrl);
+void Hal_Spi_Int_Off(hal_spi_t spi);
+uint8_t Hal_Spi_Transfer(hal_spi_t spi, uint8_t data);
+
+typedef uint8_t hal_usart_t;
+#define HAL_USARTC0 0
+void Hal_Usart_Baud(hal_usart_t usart, uint16_t bsel);
+void Hal_Usart_Ctrla(hal_usart_t usart, uint8_t ctrla);
+uint8_t Hal_Usart_Get_Ctrla(hal_usart_t usart);
+void Hal_Usart_Ctrlb(hal_usart_t usart, uint8_t ctrlb);
+uint8_t Hal_Usart_Get_Ctrlb(hal_usart_t usart);
+void Hal_Usart_Ctrlc(hal_usart_t usart, uint8_t ctrlc);
+uint8_t Hal_Usart_Status(hal_usart_t usart);
+void Hal_Usart_Clear_Status(hal_usart_t usart, uint8_t flags);
+void Hal_Usart_Put(hal_usart_t usart, uint8_t data);
+uint8_t Hal_Usart_Get(hal_usart_t usart);
+
+void Hal_Eeprom_Unmap();
+void Hal_Eeprom_Write(uint16_t addr, uint8_t value);
+uint8_t Hal_Eeprom_Read(uint16_t addr);
+
+typedef uint8_t hal_timer_t;
+#define HAL_TCD1 0
+#define HAL_TCE0 1
+#define HAL_TCF0 2
+#define HAL_TCC0 3
+#define HAL_TCD0 4
+#define HAL_CCA 0
+#define HAL_CCB 1
+#define HAL_CCC 2
+#define HAL_CCD 3
+void Hal_Timer_Clksel(hal_timer_t tc, uint8_t clksel);
+uint8_t Hal_Timer_Get_Clksel(hal_timer_t tc);
+uint8_t Hal_Timer_Running(hal_timer_t tc);
+void Hal_Timer_Reset(hal_timer_t tc);
+void Hal_Timer_Ctrlb(hal_timer_t tc, uint8_t ctrlb);
+void Hal_Timer_Ctrld(hal_timer_t tc, uint8_t ctrld);
+void Hal_Timer_Int_Ctrlb(hal_timer_t tc, uint8_t intctrlb);
+uint8_t Hal_Timer_Get_Int_Ctrlb(hal_timer_t tc);
+uint8_t Hal_Timer_Flags(hal_timer_t tc);
+void Hal_Timer_Clear_Flags(hal_timer_t tc, uint8_t flags);
+void Hal_Timer_Count(hal_timer_t tc, uint16_t cnt);
+uint16_t Hal_Timer_Get_Count(hal_timer_t tc);
+void Hal_Timer_Period(hal_timer_t tc, uint16_t per);
+uint16_t Hal_Timer_Get_Period(hal_timer_t tc);
+void Hal_Timer_Cc(hal_timer_t tc, uint8_t ch, uint16_t value);
+uint16_t Hal_Timer_Get_Cc(hal_timer_t tc, uint8_t ch);
+
+void Hal_Event_Mux(uint8_t ch, uint8_t mux);
+
+void Hal_Rtc_Source(uint8_t src);
+void Hal_Rtc_Wait();
+void Hal_Rtc_Ctrl(uint8_t ctrl);
+void Hal_Rtc_Period(uint16_t per);
+void Hal_Rtc_Count(uint16_t cnt);
+uint16_t Hal_Rtc_Get_Count();
+void Hal_Rtc_Compare(uint16_t comp);
+void Hal_Rtc_Int_Ctrl(uint8_t intctrl);
+uint8_t Hal_Rtc_Get_Int_Ctrl();
+void Hal_Rtc_Clear_Flags(uint8_t flags);
+
+void Hal_Clock_32MHz_Calibrated();
+void Hal_Clock_Prescalers(uint8_t psadiv, uint8_t psbcdiv);
+
+void Hal_Sleep(uint8_t mode);
+
+void Hal_Delay_Us(double us);
+void Hal_Delay_Ms(double ms);
+void Hal_Nop();
+void Hal_Spin();
+
+#endif /* HALSIM_H_ */
@@ -0,0 +1,877 @@
+/*
+ * chips.c
+ *
+ * Created: 10/19/2026
+ */
+// Models of the chips on the board's SPI buses, as far as the drivers use them:
+//  - FM25V05 FRAM on SPIC, CS_FRAM on PB3. WREN, WRDI, RDSR, RDID, READ and WRITE with the write enable latch
+//  - MCP23S17 port expander on SPIC, CS on PA3. registers in bank 0 with sequential addressing
+//  - SD card in SPI mode on SPIC, its chip select on the port expander's GPB3 and power on PF5 (Ext1Power). block
+//    addressed like an SDHC card, backed by a disk image file. CMD0, 1, 8, 12, 17, 18, 24, 25, 55, 58 and ACMD41. a written
+//    block keeps the card busy for Sd_Write_Us
+//  - AD7767 on SPIC, CS on PF1 and data ready on PF0. converts at the rate it is started with, each conversion is a data
+//    ready pulse and the next 24 bits read out
+//  - the two filter muxes on SPIC, chip selects on PE4 and PC1. set_filter writes both at once, so they only listen
+//  - AT86RF212 on SPID, SEL on PD4, RST on PD0, SLP_TR on PD1 and IRQ on PD2. the state machine with its transition times,
+//    sleep, the frame buffer and the IRQ line. a frame sent with TX_START takes its air time at the rate TRX_CTRL_2 sets and
+//    in TX_ARET_ON one clear CCA before it, then waits for an ack (Radio_Acks) and retries as XAH_CTRL_0 says. frames from
+//    other nodes come in with Radio_Receive, with RX_START after the SHR and TRX_END at the end, filtered and acked in
+//    RX_AACK_ON
+// the port expander, FRAM, ADC and muxes are on the rail switched by PC0 (ADCPower). a chip selected without power is an
+// error, and the port expander comes up reset whenever the rail does.
+
+#include <string.h>
+#include "sim.h"
+
+#define TRUE 1
+#define FALSE 0
+
+static uint8_t Rail(){
+	return Sim_Driven_High(HAL_PORTC, 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// FM25V05 FRAM
+
+#define FR_WRSR 0x01
+#define FR_WRITE 0x02
+#define FR_READ 0x03
+#define FR_WRDI 0x04
+#define FR_RDSR 0x05
+#define FR_WREN 0x06
+#define FR_RDID 0x9F
+#define FR_WEL_bm 0x02
+
+uint8_t Fram_Mem[65536];
+static uint8_t FrWel, FrOp, FrBytes;
+static uint16_t FrAddr;
+
+static uint8_t Fram_Selected(){
+	return Sim_Driven_Low(HAL_PORTB, 3);
+}
+
+static void Fram_Reset(){
+	FrWel = FALSE;
+}
+
+static void Fram_Select(uint8_t on){
+	//a write that got to its data clears the latch when it ends
+	if(!on && FrOp == FR_WRITE && FrBytes > 3) FrWel = FALSE;
+	FrOp = 0;
+	FrBytes = 0;
+}
+
+static uint8_t Fram_Transfer(uint8_t mosi){
+
+	static const uint8_t id[9] = {0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0xC2, 0x23, 0x00};
+	uint8_t n = FrBytes;
+
+	if(FrBytes < 0xFF) FrBytes++;
+	if(!n){
+		FrOp = mosi;
+		switch(mosi){
+		case FR_WREN: FrWel = TRUE; break;
+		case FR_WRDI: FrWel = FALSE; break;
+		case FR_READ: case FR_WRITE: case FR_RDSR: case FR_RDID: case FR_WRSR: break;
+		default: Sim_Error("FRAM: opcode 0x%02x", mosi);
+		}
+		return 0xFF;
+	}
+	switch(FrOp){
+	case FR_RDSR:
+		return FrWel ? FR_WEL_bm : 0x00;
+	case FR_RDID:
+		return id[(n - 1)%sizeof(id)];
+	case FR_READ:
+	case FR_WRITE:
+		if(n == 1){
+			FrAddr = mosi << 8;
+			return 0xFF;
+		}
+		if(n == 2){
+			FrAddr |= mosi;
+			return 0xFF;
+		}
+		if(FrOp == FR_READ) return Fram_Mem[FrAddr++];
+		if(!FrWel){
+			if(n == 3) Sim_Error("FRAM: write without WREN");
+			return 0xFF;
+		}
+		Fram_Mem[FrAddr++] = mosi;
+		return 0xFF;
+	case FR_WREN:
+	case FR_WRDI:
+		Sim_Error("FRAM: bytes after opcode 0x%02x without CS going high", FrOp);
+		FrOp = 0;
+	}
+	return 0xFF;
+}
+
+static Sim_Chip_t Fram = {"FRAM", HAL_SPIC, Rail, Fram_Selected, Fram_Reset, Fram_Select, Fram_Transfer};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// MCP23S17 port expander
+
+#define PX_REGS 0x16
+#define PX_IODIRA 0x00
+#define PX_IODIRB 0x01
+#define PX_GPIOA 0x12
+#define PX_GPIOB 0x13
+#define PX_OLATA 0x14
+#define PX_OLATB 0x15
+
+static uint8_t PxReg[PX_REGS];
+static uint8_t PxBytes, PxRead, PxAddr;
+
+uint8_t PortEx_Reg(uint8_t reg){
+	return PxReg[reg];
+}
+
+static uint8_t PortEx_Selected(){
+	return Sim_Driven_Low(HAL_PORTA, 3);
+}
+
+static void PortEx_Reset(){
+	memset(PxReg, 0, sizeof(PxReg));
+	PxReg[PX_IODIRA] = PxReg[PX_IODIRB] = 0xFF;
+}
+
+static void PortEx_Select(uint8_t on){
+	PxBytes = 0;
+}
+
+static Sim_Chip_t Sd;
+
+static uint8_t PortEx_Transfer(uint8_t mosi){
+
+	uint8_t miso = 0xFF, reg;
+
+	switch(PxBytes){
+	case 0:
+		if((mosi & 0xFE) != 0x40) Sim_Error("port expander: opcode 0x%02x", mosi);
+		PxRead = mosi & 0x01;
+		PxBytes++;
+		return 0xFF;
+	case 1:
+		if(mosi >= PX_REGS) Sim_Error("port expander: register 0x%02x", mosi);
+		PxAddr = mosi%PX_REGS;
+		PxBytes++;
+		return 0xFF;
+	}
+	reg = PxAddr;
+	PxAddr = (PxAddr + 1)%PX_REGS;
+	if(PxRead){
+		if(Sd.on) Sim_Error("port expander read with the sd card selected");
+		if(reg == PX_GPIOA || reg == PX_GPIOB) miso = PxReg[reg + 2] & ~PxReg[reg - PX_GPIOA];	//inputs read low
+		else miso = PxReg[reg];
+		return miso;
+	}
+	if(reg == PX_GPIOA || reg == PX_GPIOB) reg += 2;	//writes to GPIO go to the latch
+	PxReg[reg] = mosi;
+	//the sd card's select is on GPB3
+	Sim_Update_Selects();
+	return miso;
+}
+
+//the sd card's cs can only be changed by talking to the expander with the card still selected. SO only drives on reads,
+//so it counts as a listener and PortEx_Transfer checks the reads
+static Sim_Chip_t PortEx = {"port expander", HAL_SPIC, Rail, PortEx_Selected, PortEx_Reset, PortEx_Select,
+	PortEx_Transfer, TRUE};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// SD card
+
+#define SD_SECTOR 512
+#define SD_ACCESS_BYTES 8	// 0xFF before a data token
+#define SD_INIT_TRIES 3	// ACMD41s before the card leaves idle
+#define SD_STOP_US 100	// busy after a multiple block write or read is stopped
+#define SD_R1_IDLE 0x01
+#define SD_R1_ILLEGAL 0x04
+
+enum{
+	SD_COMMAND,
+	SD_WRITE_TOKEN,
+	SD_WRITE_DATA,
+	SD_READ_MULTI
+};
+
+uint32_t Sd_Write_Us = 500;
+static FILE* SdImage;
+static uint8_t SdCmd[6], SdCmdBytes;
+static uint8_t SdIdle, SdApp, SdInits, SdMode, SdMulti;
+static uint8_t SdQueue[SD_SECTOR + 16];
+static uint16_t SdHead, SdLength;
+static uint8_t SdBlock[SD_SECTOR + 2];
+static uint16_t SdBytes;
+static uint32_t SdSector, SdWritten;
+static uint64_t SdBusyUntil;
+
+uint32_t Sd_Blocks_Written(){
+	return SdWritten;
+}
+
+static uint8_t Sd_Powered(){
+	return Sim_Driven_High(HAL_PORTF, 5);
+}
+
+static uint8_t Sd_Selected(){
+	return PortEx.up && !(PxReg[PX_IODIRB] & 0x08) && !(PxReg[PX_OLATB] & 0x08);
+}
+
+static void Sd_Reset(){
+	SdIdle = TRUE;
+	SdApp = FALSE;
+	SdInits = 0;
+	SdMode = SD_COMMAND;
+	SdCmdBytes = 0;
+	SdHead = SdLength = 0;
+	SdBusyUntil = 0;
+}
+
+static void Sd_Queue(const uint8_t* bytes, uint16_t length){
+	if(SdHead + SdLength + length > sizeof(SdQueue)){
+		memmove(SdQueue, SdQueue + SdHead, SdLength);
+		SdHead = 0;
+	}
+	memcpy(SdQueue + SdHead + SdLength, bytes, length);
+	SdLength += length;
+}
+
+static void Sd_Queue_Byte(uint8_t byte){
+	Sd_Queue(&byte, 1);
+}
+
+static void Sd_Queue_Block(uint32_t sector){
+
+	uint8_t data[SD_SECTOR];
+	size_t got = 0;
+	uint8_t i;
+
+	memset(data, 0, sizeof(data));
+	if(!fseek(SdImage, (long)sector*SD_SECTOR, SEEK_SET)) got = fread(data, 1, SD_SECTOR, SdImage);
+	(void)got;	//past the end of the image reads zeros
+	for(i=0;i<SD_ACCESS_BYTES;i++) Sd_Queue_Byte(0xFF);
+	Sd_Queue_Byte(0xFE);
+	Sd_Queue(data, SD_SECTOR);
+	Sd_Queue_Byte(0x00);	//crc, not checked
+	Sd_Queue_Byte(0x00);
+}
+
+static void Sd_Store_Block(){
+	if(fseek(SdImage, (long)SdSector*SD_SECTOR, SEEK_SET) || fwrite(SdBlock, 1, SD_SECTOR, SdImage) != SD_SECTOR){
+		Sim_Error("sd: can't write sector %u of the image", SdSector);
+	}
+	SdSector++;
+	SdWritten++;
+}
+
+static void Sd_Command(){
+
+	uint8_t cmd = SdCmd[0] & 0x3F, app = SdApp;
+	uint32_t arg = ((uint32_t)SdCmd[1] << 24) | ((uint32_t)SdCmd[2] << 16) | (SdCmd[3] << 8) | SdCmd[4];
+	uint8_t r1 = SdIdle ? SD_R1_IDLE : 0x00;
+	uint8_t resp[6] = {0xFF, r1};
+
+	//a command drops what was still going out, e.g. the rest of a block being streamed
+	SdHead = SdLength = 0;
+	SdApp = FALSE;
+	switch(cmd){
+	case 0:
+		Sd_Reset();
+		resp[1] = SD_R1_IDLE;
+		Sd_Queue(resp, 2);
+		return;
+	case 8:
+		resp[2] = resp[3] = 0x00;
+		resp[4] = (arg >> 8) & 0x0F;
+		resp[5] = arg & 0xFF;
+		Sd_Queue(resp, 6);
+		return;
+	case 55:
+		SdApp = TRUE;
+		Sd_Queue(resp, 2);
+		return;
+	case 1:	//SD_init sends CMD1 after a CMD55, SPI mode cards take it like ACMD41
+	case 41:
+		if(cmd == 41 && !app) break;
+		if(SdIdle && ++SdInits >= SD_INIT_TRIES) SdIdle = FALSE;
+		resp[1] = SdIdle ? SD_R1_IDLE : 0x00;
+		Sd_Queue(resp, 2);
+		return;
+	case 58:
+		resp[2] = 0xC0;	//powered up, block addressed
+		resp[3] = 0xFF;
+		resp[4] = 0x80;
+		resp[5] = 0x00;
+		Sd_Queue(resp, 6);
+		return;
+	case 12:
+		if(SdMode != SD_READ_MULTI) break;
+		SdMode = SD_COMMAND;
+		resp[1] = 0x00;
+		Sd_Queue(resp, 2);	//stuff byte and R1
+		SdBusyUntil = Sim_Now + SIM_US(SD_STOP_US);
+		return;
+	case 17:
+	case 18:
+	case 24:
+	case 25:
+		if(SdIdle){
+			Sim_Error("sd: CMD%u before the card is initialized", cmd);
+			break;
+		}
+		Sd_Queue(resp, 2);
+		SdSector = arg;
+		if(cmd == 17) Sd_Queue_Block(SdSector);
+		else if(cmd == 18) SdMode = SD_READ_MULTI;
+		else{
+			SdMode = SD_WRITE_TOKEN;
+			SdMulti = cmd == 25;
+		}
+		return;
+	}
+	resp[1] = r1 | SD_R1_ILLEGAL;
+	Sd_Queue(resp, 2);
+}
+
+//cs going high starts the command framing over, the expander's bytes that went by are forgotten
+static void Sd_Select(uint8_t on){
+	if(!on) SdCmdBytes = 0;
+}
+
+static uint8_t Sd_Transfer(uint8_t mosi){
+
+
+	uint8_t miso = 0xFF;
+
+	//what goes out
+	if(!SdLength && SdMode == SD_READ_MULTI) Sd_Queue_Block(SdSector++);
+	if(SdLength){
+		miso = SdQueue[SdHead++];
+		SdLength--;
+	}
+	else if(Sim_Now < SdBusyUntil) miso = 0x00;
+
+	//what comes in
+	switch(SdMode){
+	case SD_WRITE_TOKEN:
+		if(Sim_Now < SdBusyUntil || mosi == 0xFF) break;
+		if(mosi == (SdMulti ? 0xFC : 0xFE)){
+			SdMode = SD_WRITE_DATA;
+			SdBytes = 0;
+		}
+		else if(SdMulti && mosi == 0xFD){
+			SdMode = SD_COMMAND;
+			Sd_Queue_Byte(0xFF);
+			SdBusyUntil = Sim_Now + SIM_US(SD_STOP_US);
+		}
+		else Sim_Error("sd: 0x%02x while waiting for a data token", mosi);
+		break;
+	case SD_WRITE_DATA:
+		SdBlock[SdBytes++] = mosi;
+		if(SdBytes == sizeof(SdBlock)){
+			Sd_Store_Block();
+			Sd_Queue_Byte(0x05);	//data accepted
+			SdBusyUntil = Sim_Now + SIM_US(Sd_Write_Us);
+			SdMode = SdMulti ? SD_WRITE_TOKEN : SD_COMMAND;
+		}
+		break;
+	default:
+		if(!SdCmdBytes && (mosi & 0xC0) != 0x40) break;
+		SdCmd[SdCmdBytes++] = mosi;
+		if(SdCmdBytes == sizeof(SdCmd)){
+			SdCmdBytes = 0;
+			Sd_Command();
+		}
+	}
+	return miso;
+}
+
+static Sim_Chip_t Sd = {"sd card", HAL_SPIC, Sd_Powered, Sd_Selected, Sd_Reset, Sd_Select, Sd_Transfer};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// AD7767
+
+static uint32_t AdRate, AdConverted;
+static uint64_t AdStart, AdNext;
+static uint32_t AdShift;
+static uint8_t AdBytes;
+
+//a fixed pseudo random sequence over the whole 24 bit range
+uint32_t Ad7767_Sample(uint32_t n){
+	return ((n + 1)*2654435761UL >> 8) & 0xFFFFFF;
+}
+
+uint32_t Ad7767_Converted(){
+	return AdConverted;
+}
+
+void Ad7767_Start(uint32_t rate){
+	AdRate = rate;
+	AdConverted = 0;
+	AdStart = Sim_Now;
+	AdNext = rate ? AdStart + SIM_HZ/rate : 0;
+	if(!rate) Sim_Irq_Clear(SIM_IRQ_PORTF_INT0);
+}
+
+static uint64_t Ad7767_Next(){
+	return AdNext;
+}
+
+//a conversion finished: data ready pulses low on PF0
+static void Ad7767_Edge(){
+	AdConverted++;
+	AdNext = AdStart + (AdConverted + 1)*SIM_HZ/AdRate;
+	Sim_Pin_Drive(HAL_PORTF, 0, FALSE);
+	Sim_Pin_Drive(HAL_PORTF, 0, TRUE);
+}
+
+static uint8_t Ad7767_Selected(){
+	return Sim_Driven_Low(HAL_PORTF, 1);
+}
+
+static void Ad7767_Select(uint8_t on){
+	if(!on) return;
+	AdShift = AdConverted ? Ad7767_Sample(AdConverted - 1) : 0;
+	AdBytes = 0;
+}
+
+static uint8_t Ad7767_Transfer(uint8_t mosi){
+	if(!AdConverted) Sim_Error("AD7767: read before the first conversion");
+	if(AdBytes >= 3) return 0x00;
+	return AdShift >> (16 - 8*AdBytes++);
+}
+
+static Sim_Chip_t Ad7767 = {"AD7767", HAL_SPIC, Rail, Ad7767_Selected, NULL, Ad7767_Select, Ad7767_Transfer};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// filter muxes
+
+static uint8_t Mux_Lower_Selected(){
+	return Sim_Driven_Low(HAL_PORTE, 4);
+}
+
+static uint8_t Mux_Upper_Selected(){
+	return Sim_Driven_Low(HAL_PORTC, 1);
+}
+
+static uint8_t Mux_Transfer(uint8_t mosi){
+	return 0xFF;
+}
+
+static Sim_Chip_t MuxLower = {"lower mux", HAL_SPIC, Rail, Mux_Lower_Selected, NULL, NULL, Mux_Transfer, TRUE};
+static Sim_Chip_t MuxUpper = {"upper mux", HAL_SPIC, Rail, Mux_Upper_Selected, NULL, NULL, Mux_Transfer, TRUE};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// AT86RF212
+
+#define RF_REGS 0x40
+#define RF_TRX_STATUS 0x01
+#define RF_TRX_STATE 0x02
+#define RF_PHY_RSSI 0x06
+#define RF_PHY_ED_LEVEL 0x07
+#define RF_TRX_CTRL_2 0x0C
+#define RF_IRQ_MASK 0x0E
+#define RF_IRQ_STATUS 0x0F
+#define RF_PART_NUM 0x1C
+#define RF_VERSION_NUM 0x1D
+#define RF_MAN_ID_0 0x1E
+#define RF_MAN_ID_1 0x1F
+#define RF_SHORT_ADDR_0 0x20
+#define RF_PAN_ID_0 0x22
+#define RF_XAH_CTRL_0 0x2C
+#define RF_CSMA_SEED_1 0x2E
+#define RF_RX_START_bm 0x04
+#define RF_TRX_END_bm 0x08
+#define RF_CRC_VALID_bm 0x80
+#define RF_I_AM_COORD_bm 0x08
+#define RF_TRAC_SUCCESS 0x00
+#define RF_TRAC_NO_ACK 0x05
+#define RF_FRAME 129	// PHR, PSDU and LQI
+// states as TRX_STATUS has them, the commands to reach them are the same numbers
+#define RF_BUSY_RX 0x01
+#define RF_BUSY_TX 0x02
+#define RF_RX_ON 0x06
+#define RF_TRX_OFF 0x08
+#define RF_PLL_ON 0x09
+#define RF_SLEEP 0x0F
+#define RF_BUSY_RX_AACK 0x11
+#define RF_BUSY_TX_ARET 0x12
+#define RF_RX_AACK_ON 0x16
+#define RF_TX_ARET_ON 0x19
+#define RF_TRANSITION 0x1F
+#define RF_CMD_NOP 0x00
+#define RF_CMD_TX_START 0x02
+#define RF_CMD_FORCE_TRX_OFF 0x03
+#define RF_CMD_FORCE_PLL_ON 0x04
+// transition times (us), the ones chb_drvr.h waits
+#define RF_RESET_US 26	// reset to TRX_OFF
+#define RF_PLL_US 110	// TRX_OFF to a state with the PLL on
+#define RF_SWITCH_US 1	// between the states with the PLL on, and back to TRX_OFF
+#define RF_SLEEP_US 35
+#define RF_WAKE_US 240
+// air times, in bits at the PSDU rate. symbols are counted as O-QPSK's 4 bits
+#define RF_SHR_BITS 48	// preamble, SFD and PHR, at the base rate of the mode
+#define RF_CCA_BITS 32	// one CCA of 8 symbols
+#define RF_TURNAROUND_BITS 48	// 12 symbols
+#define RF_ACK_BITS 88	// SHR, PHR and the 5 bytes of an ack
+#define RF_ACK_WAIT_BITS 216	// 54 symbols, macAckWaitDuration
+
+enum{RF_IDLE, RF_SWITCH, RF_TX, RF_TX_ACK, RF_TX_WAIT, RF_RX_HEAD, RF_RX, RF_ACK};
+
+uint8_t Radio_Acks = TRUE;
+uint8_t Radio_Noise;
+uint64_t Radio_Irq_Edge;
+static uint8_t RfReg[RF_REGS];
+static uint8_t RfFrame[RF_FRAME];
+static uint8_t RfSent[RF_FRAME];
+static uint8_t RfAir[RF_FRAME];	// the frame coming in: PHR, PSDU
+static uint8_t RfAirCrc, RfAirEd;
+static uint8_t RfCmd, RfBytes, RfSlpTr;
+static uint8_t RfPhase, RfNext, RfPending, RfTries;
+static uint64_t RfAt;	// the end of the phase
+static uint32_t RfSentFrames, RfMissed;
+
+uint8_t Radio_Reg(uint8_t reg){
+	return RfReg[reg];
+}
+
+const uint8_t* Radio_Sent(){
+	return RfSent;
+}
+
+uint32_t Radio_Frames_Sent(){
+	return RfSentFrames;
+}
+
+uint32_t Radio_Frames_Missed(){
+	return RfMissed;
+}
+
+//PSDU rate of the mode TRX_CTRL_2 sets, or the base rate the SHR goes out at
+static uint32_t Radio_Kbps(uint8_t base){
+
+	static const uint16_t kbps[16] = {20, 20, 20, 20, 40, 40, 40, 40, 100, 200, 400, 400, 250, 500, 1000, 1000};
+
+	return kbps[(RfReg[RF_TRX_CTRL_2] & 0x0F) & (base ? 0x0C : 0x0F)];
+}
+
+static uint64_t Radio_Bits(uint32_t bits){
+	return bits*SIM_HZ/(Radio_Kbps(FALSE)*1000);
+}
+
+static uint64_t Radio_Air(uint8_t length){
+	return RF_SHR_BITS*SIM_HZ/(Radio_Kbps(TRUE)*1000) + Radio_Bits(8*length);
+}
+
+//IRQ follows the pending interrupts that are enabled
+static void Radio_Irq(uint8_t irqs){
+	if(!RfReg[RF_IRQ_STATUS] && (irqs & RfReg[RF_IRQ_MASK])) Radio_Irq_Edge = Sim_Now;
+	RfReg[RF_IRQ_STATUS] |= irqs & RfReg[RF_IRQ_MASK];
+	Sim_Pin_Drive(HAL_PORTD, 2, RfReg[RF_IRQ_STATUS] != 0);
+}
+
+static void Radio_Command(uint8_t cmd);
+
+static void Radio_Switch(uint8_t state, uint32_t us){
+	RfReg[RF_TRX_STATUS] = RF_TRANSITION;
+	RfNext = state;
+	RfPhase = RF_SWITCH;
+	RfAt = Sim_Now + SIM_US(us);
+}
+
+//a state the radio stays in. a command that came while it was busy takes effect now
+static void Radio_Settle(uint8_t state){
+
+	uint8_t cmd = RfPending;
+
+	RfReg[RF_TRX_STATUS] = state;
+	RfPhase = RF_IDLE;
+	RfPending = RF_CMD_NOP;
+	if(cmd != RF_CMD_NOP) Radio_Command(cmd);
+}
+
+static void Radio_Tx(){
+
+	uint8_t state = RfReg[RF_TRX_STATUS];
+
+	if(state != RF_PLL_ON && state != RF_TX_ARET_ON){
+		Sim_Error("AT86RF212: TX_START in state 0x%02x", state);
+		return;
+	}
+	if(RfFrame[0] < 2 || RfFrame[0] > RF_FRAME - 2) Sim_Error("AT86RF212: sending a frame of %u bytes", RfFrame[0]);
+	memcpy(RfSent, RfFrame, RF_FRAME);
+	RfReg[RF_TRX_STATUS] = (state == RF_PLL_ON) ? RF_BUSY_TX : RF_BUSY_TX_ARET;
+	RfTries = 0;
+	RfPhase = RF_TX;
+	RfAt = Sim_Now + Radio_Air(RfFrame[0]) + ((state == RF_PLL_ON) ? 0 : Radio_Bits(RF_CCA_BITS));
+}
+
+static void Radio_Tx_End(uint8_t trac){
+	RfReg[RF_TRX_STATE] = (trac << 5) | (RfReg[RF_TRX_STATE] & 0x1F);
+	RfSentFrames++;
+	Radio_Settle((RfReg[RF_TRX_STATUS] == RF_BUSY_TX) ? RF_PLL_ON : RF_TX_ARET_ON);
+	Radio_Irq(RF_TRX_END_bm);
+}
+
+static void Radio_Command(uint8_t cmd){
+
+	uint8_t state = RfReg[RF_TRX_STATUS];
+
+	switch(cmd){
+	case RF_CMD_NOP: return;
+	case RF_CMD_TX_START: Radio_Tx(); return;
+	//the forced ones cut off whatever is going on
+	case RF_CMD_FORCE_TRX_OFF:
+		RfPending = RF_CMD_NOP;
+		Radio_Switch(RF_TRX_OFF, RF_SWITCH_US);
+		return;
+	case RF_CMD_FORCE_PLL_ON:
+		RfPending = RF_CMD_NOP;
+		Radio_Switch(RF_PLL_ON, (state == RF_TRX_OFF) ? RF_PLL_US : RF_SWITCH_US);
+		return;
+	}
+	if(state == RF_SLEEP){
+		Sim_Error("AT86RF212: command 0x%02x while asleep", cmd);
+		return;
+	}
+	if(state == RF_TRANSITION){
+		Sim_Error("AT86RF212: command 0x%02x during a state transition", cmd);
+		return;
+	}
+	if(RfPhase != RF_IDLE){
+		RfPending = cmd;
+		return;
+	}
+	switch(cmd){
+	case RF_TRX_OFF:
+		Radio_Switch(RF_TRX_OFF, RF_SWITCH_US);
+		break;
+	case RF_PLL_ON:
+	case RF_RX_ON:
+	case RF_RX_AACK_ON:
+	case RF_TX_ARET_ON:
+		if((state == RF_RX_AACK_ON && cmd == RF_TX_ARET_ON) || (state == RF_TX_ARET_ON && cmd == RF_RX_AACK_ON)){
+			Sim_Error("AT86RF212: 0x%02x to 0x%02x without going through PLL_ON", state, cmd);
+		}
+		Radio_Switch(cmd, (state == RF_TRX_OFF) ? RF_PLL_US : RF_SWITCH_US);
+		break;
+	default:
+		Sim_Error("AT86RF212: TRX_CMD 0x%02x", cmd);
+	}
+}
+
+//RX_AACK_ON only takes data frames for its PAN, sent to its short address or broadcast. without a destination the
+//coordinator takes them
+static uint8_t Radio_For_Us(){
+
+	const uint8_t* psdu = RfAir + 1;
+	uint16_t pan = RfReg[RF_PAN_ID_0] | (RfReg[RF_PAN_ID_0 + 1] << 8);
+	uint16_t addr = RfReg[RF_SHORT_ADDR_0] | (RfReg[RF_SHORT_ADDR_0 + 1] << 8);
+	uint16_t destPan = psdu[3] | (psdu[4] << 8), dest = psdu[5] | (psdu[6] << 8);
+
+	if((psdu[0] & 0x07) != 0x01) return FALSE;
+	switch((psdu[1] >> 2) & 0x03){
+	case 0:
+		return (RfReg[RF_CSMA_SEED_1] & RF_I_AM_COORD_bm) != 0 && destPan == pan;
+	case 2:
+		return (destPan == pan || destPan == 0xFFFF) && (dest == addr || dest == 0xFFFF);
+	default:
+		return FALSE;
+	}
+}
+
+static void Radio_Rx_End(){
+
+	uint8_t length = RfAir[0], aack = (RfReg[RF_TRX_STATUS] == RF_BUSY_RX_AACK);
+	const uint8_t* psdu = RfAir + 1;
+
+	memcpy(RfFrame, RfAir, length + 1);
+	RfFrame[length + 1] = 0xFF;	//LQI
+	RfReg[RF_PHY_ED_LEVEL] = RfAirEd;
+	RfReg[RF_PHY_RSSI] = (RfReg[RF_PHY_RSSI] & ~RF_CRC_VALID_bm) | (RfAirCrc ? RF_CRC_VALID_bm : 0);
+	if(!aack){
+		Radio_Settle(RF_RX_ON);
+		Radio_Irq(RF_TRX_END_bm);
+		return;
+	}
+	if(!RfAirCrc || !Radio_For_Us()){
+		Radio_Settle(RF_RX_AACK_ON);
+		return;
+	}
+	Radio_Irq(RF_TRX_END_bm);
+	//the ack goes out in BUSY_RX_AACK, not to a broadcast
+	if((psdu[0] & 0x20) && (psdu[5] & psdu[6]) != 0xFF){
+		RfPhase = RF_ACK;
+		RfAt = Sim_Now + Radio_Bits(RF_TURNAROUND_BITS + RF_ACK_BITS);
+	}
+	else Radio_Settle(RF_RX_AACK_ON);
+}
+
+void Radio_Receive(const uint8_t* psdu, uint8_t length, uint8_t crc, uint8_t ed){
+
+	uint8_t state = RfReg[RF_TRX_STATUS];
+
+	if(RfPhase != RF_IDLE || (state != RF_RX_ON && state != RF_RX_AACK_ON)){
+		RfMissed++;
+		return;
+	}
+	RfAir[0] = length;
+	memcpy(RfAir + 1, psdu, length);
+	RfAirCrc = crc;
+	RfAirEd = ed;
+	RfReg[RF_TRX_STATUS] = (state == RF_RX_ON) ? RF_BUSY_RX : RF_BUSY_RX_AACK;
+	RfPhase = RF_RX_HEAD;
+	RfAt = Sim_Now + RF_SHR_BITS*SIM_HZ/(Radio_Kbps(TRUE)*1000);
+}
+
+static uint64_t Radio_Next(){
+	return (RfPhase != RF_IDLE) ? RfAt : 0;
+}
+
+static void Radio_Due(){
+	switch(RfPhase){
+	case RF_SWITCH:
+		Radio_Settle(RfNext);
+		break;
+	case RF_TX:
+		if(RfReg[RF_TRX_STATUS] == RF_BUSY_TX || !(RfFrame[1] & 0x20)) Radio_Tx_End(RF_TRAC_SUCCESS);
+		else if(Radio_Acks){
+			RfPhase = RF_TX_ACK;
+			RfAt = Sim_Now + Radio_Bits(RF_TURNAROUND_BITS + RF_ACK_BITS);
+		}
+		else{
+			RfPhase = RF_TX_WAIT;
+			RfAt = Sim_Now + Radio_Bits(RF_ACK_WAIT_BITS);
+		}
+		break;
+	case RF_TX_ACK:
+		Radio_Tx_End(RF_TRAC_SUCCESS);
+		break;
+	case RF_TX_WAIT:
+		//MAX_FRAME_RETRIES more tries before giving up
+		if(RfTries++ < (RfReg[RF_XAH_CTRL_0] >> 4)){
+			RfPhase = RF_TX;
+			RfAt = Sim_Now + Radio_Air(RfFrame[0]) + Radio_Bits(RF_CCA_BITS);
+		}
+		else Radio_Tx_End(RF_TRAC_NO_ACK);
+		break;
+	case RF_RX_HEAD:
+		Radio_Irq(RF_RX_START_bm);
+		RfPhase = RF_RX;
+		RfAt = Sim_Now + Radio_Bits(8*RfAir[0]);
+		break;
+	case RF_RX:
+		Radio_Rx_End();
+		break;
+	case RF_ACK:
+		Radio_Settle(RF_RX_AACK_ON);
+		break;
+	}
+}
+
+//held in reset while RST is low
+static uint8_t Radio_Powered(){
+	return !Sim_Driven_Low(HAL_PORTD, 0);
+}
+
+static uint8_t Radio_Selected(){
+	return Sim_Driven_Low(HAL_PORTD, 4);
+}
+
+//registers the model doesn't use come up 0
+static void Radio_Reset(){
+	memset(RfReg, 0, sizeof(RfReg));
+	RfReg[RF_PART_NUM] = 0x07;
+	RfReg[RF_VERSION_NUM] = 0x01;
+	RfReg[RF_MAN_ID_0] = 0x1F;
+	RfPending = RF_CMD_NOP;
+	RfSlpTr = Sim_Driven_High(HAL_PORTD, 1);
+	Radio_Switch(RF_TRX_OFF, RF_RESET_US);
+	Sim_Pin_Drive(HAL_PORTD, 2, FALSE);
+}
+
+static void Radio_Select(uint8_t on){
+	RfBytes = 0;
+	if(on && RfReg[RF_TRX_STATUS] == RF_SLEEP) Sim_Error("AT86RF212: selected while asleep");
+}
+
+//SLP_TR: sleep from TRX_OFF and wake up again, or start sending in PLL_ON and TX_ARET_ON
+static void Radio_Pins(){
+
+	uint8_t slpTr = Sim_Driven_High(HAL_PORTD, 1), state = RfReg[RF_TRX_STATUS];
+
+	if(slpTr == RfSlpTr) return;
+	RfSlpTr = slpTr;
+	if(slpTr && state == RF_TRX_OFF && RfPhase == RF_IDLE) Radio_Switch(RF_SLEEP, RF_SLEEP_US);
+	else if(slpTr && (state == RF_PLL_ON || state == RF_TX_ARET_ON) && RfPhase == RF_IDLE) Radio_Tx();
+	else if(!slpTr && state == RF_SLEEP) Radio_Switch(RF_TRX_OFF, RF_WAKE_US);
+}
+
+static void Radio_Write(uint8_t reg, uint8_t value){
+	switch(reg){
+	case RF_TRX_STATE:
+		RfReg[reg] = (RfReg[reg] & 0xE0) | (value & 0x1F);
+		Radio_Command(value & 0x1F);
+		break;
+	case RF_PHY_ED_LEVEL:	//starts a measurement, taken as done at once
+		RfReg[reg] = Radio_Noise;
+		break;
+	case RF_TRX_STATUS:
+	case RF_PHY_RSSI:
+	case RF_IRQ_STATUS:
+	case RF_PART_NUM:
+	case RF_VERSION_NUM:
+	case RF_MAN_ID_0:
+	case RF_MAN_ID_1:
+		break;
+	default:
+		RfReg[reg] = value;
+	}
+}
+
+static uint8_t Radio_Transfer(uint8_t mosi){
+
+	uint8_t n = RfBytes, miso;
+
+	if(RfBytes < 0xFF) RfBytes++;
+	if(!n){
+		RfCmd = mosi;
+		return 0x00;	//PHY status, not used
+	}
+	if((RfCmd & 0xC0) == 0x80){
+		miso = RfReg[RfCmd & 0x3F];
+		if((RfCmd & 0x3F) == RF_IRQ_STATUS){
+			RfReg[RF_IRQ_STATUS] = 0;
+			Sim_Pin_Drive(HAL_PORTD, 2, FALSE);
+		}
+		return miso;
+	}
+	if((RfCmd & 0xC0) == 0xC0){
+		Radio_Write(RfCmd & 0x3F, mosi);
+		return 0x00;
+	}
+	if((RfCmd & 0xE0) == 0x60){
+		if(n <= RF_FRAME - 1) RfFrame[n - 1] = mosi;
+		if(n == 1 && mosi > RF_FRAME - 2) Sim_Error("AT86RF212: frame length %u", mosi);
+		return 0x00;
+	}
+	if((RfCmd & 0xE0) == 0x20) return (n <= RF_FRAME) ? RfFrame[n - 1] : 0x00;
+	return 0x00;	//sram access isn't modeled
+}
+
+static Sim_Chip_t Radio = {"AT86RF212", HAL_SPID, Radio_Powered, Radio_Selected, Radio_Reset, Radio_Select, Radio_Transfer,
+	.pins = Radio_Pins};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+Sim_Chip_t* Sim_Chips[SIM_CHIPS] = {&PortEx, &Fram, &Sd, &Ad7767, &MuxLower, &MuxUpper, &Radio, NULL};
+
+void Chips_Init(FILE* image){
+	Sim_Init();
+	Sim_Timed(Ad7767_Next, Ad7767_Edge);
+	Sim_Timed(Radio_Next, Radio_Due);
+	Sim_Pin_Drive(HAL_PORTF, 0, TRUE);	//data ready idles high
+	SdImage = image;
+	Sim_Update_Selects();
+}
@@ -0,0 +1,1028 @@
+/*
+ * halsim.c
+ *
+ * Created: 10/19/2026
+ */
+// Linux backend of Hal.h (see HalSim.h). keeps the port, SPI module, USART, EEPROM, timer and RTC state, hands the SPI bytes
+// to the chips whose select lines are driven low and checks that only one is. pins the chips drive (Sim_Pin_Drive) raise the
+// port's INT0 as the pin's input sense and the port's mask set up, and are events for the timers to capture. interrupts are
+// on or off like SREG's I bit, with the PMIC's levels on top, and a handler runs wherever the board would take its
+// interrupt: right at the request while they let it, or as soon as they do. the models that change with time (the USART's
+// bytes going out and coming in, the timer compares and the RTC, the chips in chips.c) are stepped as the clock moves past
+// them, and a sleep moves it on from one to the next until an interrupt is taken.
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>	// the stand-in in stub/
+#include "sim.h"
+
+#define TRUE 1
+#define FALSE 0
+#define SPI_BYTE_OVERHEAD 4	// cycles from the flag coming up to the next byte going out
+#define SIM_MAX_ERRORS 20	// printed, the rest only counted
+#define SIM_SPIN_CYCLES 4	// a pass of a wait loop
+#define SIM_TIMED 8
+#define SIM_SERIAL_BUF 4096
+#define SIM_EEPROM_WRITE_US 8000	// atomic page erase and write
+
+uint64_t Sim_Now;
+uint8_t Sim_Out[SIM_PORTS];
+uint8_t Sim_Dir[SIM_PORTS];
+uint8_t Sim_In[SIM_PORTS];
+uint8_t Sim_Eeprom[SIM_EEPROM_BYTES];
+uint32_t Sim_Eeprom_Writes;
+uint32_t Sim_Errors;
+uint64_t Sim_Irq_Off_Max;
+uint64_t Sim_Irq_Latency_Max[SIM_IRQS];
+uint32_t Sim_Serial_Overruns;
+uint16_t Sim_Clock_Div = 1;
+uint64_t Sim_Stopped;
+
+static const char* SpiNames[SIM_SPIS] = {"SPIC", "SPID"};
+static const int8_t PortIrqs[SIM_PORTS] = {-1, -1, -1, SIM_IRQ_PORTD_INT0, SIM_IRQ_PORTE_INT0, SIM_IRQ_PORTF_INT0};
+static uint8_t PinCtrl[SIM_PORTS][8], IntCtrl[SIM_PORTS], Int0Mask[SIM_PORTS];
+static uint8_t SpiCtrl[SIM_SPIS];
+static uint8_t IrqOn = TRUE;	// SREG's I bit
+static uint8_t IrqLevels;	// levels on in the PMIC (its CTRL register)
+static uint8_t IrqActive;	// levels whose handler is running (its STATUS register)
+static uint64_t IrqOffSince;
+static uint32_t IrqTaken;	// handlers run, a sleep lasts until this goes up
+static uint8_t Stopped;	// in power-save: the peripheral clock is off
+static struct{
+	void (*handler)();
+	uint8_t level;
+	uint8_t pending;
+	uint8_t edge;	// cleared when the handler starts
+	uint64_t since;
+} Irq[SIM_IRQS];
+static struct{
+	uint64_t (*next)();
+	void (*due)();
+} Timed[SIM_TIMED];
+static uint8_t Timeds;
+
+static void Ev_Pin(uint8_t port, uint8_t pin);
+static void Sleep_Wake();
+
+void Sim_Error(const char* fmt, ...){
+
+	va_list args;
+
+	if(++Sim_Errors > SIM_MAX_ERRORS) return;
+	fprintf(stderr, "hostsim: %.3f ms: ", Sim_Now*1000.0/SIM_HZ);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+void Sim_Reset_Stats(){
+	Sim_Irq_Off_Max = 0;
+	memset(Sim_Irq_Latency_Max, 0, sizeof(Sim_Irq_Latency_Max));
+	if(!IrqOn && !IrqActive) IrqOffSince = Sim_Now;
+}
+
+uint8_t Sim_Driven_Low(uint8_t port, uint8_t pin){
+	return (Sim_Dir[port] & (1 << pin)) && !(Sim_Out[port] & (1 << pin));
+}
+
+uint8_t Sim_Driven_High(uint8_t port, uint8_t pin){
+	return (Sim_Dir[port] & (1 << pin)) && (Sim_Out[port] & (1 << pin));
+}
+
+void Sim_Update_Selects(){
+
+	Sim_Chip_t** chip;
+	uint8_t up, on;
+
+	//power first so a chip that comes up selected starts out reset
+	for(chip=Sim_Chips;*chip;chip++){
+		up = !(*chip)->powered || (*chip)->powered();
+		if(up != (*chip)->up){
+			(*chip)->up = up;
+			if(up && (*chip)->reset) (*chip)->reset();
+		}
+	}
+	for(chip=Sim_Chips;*chip;chip++){
+		on = (*chip)->up && (*chip)->selected();
+		if(on != (*chip)->on){
+			(*chip)->on = on;
+			if((*chip)->select) (*chip)->select(on);
+		}
+		if((*chip)->up && (*chip)->pins) (*chip)->pins();
+	}
+}
+
+//the request the cpu would take now: the highest level above the running handlers, the lowest vector within a level
+static int8_t Irq_Next(){
+
+	int8_t irq, best = -1;
+
+	if(!IrqOn) return -1;
+	for(irq=0;irq<SIM_IRQS;irq++){
+		if(!Irq[irq].pending || !Irq[irq].level || !(IrqLevels & (1 << (Irq[irq].level - 1)))) continue;
+		if(IrqActive >> (Irq[irq].level - 1)) continue;
+		if(best < 0 || Irq[irq].level > Irq[best].level) best = irq;
+	}
+	return best;
+}
+
+//run the handlers of the requests that came in, if interrupts let them. the I bit stays on in a handler like on the
+//XMEGA and only a higher level can come in on top of it
+static void Irq_Run(){
+
+	int8_t irq;
+	uint8_t level;
+
+	while((irq = Irq_Next()) >= 0){
+		if(Sim_Now - Irq[irq].since > Sim_Irq_Latency_Max[irq]) Sim_Irq_Latency_Max[irq] = Sim_Now - Irq[irq].since;
+		if(Irq[irq].edge) Irq[irq].pending = FALSE;
+		if(!Irq[irq].handler){
+			Irq[irq].pending = FALSE;
+			continue;
+		}
+		//the interrupt wakes the core up and the peripheral clock comes back before the handler runs
+		if(Stopped) Sleep_Wake();
+		level = 1 << (Irq[irq].level - 1);
+		IrqActive |= level;
+		IrqTaken++;
+		Irq[irq].handler();
+		IrqActive &= ~level;
+		if(!IrqOn){
+			Sim_Error("interrupt %d returned with interrupts off", irq);
+			IrqOn = TRUE;
+		}
+	}
+}
+
+//when the next model is due to change and which one, 0 if none is
+static uint64_t Timed_Next(uint8_t* model){
+
+	uint64_t at, soonest = 0;
+	uint8_t i;
+
+	for(i=0;i<Timeds;i++){
+		at = Timed[i].next();
+		if(at && (!soonest || at < soonest)){
+			soonest = at;
+			*model = i;
+		}
+	}
+	return soonest;
+}
+
+void Sim_Advance(uint64_t cycles){
+
+	uint64_t end = Sim_Now + cycles, before, soonest;
+	uint8_t model = 0;
+
+	//a request that came in with the last byte or pin change is taken before anything else goes on
+	Irq_Run();
+	for(;;){
+		soonest = Timed_Next(&model);
+		if(!soonest || soonest > end) break;
+		if(soonest > Sim_Now) Sim_Now = soonest;
+		Timed[model].due();
+		//the time the handlers take comes on top of what was going on
+		before = Sim_Now;
+		Irq_Run();
+		end += Sim_Now - before;
+	}
+	Sim_Now = end;
+}
+
+void Sim_Timed(uint64_t (*next)(), void (*due)()){
+	if(Timeds == SIM_TIMED) return;
+	Timed[Timeds].next = next;
+	Timed[Timeds++].due = due;
+}
+
+void Sim_Irq_Handler(uint8_t irq, void (*handler)()){
+	Irq[irq].handler = handler;
+}
+
+void Sim_Irq_Level(uint8_t irq, uint8_t level){
+	Irq[irq].level = level;
+}
+
+void Sim_Irq_Raise(uint8_t irq){
+	Irq[irq].pending = TRUE;
+	Irq[irq].edge = TRUE;
+	Irq[irq].since = Sim_Now;
+}
+
+void Sim_Irq_Flag(uint8_t irq, uint8_t up){
+	if(up && !Irq[irq].pending) Irq[irq].since = Sim_Now;
+	Irq[irq].pending = up;
+	Irq[irq].edge = FALSE;
+}
+
+void Sim_Irq_Clear(uint8_t irq){
+	Irq[irq].pending = FALSE;
+}
+
+hal_irq_t Hal_Irq_Save(){
+
+	hal_irq_t irq = IrqOn;
+
+	Hal_Irq_Off();
+	return irq;
+}
+
+void Hal_Irq_Off(){
+	if(IrqOn && !IrqActive) IrqOffSince = Sim_Now;
+	IrqOn = FALSE;
+}
+
+void Hal_Irq_Restore(hal_irq_t irq){
+	if(!irq){
+		Hal_Irq_Off();
+		return;
+	}
+	if(!IrqOn && !IrqActive && Sim_Now - IrqOffSince > Sim_Irq_Off_Max) Sim_Irq_Off_Max = Sim_Now - IrqOffSince;
+	IrqOn = TRUE;
+	Irq_Run();
+}
+
+void Hal_Reset(){
+	Sim_Error("software reset");
+	exit(1);
+}
+
+void Hal_Irq_Levels_On(uint8_t levels){
+	IrqLevels |= levels;
+	Irq_Run();
+}
+
+void Hal_Irq_Levels_Off(uint8_t levels){
+	IrqLevels &= ~levels;
+}
+
+void Hal_Gpio_Set(hal_port_t port, uint8_t pins){
+	Sim_Out[port] |= pins;
+	Sim_Update_Selects();
+}
+
+void Hal_Gpio_Clr(hal_port_t port, uint8_t pins){
+	Sim_Out[port] &= ~pins;
+	Sim_Update_Selects();
+}
+
+void Hal_Gpio_Output(hal_port_t port, uint8_t pins){
+	Sim_Dir[port] |= pins;
+	Sim_Update_Selects();
+}
+
+void Hal_Gpio_Input(hal_port_t port, uint8_t pins){
+	Sim_Dir[port] &= ~pins;
+	Sim_Update_Selects();
+}
+
+void Hal_Gpio_Pullup(hal_port_t port, uint8_t pin){
+	PinCtrl[port][pin] = PORT_OPC_WIREDANDPULL_gc;
+}
+
+uint8_t Hal_Gpio_Get_Out(hal_port_t port){
+	return Sim_Out[port];
+}
+
+void Hal_Gpio_Pin_Ctrl(hal_port_t port, uint8_t pin, uint8_t ctrl){
+	PinCtrl[port][pin] = ctrl;
+}
+
+uint8_t Hal_Gpio_Get_Pin_Ctrl(hal_port_t port, uint8_t pin){
+	return PinCtrl[port][pin];
+}
+
+void Hal_Gpio_Int_Ctrl(hal_port_t port, uint8_t ctrl){
+	IntCtrl[port] = ctrl;
+	if(PortIrqs[port] < 0){
+		if(ctrl & PORT_INT0LVL_gm) Sim_Error("INT0 of port %c isn't modeled", 'A' + port);
+		return;
+	}
+	Sim_Irq_Level(PortIrqs[port], ctrl & PORT_INT0LVL_gm);
+}
+
+uint8_t Hal_Gpio_Get_Int_Ctrl(hal_port_t port){
+	return IntCtrl[port];
+}
+
+void Hal_Gpio_Int0_Mask(hal_port_t port, uint8_t pins){
+	Int0Mask[port] = pins;
+}
+
+uint8_t Hal_Gpio_Get_Int0_Mask(hal_port_t port){
+	return Int0Mask[port];
+}
+
+//an edge the pin senses is an event on the channels the pin drives and raises the port's INT0 if the pin is in its mask.
+//level sensing isn't modeled
+void Sim_Pin_Drive(uint8_t port, uint8_t pin, uint8_t high){
+
+	uint8_t bit = 1 << pin, sense = PinCtrl[port][pin] & PORT_ISC_gm, sensed;
+
+	if(!(Sim_In[port] & bit) == !high) return;
+	if(high) Sim_In[port] |= bit;
+	else Sim_In[port] &= ~bit;
+	if(Sim_Dir[port] & bit) Sim_Error("pin %u of port %c driven by a chip and the cpu", pin, 'A' + port);
+	sensed = sense == PORT_ISC_BOTHEDGES_gc || (sense == PORT_ISC_RISING_gc && high) || (sense == PORT_ISC_FALLING_gc && !high);
+	if(sensed) Ev_Pin(port, pin);
+	if(PortIrqs[port] < 0 || !(Int0Mask[port] & bit)) return;
+	if(sense == PORT_ISC_LEVEL_gc) Sim_Error("level sensing on pin %u of port %c isn't modeled", pin, 'A' + port);
+	if(sensed) Sim_Irq_Raise(PortIrqs[port]);
+}
+
+void Hal_Spi_Ctrl(hal_spi_t spi, uint8_t ctrl){
+	SpiCtrl[spi] = ctrl;
+}
+
+void Hal_Spi_Int_Off(hal_spi_t spi){
+}
+
+uint8_t Hal_Spi_Transfer(hal_spi_t spi, uint8_t data){
+
+	static const uint8_t div[4] = {4, 16, 64, 128};
+	uint8_t ctrl = SpiCtrl[spi], miso = 0xFF;
+	uint32_t cycles;
+	Sim_Chip_t** chip;
+	Sim_Chip_t* driver = NULL;
+	Sim_Chip_t* on[SIM_CHIPS];
+	uint8_t n;
+
+	if((ctrl & (SPI_ENABLE_bm | SPI_MASTER_bm)) != (SPI_ENABLE_bm | SPI_MASTER_bm)){
+		Sim_Error("%s transfer with the module off or not master (CTRL 0x%02x)", SpiNames[spi], ctrl);
+	}
+	//the chips see the byte as things stand when it starts, a select that changes with it (through the port expander)
+	//counts from the next one
+	for(chip=Sim_Chips, n=0;*chip;chip++){
+		if((*chip)->spi != spi) continue;
+		if(!(*chip)->up && (*chip)->selected()) Sim_Error("%s selected without power", (*chip)->name);
+		if(!(*chip)->on) continue;
+		if(!(*chip)->listener && driver) Sim_Error("%s and %s both selected on %s", driver->name, (*chip)->name, SpiNames[spi]);
+		if(!(*chip)->listener) driver = *chip;
+		on[n++] = *chip;
+	}
+	while(n) miso &= on[--n]->transfer(data);
+	cycles = 8*div[ctrl & SPI_PRESCALER_gm]*Sim_Clock_Div;
+	if(ctrl & SPI_CLK2X_bm) cycles /= 2;
+	Sim_Advance(cycles + SPI_BYTE_OVERHEAD);
+	return miso;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// USARTC0 and the host on the other end of it. 2 received bytes wait in the module, the next one is lost (BUFOVF). a byte
+// written goes to the shift register if it is idle or waits in the data register
+
+static struct{
+	uint8_t ctrla, ctrlb, ctrlc, status;
+	uint16_t bsel;
+	uint8_t data, shift, shifting;
+	uint64_t shifted;	// the byte in the shift register is out
+	uint8_t rx[2], rxLength;
+	uint8_t in[SIM_SERIAL_BUF];	// from the host, still to come in
+	uint16_t inHead, inLength;
+	uint64_t inAt;	// the next one is in
+	uint8_t out[SIM_SERIAL_BUF];	// to the host
+	uint16_t outLength;
+} Usart = {.status = USART_DREIF_bm};
+
+static uint64_t Usart_Byte_Time(){
+
+	uint8_t bits = 1 + 5 + (Usart.ctrlc & 0x07) + ((Usart.ctrlc & 0x30) ? 1 : 0) + ((Usart.ctrlc & 0x08) ? 2 : 1);
+
+	return (uint64_t)bits*((Usart.ctrlb & USART_CLK2X_bm) ? 8 : 16)*(Usart.bsel + 1)*Sim_Clock_Div;
+}
+
+static void Usart_Flags(){
+	Sim_Irq_Level(SIM_IRQ_USARTC0_RXC, (Usart.ctrla & USART_RXCINTLVL_gm) >> 4);
+	Sim_Irq_Level(SIM_IRQ_USARTC0_DRE, Usart.ctrla & USART_DREINTLVL_gm);
+	Sim_Irq_Flag(SIM_IRQ_USARTC0_RXC, (Usart.status & USART_RXCIF_bm) != 0);
+	Sim_Irq_Flag(SIM_IRQ_USARTC0_DRE, (Usart.status & USART_DREIF_bm) != 0);
+}
+
+static void Usart_Shift(uint8_t byte){
+	if(!(Sim_Dir[HAL_PORTC] & PIN3_bm)) Sim_Error("USARTC0: sending with TXD (PC3) an input");
+	Usart.shift = byte;
+	Usart.shifting = TRUE;
+	Usart.shifted = Sim_Now + Usart_Byte_Time();
+}
+
+static uint64_t Usart_Next(){
+
+	uint64_t next = Usart.shifting ? Usart.shifted : 0;
+
+	if(Usart.inLength && (!next || Usart.inAt < next)) next = Usart.inAt;
+	return next;
+}
+
+static void Usart_Due(){
+	if(Usart.shifting && Usart.shifted <= Sim_Now){
+		if(Usart.outLength < SIM_SERIAL_BUF) Usart.out[Usart.outLength++] = Usart.shift;
+		Usart.shifting = FALSE;
+		if(!(Usart.status & USART_DREIF_bm)){
+			Usart.status |= USART_DREIF_bm;
+			Usart_Shift(Usart.data);
+		}
+		else Usart.status |= USART_TXCIF_bm;
+	}
+	if(Usart.inLength && Usart.inAt <= Sim_Now){
+		if(!(Usart.ctrlb & USART_RXEN_bm));	//the receiver is off, the byte goes by
+		else if(Usart.rxLength == sizeof(Usart.rx)){
+			Usart.status |= USART_BUFOVF_bm;
+			Sim_Serial_Overruns++;
+		}
+		else{
+			Usart.rx[Usart.rxLength++] = Usart.in[Usart.inHead];
+			Usart.status |= USART_RXCIF_bm;
+		}
+		Usart.inHead++;
+		Usart.inAt += Usart_Byte_Time();
+		if(!--Usart.inLength) Usart.inHead = 0;
+	}
+	Usart_Flags();
+}
+
+void Sim_Serial_Send(const uint8_t* data, uint16_t length){
+	if(Usart.inHead + Usart.inLength + length > SIM_SERIAL_BUF){
+		Sim_Error("more than %u bytes queued for USARTC0", SIM_SERIAL_BUF);
+		return;
+	}
+	if(!Usart.inLength) Usart.inAt = Sim_Now + Usart_Byte_Time();
+	memcpy(Usart.in + Usart.inHead + Usart.inLength, data, length);
+	Usart.inLength += length;
+}
+
+uint16_t Sim_Serial_Received(uint8_t* data){
+
+	uint16_t length = Usart.outLength;
+
+	memcpy(data, Usart.out, length);
+	Usart.outLength = 0;
+	return length;
+}
+
+void Hal_Usart_Baud(hal_usart_t usart, uint16_t bsel){
+	Usart.bsel = bsel & 0x0FFF;
+}
+
+void Hal_Usart_Ctrla(hal_usart_t usart, uint8_t ctrla){
+	Usart.ctrla = ctrla;
+	Usart_Flags();
+	Irq_Run();
+}
+
+uint8_t Hal_Usart_Get_Ctrla(hal_usart_t usart){
+	return Usart.ctrla;
+}
+
+void Hal_Usart_Ctrlb(hal_usart_t usart, uint8_t ctrlb){
+	Usart.ctrlb = ctrlb;
+	if(!(ctrlb & USART_RXEN_bm)){
+		Usart.rxLength = 0;
+		Usart.status &= ~(USART_RXCIF_bm | USART_BUFOVF_bm);
+	}
+	Usart_Flags();
+}
+
+uint8_t Hal_Usart_Get_Ctrlb(hal_usart_t usart){
+	return Usart.ctrlb;
+}
+
+void Hal_Usart_Ctrlc(hal_usart_t usart, uint8_t ctrlc){
+	Usart.ctrlc = ctrlc;
+}
+
+uint8_t Hal_Usart_Status(hal_usart_t usart){
+	return Usart.status;
+}
+
+void Hal_Usart_Clear_Status(hal_usart_t usart, uint8_t flags){
+	Usart.status &= ~(flags & USART_TXCIF_bm);
+}
+
+void Hal_Usart_Put(hal_usart_t usart, uint8_t data){
+	if(!(Usart.ctrlb & USART_TXEN_bm)) Sim_Error("USARTC0: DATA written with the transmitter off");
+	else if(!(Usart.status & USART_DREIF_bm)) Sim_Error("USARTC0: DATA written while it still holds a byte");
+	else if(!Usart.shifting) Usart_Shift(data);
+	else{
+		Usart.data = data;
+		Usart.status &= ~USART_DREIF_bm;
+	}
+	Usart_Flags();
+	Irq_Run();
+}
+
+uint8_t Hal_Usart_Get(hal_usart_t usart){
+
+	uint8_t data = Usart.rx[0];
+
+	if(!Usart.rxLength) return data;
+	Usart.rx[0] = Usart.rx[1];
+	if(!--Usart.rxLength) Usart.status &= ~USART_RXCIF_bm;
+	Usart.status &= ~USART_BUFOVF_bm;
+	Usart_Flags();
+	return data;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// EEPROM through the NVM controller. a write keeps it busy for SIM_EEPROM_WRITE_US and the next access waits it out, like
+// the busy flag the driver polls
+
+static uint64_t EepromBusyUntil;
+
+static void Eeprom_Wait(){
+	if(EepromBusyUntil > Sim_Now) Sim_Advance(EepromBusyUntil - Sim_Now);
+}
+
+void Hal_Eeprom_Unmap(){
+}
+
+void Hal_Eeprom_Write(uint16_t addr, uint8_t value){
+	Eeprom_Wait();
+	if(addr >= SIM_EEPROM_BYTES){
+		Sim_Error("EEPROM write at 0x%04x, past its end", addr);
+		return;
+	}
+	Sim_Eeprom[addr] = value;
+	Sim_Eeprom_Writes++;
+	EepromBusyUntil = Sim_Now + SIM_US(SIM_EEPROM_WRITE_US);
+}
+
+uint8_t Hal_Eeprom_Read(uint16_t addr){
+	Eeprom_Wait();
+	if(addr >= SIM_EEPROM_BYTES){
+		Sim_Error("EEPROM read at 0x%04x, past its end", addr);
+		return 0xFF;
+	}
+	return Sim_Eeprom[addr];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// TCD1, TCE0, TCF0, TCC0 and TCD0 (the accelerometer timers, here for SPIBus to mask their interrupts), the event
+// system and the RTC. a timer counts once per prescaled peripheral clock, or once per event on the channel its clock
+// select names (TCF0 counting TCD1's overflows is the local clock). the counts are brought up to date whenever the
+// firmware looks at a timer and at the next compare that has its interrupt on. a pin edge is an event on the channels
+// the pin drives and the timers capturing on them take their count, two deep like the chip's buffer. the RTC counts the
+// 32kHz crystal on its own, on through power-save where the peripheral clock and the timers stop. a compare flag stays
+// up in INTFLAGS when its handler runs, nothing reads it
+
+#define SIM_EVCHS 8
+#define SIM_RTC_SYNC 2	// RTC cycles a write to CNT or CTRL takes to get across to its clock
+
+static const char* TcNames[SIM_TCS] = {"TCD1", "TCE0", "TCF0", "TCC0", "TCD0"};
+static const uint8_t TcChannels[SIM_TCS] = {2, 4, 4, 4, 4};
+static const uint8_t TcOverflows[SIM_TCS] = {EVSYS_CHMUX_TCD1_OVF_gc, EVSYS_CHMUX_TCE0_OVF_gc, EVSYS_CHMUX_TCF0_OVF_gc,
+	EVSYS_CHMUX_TCC0_OVF_gc, EVSYS_CHMUX_TCD0_OVF_gc};
+static const int8_t TcIrqs[SIM_TCS][4] = {{-1, -1, -1, -1}, {-1, -1, -1, -1}, {-1, -1, SIM_IRQ_TCF0_CCC, SIM_IRQ_TCF0_CCD},
+	{-1, -1, -1, -1}, {-1, -1, -1, -1}};
+static const uint16_t TcDiv[8] = {0, 1, 2, 4, 8, 64, 256, 1024};
+static uint8_t EvMux[SIM_EVCHS];
+static uint64_t StoppedAt;
+static struct{
+	uint8_t clksel, ctrlb, ctrld, intctrlb, flags;
+	uint16_t cnt, per, cc[4];
+	uint16_t next[4];	// the second capture
+	uint8_t captures[4];
+	uint64_t at;	// the count is up to date to here
+} Tc[SIM_TCS];
+static struct{
+	uint8_t src, ctrl, intctrl, flags;
+	uint16_t cnt, per, comp;
+	uint64_t at;
+	uint64_t busyUntil;	// SYNCBUSY
+} Rtc = {.per = 0xFFFF};
+
+//cycles per count of a timer on the prescaler, 0 if it doesn't count by itself
+static uint64_t Tc_Cycles(uint8_t tc){
+	return (Tc[tc].clksel && Tc[tc].clksel < TC_CLKSEL_EVCH0_gc) ? (uint64_t)TcDiv[Tc[tc].clksel]*Sim_Clock_Div : 0;
+}
+
+static uint8_t Tc_Capturing(uint8_t tc, uint8_t ch){
+	return (Tc[tc].ctrld & TC0_EVACT_gm) == TC_EVACT_CAPT_gc && (Tc[tc].ctrlb & (TC0_CCAEN_bm << ch));
+}
+
+static void Tc_Steps(uint8_t tc, uint64_t n);
+
+//n events on channel ch for the timers that count them
+static void Ev_Clock(uint8_t ch, uint64_t n){
+
+	uint8_t tc;
+
+	for(tc=0;tc<SIM_TCS;tc++) if(Tc[tc].clksel == TC_CLKSEL_EVCH0_gc + ch) Tc_Steps(tc, n);
+}
+
+//move a timer's count on by n, with its compare matches and overflows. a count set past the period runs on to 0xFFFF
+static void Tc_Steps(uint8_t tc, uint64_t n){
+
+	uint32_t top = (uint32_t)Tc[tc].per + 1, cnt = Tc[tc].cnt, d;
+	uint64_t wraps;
+	uint8_t ch;
+
+	if(!n) return;
+	if(cnt >= top){
+		d = 0x10000 - cnt;
+		if(n < d){
+			Tc[tc].cnt += n;
+			return;
+		}
+		n -= d;
+		cnt = 0;
+	}
+	for(ch=0;ch<TcChannels[tc];ch++){
+		if(Tc_Capturing(tc, ch) || Tc[tc].cc[ch] >= top) continue;
+		d = (Tc[tc].cc[ch] + top - cnt)%top;
+		if((d ? d : top) > n) continue;
+		Tc[tc].flags |= TC0_CCAIF_bm << ch;
+		if(TcIrqs[tc][ch] >= 0) Sim_Irq_Raise(TcIrqs[tc][ch]);
+	}
+	wraps = (cnt + n)/top;
+	Tc[tc].cnt = (cnt + n)%top;
+	if(!wraps) return;
+	Tc[tc].flags |= TC0_OVFIF_bm;
+	for(ch=0;ch<SIM_EVCHS;ch++) if(EvMux[ch] == TcOverflows[tc]) Ev_Clock(ch, wraps);
+}
+
+//bring the counts up to date. the timers clocked through the event system come along with the ones they count
+static void Tc_Settle(){
+
+	uint64_t cycles, n;
+	uint8_t tc;
+
+	for(tc=0;tc<SIM_TCS;tc++){
+		cycles = Tc_Cycles(tc);
+		if(!cycles || Stopped){
+			Tc[tc].at = Sim_Now;
+			continue;
+		}
+		n = (Sim_Now - Tc[tc].at)/cycles;
+		Tc[tc].at += n*cycles;
+		Tc_Steps(tc, n);
+	}
+}
+
+//when a timer will have counted k more, 0 if it won't. a timer on events counts the overflows of one on the prescaler
+static uint64_t Tc_When(uint8_t tc, uint64_t k){
+
+	uint8_t ch, src;
+	uint32_t top;
+
+	if(Stopped) return 0;
+	if(Tc_Cycles(tc)) return Tc[tc].at + k*Tc_Cycles(tc);
+	if(Tc[tc].clksel < TC_CLKSEL_EVCH0_gc) return 0;
+	ch = Tc[tc].clksel - TC_CLKSEL_EVCH0_gc;
+	for(src=0;src<SIM_TCS;src++){
+		if(EvMux[ch] != TcOverflows[src] || !Tc_Cycles(src)) continue;
+		top = (uint32_t)Tc[src].per + 1;
+		return Tc_When(src, ((Tc[src].cnt < top) ? top - Tc[src].cnt : 0x10000 - Tc[src].cnt + top) + (k - 1)*top);
+	}
+	return 0;
+}
+
+//the next compare with its interrupt on
+static uint64_t Tc_Next(){
+
+	uint64_t at, soonest = 0;
+	uint32_t top, d;
+	uint8_t tc, ch;
+
+	for(tc=0;tc<SIM_TCS;tc++){
+		top = (uint32_t)Tc[tc].per + 1;
+		for(ch=0;ch<TcChannels[tc];ch++){
+			if(!((Tc[tc].intctrlb >> 2*ch) & 0x03) || Tc_Capturing(tc, ch) || Tc[tc].cc[ch] >= top) continue;
+			if(Tc[tc].cnt >= top) d = 0x10000 - Tc[tc].cnt + Tc[tc].cc[ch];
+			else d = (Tc[tc].cc[ch] + top - Tc[tc].cnt)%top;
+			at = Tc_When(tc, d ? d : top);
+			if(at && (!soonest || at < soonest)) soonest = at;
+		}
+	}
+	return soonest;
+}
+
+//an event on channel ch from a pin: the timers capturing on it take their count, the ones counting it count it
+static void Ev_Fire(uint8_t ch){
+
+	uint8_t tc, cc;
+
+	Tc_Settle();
+	for(tc=0;tc<SIM_TCS;tc++){
+		if((Tc[tc].ctrld & TC0_EVACT_gm) != TC_EVACT_CAPT_gc || (Tc[tc].ctrld & TC0_EVSEL_gm) < TC_EVSEL_CH0_gc) continue;
+		cc = ch - ((Tc[tc].ctrld & TC0_EVSEL_gm) - TC_EVSEL_CH0_gc);
+		if(cc >= TcChannels[tc] || !Tc_Capturing(tc, cc)) continue;
+		if(Tc[tc].captures[cc] == 2){
+			Tc[tc].flags |= TC0_ERRIF_bm;	//the buffer is full, the capture is lost
+			continue;
+		}
+		if(Tc[tc].captures[cc]++) Tc[tc].next[cc] = Tc[tc].cnt;
+		else Tc[tc].cc[cc] = Tc[tc].cnt;
+		Tc[tc].flags |= TC0_CCAIF_bm << cc;
+	}
+	Ev_Clock(ch, 1);
+}
+
+static void Ev_Pin(uint8_t port, uint8_t pin){
+
+	uint8_t ch;
+
+	for(ch=0;ch<SIM_EVCHS;ch++) if(EvMux[ch] == EVSYS_CHMUX_PORTA_PIN0_gc + 8*port + pin) Ev_Fire(ch);
+}
+
+static void Tc_Levels(uint8_t tc){
+
+	uint8_t ch, level;
+
+	for(ch=0;ch<TcChannels[tc];ch++){
+		level = (Tc[tc].intctrlb >> 2*ch) & 0x03;
+		if(TcIrqs[tc][ch] >= 0) Sim_Irq_Level(TcIrqs[tc][ch], level);
+		else if(level) Sim_Error("%s CC%c interrupt isn't modeled", TcNames[tc], 'A' + ch);
+	}
+}
+
+static uint8_t Tc_Channel(uint8_t tc, uint8_t ch){
+	if(ch < TcChannels[tc]) return TRUE;
+	Sim_Error("%s has no CC%c", TcNames[tc], 'A' + ch);
+	return FALSE;
+}
+
+void Hal_Timer_Clksel(hal_timer_t tc, uint8_t clksel){
+	Tc_Settle();
+	//a new rate counts from here, the part of a count the old one had gone is lost
+	Tc[tc].clksel = clksel & TC0_CLKSEL_gm;
+	Tc[tc].at = Sim_Now;
+}
+
+uint8_t Hal_Timer_Get_Clksel(hal_timer_t tc){
+	return Tc[tc].clksel;
+}
+
+uint8_t Hal_Timer_Running(hal_timer_t tc){
+	return Tc[tc].clksel != TC_CLKSEL_OFF_gc;
+}
+
+void Hal_Timer_Reset(hal_timer_t tc){
+	if(Tc[tc].clksel) Sim_Error("%s reset while it runs", TcNames[tc]);
+	memset(&Tc[tc], 0, sizeof(Tc[tc]));
+	Tc[tc].per = 0xFFFF;
+	Tc[tc].at = Sim_Now;
+	Tc_Levels(tc);
+}
+
+void Hal_Timer_Ctrlb(hal_timer_t tc, uint8_t ctrlb){
+	Tc_Settle();
+	Tc[tc].ctrlb = ctrlb;
+}
+
+void Hal_Timer_Ctrld(hal_timer_t tc, uint8_t ctrld){
+	Tc_Settle();
+	Tc[tc].ctrld = ctrld;
+}
+
+void Hal_Timer_Int_Ctrlb(hal_timer_t tc, uint8_t intctrlb){
+	Tc_Settle();
+	Tc[tc].intctrlb = intctrlb;
+	Tc_Levels(tc);
+	Irq_Run();
+}
+
+uint8_t Hal_Timer_Get_Int_Ctrlb(hal_timer_t tc){
+	return Tc[tc].intctrlb;
+}
+
+uint8_t Hal_Timer_Flags(hal_timer_t tc){
+	Tc_Settle();
+	return Tc[tc].flags;
+}
+
+void Hal_Timer_Clear_Flags(hal_timer_t tc, uint8_t flags){
+
+	uint8_t ch;
+
+	Tc_Settle();
+	Tc[tc].flags &= ~flags;
+	for(ch=0;ch<TcChannels[tc];ch++) if((flags & (TC0_CCAIF_bm << ch)) && TcIrqs[tc][ch] >= 0) Sim_Irq_Clear(TcIrqs[tc][ch]);
+}
+
+void Hal_Timer_Count(hal_timer_t tc, uint16_t cnt){
+	Tc_Settle();
+	Tc[tc].cnt = cnt;
+}
+
+uint16_t Hal_Timer_Get_Count(hal_timer_t tc){
+	Tc_Settle();
+	return Tc[tc].cnt;
+}
+
+void Hal_Timer_Period(hal_timer_t tc, uint16_t per){
+	Tc_Settle();
+	Tc[tc].per = per;
+}
+
+uint16_t Hal_Timer_Get_Period(hal_timer_t tc){
+	return Tc[tc].per;
+}
+
+void Hal_Timer_Cc(hal_timer_t tc, uint8_t ch, uint16_t value){
+	if(!Tc_Channel(tc, ch)) return;
+	Tc_Settle();
+	Tc[tc].cc[ch] = value;
+}
+
+//a capture channel gives its oldest capture and keeps its flag up while there is another
+uint16_t Hal_Timer_Get_Cc(hal_timer_t tc, uint8_t ch){
+
+	uint16_t value;
+
+	if(!Tc_Channel(tc, ch)) return 0;
+	Tc_Settle();
+	value = Tc[tc].cc[ch];
+	if(!Tc[tc].captures[ch]) return value;
+	if(--Tc[tc].captures[ch]) Tc[tc].cc[ch] = Tc[tc].next[ch];
+	else Tc[tc].flags &= ~(TC0_CCAIF_bm << ch);
+	return value;
+}
+
+void Hal_Event_Mux(uint8_t ch, uint8_t mux){
+	Tc_Settle();
+	EvMux[ch] = mux;
+}
+
+static uint8_t Rtc_Running(){
+	return (Rtc.src & CLK_RTCEN_bm) && (Rtc.src & CLK_RTCSRC_gm) == CLK_RTCSRC_TOSC32_gc && Rtc.ctrl;
+}
+
+//crystal cycles by time t and the time of the n-th one
+static uint64_t Rtc_Ticks(uint64_t t){
+	return t*SIM_RTC_HZ/SIM_HZ;
+}
+
+static uint64_t Rtc_Time(uint64_t n){
+	return (n*SIM_HZ + SIM_RTC_HZ - 1)/SIM_RTC_HZ;
+}
+
+static void Rtc_Settle(){
+
+	uint64_t n = Rtc_Ticks(Sim_Now) - Rtc_Ticks(Rtc.at);
+	uint32_t top = (uint32_t)Rtc.per + 1, d;
+
+	Rtc.at = Sim_Now;
+	if(!Rtc_Running() || !n) return;
+	d = (Rtc.comp + top - Rtc.cnt)%top;
+	if(Rtc.comp < top && (d ? d : top) <= n){
+		Rtc.flags |= RTC_COMPIF_bm;
+		Sim_Irq_Raise(SIM_IRQ_RTC_COMP);
+	}
+	if(Rtc.cnt + n >= top) Rtc.flags |= RTC_OVFIF_bm;
+	Rtc.cnt = (Rtc.cnt + n)%top;
+}
+
+static uint64_t Rtc_Next(){
+
+	uint32_t top = (uint32_t)Rtc.per + 1, d;
+
+	if(!Rtc_Running() || !(Rtc.intctrl & RTC_COMPINTLVL_gm) || Rtc.comp >= top) return 0;
+	d = (Rtc.comp + top - Rtc.cnt)%top;
+	return Rtc_Time(Rtc_Ticks(Rtc.at) + (d ? d : top));
+}
+
+static void Rtc_Sync(){
+	Rtc.busyUntil = Rtc_Time(Rtc_Ticks(Sim_Now) + SIM_RTC_SYNC);
+}
+
+void Hal_Rtc_Source(uint8_t src){
+	Rtc_Settle();
+	Rtc.src = src;
+}
+
+void Hal_Rtc_Wait(){
+	if(Rtc.busyUntil > Sim_Now) Sim_Advance(Rtc.busyUntil - Sim_Now);
+}
+
+void Hal_Rtc_Ctrl(uint8_t ctrl){
+	Rtc_Settle();
+	if((ctrl & RTC_PRESCALER_gm) > RTC_PRESCALER_DIV1_gc) Sim_Error("RTC prescaler 0x%02x isn't modeled", ctrl);
+	Rtc.ctrl = ctrl & RTC_PRESCALER_gm;
+	Rtc_Sync();
+}
+
+void Hal_Rtc_Period(uint16_t per){
+	Rtc_Settle();
+	Rtc.per = per;
+}
+
+void Hal_Rtc_Count(uint16_t cnt){
+	Rtc_Settle();
+	Rtc.cnt = cnt;
+	Rtc_Sync();
+}
+
+uint16_t Hal_Rtc_Get_Count(){
+	if(Rtc.busyUntil > Sim_Now) Sim_Error("RTC CNT read before it is in synch");
+	Rtc_Settle();
+	return Rtc.cnt;
+}
+
+void Hal_Rtc_Compare(uint16_t comp){
+	Rtc_Settle();
+	Rtc.comp = comp;
+}
+
+void Hal_Rtc_Int_Ctrl(uint8_t intctrl){
+	Rtc_Settle();
+	if(intctrl & RTC_OVFINTLVL_gm) Sim_Error("RTC overflow interrupt isn't modeled");
+	Rtc.intctrl = intctrl;
+	Sim_Irq_Level(SIM_IRQ_RTC_COMP, (intctrl & RTC_COMPINTLVL_gm) >> 2);
+	Irq_Run();
+}
+
+uint8_t Hal_Rtc_Get_Int_Ctrl(){
+	return Rtc.intctrl;
+}
+
+void Hal_Rtc_Clear_Flags(uint8_t flags){
+	Rtc_Settle();
+	Rtc.flags &= ~flags;
+	if(flags & RTC_COMPIF_bm) Sim_Irq_Clear(SIM_IRQ_RTC_COMP);
+}
+
+//the oscillator and its calibration are there from the start, and so is the 32kHz crystal
+void Hal_Clock_32MHz_Calibrated(){
+	Hal_Clock_Prescalers(CLK_PSADIV_1_gc, CLK_PSBCDIV_1_1_gc);
+}
+
+//prescaler A divides by 1, 2, 4, ... 512. a baud rate doesn't survive a change, so the USART has to be off
+void Hal_Clock_Prescalers(uint8_t psadiv, uint8_t psbcdiv){
+
+	uint8_t sel = (psadiv & CLK_PSADIV_gm) >> 2;
+	uint16_t div = (sel && (sel & 1)) ? 2 << (sel >> 1) : 1;
+
+	if(psbcdiv != CLK_PSBCDIV_1_1_gc) Sim_Error("clock prescalers B and C aren't modeled");
+	if(sel > 0x11 || (sel && !(sel & 1))) Sim_Error("clock prescaler A 0x%02x doesn't exist", psadiv);
+	if(div == Sim_Clock_Div) return;
+	if(Usart.ctrlb & (USART_RXEN_bm | USART_TXEN_bm)) Sim_Error("clock changed speed with USARTC0 on");
+	Tc_Settle();
+	Sim_Clock_Div = div;
+}
+
+//the core wakes up: the timers count on from here
+static void Sleep_Wake(){
+	Tc_Settle();
+	Stopped = FALSE;
+	Sim_Stopped += Sim_Now - StoppedAt;
+}
+
+//the clock moves on from one model to the next until a handler runs. in power-save the timers stand still and only the
+//pins and the RTC can wake the core
+void Hal_Sleep(uint8_t mode){
+
+	uint32_t taken = IrqTaken;
+	uint64_t at;
+	uint8_t model;
+
+	if(IrqOn) Sim_Error("sleep with interrupts on, one could come in before it and not wake the core");
+	if(mode == SLEEP_SMODE_PSAVE_gc){
+		Tc_Settle();
+		Stopped = TRUE;
+		StoppedAt = Sim_Now;
+	}
+	else if(mode != SLEEP_SMODE_IDLE_gc) Sim_Error("sleep mode 0x%02x isn't modeled", mode);
+	Hal_Irq_On();
+	while(IrqTaken == taken){
+		if(!(at = Timed_Next(&model))){
+			Sim_Error("asleep with nothing to wake the core");
+			break;
+		}
+		Sim_Advance((at > Sim_Now) ? at - Sim_Now : 0);
+	}
+	if(Stopped) Sleep_Wake();
+	Hal_Irq_Off();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+void Sim_Init(){
+
+	uint8_t tc;
+
+	memset(Sim_Eeprom, 0xFF, sizeof(Sim_Eeprom));	//erased
+	for(tc=0;tc<SIM_TCS;tc++) Tc[tc].per = 0xFFFF;
+	Sim_Timed(Usart_Next, Usart_Due);
+	Sim_Timed(Tc_Next, Tc_Settle);
+	Sim_Timed(Rtc_Next, Rtc_Settle);
+}
+
+//the delays count cpu cycles, so they run long on a slow clock like _delay_us does
+void Hal_Delay_Us(double us){
+	Sim_Advance(SIM_US(us)*Sim_Clock_Div);
+}
+
+void Hal_Delay_Ms(double ms){
+	Sim_Advance(SIM_US(ms*1000)*Sim_Clock_Div);
+}
+
+void Hal_Nop(){
+	Sim_Advance(Sim_Clock_Div);
+}
+
+void Hal_Spin(){
+	Sim_Advance(SIM_SPIN_CYCLES*Sim_Clock_Div);
+}
@@ -0,0 +1,784 @@
+/*
+ * hostsim.c
+ *
+ * Created: 10/19/2026
+ */
+// Host build of the firmware's drivers on the Linux backend of Hal.h. SPIBus.c, FRAM.c, SD_Card.c, FAT32.c, the port
+// expander and power switches in utility_functions.c, SerialUSB.c, the radio driver (chb.c, chb_drvr.c, chb_spi.c,
+// chb_eeprom.c) and the clock, local clock and event modules (Clock.c, TimeSynch.c, Event.c) are compiled as they are,
+// with HAL_SIM, against the chip models in chips.c and the USART, EEPROM, timer and RTC models in halsim.c. Each driver
+// is run through its paths and the result checked against the model (the local clock against the simulated one and the
+// wakeups at event deadlines, the FRAM contents, the port expander registers, the blocks in the disk image and the file
+// writeFile made on it, the frames the radio sent and took in and their timestamps, the bytes the host got), timed on
+// the simulated clock. Then the AD7767 is started and its data ready interrupt taken the way ISR(PORTF_INT0_vect) takes
+// it while SD blocks and FRAM go out, to find the highest sample rate that loses nothing.
+// Times count the SPI bytes at their clock, the radio's air time, the sd card's busy time and the delays; the cpu's own
+// instructions are free, so they are bus and wait times, not cpu cycles, and the sample rate is what the bus allows.
+// With -b the hot paths are timed one call at a time on the same clock (the sample read of the data ready interrupt,
+// writeFRAM, SD_write_block, writeFile, a radio frame upload and a whole chb_write) and written as name_bus_us=us
+// lines; -r compares them with a baseline file and fails on times that grew, so make bench catches regressions in bus
+// traffic and waits. It doesn't count the firmware's cycles on the ATxmega; the README says why that isn't here.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "Clock.h"
+#include "FRAM.h"
+#include "SD_Card.h"
+#include "chb.h"
+#include "chb_drvr.h"
+#include "FAT32.h"
+#include "SerialUSB.h"
+#include "Event.h"
+#include "TimeSynch.h"
+#include "Energy.h"
+
+#define FRAM_BYTES 65536UL
+#define FRAM_PIECE 4096	// bytes per writeFRAMAt
+#define SD_FIRST_SECTOR 2048	// where the tests write on the card
+#define RATE_MIN 250
+#define RATE_MAX 128000
+#define SAMPLING_BLOCKS 16	// sd blocks written per sampling run
+#define RF_ADDR 0x0102	// this node
+#define RF_PEER 0x0203	// the node it talks to
+#define RF_ED 0x40	// what frames come in with
+#define RF_RX_TIMEOUT_US 10000
+#define RF_TS_SLACK 4	// local ticks a timestamp may be off by, what clock speed changes gain or lose
+#define RF_DRDY_RATE 16000	// data ready rate while a frame is read out, a few edges come in during the read
+#define RF_DRDY_LATENCY_US 20	// longest the data ready interrupt may wait meanwhile, a few register accesses
+#define WAKE_MS 5	// an event deadline slept to in idle
+#define STOP_MS 100	// one slept to in power-save
+#define TICKS_PER_MS (TS_TICKS_PER_SEC/1000)
+#define TICKS_PER_RTC ((int32_t)(CLOCK_TICK_HZ/CLOCK_RTC_HZ))
+#define SERIAL_BAUD 1000000	// HOSTLINK_BAUD
+#define SERIAL_BYTES 200	// each way, less than the receive buffer holds
+#define BENCH_MAX 16
+#define BENCH_TOLERANCE 1	// percent a time may grow before it is a regression
+#define BENCH_RATE 250	// data ready rate for timing the interrupt, no second edge comes in while it runs
+#define FAT_FILE_BYTES 2048	// written, then 4096 appended to cross into a second cluster
+#define FAT_SECTORS 65536UL	// the benchmark partition, 32MB
+#define FAT_RESERVED 32	// sectors before the first FAT
+#define FAT_CLUSTER 8	// sectors per cluster
+#define FAT_SIZE 64	// sectors per FAT, enough for the partition's clusters
+#define FAT_ALIGN 2048	// the partition starts on a multiple of this, past the sectors the tests use
+
+// interrupt handlers
+void USARTC0_RXC_vect(void);
+void USARTC0_DRE_vect(void);
+void PORTD_INT0_vect(void);
+void RTC_COMP_vect(void);
+void TCF0_CCC_vect(void);
+void TCF0_CCD_vect(void);
+
+static struct{
+	char* image;	// disk image, a temporary file if none
+	uint32_t blocks;	// sd blocks per test
+	uint32_t rate;	// sample rate for the sampling test, 0 to search
+	char* bench;	// where the benchmark results go, NULL for none
+	char* baseline;	// results to compare them with
+} cfg = {NULL, 64, 0, NULL, NULL};
+
+static uint32_t Failures;
+static uint32_t Expected, Missed, Corrupt;
+static struct{
+	const char* name;
+	double us;
+} Bench[BENCH_MAX];
+static uint8_t Benches;
+
+static void Check(uint8_t ok, const char* what){
+	if(ok) return;
+	Failures++;
+	fprintf(stderr, "hostsim: FAILED %s\n", what);
+}
+
+static double Kbps(uint32_t bytes, uint64_t cycles){
+	return cycles ? bytes*(double)SIM_HZ/cycles/1024 : 0;
+}
+
+static double Us(uint64_t cycles){
+	return cycles*1e6/SIM_HZ;
+}
+
+//local clock ticks in a stretch of the simulated clock
+static uint32_t Ticks(uint64_t cycles){
+	return cycles/(SIM_HZ/CLOCK_TICK_HZ);
+}
+
+//a local time within slack ticks of another
+static uint8_t Near(uint32_t t, uint32_t expected, uint32_t slack){
+	return (uint32_t)(t - expected + slack) <= 2*slack;
+}
+
+static void Fill(uint8_t* data, uint32_t length, uint32_t seed){
+	while(length--){
+		seed = seed*1103515245UL + 12345;
+		*data++ = seed >> 16;
+	}
+}
+
+//the bus part of ISR(PORTF_INT0_vect): take the bus from whoever has it and read the 24 bits
+static void Drdy(){
+
+	const SPIBus_Device_t* prev;
+	uint32_t sample, n;
+
+	prev = SPIBus_Acquire(&SPIBus_ADC);
+	for(uint8_t bufIndex = 0; bufIndex < 3; bufIndex++) {
+		SPIBuffer[bufIndex] = Hal_Spi_Transfer(HAL_SPIC, 0xAA);
+	}
+	SPIBus_Release(&SPIBus_ADC, prev);
+	sample = ((uint32_t)SPIBuffer[0] << 16) | (SPIBuffer[1] << 8) | SPIBuffer[2];
+	//the converter may have moved on since the edge this runs for
+	n = Ad7767_Converted() - 1;
+	if(sample != Ad7767_Sample(n)) Corrupt++;
+	if(n > Expected) Missed += n - Expected;
+	Expected = n + 1;
+}
+
+//sleep in Event_Wait until a deadline dt ticks out. returns how late it woke, negative if early
+static int32_t Wake_After(uint32_t dt){
+
+	uint32_t deadline = TimeSynch_Get_Local_Time() + dt;
+
+	Event_Wake_At(deadline);
+	Check(Event_Wait(EVENT_TIMER) == EVENT_TIMER, "Event_Wait returns the timer event");
+	return (int32_t)(TimeSynch_Get_Local_Time() - deadline);
+}
+
+//the local clock (TCD1 and TCF0) against the simulated one at full speed, across a slow spell and through power-save,
+//wakeups at event deadlines in idle and power-save, and the root's beacon compare
+static void Test_Clock(){
+
+	uint32_t t, stopped;
+	uint64_t start;
+	int32_t idle, stop;
+	hal_irq_t irq;
+
+	Sim_Irq_Handler(SIM_IRQ_RTC_COMP, RTC_COMP_vect);
+	Sim_Irq_Handler(SIM_IRQ_TCF0_CCC, TCF0_CCC_vect);
+	Sim_Irq_Handler(SIM_IRQ_TCF0_CCD, TCF0_CCD_vect);
+	Clock_Init();
+	TimeSynch_Init(FALSE, 0);
+	Energy_Reset();
+
+	t = TimeSynch_Get_Local_Time();
+	start = Sim_Now;
+	Hal_Delay_Ms(10);
+	Check(Near(TimeSynch_Get_Local_Time() - t, Ticks(Sim_Now - start), 1), "the local clock counts CLOCK_TICK_HZ");
+	t = TimeSynch_Get_Local_Time();
+	start = Sim_Now;
+	irq = Hal_Irq_Save();
+	Clock_Slow();
+	Check(Sim_Clock_Div == CLOCK_SLOW_DIV && Clock_Hz() == CLOCK_SLOW_HZ, "Clock_Slow prescales the clock");
+	Hal_Delay_Ms(1);
+	Clock_Fast();
+	Hal_Irq_Restore(irq);
+	Check(Sim_Clock_Div == 1 && Near(TimeSynch_Get_Local_Time() - t, Ticks(Sim_Now - start), 2),
+		"the local clock keeps its rate across a slow spell");
+
+	idle = Wake_After(WAKE_MS*TICKS_PER_MS);
+	Check(idle > -4*TICKS_PER_RTC && idle < TICKS_PER_RTC, "Event_Wake_At wakes the core from idle at the deadline");
+	Check(Energy_Get_Ms(ENERGY_CPU, ENERGY_CPU_SLEEP_SLOW) + 1 >= WAKE_MS, "idle at the slow clock accounted");
+
+	//nothing holds the clock running: power-save, the RTC times the sleep and the local clock catches up after it
+	Clock_Release_Running(CLOCK_HOLD_RADIO | CLOCK_HOLD_APP);
+	t = TimeSynch_Get_Local_Time();
+	start = Sim_Now;
+	stopped = Sim_Stopped;
+	stop = Wake_After(STOP_MS*TICKS_PER_MS);
+	Clock_Hold_Running(CLOCK_HOLD_RADIO | CLOCK_HOLD_APP);
+	Check(Sim_Stopped - stopped > Sim_Now - start - SIM_US(1000), "Event_Wait sleeps in power-save");
+	Check(Near(TimeSynch_Get_Local_Time() - t, Ticks(Sim_Now - start), 2*TICKS_PER_RTC), "Clock_Start catches the local clock up");
+	Check(stop > -4*TICKS_PER_RTC && stop < TICKS_PER_RTC, "Event_Wake_At wakes the core from power-save at the deadline");
+	Check(Energy_Get_Ms(ENERGY_CPU, ENERGY_CPU_STOP) + 1 >= STOP_MS, "power-save accounted");
+
+	//a beacon is due a second after the root starts, to a high word tick
+	TimeSynch_Init(TRUE, 1);
+	start = Sim_Now;
+	TimeSynchBeaconDue = 0;
+	Check(Event_Wait(EVENT_TIMER) == EVENT_TIMER && TimeSynchBeaconDue &&
+		Near(Ticks(Sim_Now - start), (TS_TICKS_PER_SEC >> 16) << 16, 2), "the root's beacon comes due on the TCF0 compare");
+	TimeSynch_Init(FALSE, 0);
+	Energy_Reset();
+	printf("event wakeup from idle      %10.1f us late\nevent wakeup from power-save%10.1f us late\n",
+		idle*1e6/CLOCK_TICK_HZ, stop*1e6/CLOCK_TICK_HZ);
+}
+
+static void Test_PortEx(){
+
+	uint64_t start = Sim_Now;
+
+	ADCPower(TRUE);
+	printf("ADCPower on                 %10.1f us\n", Us(Sim_Now - start));
+	Check(PortEx_Reg(0x00) == 0x00 && PortEx_Reg(0x14) == 0xFF, "port expander bank A after ADCPower");
+	start = Sim_Now;
+	PortEx_DIRSET(BIT5_bm, PS_BANKB);
+	PortEx_OUTSET(BIT5_bm, PS_BANKB);
+	printf("PortEx pin set up           %10.1f us\n", Us(Sim_Now - start));
+	start = Sim_Now;
+	PortEx_Begin();
+	PortEx_DIRSET(BIT1_bm | BIT2_bm, PS_BANKB);
+	PortEx_OUTCLR(BIT5_bm, PS_BANKB);
+	PortEx_OUTSET(BIT2_bm, PS_BANKB);
+	PortEx_End();
+	printf("PortEx batch of 3           %10.1f us\n", Us(Sim_Now - start));
+	PortEx_DIRCLR(BIT1_bm | BIT2_bm | BIT5_bm, PS_BANKB);
+	Check(PortEx_Reg(0x01) == (uint8_t)~bankB_DIR && PortEx_Reg(0x15) == bankB_OUT, "port expander bank B against the shadows");
+}
+
+static void Put16(uint8_t* at, uint16_t value){
+	at[0] = value;
+	at[1] = value >> 8;
+}
+
+static void Put32(uint8_t* at, uint32_t value){
+	Put16(at, value);
+	Put16(at + 2, value >> 16);
+}
+
+static uint16_t Get16(const uint8_t* at){
+	return at[0] | (at[1] << 8);
+}
+
+static uint32_t Get32(const uint8_t* at){
+	return Get16(at) | ((uint32_t)Get16(at + 2) << 16);
+}
+
+static void Sector_Write(FILE* image, uint32_t sector, const uint8_t* data){
+	if(fseek(image, (long)sector*SDHC_SECTOR_SIZE, SEEK_SET) || fwrite(data, 1, SDHC_SECTOR_SIZE, image) != SDHC_SECTOR_SIZE){
+		Check(FALSE, "writing the benchmark file system");
+	}
+}
+
+static void Sector_Read(FILE* image, uint32_t sector, uint8_t* data){
+	fflush(image);
+	memset(data, 0, SDHC_SECTOR_SIZE);
+	if(fseek(image, (long)sector*SDHC_SECTOR_SIZE, SEEK_SET) || fread(data, 1, SDHC_SECTOR_SIZE, image) != SDHC_SECTOR_SIZE){
+		Check(FALSE, "reading back the benchmark file system");
+	}
+}
+
+//an MBR with one FAT32 partition at first: boot sector, FSinfo, two FATs and an empty root directory in cluster 2, the
+//fields getBootSectorData reads
+static void Fat32_Format(FILE* image, uint32_t first){
+
+	uint8_t sector[SDHC_SECTOR_SIZE];
+	uint32_t i, clusters = (FAT_SECTORS - FAT_RESERVED - 2*FAT_SIZE)/FAT_CLUSTER;
+
+	memset(sector, 0, sizeof(sector));
+	sector[446 + 4] = 0x0C;	//FAT32 with LBA
+	Put32(sector + 446 + 8, first);
+	Put32(sector + 446 + 12, FAT_SECTORS);
+	Put16(sector + 510, 0xAA55);
+	Sector_Write(image, 0, sector);
+
+	memset(sector, 0, sizeof(sector));
+	memcpy(sector, "\xEB\x58\x90HOSTSIM ", 11);
+	Put16(sector + 11, SDHC_SECTOR_SIZE);
+	sector[13] = FAT_CLUSTER;
+	Put16(sector + 14, FAT_RESERVED);
+	sector[16] = 2;	//FATs
+	sector[21] = 0xF8;	//fixed disk
+	Put32(sector + 28, first);	//hidden sectors
+	Put32(sector + 32, FAT_SECTORS);
+	Put32(sector + 36, FAT_SIZE);
+	Put32(sector + 44, 2);	//root directory cluster
+	Put16(sector + 48, 1);	//FSinfo sector
+	Put16(sector + 50, 6);	//backup boot sector
+	sector[66] = 0x29;
+	memcpy(sector + 82, "FAT32   ", 8);
+	Put16(sector + 510, 0xAA55);
+	Sector_Write(image, first, sector);
+
+	memset(sector, 0, sizeof(sector));
+	Put32(sector, 0x41615252);
+	Put32(sector + 484, 0x61417272);
+	Put32(sector + 488, clusters - 1);	//free
+	Put32(sector + 492, 3);	//next free
+	Put32(sector + 508, 0xAA550000);
+	Sector_Write(image, first + 1, sector);
+
+	memset(sector, 0, sizeof(sector));
+	for(i=0;i<2*FAT_SIZE + FAT_CLUSTER;i++) Sector_Write(image, first + FAT_RESERVED + i, sector);
+	Put32(sector, 0x0FFFFFF8);
+	Put32(sector + 4, 0x0FFFFFFF);
+	Put32(sector + 8, 0x0FFFFFFF);	//the root directory's one cluster
+	for(i=0;i<2;i++) Sector_Write(image, first + FAT_RESERVED + i*FAT_SIZE, sector);
+}
+
+//writeFile of a new file, then an append that fills its cluster and takes a second one, checked against the image
+static void Test_FAT32(FILE* image){
+
+	static uint8_t data[3*FAT_FILE_BYTES];
+	uint8_t sector[SDHC_SECTOR_SIZE];
+	uint32_t first = (SD_FIRST_SECTOR + 3*cfg.blocks + SAMPLING_BLOCKS + FAT_ALIGN - 1)/FAT_ALIGN*FAT_ALIGN;
+	uint32_t root = first + FAT_RESERVED + 2*FAT_SIZE, cluster, i;
+	uint8_t same = TRUE;
+	uint64_t start, created;
+
+	Fat32_Format(image, first);
+	Check(getBootSectorData() == 0, "getBootSectorData on the FAT32 partition");
+	Fill(data, sizeof(data), 6);
+	start = Sim_Now;
+	Check(writeFile((unsigned char*)"TEST.DAT", data, FAT_FILE_BYTES) == 0, "writeFile of a new file");
+	created = Sim_Now - start;
+	start = Sim_Now;
+	Check(writeFile((unsigned char*)"TEST.DAT", data + FAT_FILE_BYTES, 2*FAT_FILE_BYTES) == 0, "writeFile append");
+	start = Sim_Now - start;
+
+	//a fresh partition puts the file in the clusters after the root directory
+	Sector_Read(image, root, sector);
+	cluster = ((uint32_t)Get16(sector + 20) << 16) | Get16(sector + 26);
+	Check(!memcmp(sector, "TEST    DAT", 11) && Get32(sector + 28) == sizeof(data), "directory entry made by writeFile");
+	for(i=0;i<sizeof(data)/SDHC_SECTOR_SIZE;i++){
+		Sector_Read(image, root + (cluster - 2)*FAT_CLUSTER + i, sector);
+		if(memcmp(sector, data + i*SDHC_SECTOR_SIZE, SDHC_SECTOR_SIZE)) same = FALSE;
+	}
+	Check(same, "file contents on the image against writeFile, across the cluster boundary");
+	printf("writeFile new file          %10.1f kB/s\nwriteFile append            %10.1f kB/s\n",
+		Kbps(FAT_FILE_BYTES, created), Kbps(2*FAT_FILE_BYTES, start));
+}
+
+static void Test_FRAM(double* write, double* read){
+
+	static uint8_t data[FRAM_BYTES];
+	uint64_t start;
+	uint32_t addr, length;
+	uint8_t same = TRUE;
+
+	Fill(data, sizeof(data), 1);
+	start = Sim_Now;
+	for(addr=0;addr<FRAM_BYTES;addr+=FRAM_PIECE) writeFRAMAt(data + addr, FRAM_PIECE, addr);
+	*write = Kbps(FRAM_BYTES, Sim_Now - start);
+	Check(!memcmp(Fram_Mem, data, sizeof(data)), "FRAM contents after writeFRAMAt");
+	start = Sim_Now;
+	for(addr=0;addr<FRAM_BYTES;addr+=length){
+		length = (FRAM_BYTES - addr < FR_READ_BUFFER_SIZE) ? FRAM_BYTES - addr : FR_READ_BUFFER_SIZE;
+		readFRAM(length, addr);
+		if(memcmp(FRAMReadBuffer, data + addr, length)) same = FALSE;
+	}
+	*read = Kbps(FRAM_BYTES, Sim_Now - start);
+	Check(same, "readFRAM against what was written");
+	printf("FRAM write                  %10.1f kB/s\nFRAM read                   %10.1f kB/s\n", *write, *read);
+}
+
+static void Test_SD(FILE* image, double* single, double* held, double* multi, double* read){
+
+	uint8_t* data = malloc(cfg.blocks*SDHC_SECTOR_SIZE);
+	uint8_t* back = malloc(cfg.blocks*SDHC_SECTOR_SIZE);
+	uint8_t* disk = malloc(cfg.blocks*SDHC_SECTOR_SIZE);
+	uint32_t bytes = cfg.blocks*SDHC_SECTOR_SIZE, i;
+	uint64_t start;
+
+	start = Sim_Now;
+	Check(SD_init() == 0, "SD_init");
+	printf("SD_init                     %10.1f ms\n", Us(Sim_Now - start)/1000);
+
+	Fill(data, bytes, 2);
+	start = Sim_Now;
+	for(i=0;i<cfg.blocks;i++) SD_write_block(SD_FIRST_SECTOR + i, data + i*SDHC_SECTOR_SIZE, SDHC_SECTOR_SIZE);
+	*single = Kbps(bytes, Sim_Now - start);
+	start = Sim_Now;
+	for(i=0;i<cfg.blocks;i++) SD_read_block(SD_FIRST_SECTOR + i, back + i*SDHC_SECTOR_SIZE);
+	*read = Kbps(bytes, Sim_Now - start);
+	Check(!memcmp(data, back, bytes), "SD_read_block against SD_write_block");
+
+	Fill(data, bytes, 3);
+	start = Sim_Now;
+	SD_Hold(TRUE);
+	for(i=0;i<cfg.blocks;i++) SD_write_block(SD_FIRST_SECTOR + i, data + i*SDHC_SECTOR_SIZE, SDHC_SECTOR_SIZE);
+	SD_Hold(FALSE);
+	*held = Kbps(bytes, Sim_Now - start);
+
+	Fill(data, bytes, 4);
+	start = Sim_Now;
+	SD_write_multiple_blocks(SD_FIRST_SECTOR + cfg.blocks, data, bytes);
+	*multi = Kbps(bytes, Sim_Now - start);
+	memset(back, 0, bytes);
+	SD_read_multiple_blocks(SD_FIRST_SECTOR + cfg.blocks, back, cfg.blocks);
+	Check(!memcmp(data, back, bytes), "SD_read_multiple_blocks against SD_write_multiple_blocks");
+	fflush(image);
+	Check(!fseek(image, (SD_FIRST_SECTOR + cfg.blocks)*SDHC_SECTOR_SIZE, SEEK_SET) && fread(disk, 1, bytes, image) == bytes
+		&& !memcmp(data, disk, bytes), "disk image against SD_write_multiple_blocks");
+	printf("SD_write_block              %10.1f kB/s\nSD_write_block held         %10.1f kB/s\n"
+		"SD_write_multiple_blocks    %10.1f kB/s\nSD_read_block               %10.1f kB/s\n", *single, *held, *multi, *read);
+	free(data);
+	free(back);
+	free(disk);
+}
+
+//sample at rate while sd blocks and FRAM go out. returns TRUE if nothing was lost
+static uint8_t Sampling_Run(uint32_t rate, uint64_t* latency){
+
+	uint8_t data[SDHC_SECTOR_SIZE];
+	uint8_t i;
+
+	Fill(data, sizeof(data), rate);
+	Expected = Missed = Corrupt = 0;
+	Sim_Reset_Stats();
+	Ad7767_Start(rate);
+	SD_Hold(TRUE);
+	for(i=0;i<SAMPLING_BLOCKS;i++) SD_write_block(SD_FIRST_SECTOR + 3*cfg.blocks + i, data, sizeof(data));
+	SD_Hold(FALSE);
+	writeFRAMAt(data, sizeof(data), 0);
+	readFRAM(sizeof(data), 0);
+	Ad7767_Start(0);
+	*latency = Sim_Irq_Latency_Max[SIM_IRQ_PORTF_INT0];
+	printf("sampling at %6u Hz        %6u samples %4u missed %4u corrupt, latency %7.1f us, interrupts off %7.1f us\n",
+		rate, Expected, Missed, Corrupt, Us(Sim_Irq_Latency_Max[SIM_IRQ_PORTF_INT0]), Us(Sim_Irq_Off_Max));
+	Check(!Corrupt, "samples read intact");
+	return !Missed && !Corrupt;
+}
+
+//a frame from RF_PEER as chb_write builds it, FCS left for the radio
+static uint8_t Radio_Peer_Frame(uint8_t* psdu, uint16_t dest, const uint8_t* data, uint8_t length, uint8_t seq){
+	psdu[0] = CHB_FCF_BYTE_0 | (1 << CHB_ACK_REQ_POS);
+	psdu[1] = CHB_FCF_BYTE_1;
+	psdu[2] = seq;
+	psdu[3] = CHB_PAN_ID & 0xFF;
+	psdu[4] = CHB_PAN_ID >> 8;
+	psdu[5] = dest & 0xFF;
+	psdu[6] = dest >> 8;
+	psdu[7] = RF_PEER & 0xFF;
+	psdu[8] = RF_PEER >> 8;
+	memcpy(psdu + CHB_HDR_SZ, data, length);
+	return CHB_HDR_SZ + length + CHB_FCS_LEN;
+}
+
+static uint8_t Radio_Wait_Rx(){
+
+	uint64_t start = Sim_Now;
+
+	while(!chb_get_pcb()->data_rcv && Sim_Now - start < SIM_US(RF_RX_TIMEOUT_US)) Hal_Spin();
+	return chb_get_pcb()->data_rcv;
+}
+
+//chb_init with the short address in the EEPROM, then a full frame out with chb_write, acked and not, and frames from
+//another node in through the IRQ and chb_read
+static void Test_Radio(double* tx, double* rx){
+
+	uint8_t data[CHB_MAX_PAYLOAD], psdu[CHB_MAX_PSDU], length, status;
+	const uint8_t* sent;
+	chb_rx_data_t frame;
+	uint32_t frames, edge;
+	uint64_t start;
+
+	Sim_Eeprom[CHB_EEPROM_SHORT_ADDR] = RF_ADDR & 0xFF;
+	Sim_Eeprom[CHB_EEPROM_SHORT_ADDR + 1] = RF_ADDR >> 8;
+	Sim_Irq_Handler(SIM_IRQ_PORTD_INT0, PORTD_INT0_vect);
+	chb_init();
+	Check(Radio_Reg(TRX_STATUS) == CHB_RX_AACK_ON, "chb_init leaves the radio in RX_AACK_ON");
+	Check(Radio_Reg(SHORT_ADDR_0) == (RF_ADDR & 0xFF) && Radio_Reg(SHORT_ADDR_1) == (RF_ADDR >> 8) &&
+		Radio_Reg(PAN_ID_0) == (CHB_PAN_ID & 0xFF) && Radio_Reg(PAN_ID_1) == (CHB_PAN_ID >> 8),
+		"chb_init sets the PAN and the short address from the EEPROM");
+	Check(chb_get_short_addr() == RF_ADDR, "chb_get_short_addr");
+
+	Fill(data, sizeof(data), 5);
+	frames = Radio_Frames_Sent();
+	start = Sim_Now;
+	status = chb_write(RF_PEER, data, sizeof(data));
+	*tx = Us(Sim_Now - start);
+	sent = Radio_Sent();
+	Check(status == CHB_SUCCESS && Radio_Frames_Sent() == frames + 1, "chb_write sends one frame and gets it acked");
+	Check(chb_get_pcb()->tx_ts_valid && Near(chb_get_pcb()->tx_ts, TimeSynch_Get_Local_Time() - Ticks(Sim_Now - Radio_Irq_Edge),
+		RF_TS_SLACK), "chb_write stamps the end of the frame on the local clock");
+	Check(sent[0] == CHB_MAX_PSDU && sent[1] == (CHB_FCF_BYTE_0 | (1 << CHB_ACK_REQ_POS)) && sent[2] == CHB_FCF_BYTE_1 &&
+		sent[6] == (RF_PEER & 0xFF) && sent[7] == (RF_PEER >> 8) && sent[8] == (RF_ADDR & 0xFF) &&
+		sent[9] == (RF_ADDR >> 8) && !memcmp(sent + 1 + CHB_HDR_SZ, data, sizeof(data)), "the frame chb_write sent");
+	Check(Radio_Reg(TRX_STATUS) == CHB_RX_AACK_ON, "the radio listens again after sending");
+
+	Radio_Acks = FALSE;
+	status = chb_write(RF_PEER, data, 16);
+	Radio_Acks = TRUE;
+	Check(status == CHB_NO_ACK && Radio_Reg(TRX_STATUS) == CHB_RX_AACK_ON, "chb_write without an ack");
+
+	//from the start of the frame on the air to it in chb's buffer
+	length = Radio_Peer_Frame(psdu, RF_ADDR, data, sizeof(data), 1);
+	start = Sim_Now;
+	Radio_Receive(psdu, length, TRUE, RF_ED);
+	Check(Radio_Wait_Rx(), "a frame for this node comes in");
+	*rx = Us(Sim_Now - start);
+	edge = TimeSynch_Get_Local_Time() - Ticks(Sim_Now - Radio_Irq_Edge);
+	//chb_read moves the payload to the start of frame, the sender stays in the pcb
+	length = chb_read(&frame);
+	Check(length == sizeof(data) && !memcmp(&frame, data, length) && chb_get_pcb()->sender_addr == RF_PEER &&
+		chb_get_pcb()->ed == RF_ED, "chb_read gives the payload, the sender and the ed");
+	Check(chb_get_pcb()->rx_ts_valid && Near(chb_get_pcb()->rx_ts, edge, RF_TS_SLACK), "the frame's timestamp from the capture");
+	Hal_Delay_Ms(1);	//the ack goes out
+
+	length = Radio_Peer_Frame(psdu, RF_ADDR + 1, data, 16, 2);
+	Radio_Receive(psdu, length, TRUE, RF_ED);
+	Check(!Radio_Wait_Rx(), "a frame for another node is filtered out");
+	length = Radio_Peer_Frame(psdu, RF_ADDR, data, 16, 3);
+	Radio_Receive(psdu, length, FALSE, RF_ED);
+	Check(!Radio_Wait_Rx(), "a frame with a bad crc is filtered out");
+	Check(!Radio_Frames_Missed(), "no frame came in while the radio wasn't listening");
+
+	//the radio interrupt reads the frame out with the data ready interrupt coming in on top of it
+	length = Radio_Peer_Frame(psdu, RF_ADDR, data, sizeof(data), 4);
+	Expected = Missed = Corrupt = 0;
+	Sim_Reset_Stats();
+	Ad7767_Start(RF_DRDY_RATE);
+	Radio_Receive(psdu, length, TRUE, RF_ED);
+	Check(Radio_Wait_Rx(), "a frame comes in while the ADC samples");
+	Ad7767_Start(0);
+	Check(chb_read(&frame) == sizeof(data) && !memcmp(&frame, data, sizeof(data)), "the frame read out while the ADC samples");
+	Check(!Missed && !Corrupt && Sim_Irq_Latency_Max[SIM_IRQ_PORTF_INT0] < SIM_US(RF_DRDY_LATENCY_US),
+		"the data ready interrupt isn't held off while a frame is read out");
+	Hal_Delay_Ms(1);
+	printf("radio chb_write (%u B)    %10.1f us\nradio frame in to chb_read %10.1f us\n", CHB_MAX_PAYLOAD, *tx, *rx);
+}
+
+//the serial link at the base station's baud rate: a buffer out to the host and one back, then bytes from the host while sd
+//blocks go out
+static void Test_Serial(double* out, double* in, uint32_t* lost){
+
+	uint8_t data[SERIAL_BYTES], back[SERIAL_BYTES];
+	uint32_t overruns;
+	uint64_t start;
+	uint16_t i;
+
+	Sim_Irq_Handler(SIM_IRQ_USARTC0_RXC, USARTC0_RXC_vect);
+	Sim_Irq_Handler(SIM_IRQ_USARTC0_DRE, USARTC0_DRE_vect);
+	Check(StartSerial(SERIAL_BAUD), "StartSerial");
+	Fill(data, sizeof(data), 9);
+	start = Sim_Now;
+	SerialWriteBuffer(data, sizeof(data));
+	SerialFlush();
+	*out = Kbps(sizeof(data), Sim_Now - start);
+	Check(Sim_Serial_Received(back) == sizeof(data) && !memcmp(back, data, sizeof(data)), "bytes the host got from SerialWriteBuffer");
+
+	Fill(data, sizeof(data), 10);
+	Event_Get(EVENT_ALL);
+	start = Sim_Now;
+	Sim_Serial_Send(data, sizeof(data));
+	for(i=0;i<sizeof(data);i++) back[i] = SerialReadByte();
+	*in = Kbps(sizeof(data), Sim_Now - start);
+	Check(!memcmp(back, data, sizeof(data)) && !SerialRxOverruns() && !Sim_Serial_Overruns, "bytes SerialReadByte got from the host");
+	Check(Event_Get(EVENT_HOST), "EVENT_HOST posted by the receive interrupt");
+
+	//an sd block only holds off the interrupts that use the bus, the receive interrupt keeps taking the bytes
+	overruns = Sim_Serial_Overruns;
+	Sim_Serial_Send(data, sizeof(data));
+	SD_Hold(TRUE);
+	for(i=0;i<SERIAL_BYTES*10*SIM_HZ/SERIAL_BAUD/SIM_US(Sd_Write_Us) + 1;i++){
+		SD_write_block(SD_FIRST_SECTOR + 3*cfg.blocks + i, data, SDHC_SECTOR_SIZE);
+	}
+	SD_Hold(FALSE);
+	Hal_Delay_Ms(1);
+	*lost = Sim_Serial_Overruns - overruns;
+	Check(SerialAvailable() + *lost == sizeof(data), "bytes from the host during sd writes counted");
+	Check(!*lost, "no bytes from the host lost during sd writes");
+	while(SerialAvailable()) SerialReadByte();
+	StopSerial();
+	printf("serial out at %7u baud  %10.1f kB/s\nserial in                   %10.1f kB/s\n"
+		"serial in during sd writes  %6u of %u bytes lost\n", SERIAL_BAUD, *out, *in, *lost, SERIAL_BYTES);
+}
+
+static void Bench_Add(const char* name, uint64_t cycles){
+	if(Benches == BENCH_MAX) return;
+	Bench[Benches].name = name;
+	Bench[Benches++].us = Us(cycles);
+}
+
+//the bus side of one data ready interrupt: taking the bus, the 3 byte read and giving it back. not the handler's own run time
+static uint64_t Bench_Drdy(){
+
+	uint64_t start;
+
+	Sim_Irq_Handler(SIM_IRQ_PORTF_INT0, NULL);
+	Ad7767_Start(BENCH_RATE);
+	Sim_Advance(SIM_HZ/BENCH_RATE);
+	Expected = Corrupt = 0;
+	start = Sim_Now;
+	Drdy();
+	start = Sim_Now - start;
+	Check(!Corrupt, "sample read by the benchmark interrupt");
+	Ad7767_Start(0);
+	Sim_Irq_Handler(SIM_IRQ_PORTF_INT0, Drdy);
+	return start;
+}
+
+//writeFile of a new file and an append into a second cluster, on a fresh partition like Test_FAT32's
+static void Bench_File(FILE* image){
+
+	static uint8_t data[3*FAT_FILE_BYTES];
+	uint64_t start;
+
+	Fat32_Format(image, (SD_FIRST_SECTOR + 3*cfg.blocks + SAMPLING_BLOCKS + FAT_ALIGN - 1)/FAT_ALIGN*FAT_ALIGN);
+	Check(getBootSectorData() == 0, "getBootSectorData on the benchmark partition");
+	Fill(data, sizeof(data), 9);
+	start = Sim_Now;
+	Check(writeFile((unsigned char*)"BENCH.DAT", data, FAT_FILE_BYTES) == 0, "writeFile of the benchmark file");
+	Bench_Add("writeFile_new_2048_bus_us", Sim_Now - start);
+	start = Sim_Now;
+	Check(writeFile((unsigned char*)"BENCH.DAT", data + FAT_FILE_BYTES, 2*FAT_FILE_BYTES) == 0, "writeFile benchmark append");
+	Bench_Add("writeFile_append_4096_bus_us", Sim_Now - start);
+}
+
+static void Bench_Run(FILE* image){
+
+	static uint8_t data[FRAM_PIECE];
+	uint8_t phr = CHB_MAX_PSDU, frame[CHB_MAX_PSDU - CHB_FCS_LEN];
+	uint32_t sector = SD_FIRST_SECTOR + 3*cfg.blocks;
+	uint64_t start;
+
+	Bench_Add("drdy_read_bus_us", Bench_Drdy());
+	//the sd card held costs deselecting and reselecting it through the port expander
+	SD_Hold(TRUE);
+	Bench_Add("drdy_read_sd_held_bus_us", Bench_Drdy());
+	SD_Hold(FALSE);
+
+	Fill(data, sizeof(data), 7);
+	start = Sim_Now;
+	writeFRAM(data, sizeof(data));
+	Bench_Add("writeFRAM_4096_bus_us", Sim_Now - start);
+
+	start = Sim_Now;
+	SD_write_block(sector, data, SDHC_SECTOR_SIZE);
+	Bench_Add("SD_write_block_bus_us", Sim_Now - start);
+	SD_Hold(TRUE);
+	start = Sim_Now;
+	SD_write_block(sector, data, SDHC_SECTOR_SIZE);
+	Bench_Add("SD_write_block_held_bus_us", Sim_Now - start);
+	SD_Hold(FALSE);
+
+	Bench_File(image);
+
+	Fill(frame, sizeof(frame), 8);
+	start = Sim_Now;
+	chb_frame_write(&phr, 1, frame, sizeof(frame));
+	Bench_Add("chb_frame_write_127_bus_us", Sim_Now - start);
+	//a whole send: the upload, the radio's state changes, the frame on the air and the ack
+	start = Sim_Now;
+	Check(chb_write(RF_PEER, data, CHB_MAX_PAYLOAD) == CHB_SUCCESS, "chb_write of the benchmark frame");
+	Bench_Add("chb_write_116_bus_us", Sim_Now - start);
+}
+
+static void Bench_Write(const char* path){
+
+	FILE* out = fopen(path, "w");
+	uint8_t i;
+
+	if(!out){
+		perror("hostsim: benchmark results");
+		Failures++;
+		return;
+	}
+	fprintf(out, "# hostsim benchmarks: us on the simulated clock of the SPI bytes, delays, sd busy time (-w %u) and radio air "
+		"time.\n# the cpu's own instructions aren't counted\n", Sd_Write_Us);
+	for(i=0;i<Benches;i++) fprintf(out, "%s=%.2f\n", Bench[i].name, Bench[i].us);
+	fclose(out);
+}
+
+//times in the baseline that grew by more than BENCH_TOLERANCE percent
+static uint32_t Bench_Compare(const char* path){
+
+	FILE* in = fopen(path, "r");
+	char line[128], *eq;
+	double base;
+	uint32_t regressions = 0;
+	uint8_t i;
+
+	if(!in){
+		perror("hostsim: benchmark baseline");
+		return 1;
+	}
+	while(fgets(line, sizeof(line), in)){
+		if(line[0] == '#' || !(eq = strchr(line, '='))) continue;
+		*eq = 0;
+		base = strtod(eq + 1, NULL);
+		for(i=0;i<Benches && strcmp(Bench[i].name, line);i++);
+		if(i == Benches){
+			fprintf(stderr, "hostsim: %s is in the baseline but wasn't measured\n", line);
+			regressions++;
+			continue;
+		}
+		if(Bench[i].us*100 <= base*(100 + BENCH_TOLERANCE)) continue;
+		fprintf(stderr, "hostsim: %s went from %.2f to %.2f\n", line, base, Bench[i].us);
+		regressions++;
+	}
+	fclose(in);
+	return regressions;
+}
+
+static void Usage(){
+	fprintf(stderr, "usage: hostsim [-i disk image] [-n sd blocks] [-w sd write busy us] [-f sample rate Hz, 0 to search]\n"
+		"               [-b benchmark results] [-r benchmark baseline]\n");
+	exit(1);
+}
+
+int main(int argc, char** argv){
+
+	int opt;
+	FILE* image;
+	double FramWrite, FramRead, SdSingle, SdHeld, SdMulti, SdRead, RfTx, RfRx, SerialOut, SerialIn;
+	uint32_t rate, best = 0, SerialLost;
+	uint64_t latency, BestLatency = 0;
+
+	while((opt = getopt(argc, argv, "i:n:w:f:b:r:")) != -1){
+		switch(opt){
+		case 'i': cfg.image = optarg; break;
+		case 'n': cfg.blocks = atoi(optarg); break;
+		case 'w': Sd_Write_Us = atoi(optarg); break;
+		case 'f': cfg.rate = atoi(optarg); break;
+		case 'b': cfg.bench = optarg; break;
+		case 'r': cfg.baseline = optarg; break;
+		default: Usage();
+		}
+	}
+	if(!cfg.blocks) Usage();
+	image = cfg.image ? fopen(cfg.image, "r+b") : tmpfile();
+	if(!image && cfg.image) image = fopen(cfg.image, "w+b");
+	if(!image){
+		perror("hostsim: disk image");
+		return 1;
+	}
+
+	Chips_Init(image);
+	init();
+	Test_Clock();
+	Test_PortEx();
+	Test_FRAM(&FramWrite, &FramRead);
+	Test_SD(image, &SdSingle, &SdHeld, &SdMulti, &SdRead);
+	Test_FAT32(image);
+	//as CO_collectADC sets up the data ready interrupt
+	Sim_Irq_Handler(SIM_IRQ_PORTF_INT0, Drdy);
+	Hal_Gpio_Input(HAL_PORTF, PIN0_bm);
+	Hal_Gpio_Pin_Ctrl(HAL_PORTF, 0, PORT_ISC_FALLING_gc | PORT_OPC_TOTEM_gc);
+	Hal_Gpio_Int0_Mask(HAL_PORTF, PIN0_bm);
+	Hal_Gpio_Int_Ctrl(HAL_PORTF, PORT_INT0LVL_MED_gc);
+	Hal_Irq_Levels_On(PMIC_LOLVLEN_bm | PMIC_MEDLVLEN_bm);
+	if(cfg.rate){
+		if(Sampling_Run(cfg.rate, &latency)){
+			best = cfg.rate;
+			BestLatency = latency;
+		}
+	}
+	else{
+		for(rate=RATE_MIN;rate<=RATE_MAX && Sampling_Run(rate, &latency);rate*=2){
+			best = rate;
+			BestLatency = latency;
+		}
+	}
+	Test_Radio(&RfTx, &RfRx);
+	Test_Serial(&SerialOut, &SerialIn, &SerialLost);
+	if(cfg.bench || cfg.baseline){
+		Bench_Run(image);
+		if(cfg.bench) Bench_Write(cfg.bench);
+		if(cfg.baseline) Failures += Bench_Compare(cfg.baseline);
+	}
+	SD_disable();
+	fclose(image);
+
+	printf("RESULT fram_write_kBps=%.1f fram_read_kBps=%.1f sd_write_kBps=%.1f sd_write_held_kBps=%.1f "
+		"sd_write_multi_kBps=%.1f sd_read_kBps=%.1f max_rate_bus_hz=%u latency_us=%.1f radio_tx_us=%.1f "
+		"radio_rx_us=%.1f serial_out_kBps=%.1f serial_in_kBps=%.1f serial_lost_in_sd_writes=%u errors=%u failures=%u\n",
+		FramWrite, FramRead, SdSingle, SdHeld, SdMulti, SdRead, best, Us(BestLatency), RfTx, RfRx, SerialOut, SerialIn,
+		SerialLost, Sim_Errors, Failures);
+	return (Sim_Errors || Failures) ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * sim.h
+ *
+ * Created: 10/19/2026
+ */
+// what halsim.c, the chip models (chips.c) and the test driver (hostsim.c) share
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "HalSim.h"
+
+#define SIM_HZ 32000000ULL	// F_CPU
+#define SIM_PORTS 6
+#define SIM_SPIS 2
+#define SIM_EEPROM_BYTES 4096
+#define SIM_TCS 5	// TCD1, TCE0, TCF0, TCC0, TCD0
+#define SIM_RTC_HZ 32768
+#define SIM_US(us) ((uint64_t)((us)*(SIM_HZ/1000000)))
+
+// pins and time (halsim.c)
+extern uint64_t Sim_Now;	// cpu cycles
+extern uint8_t Sim_Out[SIM_PORTS];
+extern uint8_t Sim_Dir[SIM_PORTS];
+extern uint8_t Sim_In[SIM_PORTS];	// levels the chips drive
+uint8_t Sim_Driven_Low(uint8_t port, uint8_t pin);
+uint8_t Sim_Driven_High(uint8_t port, uint8_t pin);
+// a chip drives one of its outputs. an edge raises the port's INT0 as the firmware set the pin up (Hal_Gpio_Pin_Ctrl,
+// Hal_Gpio_Int0_Mask)
+void Sim_Pin_Drive(uint8_t port, uint8_t pin, uint8_t high);
+// move the clock on. interrupts that come due run where they would if they are on
+void Sim_Advance(uint64_t cycles);
+// the chips' select lines may have changed, tell the ones that changed
+void Sim_Update_Selects();
+// an error in how the firmware works the hardware. counted and printed
+void Sim_Error(const char* fmt, ...);
+extern uint32_t Sim_Errors;
+
+// interrupts, in the order of their vectors, which is their priority within a level. a handler runs wherever the board would
+// take its interrupt: once it is requested, its level is on (Hal_Irq_Levels_On), interrupts are on and no handler of the
+// same or a higher level is running. an edge (a pin, a compare) is cleared as its handler starts and a second one before
+// that is lost, like on the chip. a flag (the USART's) requests for as long as it is up
+enum{
+	SIM_IRQ_RTC_COMP,	// event wakeups, ISR(RTC_COMP_vect)
+	SIM_IRQ_USARTC0_RXC,
+	SIM_IRQ_USARTC0_DRE,
+	SIM_IRQ_PORTE_INT0,
+	SIM_IRQ_PORTD_INT0,	// the AT86RF212's IRQ, ISR(PORTD_INT0_vect)
+	SIM_IRQ_PORTF_INT0,	// the AD7767's data ready, ISR(PORTF_INT0_vect)
+	SIM_IRQ_TCF0_CCC,	// the root's synch beacons, ISR(TCF0_CCC_vect)
+	SIM_IRQ_TCF0_CCD,	// event deadlines on the local clock, ISR(TCF0_CCD_vect)
+	SIM_IRQS
+};
+void Sim_Irq_Handler(uint8_t irq, void (*handler)());
+void Sim_Irq_Level(uint8_t irq, uint8_t level);	// 0 off, 1 low, 2 medium, 3 high, as the firmware set it up
+void Sim_Irq_Raise(uint8_t irq);	// an edge
+void Sim_Irq_Flag(uint8_t irq, uint8_t up);
+void Sim_Irq_Clear(uint8_t irq);
+extern uint64_t Sim_Irq_Off_Max;	// longest stretch with interrupts off outside of the handlers (cycles)
+extern uint64_t Sim_Irq_Latency_Max[SIM_IRQS];	// longest wait from a request to its handler (cycles)
+void Sim_Reset_Stats();
+
+// models that change with time. next returns when the next change is due, 0 for none, and due makes it. Sim_Advance steps
+// them as the clock goes past
+void Sim_Timed(uint64_t (*next)(), void (*due)());
+// the peripherals halsim.c models besides the pins and SPI. Chips_Init calls it
+void Sim_Init();
+
+// the host on the other end of USARTC0. bytes sent come in back to back at the baud rate the firmware set
+void Sim_Serial_Send(const uint8_t* data, uint16_t length);
+uint16_t Sim_Serial_Received(uint8_t* data);	// what the firmware sent since the last call
+extern uint32_t Sim_Serial_Overruns;	// bytes lost with the module's receive buffer full
+
+// the EEPROM, erased when the simulation starts
+extern uint8_t Sim_Eeprom[SIM_EEPROM_BYTES];
+extern uint32_t Sim_Eeprom_Writes;
+
+// the system clock prescaler (Hal_Clock_Prescalers): the cpu and the peripherals run at SIM_HZ/Sim_Clock_Div
+extern uint16_t Sim_Clock_Div;
+extern uint64_t Sim_Stopped;	// cycles spent in power-save
+
+// chips (chips.c). each one sits on a SPI module and works out whether it is selected from the pins
+typedef struct{
+	const char* name;
+	uint8_t spi;
+	uint8_t (*powered)();	// NULL if always on. held in reset counts as off
+	uint8_t (*selected)();
+	void (*reset)();	// power came up
+	void (*select)(uint8_t on);	// select line changed, NULL if the chip doesn't care
+	uint8_t (*transfer)(uint8_t mosi);	// a byte while selected, returns miso
+	uint8_t listener;	// only takes bytes, never drives miso
+	uint8_t up;
+	uint8_t on;
+	void (*pins)();	// any pin changed, NULL if the chip only cares about its select
+} Sim_Chip_t;
+
+#define SIM_CHIPS 8
+extern Sim_Chip_t* Sim_Chips[SIM_CHIPS];	// NULL terminated
+void Chips_Init(FILE* image);
+
+// what the tests look at
+extern uint8_t Fram_Mem[65536];
+uint8_t PortEx_Reg(uint8_t reg);
+uint32_t Ad7767_Sample(uint32_t n);	// the n-th sample the converter puts out
+void Ad7767_Start(uint32_t rate);	// 0 to stop
+uint32_t Ad7767_Converted();
+extern uint32_t Sd_Write_Us;	// programming time per block
+uint32_t Sd_Blocks_Written();
+uint8_t Radio_Reg(uint8_t reg);
+const uint8_t* Radio_Sent();	// PHR and PSDU of the last frame sent, the FCS bytes as they were in the frame buffer
+uint32_t Radio_Frames_Sent();
+// a frame from another node starts coming in now. length counts the FCS, crc tells whether it checks out and ed is the
+// energy it comes in with. missed unless the radio is listening and idle
+void Radio_Receive(const uint8_t* psdu, uint8_t length, uint8_t crc, uint8_t ed);
+uint32_t Radio_Frames_Missed();
+extern uint8_t Radio_Acks;	// the nodes frames go to ack them, TRUE to start with
+extern uint8_t Radio_Noise;	// what an energy detection measures
+extern uint64_t Radio_Irq_Edge;	// when IRQ last went up
+
+#endif /* SIM_H_ */
@@ -0,0 +1,9 @@
+// host stand-in for avr/interrupt.h. the simulation only switches interrupts through the HAL (Hal_Irq_Save,
+// Hal_Irq_Restore, ...), so SREG, cli and sei aren't here
+#ifndef HOSTSIM_INTERRUPT_H_
+#define HOSTSIM_INTERRUPT_H_
+
+// the handlers are plain functions halsim.c calls
+#define ISR(vector) void vector(void)
+
+#endif
@@ -0,0 +1,137 @@
+// host stand-in for avr/io.h: the bit and group values the drivers on the HAL still name
+#ifndef HOSTSIM_IO_H_
+#define HOSTSIM_IO_H_
+
+#include <stdint.h>
+#include <stdbool.h>	// on the target it comes with clksys_driver.h, which the Makefile keeps out
+
+#define PIN0_bm 0x01
+#define PIN1_bm 0x02
+#define PIN2_bm 0x04
+#define PIN3_bm 0x08
+#define PIN4_bm 0x10
+#define PIN5_bm 0x20
+#define PIN6_bm 0x40
+#define PIN7_bm 0x80
+#define _BV(bit) (1 << (bit))
+
+#define PORT_ISC_gm 0x07
+#define PORT_ISC_BOTHEDGES_gc 0x00
+#define PORT_ISC_RISING_gc 0x01
+#define PORT_ISC_FALLING_gc 0x02
+#define PORT_ISC_LEVEL_gc 0x03
+#define PORT_OPC_TOTEM_gc 0x00
+#define PORT_OPC_WIREDANDPULL_gc 0x38
+#define PORT_INT0LVL_gm 0x03
+#define PORT_INT0LVL_OFF_gc 0x00
+#define PORT_INT0LVL_LO_gc 0x01
+#define PORT_INT0LVL_MED_gc 0x02
+#define PORT_INT0LVL_HI_gc 0x03
+
+#define SPI_CLK2X_bm 0x80
+#define SPI_ENABLE_bm 0x40
+#define SPI_DORD_bm 0x20
+#define SPI_MASTER_bm 0x10
+#define SPI_MODE_gm 0x0C
+#define SPI_MODE_0_gc 0x00
+#define SPI_MODE_1_gc 0x04
+#define SPI_MODE_2_gc 0x08
+#define SPI_MODE_3_gc 0x0C
+#define SPI_PRESCALER_gm 0x03
+#define SPI_PRESCALER_DIV4_gc 0x00
+#define SPI_PRESCALER_DIV16_gc 0x01
+#define SPI_PRESCALER_DIV64_gc 0x02
+#define SPI_PRESCALER_DIV128_gc 0x03
+
+#define PMIC_HILVLEN_bm 0x04
+#define PMIC_MEDLVLEN_bm 0x02
+#define PMIC_LOLVLEN_bm 0x01
+
+#define USART_RXCIF_bm 0x80
+#define USART_TXCIF_bm 0x40
+#define USART_DREIF_bm 0x20
+#define USART_BUFOVF_bm 0x08
+#define USART_RXCINTLVL_gm 0x30
+#define USART_RXCINTLVL_OFF_gc 0x00
+#define USART_RXCINTLVL_LO_gc 0x10
+#define USART_RXCINTLVL_MED_gc 0x20
+#define USART_RXCINTLVL_HI_gc 0x30
+#define USART_DREINTLVL_gm 0x03
+#define USART_DREINTLVL_OFF_gc 0x00
+#define USART_DREINTLVL_LO_gc 0x01
+#define USART_DREINTLVL_MED_gc 0x02
+#define USART_DREINTLVL_HI_gc 0x03
+#define USART_RXEN_bm 0x10
+#define USART_TXEN_bm 0x08
+#define USART_CLK2X_bm 0x04
+
+#define TC0_CLKSEL_gm 0x0F
+#define TC1_CLKSEL_gm 0x0F
+#define TC_CLKSEL_OFF_gc 0x00
+#define TC_CLKSEL_DIV1_gc 0x01
+#define TC_CLKSEL_DIV2_gc 0x02
+#define TC_CLKSEL_DIV4_gc 0x03
+#define TC_CLKSEL_DIV8_gc 0x04
+#define TC_CLKSEL_DIV64_gc 0x05
+#define TC_CLKSEL_DIV256_gc 0x06
+#define TC_CLKSEL_DIV1024_gc 0x07
+#define TC_CLKSEL_EVCH0_gc 0x08
+#define TC_CLKSEL_EVCH4_gc 0x0C
+#define TC0_CCDEN_bm 0x80
+#define TC0_CCCEN_bm 0x40
+#define TC0_CCBEN_bm 0x20
+#define TC0_CCAEN_bm 0x10
+#define TC1_CCBEN_bm 0x20
+#define TC1_CCAEN_bm 0x10
+#define TC0_EVACT_gm 0xE0
+#define TC_EVACT_OFF_gc 0x00
+#define TC_EVACT_CAPT_gc 0x20
+#define TC0_EVDLY_bm 0x10
+#define TC0_EVSEL_gm 0x0F
+#define TC_EVSEL_OFF_gc 0x00
+#define TC_EVSEL_CH0_gc 0x08
+#define TC_EVSEL_CH2_gc 0x0A
+#define TC0_CCDINTLVL_gm 0xC0
+#define TC0_CCCINTLVL_gm 0x30
+#define TC_CCDINTLVL_LO_gc 0x40
+#define TC_CCCINTLVL_LO_gc 0x10
+#define TC0_CCDIF_bm 0x80
+#define TC0_CCCIF_bm 0x40
+#define TC0_CCBIF_bm 0x20
+#define TC0_CCAIF_bm 0x10
+#define TC0_ERRIF_bm 0x02
+#define TC0_OVFIF_bm 0x01
+#define TC1_CCBIF_bm 0x20
+#define TC1_CCAIF_bm 0x10
+
+#define EVSYS_CHMUX_PORTA_PIN0_gc 0x50	// then 8 per port
+#define EVSYS_CHMUX_PORTD_PIN2_gc 0x6A
+#define EVSYS_CHMUX_PORTF_PIN0_gc 0x78
+#define EVSYS_CHMUX_TCC0_OVF_gc 0xC0
+#define EVSYS_CHMUX_TCD0_OVF_gc 0xD0
+#define EVSYS_CHMUX_TCD1_OVF_gc 0xD8
+#define EVSYS_CHMUX_TCE0_OVF_gc 0xE0
+#define EVSYS_CHMUX_TCF0_OVF_gc 0xF0
+
+#define CLK_RTCSRC_gm 0x0E
+#define CLK_RTCSRC_TOSC32_gc 0x0A
+#define CLK_RTCEN_bm 0x01
+#define RTC_SYNCBUSY_bm 0x01
+#define RTC_PRESCALER_gm 0x07
+#define RTC_PRESCALER_OFF_gc 0x00
+#define RTC_PRESCALER_DIV1_gc 0x01
+#define RTC_COMPINTLVL_gm 0x0C
+#define RTC_COMPINTLVL_LO_gc 0x04
+#define RTC_OVFINTLVL_gm 0x03
+#define RTC_COMPIF_bm 0x02
+#define RTC_OVFIF_bm 0x01
+
+#define CLK_PSADIV_gm 0x7C
+#define CLK_PSADIV_1_gc 0x00
+#define CLK_PSADIV_8_gc 0x14
+#define CLK_PSBCDIV_1_1_gc 0x00
+
+#define SLEEP_SMODE_IDLE_gc 0x00
+#define SLEEP_SMODE_PSAVE_gc 0x06
+
+#endif
@@ -0,0 +1,8 @@
+// host stand-in for avr/pgmspace.h
+#ifndef HOSTSIM_PGMSPACE_H_
+#define HOSTSIM_PGMSPACE_H_
+
+#define PROGMEM
+#define strcpy_P strcpy
+
+#endif
@@ -0,0 +1,6 @@
+// host stand-in for util/delay.h. the drivers on the HAL wait with Hal_Delay_Us/Hal_Delay_Ms, which move the simulated
+// clock on; _delay_ isn't provided so a driver that still calls it doesn't build
+#ifndef HOSTSIM_DELAY_H_
+#define HOSTSIM_DELAY_H_
+
+#endif
@@ -0,0 +1,471 @@
+/*
+ * meshsim.c
+ *
+ * Created: 10/19/2026
+ */
+// Host simulation of the multi-hop mesh (FirmwareLib/FirmwareLib/Mesh.c) to measure delivery and throughput.
+// The motes sit on a line (like along a dam embankment) with the base station at one end. The real Mesh.c is compiled in
+// and run once per mote, its state, FRAM and radio swapped in and out around every call. The radio is modeled with log
+// distance path loss plus shadowing for the ed, a packet error rate that goes with the ed, csma, mac retries and
+// collisions from hidden motes. With -w the base station also floods a command every so often, and -r restarts it halfway
+// through the run to check that the motes still take its floods afterwards. -x makes a mote send forged floods as well,
+// which only motes further from the base station than the forger should take.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+// stand-ins for the firmware headers Mesh.c includes. the include guards keep the real ones out.
+#define CONSTANTS_AND_GLOBALS_H_
+#define UTILITY_FUNCTIONS_H_
+#define CHIBI_H
+#define CHIBI_DRVR_H
+#define FRAM_H
+#define CHB_EEPROM_H
+#define ADC_H_
+#define LPL_H_
+
+#define TRUE 1
+#define FALSE 0
+#define CHB_MAX_PSDU 127
+#define CHB_MAX_PAYLOAD 116
+enum{
+	CHB_SUCCESS = 0,
+	CHB_CHANNEL_ACCESS_FAILURE = 3,
+	CHB_NO_ACK = 5
+};
+
+typedef struct{
+	uint16_t sender_addr;
+	uint16_t destination_addr;
+	uint8_t ed;
+} pcb_t;
+
+static pcb_t* chb_get_pcb();
+static uint16_t chb_get_short_addr();
+static uint8_t chb_get_max_payload(uint16_t addr);
+static uint8_t chb_write(uint16_t addr, uint8_t* data, uint8_t length);
+static void writeFRAMAt(uint8_t* buffer, uint16_t length, uint16_t address);
+static void readFRAM(uint16_t numBytes, uint16_t startAddress);
+static void chb_eeprom_read(uint16_t addr, uint8_t* buf, uint16_t size);
+static void chb_eeprom_update(uint16_t addr, uint8_t* buf, uint16_t size);
+// the simulated motes listen all the time
+#define LPL_Send chb_write
+static uint8_t FRAMReadBuffer[CHB_MAX_PSDU];
+static volatile uint8_t ADC_Sampling_Finished = 1;
+static int32_t* ADC_BUFFER = NULL;
+
+#include "../../FirmwareLib/FirmwareLib/Mesh.c"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// simulation
+
+#define MAX_NODES 64
+#define INBOX_SIZE 4	// frames the radio buffer holds before overflowing
+#define MAX_TX 64	// transmissions kept around for collision checks
+#define MAX_RETRIES 3	// mac retries of the radio (auto ack mode)
+#define MAX_CSMA 4
+#define FRAME_OVERHEAD 28	// phy and mac header, fcs and ack frame bytes
+#define CCA_ED 8	// ed above which the channel counts as busy
+#define RECORD_HEADER 6	// seq (2 bytes), creation time (4 bytes)
+#define SIM_FLOOD 'Z'	// flooded command: 'Z', flood number (2 bytes)
+#define SIM_FORGED 'X'	// forged flood command
+
+typedef struct{
+	uint8_t data[CHB_MAX_PSDU];
+	uint8_t length;
+	uint16_t sender, destination;
+	uint8_t ed;
+} sim_frame_t;
+
+typedef struct{
+	uint16_t src;
+	uint32_t start, end;
+} sim_tx_t;
+
+typedef struct{
+	__typeof__(Mesh) mesh;
+	uint8_t fram[0x10000];
+	uint8_t eeprom[0x100];
+	sim_frame_t inbox[INBOX_SIZE];
+	uint8_t InboxHead, InboxCount;
+	uint32_t busy_until, next_hello, next_record, next_flood;
+	uint16_t seq;
+	uint32_t generated, overflows;
+	uint16_t LastFlood;
+	uint32_t floods;	// floods handed to the app
+} sim_node_t;
+
+static struct{
+	uint8_t nodes;	// including the base station (node 0)
+	double spacing;	// m
+	uint32_t duration;	// ms
+	uint32_t interval;	// ms between records per mote
+	uint8_t RecordLength;
+	double power;	// dBm
+	double shadowing;	// dB
+	uint16_t bitrate;	// kbps
+	uint32_t FloodInterval;	// ms between floods, 0 for none
+	uint8_t restart;	// restart the base station halfway through
+	uint8_t forger;	// mote sending forged floods, 0 for none
+} cfg = {7, 40, 600000, 1000, 24, 5, 4, 250, 0, FALSE, 0};
+
+static sim_node_t* node;
+static sim_tx_t tx[MAX_TX];
+static uint8_t NextTx;
+static uint8_t current;
+static pcb_t pcb;
+static uint32_t now;	// ms
+
+static struct{
+	uint32_t frames, collisions, delivered, duplicates, bytes;
+	uint32_t floods, FloodDuplicates, forged;
+	uint64_t latency;
+	uint32_t from[MAX_NODES];	// delivered records per origin
+	uint32_t MaxLatency;
+	uint8_t* seen;	// per origin and seq
+} result;
+
+static double Uniform(){
+	return (rand() + 1.0)/(RAND_MAX + 2.0);
+}
+
+static double Gaussian(){
+	return sqrt(-2*log(Uniform()))*cos(2*M_PI*Uniform());
+}
+
+//mean ed (0..84, 1dB steps above -100dBm like the AT86RF212) between two motes
+static double Mean_ED(uint8_t a, uint8_t b){
+	double d = fabs((double)a - b)*cfg.spacing;
+	if(d < 1) d = 1;
+	return cfg.power - (40 + 30*log10(d)) + 100;
+}
+
+static uint8_t Sample_ED(uint8_t a, uint8_t b){
+	double ed = Mean_ED(a, b) + cfg.shadowing*Gaussian();
+	if(ed < 0) return 0;
+	if(ed > 84) return 84;
+	return (uint8_t)ed;
+}
+
+//frame success probability for an ed. ~50% at 6dB above sensitivity
+static uint8_t Frame_OK(uint8_t ed){
+	return Uniform() < 1/(1 + exp(-(ed - 6)/1.5));
+}
+
+static uint32_t Airtime(uint8_t length){
+	return ((uint32_t)(length + FRAME_OVERHEAD)*8 + cfg.bitrate - 1)/cfg.bitrate;
+}
+
+//another transmission audible at receiver r overlapping [start, end) that isn't from s
+static uint8_t Collides(uint8_t s, uint8_t r, uint32_t start, uint32_t end){
+	for(uint8_t i=0;i<MAX_TX;i++){
+		if(tx[i].end <= start || tx[i].start >= end || tx[i].src == s || tx[i].src == r) continue;
+		if(Mean_ED(tx[i].src, r) > CCA_ED) return TRUE;
+	}
+	return FALSE;
+}
+
+static uint8_t Channel_Busy(uint8_t s, uint32_t t){
+	for(uint8_t i=0;i<MAX_TX;i++){
+		if(tx[i].start <= t && tx[i].end > t && tx[i].src != s && Mean_ED(tx[i].src, s) > CCA_ED) return TRUE;
+	}
+	return FALSE;
+}
+
+static void Deliver(uint8_t r, uint8_t s, uint16_t destination, uint8_t* data, uint8_t length, uint8_t ed){
+
+	sim_node_t* n = &node[r];
+	sim_frame_t* f;
+
+	if(n->InboxCount == INBOX_SIZE){
+		n->overflows++;
+		return;
+	}
+	f = &n->inbox[(n->InboxHead + n->InboxCount++) % INBOX_SIZE];
+	memcpy(f->data, data, length);
+	f->length = length;
+	f->sender = s;
+	f->destination = destination;
+	f->ed = ed;
+}
+
+static pcb_t* chb_get_pcb(){
+	return &pcb;
+}
+
+static uint16_t chb_get_short_addr(){
+	return current;
+}
+
+static uint8_t chb_get_max_payload(uint16_t addr){
+	return CHB_MAX_PAYLOAD;
+}
+
+//blocking like the real chb_write: the mote is busy for the airtime of every attempt
+static uint8_t chb_write(uint16_t addr, uint8_t* data, uint8_t length){
+
+	uint32_t t = node[current].busy_until > now ? node[current].busy_until : now;
+	uint32_t end;
+	uint8_t attempt, backoff, ed;
+
+	for(attempt=0;attempt<=MAX_RETRIES;attempt++){
+		for(backoff=0;backoff<MAX_CSMA && Channel_Busy(current, t);backoff++) t += 1 + rand()%(2 << backoff);
+		if(backoff == MAX_CSMA){
+			node[current].busy_until = t;
+			return CHB_CHANNEL_ACCESS_FAILURE;
+		}
+		end = t + Airtime(length);
+		tx[NextTx].src = current;
+		tx[NextTx].start = t;
+		tx[NextTx].end = end;
+		NextTx = (NextTx + 1) % MAX_TX;
+		result.frames++;
+
+		if(addr == 0xFFFF){
+			for(uint8_t r=0;r<cfg.nodes;r++){
+				if(r == current) continue;
+				ed = Sample_ED(current, r);
+				if(!Frame_OK(ed)) continue;
+				if(Collides(current, r, t, end)){
+					result.collisions++;
+					continue;
+				}
+				Deliver(r, current, addr, data, length, ed);
+			}
+			node[current].busy_until = end;
+			return CHB_SUCCESS;
+		}
+
+		ed = Sample_ED(current, addr);
+		if(addr < cfg.nodes && Frame_OK(ed)){
+			if(Collides(current, addr, t, end)) result.collisions++;
+			else{
+				//the radio acks in hardware so the frame counts as delivered even if it gets lost in a full buffer
+				Deliver(addr, current, addr, data, length, ed);
+				if(Frame_OK(Sample_ED(addr, current))){
+					node[current].busy_until = end;
+					return CHB_SUCCESS;
+				}
+			}
+		}
+		t = end + 1;
+	}
+	node[current].busy_until = t;
+	return CHB_NO_ACK;
+}
+
+static void writeFRAMAt(uint8_t* buffer, uint16_t length, uint16_t address){
+	memcpy(node[current].fram + address, buffer, length);
+}
+
+static void readFRAM(uint16_t numBytes, uint16_t startAddress){
+	memcpy(FRAMReadBuffer, node[current].fram + startAddress, numBytes);
+}
+
+static void chb_eeprom_read(uint16_t addr, uint8_t* buf, uint16_t size){
+	memcpy(buf, node[current].eeprom + addr, size);
+}
+
+static void chb_eeprom_update(uint16_t addr, uint8_t* buf, uint16_t size){
+	memcpy(node[current].eeprom + addr, buf, size);
+}
+
+static void Enter(uint8_t n){
+	current = n;
+	Mesh = node[n].mesh;
+}
+
+static void Leave(){
+	node[current].mesh = Mesh;
+}
+
+static void Base_Record(uint8_t* record, uint8_t length){
+
+	uint16_t origin = *(uint16_t*)record;
+	uint8_t* data = record + MESH_RECORD_HEADER_LENGTH;
+	uint16_t seq;
+	uint32_t created, latency;
+	uint32_t index;
+
+	if(length < MESH_RECORD_HEADER_LENGTH + RECORD_HEADER || origin >= cfg.nodes) return;
+	memcpy(&seq, data, 2);
+	memcpy(&created, data + 2, 4);
+	index = (uint32_t)origin*65536 + seq;
+	if(result.seen[index]){
+		result.duplicates++;
+		return;
+	}
+	result.seen[index] = TRUE;
+	latency = now - created;
+	result.delivered++;
+	result.bytes += length - MESH_RECORD_HEADER_LENGTH;
+	result.latency += latency;
+	result.from[origin]++;
+	if(latency > result.MaxLatency) result.MaxLatency = latency;
+}
+
+//one pass through the main loop of a mote (Node.c) or the base station
+static void Step(uint8_t n){
+
+	sim_node_t* s = &node[n];
+	uint8_t record[MESH_RECORD_HEADER_LENGTH + MESH_MAX_RECORD];
+	uint8_t length;
+	uint16_t flood;
+	sim_frame_t* f;
+
+	if(s->busy_until > now) return;
+	Enter(n);
+	if(now >= s->next_hello){
+		Mesh_Send_Hello();
+		s->next_hello += MESH_HELLO_PERIOD*1000;
+	}
+	if(n != 0 && now >= s->next_record){
+		memset(record, 0, sizeof(record));
+		memcpy(record, &s->seq, 2);
+		memcpy(record + 2, &now, 4);
+		Mesh_Enqueue(n, record, cfg.RecordLength);
+		s->seq++;
+		s->generated++;
+		s->next_record += cfg.interval;
+	}
+	if(n == 0 && cfg.FloodInterval && now >= s->next_flood){
+		flood = ++result.floods;
+		record[0] = SIM_FLOOD;
+		memcpy(record + 1, &flood, 2);
+		Mesh_Flood(record, 3);
+		s->next_flood += cfg.FloodInterval;
+	}
+	if(n != 0 && n == cfg.forger && cfg.FloodInterval && now >= s->next_flood){
+		//a flood that looks newer than the last real one
+		record[0] = MESH_FLOOD;
+		record[1] = Mesh.FloodEpoch;
+		record[2] = Mesh.FloodSeq + 1;
+		record[3] = SIM_FORGED;
+		LPL_Send(0xFFFF, record, 4);
+		s->next_flood += cfg.FloodInterval;
+	}
+	if(s->InboxCount){
+		f = &s->inbox[s->InboxHead];
+		s->InboxHead = (s->InboxHead + 1) % INBOX_SIZE;
+		s->InboxCount--;
+		pcb.sender_addr = f->sender;
+		pcb.destination_addr = f->destination;
+		pcb.ed = f->ed;
+		length = f->length;
+		//what the app would take as a command from the base station
+		if(!Mesh_Handle_Frame(f->data, &length) && pcb.sender_addr == MESH_BASE_ADDR){
+			if(length == 3 && f->data[0] == SIM_FLOOD){
+				memcpy(&flood, f->data + 1, 2);
+				if(flood == s->LastFlood) result.FloodDuplicates++;
+				else s->floods++;
+				s->LastFlood = flood;
+			}
+			else if(length == 1 && f->data[0] == SIM_FORGED) result.forged++;
+		}
+	}
+	if(n == 0){
+		//the host drains the base station's queue
+		while((length = Mesh_Dequeue(record)) != 0) Base_Record(record, length);
+	}
+	else if(Mesh_Queue_Length() && !s->InboxCount){
+		Mesh_Forward();
+	}
+	Leave();
+}
+
+static void Usage(){
+	fprintf(stderr, "usage: meshsim [-n motes] [-d spacing m] [-t duration s] [-i record interval ms] [-l record length]\n"
+		"               [-p tx power dBm] [-g shadowing dB] [-b bitrate kbps] [-s seed] [-w flood interval ms] [-r]\n"
+		"               [-x forging mote]\n");
+	exit(1);
+}
+
+int main(int argc, char** argv){
+
+	int opt;
+	unsigned seed = 1;
+	uint32_t generated = 0, overflows = 0, dropped = 0, failures = 0, changes = 0, routed = 0, floods = 0;
+	uint64_t hops = 0;
+
+	while((opt = getopt(argc, argv, "n:d:t:i:l:p:g:b:s:w:rx:")) != -1){
+		switch(opt){
+		case 'n': cfg.nodes = atoi(optarg) + 1; break;
+		case 'd': cfg.spacing = atof(optarg); break;
+		case 't': cfg.duration = atoi(optarg)*1000; break;
+		case 'i': cfg.interval = atoi(optarg); break;
+		case 'l': cfg.RecordLength = atoi(optarg); break;
+		case 'p': cfg.power = atof(optarg); break;
+		case 'g': cfg.shadowing = atof(optarg); break;
+		case 'b': cfg.bitrate = atoi(optarg); break;
+		case 's': seed = atoi(optarg); break;
+		case 'w': cfg.FloodInterval = atoi(optarg); break;
+		case 'r': cfg.restart = TRUE; break;
+		case 'x': cfg.forger = atoi(optarg); break;
+		default: Usage();
+		}
+	}
+	if(cfg.nodes < 2 || cfg.forger >= cfg.nodes || cfg.nodes > MAX_NODES || cfg.interval == 0 || cfg.bitrate == 0
+		|| cfg.RecordLength < RECORD_HEADER || cfg.RecordLength > MESH_MAX_RECORD) Usage();
+	srand(seed);
+
+	node = calloc(cfg.nodes, sizeof(sim_node_t));
+	result.seen = calloc((size_t)cfg.nodes*65536, 1);
+	if(!node || !result.seen) return 1;
+	for(uint8_t n=0;n<cfg.nodes;n++){
+		Enter(n);
+		Mesh_Init(n == 0);
+		Leave();
+		node[n].next_hello = rand()%(MESH_HELLO_PERIOD*1000);
+		//give the tree a few hello periods to form before data starts
+		node[n].next_record = 3*MESH_HELLO_PERIOD*1000 + rand()%cfg.interval;
+		node[n].next_flood = 3*MESH_HELLO_PERIOD*1000;
+	}
+
+	for(now=0;now<cfg.duration;now++){
+		if(cfg.restart && now == cfg.duration/2){
+			//the base station comes back up with a new flood epoch and counts floods from 1 again
+			Enter(0);
+			Mesh_Init(TRUE);
+			Leave();
+		}
+		//random order every ms so no mote always goes first
+		uint8_t start = rand()%cfg.nodes;
+		for(uint8_t i=0;i<cfg.nodes;i++) Step((start + i)%cfg.nodes);
+	}
+
+	printf("mote  hops parent  ed(parent) generated  queued  forwarded dropped tx_fail changes overflows\n");
+	for(uint8_t n=0;n<cfg.nodes;n++){
+		mesh_stats_t* st = &node[n].mesh.stats;
+		mesh_neighbor_t* p = NULL;
+		Enter(n);
+		p = Mesh_Find_Neighbor(Mesh.parent, FALSE);
+		printf("%4u  %4u %6u  %10u %9u %7u %10u %7u %7u %7u %9u\n", n, Mesh_Get_Hops(), n ? Mesh_Get_Parent() : 0,
+			p ? p->ed : 0, node[n].generated, st->queued, st->forwarded, st->dropped, st->tx_failures, st->parent_changes,
+			node[n].overflows);
+		Leave();
+		generated += node[n].generated;
+		overflows += node[n].overflows;
+		dropped += st->dropped;
+		failures += st->tx_failures;
+		changes += st->parent_changes;
+		floods += node[n].floods;
+		//average path length of the delivered records, by the hop count each mote ended up with
+		if(n && node[n].mesh.hops != MESH_NO_ROUTE){
+			hops += (uint64_t)result.from[n]*node[n].mesh.hops;
+			routed += result.from[n];
+		}
+	}
+	printf("RESULT motes=%u spacing=%.0f duration=%u generated=%u delivered=%u delivery=%.4f duplicates=%u throughput_bps=%.1f "
+		"latency_avg_ms=%.1f latency_max_ms=%u hops_avg=%.2f frames=%u collisions=%u dropped=%u overflows=%u tx_failures=%u "
+		"parent_changes=%u floods=%u flood_delivery=%.4f flood_duplicates=%u forged_taken=%u\n",
+		cfg.nodes - 1, cfg.spacing, cfg.duration/1000, generated, result.delivered, generated ? (double)result.delivered/generated : 0,
+		result.duplicates, result.bytes*8.0*1000/cfg.duration, result.delivered ? (double)result.latency/result.delivered : 0,
+		result.MaxLatency, routed ? (double)hops/routed : 0, result.frames, result.collisions,
+		dropped, overflows, failures, changes, result.floods,
+		result.floods ? (double)floods/((double)result.floods*(cfg.nodes - 1)) : 0, result.FloodDuplicates, result.forged);
+	return 0;
+}